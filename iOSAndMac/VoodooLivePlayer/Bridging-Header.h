@@ -3,8 +3,13 @@
 //
 
 #include "demuxer.h"
-
-void* flv_demuxer_init(void* userdata, fn_demuxer_callback_t callback);
-void flv_demuxer_fint(void* ctx);
-int flv_demuxer_feed(void* ctx, const void* data, int len);
-
+#include "packet_pool.h"
+#include "packet_queue.h"
+#include "gop_cache.h"
+#include "flv.h"
+#include "flv_probe.h"
+#include "rtmp.h"
+#include "ts.h"
+#include "hls_playlist.h"
+#include "hls_scheduler.h"
+#include "fmp4_recorder.h"
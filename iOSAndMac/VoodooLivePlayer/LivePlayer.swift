@@ -179,6 +179,10 @@ open class LivePlayer {
     
     var streamSource:LiveStreamSource? = nil
     var pipeline:LivePipeline? = nil
+    /*
+     connected ahead of a channel switch, keyed by url
+     */
+    private var preloadedPipelines = [URL: LiveFLVPipeline]()
     
     func load(fromURL url:String, title:String = "") -> Bool {
         if let streamSource = LiveStreamSource.parse(url: url, title: title) {
@@ -200,6 +204,11 @@ open class LivePlayer {
         guard source.type != .UNKNOWN else { return false }
         switch source.type {
         case .HTTP_FLV:
+            if let pipeline = preloadedPipelines.removeValue(forKey: source.url) {
+                playerViewController.mode = .sampleBufferMode
+                replacePipeline(pipeline: pipeline)
+                return true
+            }
             if let pipeline = LiveFLVPipeline(player: self, source: source) {
                 replacePipeline(pipeline: pipeline)
                 return true
@@ -210,6 +219,10 @@ open class LivePlayer {
                 return true
             }
         case .HLS:
+            if config.hlsMethod == .CUSTOM, let pipeline = LiveFLVPipeline(player: self, source: source) {
+                replacePipeline(pipeline: pipeline)
+                return true
+            }
             if let pipeline = LiveHLSPipeline(player: self, source: source) {
                 replacePipeline(pipeline: pipeline)
                 return true
@@ -221,10 +234,34 @@ open class LivePlayer {
         return false
     }
     
+    /*
+     http-flv only. connects to the source now and keeps its current gop,
+     a later load(fromSource:) of the same url followed by play() shows it
+     without waiting for a keyframe. see config.preloadLatencyMs
+     */
+    public func preload(fromSource source:LiveStreamSource) -> Bool {
+        guard source.type == .HTTP_FLV else { return false }
+        if preloadedPipelines[source.url] != nil {
+            return true
+        }
+        guard let pipeline = LiveFLVPipeline(player: self, source: source, preloading: true), pipeline.preload() else { return false }
+        preloadedPipelines[source.url] = pipeline
+        return true
+    }
+
+    public func cancelPreload(fromSource source:LiveStreamSource) {
+        preloadedPipelines.removeValue(forKey: source.url)?.stop()
+    }
+
     public func unload() {
         if pipeline?.state != .READY &&
             pipeline?.state != .FINISHED {
             pipeline?.stop()
+        } else if let flvPipeline = pipeline as? LiveFLVPipeline {
+            /*
+             a preloaded one is connected while READY
+             */
+            flvPipeline.stop()
         }
         pipeline = nil
     }
@@ -17,8 +17,34 @@ public struct LivePlayerConfig {
         case NOT_RENDER
     }
     
+    public enum HLSMethod {
+        case SYSTEM     /*  AVPlayer    */
+        case CUSTOM     /*  LiveHLSLoader + LiveTSDemuxer through the sample buffer renderers   */
+    }
+    
     public var videoRenderMethod: RenderMethod = .NOT_RENDER
     public var audioRenderMethod: RenderMethod = .NOT_RENDER
+    public var hlsMethod: HLSMethod = .SYSTEM
+    public var hlsLowLatency: Bool = true
+    /*
+     http-flv only, records to <prefix>-0000.mp4 ... with a <prefix>.idx keyframe index
+     */
+    public var recordPathPrefix: String? = nil
+    public var recordSegmentMs: UInt32 = 0
+    /*
+     http-flv and custom hls: 0 loads, demuxes and decodes on one serial queue,
+     otherwise demuxing gets its own queue and hands packets over a queue this big
+     */
+    public var packetQueueCapacity: UInt32 = 0
+    /*
+     http-flv, LivePlayer.preload: the current gop is kept within these caps
+     (0 for 10 s and 16 MB) and played starting preloadLatencyMs behind the
+     newest packet, the frames ahead of that are decoded without being shown.
+     a negative preloadLatencyMs shows the whole gop
+     */
+    public var gopCacheMaxMs: UInt32 = 0
+    public var gopCacheMaxBytes: UInt32 = 0
+    public var preloadLatencyMs: Int64 = 1000
     
     public init(videoRenderMethod: RenderMethod, audioRenderMethod: RenderMethod) {
         self.videoRenderMethod = videoRenderMethod
@@ -12,6 +12,43 @@ import AVFoundation
 public class VideoFormatHelper {
     public let FRAME_TIMESCALE = Int32(1000)
     public class func videoStreamInfo(fromParameters parameters:Data, withCodecID codecID: LiveVideoStreamInfo.CodecID) -> LiveVideoStreamInfo? {
+        var streamInfo: LiveVideoStreamInfo?
+        switch codecID {
+        case .H264:
+            streamInfo = avcStreamInfo(fromParameters: parameters)
+        case .HEVC:
+            streamInfo = hevcStreamInfo(fromParameters: parameters)
+        case .AV1:
+            streamInfo = LiveVideoStreamInfo(videoCodecID: .AV1, sps: nil, pps: nil, vps: nil)
+        default:
+            return nil
+        }
+        guard var info = streamInfo else { return nil }
+        info.configurationRecord = [UInt8](parameters)
+        
+        var spsInfo = video_sps_info_t()
+        let ret = parameters.withUnsafeBytes { (ptr: UnsafeRawBufferPointer) -> Int32 in
+            let base = ptr.bindMemory(to: UInt8.self).baseAddress
+            switch codecID {
+            case .HEVC: return hevc_parse_decoder_config(base, UInt32(ptr.count), &spsInfo)
+            case .AV1: return av1_parse_decoder_config(base, UInt32(ptr.count), &spsInfo)
+            default: return avc_parse_decoder_config(base, UInt32(ptr.count), &spsInfo)
+            }
+        }
+        if ret == 0 {
+            info.width = Int(spsInfo.width)
+            info.height = Int(spsInfo.height)
+            info.profile = Int(spsInfo.profile_idc)
+            info.level = Int(spsInfo.level_idc)
+            info.frameRate = spsInfo.frame_rate
+            info.maxNumReorderFrames = Int(spsInfo.max_num_reorder_frames)
+            info.maxDecFrameBuffering = Int(spsInfo.max_dec_frame_buffering)
+            info.nalUnitLength = Int(spsInfo.nal_length_size)
+        }
+        return info
+    }
+    
+    private class func avcStreamInfo(fromParameters parameters:Data) -> LiveVideoStreamInfo? {
         /*
             AVCDecoderConfigurationRecord
          
@@ -64,7 +101,57 @@ public class VideoFormatHelper {
         
         let vps:[UInt8]? = nil
     
-        return LiveVideoStreamInfo(videoCodecID: codecID, sps: sps, pps: pps, vps: vps)
+        return LiveVideoStreamInfo(videoCodecID: .H264, sps: sps, pps: pps, vps: vps)
+    }
+    
+    private class func hevcStreamInfo(fromParameters parameters:Data) -> LiveVideoStreamInfo? {
+        /*
+            HEVCDecoderConfigurationRecord
+         
+            22 bytes of profile / tier / level and stream info, then
+            unsigned int(8) numOfArrays;
+            for (j=0; j < numOfArrays; j++) {
+                bit(1) array_completeness;
+                unsigned int(1) reserved = 0;
+                unsigned int(6) NAL_unit_type;
+                unsigned int(16) numNalus;
+                for (i=0; i< numNalus; i++) {
+                    unsigned int(16) nalUnitLength;
+                    bit(8*nalUnitLength) nalUnit;
+                }
+            }
+        */
+        guard parameters.count > 23, parameters[0] == 1 else { return nil }
+        
+        var vps:[UInt8]?
+        var sps:[UInt8]?
+        var pps:[UInt8]?
+        let arrayCount = Int(parameters[22])
+        var ptr = 23
+        for _ in 0..<arrayCount {
+            guard ptr + 3 <= parameters.count else { return nil }
+            let nalType = parameters[ptr] & 0x3f
+            let nalCount = (Int(parameters[ptr+1]) << 8) + Int(parameters[ptr+2])
+            ptr += 3
+            for _ in 0..<nalCount {
+                guard ptr + 2 <= parameters.count else { return nil }
+                let len = (Int(parameters[ptr]) << 8) + Int(parameters[ptr+1])
+                ptr += 2
+                guard ptr + len <= parameters.count else { return nil }
+                let nal = [UInt8](parameters.subdata(in: ptr..<ptr+len))
+                if nalType == 32 && vps == nil {
+                    vps = nal
+                } else if nalType == 33 && sps == nil {
+                    sps = nal
+                } else if nalType == 34 && pps == nil {
+                    pps = nal
+                }
+                ptr += len
+            }
+        }
+        guard vps != nil, sps != nil, pps != nil else { return nil }
+        
+        return LiveVideoStreamInfo(videoCodecID: .HEVC, sps: sps, pps: pps, vps: vps)
     }
     
     public class func videoFormatDescription(fromStreamInfo streamInfo: LiveVideoStreamInfo) -> CMVideoFormatDescription? {
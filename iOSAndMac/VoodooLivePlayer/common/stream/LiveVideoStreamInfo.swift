@@ -13,6 +13,7 @@ public struct LiveVideoStreamInfo {
     public enum CodecID : Int {
         case H264 = 7
         case HEVC = 12
+        case AV1 = 13       //  enhanced flv av01
         case UNKONWN
     }
     
@@ -21,4 +22,17 @@ public struct LiveVideoStreamInfo {
     public var sps:[UInt8]? = nil
     public var pps:[UInt8]? = nil
     public var vps:[UInt8]? = nil  //  for hevc codec
+    public var configurationRecord:[UInt8]? = nil  //  avcC / hvcC / av1C as received
+    
+    /*
+     decoded from sps, zero / -1 when unknown
+     */
+    public var width:Int = 0
+    public var height:Int = 0
+    public var profile:Int = 0
+    public var level:Int = 0
+    public var frameRate:Double = 0
+    public var maxNumReorderFrames:Int = -1
+    public var maxDecFrameBuffering:Int = -1
+    public var nalUnitLength:Int = 4
 }
@@ -14,22 +14,45 @@ public struct LiveListItem {
     public var coverUrl:String?
     public var title:String
     public var name:String
+    public var streamInfo:LiveStreamInfo?
 }
 
 
 public protocol LiveListDownloaderDelegate : class {
     func handle(downloader:LiveListDownloader?,error:Error?)
     func handle(downloader:LiveListDownloader?,liveList:Array<LiveListItem>)
+    /*
+     after probeStreams, once per item on the prober's queue
+     */
+    func handle(downloader:LiveListDownloader?,index:Int,streamInfo:LiveStreamInfo?)
+}
+
+public extension LiveListDownloaderDelegate {
+    func handle(downloader:LiveListDownloader?,index:Int,streamInfo:LiveStreamInfo?) {}
 }
 
 
 public class LiveListDownloader {
     public weak var delegate:LiveListDownloaderDelegate?
     public var urlSession:URLSession
+    /*
+     probe every flv url of a loaded list for codec, size and audio format
+     */
+    public var probeStreams = false
+    public lazy var prober = LiveStreamProber()
     init() {
         urlSession = URLSession(configuration: .default)
     }
     public func load() {}
+    public func probe(liveList:Array<LiveListItem>) {
+        for (index, item) in liveList.enumerated() {
+            if let flvUrl = item.flvUrl {
+                prober.probe(url: flvUrl) { [weak self] (info:LiveStreamInfo?) in
+                    self?.delegate?.handle(downloader: self, index: index, streamInfo: info)
+                }
+            }
+        }
+    }
     public func handle(downloadContent:String?, error:Error?) {}
     public func download(url:String) {
         if let httpURL = URL(string: url) {
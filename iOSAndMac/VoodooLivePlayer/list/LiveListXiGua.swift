@@ -70,6 +70,9 @@ public class LiveListXiGua : LiveListDownloader {
                             }
                         }
                         self.delegate?.handle(downloader: self, liveList: liveList)
+                        if probeStreams {
+                            probe(liveList: liveList)
+                        }
                         return true
                     }
                 }
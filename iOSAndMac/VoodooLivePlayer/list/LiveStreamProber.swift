@@ -0,0 +1,144 @@
+//
+//  LiveStreamProber.swift
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+import Foundation
+
+/*
+ what flv_probe found at the head of a stream. zero when unknown
+ */
+public struct LiveStreamInfo {
+    public var videoCodecId: Int
+    public var width: Int
+    public var height: Int
+    public var frameRate: Double
+    public var audioFormat: Int         // flv sound format, 10 is aac, -1 without audio
+    public var sampleRate: Int
+    public var channels: Int
+    public var videoDataRate: Double    // kbps from onMetaData
+    public var audioDataRate: Double
+    public var keyframeOffset: UInt64
+    public var bytesProbed: UInt64
+    public var complete: Bool           // every announced stream was found
+
+    init(info: flv_probe_info_t, complete: Bool) {
+        videoCodecId = Int(info.video_codec_id)
+        width = Int(info.width != 0 ? info.width : Int32(info.meta_width))
+        height = Int(info.height != 0 ? info.height : Int32(info.meta_height))
+        frameRate = info.frame_rate > 0 ? info.frame_rate : info.meta_frame_rate
+        audioFormat = Int(info.audio_format)
+        sampleRate = Int(info.sample_rate)
+        channels = Int(info.channels)
+        videoDataRate = info.video_data_rate
+        audioDataRate = info.audio_data_rate
+        keyframeOffset = info.keyframe_offset
+        bytesProbed = info.bytes_probed
+        self.complete = complete
+    }
+}
+
+/*
+ reads only the head of many flv urls at once and cancels each download
+ as soon as its probe is done. a probe holds a few KB, the connections are
+ the limit, so at most maxConcurrent run and the rest wait in order.
+ completion is called on an internal queue
+ */
+public class LiveStreamProber : NSObject, URLSessionDataDelegate {
+    private struct Probe {
+        let probe: OpaquePointer
+        let completion: (LiveStreamInfo?) -> Void
+    }
+
+    public var maxConcurrent = 64
+    public var timeout: TimeInterval = 5.0
+
+    private let queue = DispatchQueue(label: "voodoo.stream.prober")
+    private var session: URLSession!
+    private var running = [Int: Probe]()
+    private var pending = [(URL, (LiveStreamInfo?) -> Void)]()
+
+    public override init() {
+        super.init()
+        let operationQueue = OperationQueue()
+        operationQueue.underlyingQueue = queue
+        operationQueue.maxConcurrentOperationCount = 1
+        let configuration = URLSessionConfiguration.ephemeral
+        configuration.httpMaximumConnectionsPerHost = 16
+        session = URLSession(configuration: configuration, delegate: self, delegateQueue: operationQueue)
+    }
+
+    deinit {
+        for (_, entry) in running {
+            flv_probe_destroy(entry.probe)
+        }
+    }
+
+    public func probe(url: String, completion: @escaping (LiveStreamInfo?) -> Void) {
+        guard let httpURL = URL(string: url) else {
+            completion(nil)
+            return
+        }
+        queue.async {
+            self.pending.append((httpURL, completion))
+            self.startPending()
+        }
+    }
+
+    /*
+     the session keeps a reference to its delegate until invalidated
+     */
+    public func cancelAll() {
+        queue.async {
+            self.pending.removeAll()
+            self.session.invalidateAndCancel()
+        }
+    }
+
+    private func startPending() {
+        while running.count < maxConcurrent && !pending.isEmpty {
+            let (url, completion) = pending.removeFirst()
+            guard let probe = flv_probe_create(0, 0, nil) else {
+                completion(nil)
+                continue
+            }
+            let request = URLRequest(url: url, cachePolicy: .reloadIgnoringLocalAndRemoteCacheData, timeoutInterval: timeout)
+            let task = session.dataTask(with: request)
+            running[task.taskIdentifier] = Probe(probe: probe, completion: completion)
+            task.resume()
+        }
+    }
+
+    private func finish(task: URLSessionTask, result: Int32) {
+        guard let entry = running.removeValue(forKey: task.taskIdentifier) else { return }
+        let info = flv_probe_get_info(entry.probe)!.pointee
+        flv_probe_destroy(entry.probe)
+        if (info.found & UInt32(FLV_PROBE_FOUND_HEADER)) == 0 {
+            entry.completion(nil)
+        } else {
+            entry.completion(LiveStreamInfo(info: info, complete: result == FLV_PROBE_DONE))
+        }
+        startPending()
+    }
+
+    public func urlSession(_ session: URLSession, dataTask: URLSessionDataTask, didReceive data: Data) {
+        guard let entry = running[dataTask.taskIdentifier] else { return }
+        let result = data.withUnsafeBytes { (buffer: UnsafeRawBufferPointer) -> Int32 in
+            flv_probe_feed(entry.probe, buffer.baseAddress, UInt32(buffer.count))
+        }
+        if result != FLV_PROBE_NEED_MORE {
+            dataTask.cancel()
+            finish(task: dataTask, result: result)
+        }
+    }
+
+    /*
+     the stream ended or failed before the probe was done, keep what it got
+     */
+    public func urlSession(_ session: URLSession, task: URLSessionTask, didCompleteWithError error: Error?) {
+        finish(task: task, result: FLV_PROBE_NEED_MORE)
+    }
+}
@@ -28,6 +28,9 @@ class LiveCustomPipeline : LivePipeline, LiveLoaderDelegate, LiveDemuxerDelegate
      loader delegate
      */
     func handle(loaderData data: Data, withType type: LivePipelineDataType) {}
+    func handle(loaderData data: Data, withType type: LivePipelineDataType, ts: [Int64], flag: UInt32) {
+        handle(demuxerData: data, withType: type, ts: ts, flag: flag)
+    }
     func handle(loaderError error: Error?) {
         raiseError(error: error)
         if error == nil {
@@ -38,6 +41,7 @@ class LiveCustomPipeline : LivePipeline, LiveLoaderDelegate, LiveDemuxerDelegate
             change(state: .LOADING)
         }
     }
+    func handle(loaderBoundaryWithDiscontinuity discontinuity: Bool) {}
     /**
      demuxer delegate
      */
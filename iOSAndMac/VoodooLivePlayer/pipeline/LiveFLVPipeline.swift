@@ -17,17 +17,98 @@ class LiveFLVPipeline : LiveCustomPipeline {
     var audioDecoder:LiveAudioDecoder?
     
     let dispatchQueue = DispatchQueue(label: "VoodooLivePlayer.LivePlayerFLVPipeline.queue")
+    /*
+     with config.packetQueueCapacity the loader callbacks and the demuxer run
+     here and the packets go to dispatchQueue through packetQueue, otherwise
+     everything runs on dispatchQueue
+     */
+    private var demuxQueue: DispatchQueue?
+    private var packetQueue: LivePacketQueue?
+    /*
+     loader data held on demuxQueue while the decoders are behind
+     */
+    private var pendingLoaderWork = [() -> Void]()
 
-    init?(player: LivePlayer, source:LiveStreamSource) {
-        if source.type != .HTTP_FLV { return nil }
-        player.playerViewController.mode = .sampleBufferMode
-        self.loader = LiveFLVLoader(source: source)
-        self.demuxer = LiveFLVDemuxer()
+    private var loadingTime: UInt64 = 0
+    /*
+     dispatchQueue. loader and demuxer run while still READY, see preload()
+     */
+    private var preloading = false
+    /*
+     dispatchQueue. the replayed gop is shown from here on, see beforePresentation
+     */
+    private var presentFromPts: Int64 = VOODOO_NOPTS_VALUE
+
+    /*
+     preloading leaves the view to the pipeline playing now, it is switched
+     when this one is loaded
+     */
+    init?(player: LivePlayer, source:LiveStreamSource, preloading: Bool = false) {
+        if source.type == .HTTP_FLV {
+            self.loader = LiveFLVLoader(source: source)
+            let flvDemuxer = LiveFLVDemuxer()
+            flvDemuxer.recordPathPrefix = player.config.recordPathPrefix
+            flvDemuxer.recordSegmentMs = player.config.recordSegmentMs
+            flvDemuxer.gopCacheMaxMs = player.config.gopCacheMaxMs
+            flvDemuxer.gopCacheMaxBytes = player.config.gopCacheMaxBytes
+            self.demuxer = flvDemuxer
+        } else if source.type == .HLS && player.config.hlsMethod == .CUSTOM {
+            /*
+             same decoders and renderers, the segments are mpeg-ts
+             */
+            self.loader = LiveHLSLoader(source: source, lowLatency: player.config.hlsLowLatency)
+            self.demuxer = LiveTSDemuxer()
+        } else {
+            return nil
+        }
+        if !preloading {
+            player.playerViewController.mode = .sampleBufferMode
+        }
         super.init(player: player, streamSource: source)
+        if player.config.packetQueueCapacity > 0 {
+            packetQueue = LivePacketQueue(capacity: player.config.packetQueueCapacity, consumerQueue: dispatchQueue) { [weak self] packet in
+                guard let self = self else {
+                    demuxer_packet_release(packet)
+                    return
+                }
+                self.handle(queuedPacket: packet)
+            }
+        }
+        if let packetQueue = self.packetQueue {
+            let demuxQueue = DispatchQueue(label: "VoodooLivePlayer.LivePlayerFLVPipeline.demuxQueue")
+            packetQueue.onResume = { [weak self] in
+                demuxQueue.async { self?.resumeDemuxing() }
+            }
+            self.demuxQueue = demuxQueue
+            demuxer.packetQueue = packetQueue
+        }
         loader.delegate = self
-        loader.delegateQueue = dispatchQueue
+        loader.delegateQueue = demuxQueue ?? dispatchQueue
         demuxer.delegate = self
-        demuxer.delegateQueue = dispatchQueue
+        demuxer.delegateQueue = demuxQueue ?? dispatchQueue
+    }
+
+    var packetQueueStats: packet_queue_stats_t? {
+        return packetQueue?.stats
+    }
+
+    /*
+     loader and demuxer are only touched from demuxQueue. dispatchQueue may
+     wait for it, never the other way round
+     */
+    private func onDemuxQueue<T>(_ block: () -> T) -> T {
+        if let demuxQueue = self.demuxQueue {
+            return demuxQueue.sync(execute: block)
+        }
+        return block()
+    }
+
+    private func onPipelineQueue(_ block: @escaping () -> Void) {
+        if demuxQueue != nil {
+            dispatchQueue.async(execute: block)
+        } else {
+            block()
+        }
     }
     
     override func start() -> Bool {
@@ -37,10 +118,56 @@ class LiveFLVPipeline : LiveCustomPipeline {
         }
         return true
     }
+
+    /*
+     http-flv. connects and demuxes while still READY, the demuxer keeps only
+     the current gop. start() then begins on that keyframe at once instead of
+     connecting and waiting for the next one
+     */
+    func preload() -> Bool {
+        guard let flvDemuxer = demuxer as? LiveFLVDemuxer else { return false }
+        dispatchQueue.async {
+            guard self.state == .READY, !self.preloading else { return }
+            self.preloading = self.onDemuxQueue { () -> Bool in
+                self.pendingLoaderWork.removeAll()
+                guard flvDemuxer.mute(), flvDemuxer.start() else { return false }
+                guard self.loader.start() else {
+                    flvDemuxer.stop()
+                    return false
+                }
+                return true
+            }
+        }
+        return true
+    }
+
+    /*
+     dispatchQueue, in place of starting demuxer and loader
+     */
+    private func attachPreloaded() {
+        guard let flvDemuxer = demuxer as? LiveFLVDemuxer else { return }
+        let targetLatencyMs = player?.config.preloadLatencyMs ?? -1
+        onDemuxQueue {
+            self.packetQueue?.resumed()
+            flvDemuxer.unmute(targetLatencyMs: targetLatencyMs) { (presentDts) in
+                /*
+                 before any of the gop is handed on, dispatchQueue runs this or waits for it
+                 */
+                self.presentFromPts = presentDts
+                if presentDts != VOODOO_NOPTS_VALUE {
+                    self.renderSynchronizer.present(fromPTS: presentDts)
+                }
+            }
+        }
+    }
     
     override func stop() {
         let stopSemaphore = DispatchSemaphore(value: 0)
         dispatchQueue.async {
+            if self.preloading {
+                self.preloading = false
+                self.stopLoading()
+            }
             if self.state == .LOADING {
                 self.change(state: .READY)
             } else if self.state == .PLAYING {
@@ -54,10 +181,22 @@ class LiveFLVPipeline : LiveCustomPipeline {
     
     private func stopAll() {
         super.renderSynchronizer.stop()
-        self.loader.stop()
-        self.demuxer.stop()
+        stopLoading()
         self.audioDecoder?.stop()
         self.videoDecoder?.stop()
+        if var stats = packetQueue?.stats {
+            let p50 = Double(packet_queue_wait_percentile_ns(&stats, 0.5)) / 1e6
+            let p99 = Double(packet_queue_wait_percentile_ns(&stats, 0.99)) / 1e6
+            print(">> PACKET QUEUE DEPTH MAX \(stats.max_depth)/\(stats.capacity), WAIT P50 \(p50) P99 \(p99) MAX \(Double(stats.wait_ns_max) / 1e6) ms, \(stats.throttles) THROTTLES")
+        }
+    }
+
+    private func stopLoading() {
+        onDemuxQueue {
+            self.loader.stop()
+            self.demuxer.stop()
+            self.pendingLoaderWork.removeAll()
+        }
     }
     
     override func handle(stateWillChangeFrom from: LivePlayerState, to: LivePlayerState) -> StateChangeResult {
@@ -65,19 +204,30 @@ class LiveFLVPipeline : LiveCustomPipeline {
             guard super.renderSynchronizer.start() else { return .ERROR }
             return .SUCCESS
         } else if to == .LOADING {
-            /*
-             first start demuxer
-             */
-            guard demuxer.start() else { return .REJECT }
-            /*
-             second start loader
-             */
-            guard loader.start() else {
-                demuxer.stop()
-                return .REJECT
+            loadingTime = DispatchTime.now().uptimeNanoseconds
+            presentFromPts = VOODOO_NOPTS_VALUE
+            if preloading {
+                /*
+                 already loading, the gop is replayed once the state is LOADING
+                 */
+                return .SUCCESS
+            }
+            return onDemuxQueue { () -> StateChangeResult in
+                self.pendingLoaderWork.removeAll()
+                self.packetQueue?.resumed()
+                /*
+                 first start demuxer
+                 */
+                guard self.demuxer.start() else { return .REJECT }
+                /*
+                 second start loader
+                 */
+                guard self.loader.start() else {
+                    self.demuxer.stop()
+                    return .REJECT
+                }
+                return .SUCCESS
             }
-
-            return .SUCCESS
         }
         return .SUCCESS
     }
@@ -85,20 +235,83 @@ class LiveFLVPipeline : LiveCustomPipeline {
     override func handle(stateChangedFrom from: LivePlayerState, to: LivePlayerState) {
         if to == .ERROR || to == .FINISHED || to == .READY {
             if from == .LOADING {
-                self.loader.stop()
+                stopLoading()
             } else if from == .PLAYING {
                 self.stopAll()
             }
+        } else if to == .LOADING && preloading {
+            preloading = false
+            attachPreloaded()
         } else if to == .PLAYING {
-            
+            print(">> FIRST FRAME AFTER \((DispatchTime.now().uptimeNanoseconds - loadingTime) / 1_000_000) ms")
         }
         
         super.handle(stateChangedFrom: from, to: to)
     }
     
     override func handle(loaderData data: Data, withType type: LivePipelineDataType) {
+        if deferLoaderWork({ self.demuxer.feed(data: data) }) { return }
         demuxer.feed(data: data)
     }
+
+    override func handle(loaderError error: Error?) {
+        onPipelineQueue {
+            if self.preloading {
+                /*
+                 not playing yet, start() connects again
+                 */
+                self.preloading = false
+                self.stopLoading()
+                return
+            }
+            super.handle(loaderError: error)
+        }
+    }
+
+    /*
+     demuxQueue. while the packet queue is throttled nothing more is parsed,
+     the bytes wait here in order until the decoders catch up
+     */
+    private func deferLoaderWork(_ work: @escaping () -> Void) -> Bool {
+        guard let packetQueue = self.packetQueue, packetQueue.throttled || !pendingLoaderWork.isEmpty else { return false }
+        pendingLoaderWork.append(work)
+        return true
+    }
+
+    private func resumeDemuxing() {
+        guard let packetQueue = self.packetQueue else { return }
+        packetQueue.resumed()
+        while !packetQueue.throttled && !pendingLoaderWork.isEmpty {
+            pendingLoaderWork.removeFirst()()
+        }
+    }
+
+    /*
+     dispatchQueue, packets from packetQueue
+     */
+    private func handle(queuedPacket packet: UnsafeMutablePointer<demuxer_packet_t>) {
+        let data = Data(bytesNoCopy: UnsafeMutableRawPointer(packet.pointee.data), count: Int(packet.pointee.size), deallocator: .custom({ _, _ in
+            demuxer_packet_release(packet)
+        }))
+        guard state == .LOADING || state == .PLAYING, let dataType = LivePipelineDataType(rawValue: Int(packet.pointee.type)) else { return }
+        handle(demuxerData: data, withType: dataType, ts: [packet.pointee.pts, packet.pointee.dts], flag: packet.pointee.flag)
+    }
+    
+    override func handle(loaderBoundaryWithDiscontinuity discontinuity: Bool) {
+        if deferLoaderWork({ self.boundary(discontinuity: discontinuity) }) { return }
+        boundary(discontinuity: discontinuity)
+    }
+
+    private func boundary(discontinuity: Bool) {
+        guard let tsDemuxer = demuxer as? LiveTSDemuxer else { return }
+        /*
+         the last pes of the previous piece has nothing after it to close it
+         */
+        tsDemuxer.flush()
+        if discontinuity {
+            tsDemuxer.reset()
+        }
+    }
     
     override func handle(demuxerData data: Data, withType type: LivePipelineDataType, ts: [Int64], flag: UInt32) {
         switch type {
@@ -108,16 +321,35 @@ class LiveFLVPipeline : LiveCustomPipeline {
             handle(audioParameters: data, flag: flag)
             checkDecoder()
         case .audioPacket:
+            if beforePresentation(ts: ts) { break }
             handle(audioPacket: data, ts: ts, flag: flag)
         case .videoParameters:
             handle(videoParameters: data, flag: flag)
             checkDecoder()
         case .videoPacket:
-            handle(videoPacket: data, ts: ts, flag: flag)
+            let decodeOnly = beforePresentation(ts: ts)
+            handle(videoPacket: data, ts: ts, flag: decodeOnly ? flag | UInt32(VOODOO_PACKET_FLAG_DECODE_ONLY) : flag)
+        case .metadata:
+            handle(metadata: data)
         default:
             break
         }
     }
+
+    /*
+     a replayed gop: video ahead of presentFromPts is decoded without being
+     shown, audio ahead of it dropped. the packets are in dts order, the first
+     one at presentFromPts ends the replay
+     */
+    private func beforePresentation(ts: [Int64]) -> Bool {
+        guard presentFromPts != VOODOO_NOPTS_VALUE else { return false }
+        if ts[1] != VOODOO_NOPTS_VALUE && ts[1] >= presentFromPts {
+            presentFromPts = VOODOO_NOPTS_VALUE
+            return false
+        }
+        return ts[0] < presentFromPts
+    }
+
     var renderersCreated = false
     private func checkDecoder() {
         /*
@@ -150,6 +382,16 @@ class LiveFLVPipeline : LiveCustomPipeline {
             streamInfo.hasAudioStream = false
         }
     }
+    private func handle(metadata data: Data) {
+        guard data.count == MemoryLayout<flv_metadata_t>.size else { return }
+        let metadata = data.withUnsafeBytes { $0.load(as: flv_metadata_t.self) }
+        /*
+         sizes known before the first sequence header
+         */
+        streamInfo.videoWidth = Int(metadata.width)
+        streamInfo.videoHeight = Int(metadata.height)
+    }
+    
     private func handle(audioParameters parameters: Data, flag: UInt32) {
         guard self.streamInfo.hasAudioStream else { return }
         
@@ -184,7 +426,22 @@ class LiveFLVPipeline : LiveCustomPipeline {
             return
         }
         
+        /*
+         sps wins over onMetaData
+         */
+        let videoStreamInfo = self.streamInfo.videoStreamInfo!
+        if videoStreamInfo.width > 0 && videoStreamInfo.height > 0 {
+            self.streamInfo.videoWidth = videoStreamInfo.width
+            self.streamInfo.videoHeight = videoStreamInfo.height
+        }
+        self.streamInfo.videoCodecID = videoStreamInfo.videoCodecID.rawValue
+        self.streamInfo.videoProfile = videoStreamInfo.profile
+        self.streamInfo.videoLevel = videoStreamInfo.level
+        
         self.videoDecoder = LiveSampleBufferVideoDecoder(streamInfo: self.streamInfo.videoStreamInfo!, delegate: self, delegateQueue: dispatchQueue)
+        if self.videoDecoder == nil {
+            self.streamInfo.hasVideoStream = false
+        }
     }
     
     private func handle(videoPacket packet: Data, ts: [Int64], flag: UInt32) {
@@ -11,6 +11,10 @@ import AVKit
 
 class LiveHLSPipeline : LivePipeline {
     let hlsPlayer: AVPlayer
+    private var timeObserver: Any?
+    private var startTime: UInt64 = 0
+    private var firstFrameLogged = false
+    private var observerTicks = 0
     init?(player: LivePlayer, source: LiveStreamSource) {
         if source.type == .HLS {
             player.playerViewController.mode = .AVPlayerMode
@@ -23,11 +27,32 @@ class LiveHLSPipeline : LivePipeline {
     
     override func start() -> Bool {
         player?.playerViewController.player = hlsPlayer
+        startTime = DispatchTime.now().uptimeNanoseconds
+        firstFrameLogged = false
+        /*
+         same measurements as the custom hls path: first frame, and the distance
+         to the live edge from EXT-X-PROGRAM-DATE-TIME
+         */
+        timeObserver = hlsPlayer.addPeriodicTimeObserver(forInterval: CMTime(value: 1, timescale: 10), queue: .main) { [weak self] time in
+            guard let self = self, let item = self.hlsPlayer.currentItem, time.seconds > 0 else { return }
+            if !self.firstFrameLogged {
+                self.firstFrameLogged = true
+                print(">> AVPLAYER FIRST FRAME AFTER \((DispatchTime.now().uptimeNanoseconds - self.startTime) / 1_000_000) ms")
+            }
+            self.observerTicks += 1
+            if let date = item.currentDate(), self.observerTicks % 10 == 0 {
+                print(">> AVPLAYER LATENCY \(Int(Date().timeIntervalSince(date) * 1000)) ms")
+            }
+        }
         hlsPlayer.play()
         return true
     }
     
     override func stop() {
+        if let observer = timeObserver {
+            hlsPlayer.removeTimeObserver(observer)
+            timeObserver = nil
+        }
         hlsPlayer.rate = 0
         hlsPlayer.replaceCurrentItem(with: nil)
         player.playerViewController.player = nil
@@ -0,0 +1,104 @@
+//
+//  LivePacketQueue.swift
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+import Foundation
+
+/*
+ pooled packets from the demuxer thread to another queue over packet_queue.
+ push() on the producer side only, consumer runs on consumerQueue with one
+ reference per packet, a batch at a time so other work on that queue gets
+ in between. past the high water the producer is throttled until onResume.
+ */
+class LivePacketQueue {
+    private let queue: OpaquePointer
+    private let consumerQueue: DispatchQueue
+    private let consumer: (UnsafeMutablePointer<demuxer_packet_t>) -> Void
+    private static let batchSize = 64
+    private let batch = UnsafeMutablePointer<UnsafeMutablePointer<demuxer_packet_t>?>.allocate(capacity: LivePacketQueue.batchSize)
+
+    /*
+     producer side
+     */
+    private var overflow = [UnsafeMutablePointer<demuxer_packet_t>]()
+    private(set) var throttled = false
+    /*
+     called on consumerQueue, the producer should go on and call resumed()
+     */
+    var onResume: (() -> Void)?
+
+    init?(capacity: UInt32, consumerQueue: DispatchQueue, consumer: @escaping (UnsafeMutablePointer<demuxer_packet_t>) -> Void) {
+        guard let queue = packet_queue_create(capacity, 0, nil) else { return nil }
+        self.queue = queue
+        self.consumerQueue = consumerQueue
+        self.consumer = consumer
+    }
+
+    deinit {
+        for packet in overflow {
+            demuxer_packet_release(packet)
+        }
+        packet_queue_destroy(queue)
+        batch.deallocate()
+    }
+
+    /*
+     takes over the reference. whatever does not fit waits here in order
+     */
+    func push(_ packet: UnsafeMutablePointer<demuxer_packet_t>) {
+        if overflow.isEmpty && enqueue(packet) {
+            return
+        }
+        overflow.append(packet)
+        flushOverflow()
+    }
+
+    func resumed() {
+        throttled = false
+        flushOverflow()
+    }
+
+    var stats: packet_queue_stats_t {
+        var stats = packet_queue_stats_t()
+        packet_queue_get_stats(queue, &stats)
+        return stats
+    }
+
+    private func flushOverflow() {
+        while let packet = overflow.first, enqueue(packet) {
+            overflow.removeFirst()
+        }
+    }
+
+    private func enqueue(_ packet: UnsafeMutablePointer<demuxer_packet_t>) -> Bool {
+        let result = packet_queue_push(queue, packet)
+        if result < 0 {
+            throttled = true
+            return false
+        }
+        if result & PACKET_QUEUE_WAKE_CONSUMER != 0 {
+            consumerQueue.async { self.drain() }
+        }
+        if result & PACKET_QUEUE_THROTTLED != 0 {
+            throttled = true
+        }
+        return true
+    }
+
+    private func drain() {
+        let count = Int(packet_queue_pop(queue, batch, Int32(LivePacketQueue.batchSize)))
+        for i in 0..<count {
+            consumer(batch[i]!)
+        }
+        if packet_queue_resume_producer(queue) != 0 {
+            onResume?()
+        }
+        if count > 0 || packet_queue_consumer_idle(queue) == 0 {
+            consumerQueue.async { self.drain() }
+        }
+    }
+}
@@ -17,6 +17,7 @@ enum LivePipelineDataType : Int {
     case videoPacket = 3
     case audioParameters = 4
     case audioPacket = 5
+    case metadata = 6
 }
 
 enum LivePipelineData {
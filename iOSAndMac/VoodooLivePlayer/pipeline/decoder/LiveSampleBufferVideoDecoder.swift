@@ -23,6 +23,13 @@ class LiveSampleBufferVideoDecoder : LiveVideoDecoder {
     }
     
     private class func createFormatDescription(streamInfo: LiveVideoStreamInfo) -> CMVideoFormatDescription? {
+        if streamInfo.videoCodecID == .HEVC {
+            return createHEVCFormatDescription(streamInfo: streamInfo)
+        }
+        /*
+         av1 has no sample buffer path yet
+         */
+        guard streamInfo.videoCodecID == .H264 else { return nil }
         var formatDescription:CMVideoFormatDescription? = nil
         let pointerSPS = UnsafePointer<UInt8>(streamInfo.sps!)
         let pointerPPS = UnsafePointer<UInt8>(streamInfo.pps!)
@@ -34,7 +41,26 @@ class LiveSampleBufferVideoDecoder : LiveVideoDecoder {
         let sizeParamArray = [streamInfo.sps!.count, streamInfo.pps!.count]
         let parameterSetSizes = UnsafePointer<Int>(sizeParamArray)
         
-        let status = CMVideoFormatDescriptionCreateFromH264ParameterSets(allocator: kCFAllocatorDefault, parameterSetCount: 2, parameterSetPointers: parameterSetPointers, parameterSetSizes: parameterSetSizes, nalUnitHeaderLength: 4, formatDescriptionOut: &formatDescription)
+        let status = CMVideoFormatDescriptionCreateFromH264ParameterSets(allocator: kCFAllocatorDefault, parameterSetCount: 2, parameterSetPointers: parameterSetPointers, parameterSetSizes: parameterSetSizes, nalUnitHeaderLength: Int32(streamInfo.nalUnitLength), formatDescriptionOut: &formatDescription)
+        
+        guard status == noErr else { return nil }
+        
+        return formatDescription
+    }
+    
+    private class func createHEVCFormatDescription(streamInfo: LiveVideoStreamInfo) -> CMVideoFormatDescription? {
+        guard #available(iOS 11.0, macOS 10.13, *) else { return nil }
+        var formatDescription:CMVideoFormatDescription? = nil
+        let pointerVPS = UnsafePointer<UInt8>(streamInfo.vps!)
+        let pointerSPS = UnsafePointer<UInt8>(streamInfo.sps!)
+        let pointerPPS = UnsafePointer<UInt8>(streamInfo.pps!)
+        let dataParamArray = [pointerVPS, pointerSPS, pointerPPS]
+        let parameterSetPointers = UnsafePointer<UnsafePointer<UInt8>>(dataParamArray)
+        
+        let sizeParamArray = [streamInfo.vps!.count, streamInfo.sps!.count, streamInfo.pps!.count]
+        let parameterSetSizes = UnsafePointer<Int>(sizeParamArray)
+        
+        let status = CMVideoFormatDescriptionCreateFromHEVCParameterSets(allocator: kCFAllocatorDefault, parameterSetCount: 3, parameterSetPointers: parameterSetPointers, parameterSetSizes: parameterSetSizes, nalUnitHeaderLength: Int32(streamInfo.nalUnitLength), extensions: nil, formatDescriptionOut: &formatDescription)
         
         guard status == noErr else { return nil }
         
@@ -49,9 +75,12 @@ class LiveSampleBufferVideoDecoder : LiveVideoDecoder {
             }
             return nil
         }) {
-            if flag == VOODOO_VIDEO_PACKET_FLAG_IS_KEY_FRAME {
+            if (flag & UInt32(VOODOO_VIDEO_PACKET_FLAG_IS_KEY_FRAME)) != 0 {
                 videoFrame.keyFrame = true
             }
+            if (flag & UInt32(VOODOO_PACKET_FLAG_DECODE_ONLY)) != 0 {
+                videoFrame.setDoNotDisplay(true)
+            }
             delegate?.handle(decoder: self, outputFrame: videoFrame)
         }
     }
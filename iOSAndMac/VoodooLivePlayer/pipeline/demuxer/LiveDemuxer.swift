@@ -16,6 +16,11 @@ protocol LiveDemuxerDelegate : class {
 class LiveDemuxer : LivePlayerComponent{
     weak var delegate: LiveDemuxerDelegate?
     unowned var delegateQueue: DispatchQueue?
+    /*
+     when set, packets and the callback types in between them go through it
+     to the next stage instead of the delegate
+     */
+    var packetQueue: LivePacketQueue?
 
     init(delegate:LiveDemuxerDelegate? = nil, delegateQueue: DispatchQueue? = nil) {
         self.delegate = delegate
@@ -0,0 +1,215 @@
+//
+//  amf0.h
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#ifndef amf0_h
+#define amf0_h
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ allocation free AMF0 reader, strings point into the source buffer.
+ any read past the end or unexpected marker sets error and returns -1.
+ */
+#define AMF0_NUMBER         0x00
+#define AMF0_BOOLEAN        0x01
+#define AMF0_STRING         0x02
+#define AMF0_OBJECT         0x03
+#define AMF0_NULL           0x05
+#define AMF0_UNDEFINED      0x06
+#define AMF0_REFERENCE      0x07
+#define AMF0_ECMA_ARRAY     0x08
+#define AMF0_OBJECT_END     0x09
+#define AMF0_STRICT_ARRAY   0x0a
+#define AMF0_DATE           0x0b
+#define AMF0_LONG_STRING    0x0c
+
+#define AMF0_MAX_DEPTH      16
+
+typedef struct amf0_reader_s {
+    const uint8_t *data;
+    uint32_t len;
+    uint32_t pos;
+    int error;
+} amf0_reader_t;
+
+#define AMF0_INIT(r, rdata, rlen) (r)->data = (const uint8_t*)(rdata), (r)->len = (rlen), (r)->pos = 0, (r)->error = 0
+#define AMF0_LEFT(r)              ((r)->len - (r)->pos)
+#define AMF0_KEY_IS(key, key_len, str)  ((key_len) == sizeof(str) - 1 && memcmp((key), (str), sizeof(str) - 1) == 0)
+
+static inline int amf0_fail(amf0_reader_t *r) {
+    r->error = 1;
+    return -1;
+}
+
+static inline uint32_t amf0_be(const uint8_t *p, int n) {
+    uint32_t v = 0;
+    for(int i = 0;i < n;++i) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static inline int amf0_peek_type(amf0_reader_t *r) {
+    if(r->error || AMF0_LEFT(r) < 1) {
+        return amf0_fail(r);
+    }
+    return r->data[r->pos];
+}
+
+/*
+ object/ecma array property name, no marker
+ */
+static inline int amf0_read_key(amf0_reader_t *r, const char **key, uint32_t *key_len) {
+    if(r->error || AMF0_LEFT(r) < 2) {
+        return amf0_fail(r);
+    }
+    uint32_t len = amf0_be(r->data + r->pos, 2);
+    if(AMF0_LEFT(r) - 2 < len) {
+        return amf0_fail(r);
+    }
+    *key = (const char*)(r->data + r->pos + 2);
+    *key_len = len;
+    r->pos += 2 + len;
+    return 0;
+}
+
+/*
+ 00 00 09 after the last property
+ */
+static inline int amf0_is_object_end(amf0_reader_t *r) {
+    if(AMF0_LEFT(r) >= 3 &&
+       r->data[r->pos] == 0 &&
+       r->data[r->pos+1] == 0 &&
+       r->data[r->pos+2] == AMF0_OBJECT_END) {
+        r->pos += 3;
+        return 1;
+    }
+    return 0;
+}
+
+static inline int amf0_read_number(amf0_reader_t *r, double *value) {
+    if(r->error || AMF0_LEFT(r) < 9 || r->data[r->pos] != AMF0_NUMBER) {
+        return amf0_fail(r);
+    }
+    uint64_t bits = ((uint64_t)amf0_be(r->data + r->pos + 1, 4) << 32) | amf0_be(r->data + r->pos + 5, 4);
+    memcpy(value, &bits, sizeof(double));
+    r->pos += 9;
+    return 0;
+}
+
+static inline int amf0_read_boolean(amf0_reader_t *r, int *value) {
+    if(r->error || AMF0_LEFT(r) < 2 || r->data[r->pos] != AMF0_BOOLEAN) {
+        return amf0_fail(r);
+    }
+    *value = r->data[r->pos + 1] != 0;
+    r->pos += 2;
+    return 0;
+}
+
+static inline int amf0_read_string(amf0_reader_t *r, const char **str, uint32_t *str_len) {
+    if(r->error || AMF0_LEFT(r) < 1) {
+        return amf0_fail(r);
+    }
+    uint8_t marker = r->data[r->pos];
+    int size_len = marker == AMF0_STRING ? 2 : marker == AMF0_LONG_STRING ? 4 : 0;
+    if(size_len == 0 || AMF0_LEFT(r) < 1 + (uint32_t)size_len) {
+        return amf0_fail(r);
+    }
+    uint32_t len = amf0_be(r->data + r->pos + 1, size_len);
+    if(AMF0_LEFT(r) - 1 - size_len < len) {
+        return amf0_fail(r);
+    }
+    *str = (const char*)(r->data + r->pos + 1 + size_len);
+    *str_len = len;
+    r->pos += 1 + size_len + len;
+    return 0;
+}
+
+/*
+ object, ecma array or strict array header.
+ count is the strict array element count, ecma array count is only a hint
+ and objects report -1, read properties until amf0_is_object_end.
+ */
+static inline int amf0_read_container(amf0_reader_t *r, int *marker, int64_t *count) {
+    if(r->error || AMF0_LEFT(r) < 1) {
+        return amf0_fail(r);
+    }
+    *marker = r->data[r->pos];
+    if(*marker == AMF0_OBJECT) {
+        *count = -1;
+        r->pos += 1;
+        return 0;
+    }
+    if((*marker == AMF0_ECMA_ARRAY || *marker == AMF0_STRICT_ARRAY) && AMF0_LEFT(r) >= 5) {
+        *count = amf0_be(r->data + r->pos + 1, 4);
+        r->pos += 5;
+        return 0;
+    }
+    return amf0_fail(r);
+}
+
+static inline int _amf0_skip_value(amf0_reader_t *r, int depth) {
+    const char *str;
+    uint32_t len;
+    int64_t count;
+    int marker = amf0_peek_type(r);
+    if(marker < 0 || depth > AMF0_MAX_DEPTH) {
+        return amf0_fail(r);
+    }
+    switch(marker) {
+        case AMF0_NUMBER:
+            if(AMF0_LEFT(r) < 9) return amf0_fail(r);
+            r->pos += 9;
+            return 0;
+        case AMF0_BOOLEAN:
+            if(AMF0_LEFT(r) < 2) return amf0_fail(r);
+            r->pos += 2;
+            return 0;
+        case AMF0_STRING:
+        case AMF0_LONG_STRING:
+            return amf0_read_string(r, &str, &len);
+        case AMF0_NULL:
+        case AMF0_UNDEFINED:
+            r->pos += 1;
+            return 0;
+        case AMF0_REFERENCE:
+            if(AMF0_LEFT(r) < 3) return amf0_fail(r);
+            r->pos += 3;
+            return 0;
+        case AMF0_DATE:
+            if(AMF0_LEFT(r) < 11) return amf0_fail(r);
+            r->pos += 11;
+            return 0;
+        case AMF0_OBJECT:
+        case AMF0_ECMA_ARRAY:
+            amf0_read_container(r, &marker, &count);
+            while(!r->error && !amf0_is_object_end(r)) {
+                if(amf0_read_key(r, &str, &len) < 0 || _amf0_skip_value(r, depth + 1) < 0) {
+                    return amf0_fail(r);
+                }
+            }
+            return r->error ? -1 : 0;
+        case AMF0_STRICT_ARRAY:
+            amf0_read_container(r, &marker, &count);
+            for(int64_t i = 0;i < count;++i) {
+                if(_amf0_skip_value(r, depth + 1) < 0) {
+                    return -1;
+                }
+            }
+            return 0;
+        default:
+            return amf0_fail(r);
+    }
+}
+
+static inline int amf0_skip_value(amf0_reader_t *r) {
+    return _amf0_skip_value(r, 0);
+}
+
+#endif /* amf0_h */
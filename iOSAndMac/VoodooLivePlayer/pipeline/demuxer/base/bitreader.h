@@ -0,0 +1,149 @@
+//
+//  bitreader.h
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#ifndef bitreader_h
+#define bitreader_h
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ msb first bit reader backed by a 64 bit cache register.
+ the cache is refilled up to 8 bytes at a time, reads of 1~32 bits are a
+ shift and a mask. reading past the end returns zero bits and counts them
+ in overread, so callers check BR_ERROR once after a whole header.
+ */
+typedef struct bitreader_s {
+    const uint8_t *ptr;     /*  next byte to load       */
+    const uint8_t *end;
+    uint64_t cache;         /*  msb aligned, unused bits are zero */
+    uint32_t bits;          /*  valid bits in cache     */
+    uint32_t overread;
+} bitreader_t;
+
+#define BR_ERROR(br)            ((br)->overread != 0)
+#define BR_BITS_LEFT(br)        ((uint32_t)((br)->end - (br)->ptr) * 8 + (br)->bits)
+
+static inline uint64_t _BR_LOAD_BE64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_bswap64(v);
+#else
+    return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) | ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32) |
+           ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) | ((uint64_t)p[6] << 8) | (uint64_t)p[7];
+#endif
+}
+
+static inline void BR_INIT(bitreader_t *br, const void *data, uint32_t len) {
+    br->ptr = (const uint8_t*)data;
+    br->end = br->ptr + len;
+    br->cache = 0;
+    br->bits = 0;
+    br->overread = 0;
+}
+
+/*
+ after refill the cache holds at least 57 bits unless the input ends.
+ n is 1~8, so neither shift below reaches 64
+ */
+static inline void BR_REFILL(bitreader_t *br) {
+    if(br->bits > 56) {
+        return;
+    }
+    if(br->end - br->ptr >= 8) {
+        uint32_t n = (64 - br->bits) >> 3;
+        br->cache |= (_BR_LOAD_BE64(br->ptr) >> (64 - n * 8)) << (64 - br->bits - n * 8);
+        br->ptr += n;
+        br->bits += n * 8;
+        return;
+    }
+    while(br->bits <= 56 && br->ptr < br->end) {
+        br->cache |= (uint64_t)(*br->ptr++) << (56 - br->bits);
+        br->bits += 8;
+    }
+}
+
+/*
+ n: 1~32
+ */
+static inline uint32_t BR_PEEK(bitreader_t *br, uint32_t n) {
+    if(br->bits < n) {
+        BR_REFILL(br);
+    }
+    return (uint32_t)(br->cache >> (64 - n));
+}
+
+static inline void BR_SKIP(bitreader_t *br, uint32_t n) {
+    while(n > 0) {
+        if(br->bits < n) {
+            BR_REFILL(br);
+        }
+        uint32_t step = n < br->bits ? n : br->bits;
+        if(step == 0) {
+            br->overread += n;
+            return;
+        }
+        br->cache = step == 64 ? 0 : br->cache << step;
+        br->bits -= step;
+        n -= step;
+    }
+}
+
+static inline uint32_t BR_READ(bitreader_t *br, uint32_t n) {
+    if(br->bits < n) {
+        BR_REFILL(br);
+        if(br->bits < n) {
+            br->overread += n - br->bits;
+        }
+    }
+    uint32_t v = (uint32_t)(br->cache >> (64 - n));
+    br->cache = n < br->bits ? br->cache << n : 0;
+    br->bits = n < br->bits ? br->bits - n : 0;
+    return v;
+}
+
+static inline uint32_t BR_READ_BIT(bitreader_t *br) {
+    return BR_READ(br, 1);
+}
+
+/*
+ Exp-Golomb ue(v), values above 2^32-2 are reported as overread
+ */
+static inline uint32_t BR_READ_UE(bitreader_t *br) {
+    if(br->bits < 32) {
+        BR_REFILL(br);
+    }
+    if(br->cache == 0) {
+        br->overread += 1;
+        return 0;
+    }
+#if defined(__GNUC__) || defined(__clang__)
+    uint32_t zeros = (uint32_t)__builtin_clzll(br->cache);
+#else
+    uint32_t zeros = 0;
+    while(!(br->cache & (0x8000000000000000ULL >> zeros))) ++zeros;
+#endif
+    if(zeros > 31) {
+        br->overread += 1;
+        return 0;
+    }
+    BR_SKIP(br, zeros);
+    return (uint32_t)(((uint64_t)BR_READ(br, zeros + 1)) - 1);
+}
+
+static inline int32_t BR_READ_SE(bitreader_t *br) {
+    uint32_t k = BR_READ_UE(br);
+    return (k & 1) ? (int32_t)((k >> 1) + 1) : -(int32_t)(k >> 1);
+}
+
+static inline void BR_ALIGN(bitreader_t *br) {
+    BR_SKIP(br, br->bits & 7);
+}
+
+#endif /* bitreader_h */
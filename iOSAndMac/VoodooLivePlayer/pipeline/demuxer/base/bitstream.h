@@ -121,7 +121,7 @@ static inline int32_t BS_READ(bitstream_t *bs, uint8_t *buf, uint32_t len) {
          拷贝中间字节
          */
         if(read_byte_count > 0) {
-            memcpy(buf, bs->data, read_byte_count);
+            memcpy(buf, bs->data + bs->pos, read_byte_count);
             bs->pos += read_byte_count;
             buf += read_byte_count;
             sample = bs->data[bs->pos];
@@ -197,8 +197,17 @@ static inline void BS_SKIP(bitstream_t *bs, uint32_t len) {
 
 //#define BS_READ8_1(bs)          (bs)->pos >= (bs)->len ? 0 : (((bs)->data[(bs)->pos] & (1<<(7-(bs)->bit_pos)))>>(7-(bs)->bit_pos))
 //#define BS_READ8(bs, len)
-#define BS_READ16(bs,len)
-#define BS_READ32(bs,len)
+/*
+ len 0~32 bits, msb first. bitreader.h is the faster choice for parsing
+ */
+static inline uint32_t BS_READ32(bitstream_t *bs, uint32_t len) {
+    uint32_t ret = 0;
+    for(uint32_t i = 0;i < len;++i) {
+        ret = (ret << 1) | BS_READ_BIT(bs);
+    }
+    return ret;
+}
+#define BS_READ16(bs,len)       ((uint16_t)BS_READ32((bs),(len)))
 
 
 
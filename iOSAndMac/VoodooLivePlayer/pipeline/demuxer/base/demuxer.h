@@ -10,6 +10,8 @@
 #define demuxer_h
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
 
 typedef void (*fn_demuxer_callback_t)(void* userdata, int type, void* data, int size, int64_t ts[], uint32_t flag);
 #define VPMIN(a,b)   ((a)<(b)?(a):(b))
@@ -25,11 +27,83 @@ typedef void (*fn_demuxer_callback_t)(void* userdata, int type, void* data, int
 //#define VOODOO_DATA_TYPE_VIDEO_CONFIG       4
 #define VOODOO_DATA_TYPE_AUDIO_PARAMETERS   4
 #define VOODOO_DATA_TYPE_AUDIO_PACKET       5
+#define VOODOO_DATA_TYPE_METADATA           6
 //#define VOODOO_DATA_TYPE_AUDIO_CONFIG       7
 
+/*
+ one h264/hevc sei message, delivered right after its video packet with the
+ packet's pts/dts. flag carries the payload type in the low 16 bits. through
+ fn_demuxer_callback_t data points into the tag and is valid during the
+ callback only, with a packet pool it is a packet of its own.
+ */
+#define VOODOO_DATA_TYPE_SEI                7
+
 #define VOODOO_VIDEO_PACKET_FLAG_IS_KEY_FRAME   1
+#define VOODOO_SEI_FLAG_PAYLOAD_TYPE_MASK       0xffff
+#define VOODOO_SEI_FLAG_ESCAPED                 0x80000     /*  emulation prevention bytes still in, see nal_unescape */
+#define VOODOO_SEI_FLAG_SUFFIX                  0x100000    /*  hevc suffix sei */
+/*
+ chunked mode only, packet body delivered in several callbacks.
+ every piece carries FRAGMENT, the first one BEGIN and the last one END.
+ */
+#define VOODOO_PACKET_FLAG_FRAGMENT             0x10000
+#define VOODOO_PACKET_FLAG_FRAGMENT_BEGIN       0x20000
+#define VOODOO_PACKET_FLAG_FRAGMENT_END         0x40000
+/*
+ never set by a demuxer. the player marks video replayed from a gop cache
+ ahead of the presentation point, decoded but not shown.
+ */
+#define VOODOO_PACKET_FLAG_DECODE_ONLY          0x200000
 
 //#define VOODOO_NOPTS_VALUE  ((int64_t)UINT64_C(0x8000000000000000))
 #define VOODOO_NOPTS_VALUE                  ((int64_t)-9223372036854775807LL)
 
+#define VOODOO_CACHE_GROWTH_DOUBLE          0
+#define VOODOO_CACHE_GROWTH_LINEAR          1
+
+typedef void* (*fn_demuxer_malloc_t)(void* opaque, size_t size);
+typedef void (*fn_demuxer_free_t)(void* opaque, void* ptr);
+
+/*
+ demuxer memory config, zero fields use the default value.
+ the stream cache only holds tags straddling two feeds, it starts at
+ initial_cache_size and grows on demand up to max_cache_size.
+ */
+typedef struct demuxer_config_s {
+    uint32_t initial_cache_size;
+    uint32_t max_cache_size;
+    int cache_growth;               /*  VOODOO_CACHE_GROWTH_*   */
+    uint32_t cache_growth_step;     /*  linear growth only      */
+    fn_demuxer_malloc_t malloc_fn;
+    fn_demuxer_free_t free_fn;
+    void* allocator_opaque;
+} demuxer_config_t;
+
+static inline void* demuxer_default_malloc(void* opaque, size_t size) {
+    return malloc(size);
+}
+
+static inline void demuxer_default_free(void* opaque, void* ptr) {
+    free(ptr);
+}
+
+/*
+ allocator of config, malloc/free unless it sets both functions.
+ config may be NULL and may alias the outputs
+ */
+static inline void demuxer_select_allocator(const demuxer_config_t* config, fn_demuxer_malloc_t* malloc_fn, fn_demuxer_free_t* free_fn, void** opaque) {
+    if(config && config->malloc_fn && config->free_fn) {
+        fn_demuxer_malloc_t m = config->malloc_fn;
+        fn_demuxer_free_t f = config->free_fn;
+        void *o = config->allocator_opaque;
+        *malloc_fn = m;
+        *free_fn = f;
+        *opaque = o;
+    } else {
+        *malloc_fn = demuxer_default_malloc;
+        *free_fn = demuxer_default_free;
+        *opaque = NULL;
+    }
+}
+
 #endif /* demuxer_h */
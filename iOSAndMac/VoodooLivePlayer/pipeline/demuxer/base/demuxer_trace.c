@@ -0,0 +1,107 @@
+//
+//  demuxer_trace.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#include "demuxer_trace.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define DEMUXER_LOG_MESSAGE_SIZE    256
+
+#ifdef VOODOO_DEMUXER_LOG_STDERR
+static void demuxer_trace_stderr_log(void* opaque, int level, const char* message) {
+    static const char* names[] = { "ERROR", "WARN", "INFO", "DEBUG" };
+    fprintf(stderr, "[%s] %s\n", names[level & 3], message);
+}
+#endif
+
+void demuxer_trace_init(demuxer_trace_t* trace) {
+    memset(trace, 0, sizeof(demuxer_trace_t));
+#ifdef VOODOO_DEMUXER_LOG_STDERR
+    trace->log_callback = demuxer_trace_stderr_log;
+    trace->log_level = VOODOO_LOG_WARN;
+#endif
+}
+
+void demuxer_trace_set_log_callback(demuxer_trace_t* trace, fn_demuxer_log_callback_t callback, void* opaque, int level) {
+    trace->log_callback = callback;
+    trace->log_opaque = opaque;
+    trace->log_level = level;
+}
+
+void demuxer_trace_log(demuxer_trace_t* trace, int level, const char* format, ...) {
+    char message[DEMUXER_LOG_MESSAGE_SIZE];
+    va_list args;
+    if(!trace->log_callback || level > trace->log_level) {
+        return;
+    }
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    trace->log_callback(trace->log_opaque, level, message);
+}
+
+void demuxer_trace_event(demuxer_trace_t* trace, int type, int level, int64_t dts, uint64_t offset, uint32_t value) {
+    uint32_t head = trace->head;
+    uint32_t tail = __atomic_load_n(&trace->tail, __ATOMIC_ACQUIRE);
+    trace->seq++;
+    if(head - tail >= DEMUXER_EVENT_RING_SIZE) {
+        /*
+         满了丢掉新事件，只计数
+         */
+        DEMUXER_STAT_ADD(trace, events_dropped, 1);
+        return;
+    }
+    demuxer_event_t *event = &trace->events[head & (DEMUXER_EVENT_RING_SIZE - 1)];
+    event->seq = trace->seq;
+    event->type = type;
+    event->level = level;
+    event->dts = dts;
+    event->offset = offset;
+    event->value = value;
+    __atomic_store_n(&trace->head, head + 1, __ATOMIC_RELEASE);
+}
+
+int demuxer_trace_read_events(demuxer_trace_t* trace, demuxer_event_t* events, int max) {
+    uint32_t tail = trace->tail;
+    uint32_t head = __atomic_load_n(&trace->head, __ATOMIC_ACQUIRE);
+    int count = 0;
+    while(tail != head && count < max) {
+        events[count++] = trace->events[tail & (DEMUXER_EVENT_RING_SIZE - 1)];
+        ++tail;
+    }
+    __atomic_store_n(&trace->tail, tail, __ATOMIC_RELEASE);
+    return count;
+}
+
+void demuxer_trace_get_stats(demuxer_trace_t* trace, demuxer_stats_t* stats) {
+    stats->bytes_fed = __atomic_load_n(&trace->stats.bytes_fed, __ATOMIC_RELAXED);
+    stats->feeds = __atomic_load_n(&trace->stats.feeds, __ATOMIC_RELAXED);
+    stats->audio_tags = __atomic_load_n(&trace->stats.audio_tags, __ATOMIC_RELAXED);
+    stats->video_tags = __atomic_load_n(&trace->stats.video_tags, __ATOMIC_RELAXED);
+    stats->script_tags = __atomic_load_n(&trace->stats.script_tags, __ATOMIC_RELAXED);
+    stats->other_tags = __atomic_load_n(&trace->stats.other_tags, __ATOMIC_RELAXED);
+    stats->keyframes = __atomic_load_n(&trace->stats.keyframes, __ATOMIC_RELAXED);
+    stats->bytes_moved = __atomic_load_n(&trace->stats.bytes_moved, __ATOMIC_RELAXED);
+    stats->malformed_tags = __atomic_load_n(&trace->stats.malformed_tags, __ATOMIC_RELAXED);
+    stats->wrong_dts = __atomic_load_n(&trace->stats.wrong_dts, __ATOMIC_RELAXED);
+    stats->max_feed_ns = __atomic_load_n(&trace->stats.max_feed_ns, __ATOMIC_RELAXED);
+    stats->resyncs = __atomic_load_n(&trace->stats.resyncs, __ATOMIC_RELAXED);
+    stats->resync_bytes_skipped = __atomic_load_n(&trace->stats.resync_bytes_skipped, __ATOMIC_RELAXED);
+    stats->events_dropped = __atomic_load_n(&trace->stats.events_dropped, __ATOMIC_RELAXED);
+    stats->dropped_non_reference = __atomic_load_n(&trace->stats.dropped_non_reference, __ATOMIC_RELAXED);
+    stats->dropped_temporal_layers = __atomic_load_n(&trace->stats.dropped_temporal_layers, __ATOMIC_RELAXED);
+    stats->dropped_inter_frames = __atomic_load_n(&trace->stats.dropped_inter_frames, __ATOMIC_RELAXED);
+}
+
+uint64_t demuxer_trace_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
@@ -0,0 +1,115 @@
+//
+//  demuxer_trace.h
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#ifndef demuxer_trace_h
+#define demuxer_trace_h
+
+#include "demuxer.h"
+
+/*
+ demuxers never write to stdio. anomalies are counted in demuxer_stats_t,
+ recorded in a fixed size event ring and, when a log callback is set,
+ formatted and passed to it. build with VOODOO_DEMUXER_LOG_STDERR to get
+ the old stderr output as the default log callback.
+ */
+#define VOODOO_LOG_ERROR        0
+#define VOODOO_LOG_WARN         1
+#define VOODOO_LOG_INFO         2
+#define VOODOO_LOG_DEBUG        3
+
+typedef void (*fn_demuxer_log_callback_t)(void* opaque, int level, const char* message);
+
+#define VOODOO_EVENT_PARSE_ERROR        1   /*  demuxer stopped, value: source line */
+#define VOODOO_EVENT_TAG_FAILED         2   /*  value: tag type                     */
+#define VOODOO_EVENT_STREAM_ID          3   /*  value: stream id                    */
+#define VOODOO_EVENT_PREV_TAG_SIZE      4   /*  value: prev tag size read           */
+#define VOODOO_EVENT_WRONG_DTS          5   /*  value: composition time             */
+#define VOODOO_EVENT_SEQUENCE_HEADER    6   /*  sps parse failed, value: codec id   */
+#define VOODOO_EVENT_CACHE_LIMIT        7   /*  value: bytes needed                 */
+#define VOODOO_EVENT_ALLOC_FAILED       8   /*  value: bytes                        */
+#define VOODOO_EVENT_CHUNK_STREAM       9   /*  rtmp, value: chunk stream id        */
+#define VOODOO_EVENT_AGGREGATE          10  /*  rtmp truncated aggregate, value: size */
+#define VOODOO_EVENT_RESYNC             11  /*  framing lost, value: offending field */
+#define VOODOO_EVENT_RESYNCED           12  /*  next tag found, value: bytes skipped */
+#define VOODOO_EVENT_NAL_FORMAT         13  /*  unrecognised nal framing, value: size */
+#define VOODOO_EVENT_TS_CONTINUITY      14  /*  mpeg-ts packets lost, value: pid    */
+
+typedef struct demuxer_event_s {
+    uint64_t seq;
+    int type;               /*  VOODOO_EVENT_*  */
+    int level;              /*  VOODOO_LOG_*    */
+    int64_t dts;
+    uint64_t offset;        /*  input byte offset   */
+    uint32_t value;
+} demuxer_event_t;
+
+/*
+ written by the feeding thread only, readable from any thread
+ */
+typedef struct demuxer_stats_s {
+    uint64_t bytes_fed;
+    uint64_t feeds;
+    uint64_t audio_tags;
+    uint64_t video_tags;
+    uint64_t script_tags;
+    uint64_t other_tags;
+    uint64_t keyframes;
+    uint64_t bytes_moved;       /*  copied into the stream cache    */
+    uint64_t malformed_tags;
+    uint64_t wrong_dts;
+    uint64_t max_feed_ns;
+    uint64_t resyncs;
+    uint64_t resync_bytes_skipped;
+    uint64_t events_dropped;    /*  ring full                       */
+    uint64_t dropped_non_reference;     /*  flv_demuxer_set_drop_level  */
+    uint64_t dropped_temporal_layers;
+    uint64_t dropped_inter_frames;
+} demuxer_stats_t;
+
+#define DEMUXER_EVENT_RING_SIZE     64
+
+/*
+ single producer (the demuxer) single consumer (demuxer_trace_read_events)
+ */
+typedef struct demuxer_trace_s {
+    fn_demuxer_log_callback_t log_callback;
+    void* log_opaque;
+    int log_level;
+
+    demuxer_stats_t stats;
+
+    uint64_t seq;
+    uint32_t head;
+    uint32_t tail;
+    demuxer_event_t events[DEMUXER_EVENT_RING_SIZE];
+} demuxer_trace_t;
+
+#define DEMUXER_STAT_ADD(trace, field, n)   __atomic_store_n(&(trace)->stats.field, __atomic_load_n(&(trace)->stats.field, __ATOMIC_RELAXED) + (n), __ATOMIC_RELAXED)
+#define DEMUXER_STAT_MAX(trace, field, v)   do { if((uint64_t)(v) > __atomic_load_n(&(trace)->stats.field, __ATOMIC_RELAXED)) __atomic_store_n(&(trace)->stats.field, (uint64_t)(v), __ATOMIC_RELAXED); } while(0)
+
+/*
+ formats only when the level passes
+ */
+#define DEMUXER_LOG(trace, level, ...)      do { if((trace)->log_callback && (level) <= (trace)->log_level) demuxer_trace_log((trace), (level), __VA_ARGS__); } while(0)
+
+void demuxer_trace_init(demuxer_trace_t* trace);
+void demuxer_trace_set_log_callback(demuxer_trace_t* trace, fn_demuxer_log_callback_t callback, void* opaque, int level);
+void demuxer_trace_log(demuxer_trace_t* trace, int level, const char* format, ...)
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((format(printf, 3, 4)))
+#endif
+    ;
+void demuxer_trace_event(demuxer_trace_t* trace, int type, int level, int64_t dts, uint64_t offset, uint32_t value);
+int demuxer_trace_read_events(demuxer_trace_t* trace, demuxer_event_t* events, int max);
+void demuxer_trace_get_stats(demuxer_trace_t* trace, demuxer_stats_t* stats);
+/*
+ monotonic clock for feed latency
+ */
+uint64_t demuxer_trace_now_ns(void);
+
+#endif /* demuxer_trace_h */
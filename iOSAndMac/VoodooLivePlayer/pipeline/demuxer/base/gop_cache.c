@@ -0,0 +1,270 @@
+//
+//  gop_cache.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#include "gop_cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define GOP_CACHE_DEFAULT_MAX_BYTES         (16*1024*1024)
+#define GOP_CACHE_DEFAULT_MAX_DURATION      (10*1000)
+#define GOP_CACHE_INITIAL_CAPACITY          (256)
+
+struct gop_cache_s {
+    pthread_mutex_t lock;
+    gop_cache_config_t config;
+
+    fn_demuxer_malloc_t malloc_fn;
+    fn_demuxer_free_t free_fn;
+    void *allocator_opaque;
+
+    demuxer_packet_t *video_parameters;
+    demuxer_packet_t *audio_parameters;
+
+    /*
+     gop in decode order, packets[head, head + count)
+     */
+    demuxer_packet_t **packets;
+    uint32_t head;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t bytes;
+
+    /*
+     有视频时只从关键帧开始缓存，超限后等下一个关键帧
+     */
+    int has_video;
+    int gop_open;
+
+    gop_cache_stats_t stats;
+};
+
+gop_cache_t* gop_cache_create(const gop_cache_config_t* config, const demuxer_config_t* allocator) {
+    fn_demuxer_malloc_t malloc_fn;
+    fn_demuxer_free_t free_fn;
+    void *opaque;
+    demuxer_select_allocator(allocator, &malloc_fn, &free_fn, &opaque);
+
+    gop_cache_t *cache = (gop_cache_t*)malloc_fn(opaque, sizeof(gop_cache_t));
+    if(!cache) {
+        return NULL;
+    }
+    memset(cache, 0, sizeof(gop_cache_t));
+    cache->packets = (demuxer_packet_t**)malloc_fn(opaque, GOP_CACHE_INITIAL_CAPACITY * sizeof(demuxer_packet_t*));
+    if(!cache->packets) {
+        free_fn(opaque, cache);
+        return NULL;
+    }
+    cache->capacity = GOP_CACHE_INITIAL_CAPACITY;
+    if(config) {
+        cache->config = *config;
+    }
+    if(cache->config.max_bytes == 0) cache->config.max_bytes = GOP_CACHE_DEFAULT_MAX_BYTES;
+    if(cache->config.max_duration_ms == 0) cache->config.max_duration_ms = GOP_CACHE_DEFAULT_MAX_DURATION;
+    cache->malloc_fn = malloc_fn;
+    cache->free_fn = free_fn;
+    cache->allocator_opaque = opaque;
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+static demuxer_packet_t* gop_cache_at(gop_cache_t* cache, uint32_t i) {
+    return cache->packets[(cache->head + i) % cache->capacity];
+}
+
+static void gop_cache_drop_front(gop_cache_t* cache) {
+    demuxer_packet_t *packet = cache->packets[cache->head];
+    cache->bytes -= packet->size;
+    cache->head = (cache->head + 1) % cache->capacity;
+    --cache->count;
+    demuxer_packet_release(packet);
+}
+
+static void gop_cache_drop_all(gop_cache_t* cache) {
+    while(cache->count > 0) {
+        gop_cache_drop_front(cache);
+    }
+    cache->head = 0;
+}
+
+static int gop_cache_grow(gop_cache_t* cache) {
+    uint32_t capacity = cache->capacity * 2;
+    demuxer_packet_t **packets = (demuxer_packet_t**)cache->malloc_fn(cache->allocator_opaque, capacity * sizeof(demuxer_packet_t*));
+    if(!packets) {
+        return -1;
+    }
+    for(uint32_t i = 0;i < cache->count;++i) {
+        packets[i] = gop_cache_at(cache, i);
+    }
+    cache->free_fn(cache->allocator_opaque, cache->packets);
+    cache->packets = packets;
+    cache->head = 0;
+    cache->capacity = capacity;
+    return 0;
+}
+
+/*
+ 第一个和最后一个有效dts的差
+ */
+static uint32_t gop_cache_duration(gop_cache_t* cache) {
+    int64_t first = VOODOO_NOPTS_VALUE, last = VOODOO_NOPTS_VALUE;
+    for(uint32_t i = 0;i < cache->count && first == VOODOO_NOPTS_VALUE;++i) {
+        first = gop_cache_at(cache, i)->dts;
+    }
+    for(uint32_t i = cache->count;i > 0 && last == VOODOO_NOPTS_VALUE;--i) {
+        last = gop_cache_at(cache, i - 1)->dts;
+    }
+    if(first == VOODOO_NOPTS_VALUE || last <= first) {
+        return 0;
+    }
+    return (uint32_t)VPMIN(last - first, (int64_t)UINT32_MAX);
+}
+
+static int gop_cache_over_limit(gop_cache_t* cache) {
+    return cache->bytes > cache->config.max_bytes || gop_cache_duration(cache) > cache->config.max_duration_ms;
+}
+
+static void gop_cache_set_parameters(gop_cache_t* cache, demuxer_packet_t** slot, demuxer_packet_t* packet) {
+    demuxer_packet_retain(packet);
+    if(*slot) {
+        demuxer_packet_release(*slot);
+    }
+    *slot = packet;
+}
+
+void gop_cache_push(gop_cache_t* cache, demuxer_packet_t* packet) {
+    pthread_mutex_lock(&cache->lock);
+    switch(packet->type) {
+        case VOODOO_DATA_TYPE_VIDEO_PARAMETERS:
+            cache->has_video = 1;
+            gop_cache_set_parameters(cache, &cache->video_parameters, packet);
+            break;
+        case VOODOO_DATA_TYPE_AUDIO_PARAMETERS:
+            gop_cache_set_parameters(cache, &cache->audio_parameters, packet);
+            break;
+        case VOODOO_DATA_TYPE_VIDEO_PACKET:
+        case VOODOO_DATA_TYPE_AUDIO_PACKET:
+            if(packet->type == VOODOO_DATA_TYPE_VIDEO_PACKET) {
+                cache->has_video = 1;
+                if(packet->flag & VOODOO_VIDEO_PACKET_FLAG_IS_KEY_FRAME) {
+                    gop_cache_drop_all(cache);
+                    cache->gop_open = 1;
+                    cache->stats.gops++;
+                }
+            }
+            if(cache->has_video && !cache->gop_open) {
+                break;
+            }
+            if(cache->count == cache->capacity && gop_cache_grow(cache) < 0) {
+                gop_cache_drop_all(cache);
+                cache->gop_open = 0;
+                break;
+            }
+            demuxer_packet_retain(packet);
+            cache->packets[(cache->head + cache->count) % cache->capacity] = packet;
+            cache->count++;
+            cache->bytes += packet->size;
+            if(gop_cache_over_limit(cache)) {
+                if(cache->has_video) {
+                    /*
+                     去掉开头的帧gop就没法解码了，整个丢掉
+                     */
+                    gop_cache_drop_all(cache);
+                    cache->gop_open = 0;
+                    cache->stats.overflows++;
+                } else {
+                    while(cache->count > 1 && gop_cache_over_limit(cache)) {
+                        gop_cache_drop_front(cache);
+                    }
+                }
+            }
+            break;
+        default:
+            break;
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void gop_cache_clear(gop_cache_t* cache) {
+    pthread_mutex_lock(&cache->lock);
+    gop_cache_drop_all(cache);
+    cache->gop_open = 0;
+    if(cache->video_parameters) {
+        demuxer_packet_release(cache->video_parameters);
+        cache->video_parameters = NULL;
+    }
+    if(cache->audio_parameters) {
+        demuxer_packet_release(cache->audio_parameters);
+        cache->audio_parameters = NULL;
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void gop_cache_destroy(gop_cache_t* cache) {
+    gop_cache_clear(cache);
+    pthread_mutex_destroy(&cache->lock);
+    cache->free_fn(cache->allocator_opaque, cache->packets);
+    cache->free_fn(cache->allocator_opaque, cache);
+}
+
+int gop_cache_snapshot(gop_cache_t* cache, int64_t target_latency_ms, demuxer_packet_t** packets, int max, int* present_index) {
+    int n = 0, present = 0;
+    pthread_mutex_lock(&cache->lock);
+    uint32_t total = cache->count + (cache->video_parameters ? 1 : 0) + (cache->audio_parameters ? 1 : 0);
+    if(total > (uint32_t)max) {
+        pthread_mutex_unlock(&cache->lock);
+        return -1;
+    }
+    if(cache->video_parameters) {
+        packets[n++] = cache->video_parameters;
+    }
+    if(cache->audio_parameters) {
+        packets[n++] = cache->audio_parameters;
+    }
+    present = n;
+    if(target_latency_ms >= 0 && cache->count > 0) {
+        /*
+         最新的dts往前target_latency_ms之前的包只解码不显示
+         */
+        int64_t newest = VOODOO_NOPTS_VALUE;
+        for(uint32_t i = cache->count;i > 0 && newest == VOODOO_NOPTS_VALUE;--i) {
+            newest = gop_cache_at(cache, i - 1)->dts;
+        }
+        uint32_t i = 0;
+        if(newest != VOODOO_NOPTS_VALUE) {
+            while(i < cache->count) {
+                int64_t dts = gop_cache_at(cache, i)->dts;
+                if(dts != VOODOO_NOPTS_VALUE && dts >= newest - target_latency_ms) {
+                    break;
+                }
+                ++i;
+            }
+        }
+        present += (int)i;
+    }
+    for(uint32_t i = 0;i < cache->count;++i) {
+        packets[n++] = gop_cache_at(cache, i);
+    }
+    for(int i = 0;i < n;++i) {
+        demuxer_packet_retain(packets[i]);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    if(present_index) {
+        *present_index = present;
+    }
+    return n;
+}
+
+void gop_cache_get_stats(gop_cache_t* cache, gop_cache_stats_t* stats) {
+    pthread_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    stats->packets = cache->count;
+    stats->bytes = cache->bytes;
+    stats->duration_ms = gop_cache_duration(cache);
+    pthread_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,62 @@
+//
+//  gop_cache.h
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#ifndef gop_cache_h
+#define gop_cache_h
+
+#include "demuxer.h"
+#include "packet_pool.h"
+
+/*
+ latest sequence headers plus every packet since the last video keyframe,
+ held as references to pooled packets, nothing is copied.
+ a consumer that attaches late takes a snapshot and starts decoding at once
+ instead of waiting for the next keyframe.
+ pushed from the demuxing thread, snapshots may be taken from any thread.
+ */
+typedef struct gop_cache_s gop_cache_t;
+
+typedef struct gop_cache_config_s {
+    uint32_t max_bytes;         /*  0 for 16 MB                         */
+    uint32_t max_duration_ms;   /*  0 for 10 s                          */
+} gop_cache_config_t;
+
+typedef struct gop_cache_stats_s {
+    uint32_t packets;
+    uint32_t bytes;
+    uint32_t duration_ms;
+    uint64_t gops;              /*  keyframes that started a new gop    */
+    uint64_t overflows;         /*  gops dropped for exceeding a cap    */
+} gop_cache_stats_t;
+
+/*
+ allocator may be NULL for malloc/free
+ */
+gop_cache_t* gop_cache_create(const gop_cache_config_t* config, const demuxer_config_t* allocator);
+void gop_cache_destroy(gop_cache_t* cache);
+
+/*
+ takes its own reference. parameters replace the cached ones, a video
+ keyframe starts a new gop. a gop that outgrows a cap is dropped whole and
+ caching resumes at the next keyframe. without video, audio is kept as a
+ sliding window trimmed to the caps.
+ */
+void gop_cache_push(gop_cache_t* cache, demuxer_packet_t* packet);
+void gop_cache_clear(gop_cache_t* cache);
+
+/*
+ parameters first, then the gop in decode order, every packet retained
+ for the caller. returns the count, or -1 when max is too small.
+ present_index is the first packet within target_latency_ms of the newest
+ one: video before it is decoded without being shown, audio before it is
+ dropped. a negative target_latency_ms presents everything.
+ */
+int gop_cache_snapshot(gop_cache_t* cache, int64_t target_latency_ms, demuxer_packet_t** packets, int max, int* present_index);
+void gop_cache_get_stats(gop_cache_t* cache, gop_cache_stats_t* stats);
+
+#endif /* gop_cache_h */
@@ -0,0 +1,517 @@
+//
+//  nal_format.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#include "nal_format.h"
+#include "video_sps.h"
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define AVC_NAL_SEI             6
+#define AVC_NAL_SPS             7
+#define AVC_NAL_AUD             9
+#define HEVC_NAL_VPS            32
+#define HEVC_NAL_SPS            33
+#define HEVC_NAL_AUD            35
+#define HEVC_NAL_SEI_PREFIX     39
+#define HEVC_NAL_SEI_SUFFIX     40
+
+/*
+ [from, end)里第一个00 00的位置，没有返回end。
+ 起始码和缺少防竞争字节的地方都从这里开始找，数据基本没有连续的0，按16字节一批比较
+ */
+static uint32_t nal_find_zero_pair(const uint8_t* p, uint32_t from, uint32_t end) {
+    uint32_t i = from;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for(;i + 17 <= end;i += 16) {
+        __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i)), zero);
+        __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i + 1)), zero);
+        int mask = _mm_movemask_epi8(_mm_and_si128(a, b));
+        if(mask) {
+            return i + (uint32_t)__builtin_ctz((unsigned)mask);
+        }
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t zero = vdupq_n_u8(0);
+    for(;i + 17 <= end;i += 16) {
+        uint8x16_t hit = vandq_u8(vceqq_u8(vld1q_u8(p + i), zero), vceqq_u8(vld1q_u8(p + i + 1), zero));
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+        if(mask) {
+            return i + (uint32_t)(__builtin_ctzll(mask) >> 2);
+        }
+    }
+#endif
+    for(;i + 1 < end;++i) {
+        if((p[i] | p[i + 1]) == 0) {
+            return i;
+        }
+    }
+    return end;
+}
+
+/*
+ nal里下一个需要插入0x03的位置（00 00后面跟着00/01/02的那个字节），没有返回end。
+ 以0x00结尾的nal（cabac_zero_word）后面也要补0x03，不然会被当成起始码的一部分，由调用方处理
+ */
+static uint32_t nal_find_escape(const uint8_t* p, uint32_t from, uint32_t end) {
+    uint32_t i = from;
+    while((i = nal_find_zero_pair(p, i, end)) + 2 < end) {
+        if(p[i + 2] <= 2) {
+            return i + 2;
+        }
+        i += 2;
+    }
+    return end;
+}
+
+typedef struct nal_reader_s {
+    const uint8_t* p;
+    uint32_t size;
+    uint32_t pos;
+    int nal_length_size;        /*  0 for start code delimited input    */
+} nal_reader_t;
+
+/*
+ 1 有下一个nal，0 结束，-1 长度越界
+ */
+static int nal_reader_next(nal_reader_t* r, uint32_t* start, uint32_t* end) {
+    while(r->nal_length_size == 0) {
+        uint32_t i = r->pos;
+        while((i = nal_find_zero_pair(r->p, i, r->size)) + 2 < r->size && r->p[i + 2] != 1) {
+            ++i;
+        }
+        /*
+         以00 00 01结尾时起始码后面已经没有数据
+         */
+        if(i + 3 >= r->size) {
+            r->pos = r->size;
+            return 0;
+        }
+        *start = i + 3;
+        i = *start;
+        while((i = nal_find_zero_pair(r->p, i, r->size)) + 2 < r->size && r->p[i + 2] != 1) {
+            ++i;
+        }
+        if(i + 2 >= r->size) {
+            i = r->size;
+        }
+        r->pos = i;
+        /*
+         4字节起始码的第一个0和trailing_zero_8bits不属于nal
+         */
+        while(i > *start && r->p[i - 1] == 0) {
+            --i;
+        }
+        *end = i;
+        /*
+         两个起始码之间只有0的空nal跳过
+         */
+        if(*end > *start) {
+            return 1;
+        }
+    }
+    for(;;) {
+        if(r->pos == r->size) {
+            return 0;
+        }
+        if(r->size - r->pos < (uint32_t)r->nal_length_size) {
+            return -1;
+        }
+        uint32_t len = 0;
+        for(int i = 0;i < r->nal_length_size;++i) {
+            len = (len << 8) | r->p[r->pos + i];
+        }
+        r->pos += (uint32_t)r->nal_length_size;
+        if(len > r->size - r->pos) {
+            return -1;
+        }
+        *start = r->pos;
+        *end = r->pos + len;
+        r->pos += len;
+        if(len > 0) {
+            return 1;
+        }
+    }
+}
+
+int nal_next(const uint8_t* data, uint32_t size, int nal_length_size, uint32_t* pos, uint32_t* start, uint32_t* end) {
+    nal_reader_t r = { data, size, *pos, nal_length_size };
+    int ret = nal_reader_next(&r, start, end);
+    *pos = r.pos;
+    return ret;
+}
+
+static int nal_type(int codec_id, uint8_t header) {
+    return codec_id == VIDEO_CODEC_ID_HEVC ? (header >> 1) & 0x3f : header & 0x1f;
+}
+
+static int nal_is_parameter_set(int codec_id, int type) {
+    return codec_id == VIDEO_CODEC_ID_HEVC ? type == HEVC_NAL_VPS || type == HEVC_NAL_SPS : type == AVC_NAL_SPS;
+}
+
+static int nal_is_aud(int codec_id, int type) {
+    return codec_id == VIDEO_CODEC_ID_HEVC ? type == HEVC_NAL_AUD : type == AVC_NAL_AUD;
+}
+
+static int nal_scan_with(int codec_id, const uint8_t* data, uint32_t size, int nal_length_size, nal_scan_t* scan) {
+    nal_reader_t r = { data, size, 0, nal_length_size };
+    uint32_t start, end;
+    int ret;
+    memset(scan, 0, sizeof(nal_scan_t));
+    scan->input_annexb = nal_length_size == 0;
+    while((ret = nal_reader_next(&r, &start, &end)) > 0) {
+        int type = nal_type(codec_id, data[start]);
+        if(scan->nal_count == 0) {
+            scan->leading_aud = nal_is_aud(codec_id, type);
+        }
+        if(nal_is_parameter_set(codec_id, type)) {
+            scan->has_parameter_sets = 1;
+        }
+        ++scan->nal_count;
+        scan->payload_size += end - start;
+        if(nal_length_size > 0) {
+            for(uint32_t i = start;(i = nal_find_escape(data, i, end)) < end;++scan->escapes);
+            scan->escapes += data[end - 1] == 0;
+        }
+    }
+    return ret;
+}
+
+int nal_scan(int codec_id, const uint8_t* data, uint32_t size, int nal_length_size, nal_scan_t* scan) {
+    if(nal_scan_with(codec_id, data, size, nal_length_size, scan) == 0 && scan->nal_count > 0) {
+        return 0;
+    }
+    /*
+     长度对不上，再看是不是直接写了起始码
+     */
+    if(size >= 3 && data[0] == 0 && data[1] == 0 && (data[2] == 1 || (size >= 4 && data[2] == 0 && data[3] == 1))) {
+        if(nal_scan_with(codec_id, data, size, 0, scan) == 0 && scan->nal_count > 0) {
+            return 0;
+        }
+    }
+    memset(scan, 0, sizeof(nal_scan_t));
+    return -1;
+}
+
+uint32_t nal_output_size(const nal_scan_t* scan, int format, uint32_t parameters_size) {
+    uint32_t size = scan->nal_count * NAL_START_CODE_SIZE + scan->payload_size;
+    if(format == NAL_FORMAT_ANNEXB) {
+        size += scan->escapes + (scan->has_parameter_sets ? 0 : parameters_size);
+    }
+    return size;
+}
+
+static uint8_t* nal_write_prefix(uint8_t* out, int format, uint32_t len) {
+    if(format == NAL_FORMAT_ANNEXB) {
+        out[0] = out[1] = out[2] = 0;
+        out[3] = 1;
+    } else {
+        out[0] = (uint8_t)(len >> 24);
+        out[1] = (uint8_t)(len >> 16);
+        out[2] = (uint8_t)(len >> 8);
+        out[3] = (uint8_t)len;
+    }
+    return out + NAL_START_CODE_SIZE;
+}
+
+uint32_t nal_convert(const uint8_t* data, uint32_t size, int nal_length_size, const nal_scan_t* scan, int format,
+                     const uint8_t* parameters, uint32_t parameters_size, uint8_t* out) {
+    nal_reader_t r = { data, size, 0, scan->input_annexb ? 0 : nal_length_size };
+    uint8_t* o = out;
+    uint32_t start, end, index = 0;
+    int inject = format == NAL_FORMAT_ANNEXB && parameters && parameters_size > 0 && !scan->has_parameter_sets;
+    while(nal_reader_next(&r, &start, &end) > 0) {
+        if(inject && index == (scan->leading_aud ? 1u : 0u)) {
+            memcpy(o, parameters, parameters_size);
+            o += parameters_size;
+        }
+        ++index;
+        o = nal_write_prefix(o, format, end - start);
+        if(format != NAL_FORMAT_ANNEXB || scan->escapes == 0) {
+            memcpy(o, data + start, end - start);
+            o += end - start;
+            continue;
+        }
+        for(uint32_t i = start;i < end;) {
+            uint32_t escape = nal_find_escape(data, i, end);
+            memcpy(o, data + i, escape - i);
+            o += escape - i;
+            if(escape < end) {
+                *o++ = 3;
+            }
+            i = escape;
+        }
+        if(data[end - 1] == 0) {
+            *o++ = 3;
+        }
+    }
+    if(inject && index == 1 && scan->leading_aud) {
+        memcpy(o, parameters, parameters_size);
+        o += parameters_size;
+    }
+    return (uint32_t)(o - out);
+}
+
+void nal_length4_to_annexb_inplace(uint8_t* data, uint32_t size) {
+    uint32_t pos = 0;
+    while(size - pos >= NAL_START_CODE_SIZE) {
+        uint32_t len = ((uint32_t)data[pos] << 24) | ((uint32_t)data[pos + 1] << 16) | ((uint32_t)data[pos + 2] << 8) | data[pos + 3];
+        nal_write_prefix(data + pos, NAL_FORMAT_ANNEXB, len);
+        pos += NAL_START_CODE_SIZE;
+        if(len > size - pos) {
+            return;
+        }
+        pos += len;
+    }
+}
+
+static int nal_append_parameter_set(const uint8_t* nal, uint32_t len, uint8_t* out, uint32_t capacity, uint32_t* pos) {
+    if(out) {
+        if(capacity - *pos < NAL_START_CODE_SIZE + len) {
+            return -1;
+        }
+        nal_write_prefix(out + *pos, NAL_FORMAT_ANNEXB, len);
+        memcpy(out + *pos + NAL_START_CODE_SIZE, nal, len);
+    }
+    *pos += NAL_START_CODE_SIZE + len;
+    return 0;
+}
+
+/*
+ avcC: 5字节头，sps个数在低5位，每个2字节长度；然后pps个数1字节，每个2字节长度
+ hvcC: 23字节头，num_arrays个数组，每个数组1字节类型、2字节个数，每个nal 2字节长度
+ */
+int nal_parameter_sets_to_annexb(int codec_id, const uint8_t* config, uint32_t size, uint8_t* out, uint32_t capacity, int* nal_length_size) {
+    uint32_t pos, written = 0, groups, count = 0;
+    int hevc = codec_id == VIDEO_CODEC_ID_HEVC;
+    if(codec_id != VIDEO_CODEC_ID_H264 && !hevc) {
+        return -1;
+    }
+    if(size < (hevc ? 23u : 6u) || config[0] != 1) {
+        return -1;
+    }
+    if(nal_length_size) {
+        *nal_length_size = (config[hevc ? 21 : 4] & 0x3) + 1;
+    }
+    pos = hevc ? 23 : 5;
+    groups = hevc ? config[22] : 2;
+    for(uint32_t g = 0;g < groups;++g) {
+        if(hevc) {
+            if(pos + 3 > size) {
+                return -1;
+            }
+            count = ((uint32_t)config[pos + 1] << 8) | config[pos + 2];
+            pos += 3;
+        } else {
+            if(pos + 1 > size) {
+                /*
+                 没有pps个数的老记录
+                 */
+                break;
+            }
+            count = g == 0 ? config[pos] & 0x1f : config[pos];
+            pos += 1;
+        }
+        for(uint32_t i = 0;i < count;++i) {
+            if(pos + 2 > size) {
+                return -1;
+            }
+            uint32_t len = ((uint32_t)config[pos] << 8) | config[pos + 1];
+            pos += 2;
+            if(len > size - pos) {
+                return -1;
+            }
+            if(len > 0 && nal_append_parameter_set(config + pos, len, out, capacity, &written) < 0) {
+                return -1;
+            }
+            pos += len;
+        }
+    }
+    return (int)written;
+}
+
+/*
+ rbsp上按字节读，跳过防竞争字节
+ */
+typedef struct nal_rbsp_reader_s {
+    const uint8_t* p;
+    uint32_t size;
+    uint32_t pos;
+    int zeros;
+    int escaped;
+} nal_rbsp_reader_t;
+
+static int nal_rbsp_byte(nal_rbsp_reader_t* r) {
+    if(r->pos >= r->size) {
+        return -1;
+    }
+    if(r->zeros >= 2 && r->p[r->pos] == 3) {
+        r->escaped = 1;
+        r->zeros = 0;
+        if(++r->pos >= r->size) {
+            return -1;
+        }
+    }
+    uint8_t b = r->p[r->pos++];
+    r->zeros = b == 0 ? r->zeros + 1 : 0;
+    return b;
+}
+
+/*
+ payloadType/payloadSize都是若干个0xff加最后一个字节
+ */
+static int nal_rbsp_sei_value(nal_rbsp_reader_t* r, uint32_t* value) {
+    int b;
+    *value = 0;
+    while((b = nal_rbsp_byte(r)) == 0xff) {
+        *value += 0xff;
+    }
+    if(b < 0) {
+        return -1;
+    }
+    *value += (uint32_t)b;
+    return 0;
+}
+
+static int nal_parse_sei(const uint8_t* nal, uint32_t size, int header_size, int suffix, fn_nal_sei_callback_t callback, void* opaque) {
+    nal_rbsp_reader_t r = { nal, size, (uint32_t)header_size, 0, 0 };
+    nal_sei_t sei;
+    uint32_t type, payload_size;
+    int count = 0;
+    /*
+     剩下的只有rbsp_trailing_bits（0x80）就结束
+     */
+    while(r.pos + 1 < size || (r.pos < size && nal[r.pos] != 0x80)) {
+        if(nal_rbsp_sei_value(&r, &type) < 0 || nal_rbsp_sei_value(&r, &payload_size) < 0) {
+            break;
+        }
+        if(r.zeros >= 2 && r.pos < size && nal[r.pos] == 3) {
+            ++r.pos;
+            r.zeros = 0;
+        }
+        uint32_t start = r.pos;
+        r.escaped = 0;
+        for(uint32_t i = 0;i < payload_size;++i) {
+            if(nal_rbsp_byte(&r) < 0) {
+                return count;
+            }
+        }
+        sei.payload_type = (int)type;
+        sei.suffix = suffix;
+        sei.escaped = r.escaped;
+        sei.payload = nal + start;
+        sei.size = r.pos - start;
+        sei.payload_size = payload_size;
+        callback(opaque, &sei);
+        ++count;
+    }
+    return count;
+}
+
+int nal_for_each_sei(int codec_id, const uint8_t* data, uint32_t size, int nal_length_size, fn_nal_sei_callback_t callback, void* opaque) {
+    nal_reader_t r = { data, size, 0, nal_length_size };
+    uint32_t start, end;
+    int count = 0, hevc = codec_id == VIDEO_CODEC_ID_HEVC;
+    while(nal_reader_next(&r, &start, &end) > 0) {
+        int type = nal_type(codec_id, data[start]);
+        if(hevc ? type == HEVC_NAL_SEI_PREFIX || type == HEVC_NAL_SEI_SUFFIX : type == AVC_NAL_SEI) {
+            count += nal_parse_sei(data + start, end - start, hevc ? 2 : 1, type == HEVC_NAL_SEI_SUFFIX, callback, opaque);
+        }
+    }
+    return count;
+}
+
+uint32_t nal_unescape(const uint8_t* src, uint32_t size, uint8_t* dst) {
+    uint32_t o = 0;
+    int zeros = 0;
+    for(uint32_t i = 0;i < size;++i) {
+        if(zeros >= 2 && src[i] == 3) {
+            zeros = 0;
+            continue;
+        }
+        zeros = src[i] == 0 ? zeros + 1 : 0;
+        dst[o++] = src[i];
+    }
+    return o;
+}
+
+static uint8_t* nal_write_u16(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)(value >> 8);
+    out[1] = (uint8_t)value;
+    return out + 2;
+}
+
+int nal_build_avcc(const uint8_t* sps, uint32_t sps_size, const uint8_t* pps, uint32_t pps_size, uint8_t* out, uint32_t capacity) {
+    uint32_t size = 6 + 2 + sps_size + 1 + 2 + pps_size;
+    if(sps_size < 4 || sps_size > 0xffff || pps_size > 0xffff || capacity < size) {
+        return -1;
+    }
+    uint8_t *o = out;
+    *o++ = 1;
+    *o++ = sps[1];      /*  profile_idc             */
+    *o++ = sps[2];      /*  constraint flags        */
+    *o++ = sps[3];      /*  level_idc               */
+    *o++ = 0xfc | 3;    /*  lengthSizeMinusOne      */
+    *o++ = 0xe0 | 1;    /*  one sps                 */
+    o = nal_write_u16(o, sps_size);
+    memcpy(o, sps, sps_size);
+    o += sps_size;
+    *o++ = 1;
+    o = nal_write_u16(o, pps_size);
+    memcpy(o, pps, pps_size);
+    return (int)size;
+}
+
+/*
+ hvcC第1~12字节和sps里的general profile_tier_level（vps id那个字节之后）布局完全一样，
+ sps开头有防竞争字节时先去掉再拷
+ */
+int nal_build_hvcc(const uint8_t* vps, uint32_t vps_size, const uint8_t* sps, uint32_t sps_size, const uint8_t* pps, uint32_t pps_size,
+                   const video_sps_info_t* info, uint8_t* out, uint32_t capacity) {
+    const uint8_t* nals[3] = { vps, sps, pps };
+    const uint32_t sizes[3] = { vps_size, sps_size, pps_size };
+    uint8_t rbsp[24];
+    uint32_t size = 23;
+    for(int i = 0;i < 3;++i) {
+        if(sizes[i] > 0xffff) {
+            return -1;
+        }
+        size += 3 + 2 + sizes[i];
+    }
+    if(capacity < size || nal_unescape(sps, sps_size < sizeof(rbsp) ? sps_size : (uint32_t)sizeof(rbsp), rbsp) < 15) {
+        return -1;
+    }
+    uint8_t *o = out;
+    *o++ = 1;
+    memcpy(o, rbsp + 3, 12);
+    o += 12;
+    o = nal_write_u16(o, 0xf000);                                   /*  min_spatial_segmentation_idc    */
+    *o++ = 0xfc;                                                    /*  parallelismType                 */
+    *o++ = 0xfc | (uint8_t)(info->chroma_format_idc & 3);
+    *o++ = 0xf8 | (uint8_t)((info->bit_depth_luma - 8) & 7);
+    *o++ = 0xf8 | (uint8_t)((info->bit_depth_chroma - 8) & 7);
+    o = nal_write_u16(o, 0);                                        /*  avgFrameRate                    */
+    /*
+     constantFrameRate 0, numTemporalLayers和temporalIdNested取sps的，lengthSizeMinusOne 3
+     */
+    *o++ = (uint8_t)((((rbsp[2] >> 1) & 7) + 1) << 3 | (rbsp[2] & 1) << 2 | 3);
+    *o++ = 3;
+    for(int i = 0;i < 3;++i) {
+        *o++ = 0x80 | (uint8_t)(HEVC_NAL_VPS + i);                  /*  array_completeness              */
+        o = nal_write_u16(o, 1);
+        o = nal_write_u16(o, sizes[i]);
+        memcpy(o, nals[i], sizes[i]);
+        o += sizes[i];
+    }
+    return (int)size;
+}
@@ -0,0 +1,112 @@
+//
+//  nal_format.h
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#ifndef nal_format_h
+#define nal_format_h
+
+#include <stdint.h>
+#include "video_sps.h"
+
+/*
+ h264/hevc access unit framing. flv and mp4 carry nal units behind
+ nal_length_size byte big endian lengths (avcc), hardware decoders and
+ mpeg-ts want start codes (annex-b) with the parameter sets in band.
+ */
+#define NAL_FORMAT_ANNEXB           1   /*  00 00 00 01 start codes         */
+#define NAL_FORMAT_LENGTH4          2   /*  4 byte big endian lengths       */
+
+#define NAL_START_CODE_SIZE         4
+
+typedef struct nal_scan_s {
+    int input_annexb;           /*  payload was already start code delimited, e.g. some android muxers */
+    int has_parameter_sets;     /*  sps (avc) / vps, sps (hevc) in band     */
+    int leading_aud;            /*  first nal is an access unit delimiter   */
+    uint32_t nal_count;
+    uint32_t payload_size;      /*  nal bytes without lengths or start codes */
+    uint32_t escapes;           /*  00 00 0x runs missing emulation prevention */
+} nal_scan_t;
+
+/*
+ avcC / hvcC decoder configuration record to start code delimited parameter
+ sets. returns the bytes written, the size needed when out is NULL, -1 on a
+ broken record or when capacity is too small.
+ */
+int nal_parameter_sets_to_annexb(int codec_id, const uint8_t* config, uint32_t size, uint8_t* out, uint32_t capacity, int* nal_length_size);
+
+/*
+ walks the access unit once, returns -1 when it is neither consistently
+ length prefixed nor start code delimited.
+ emulation prevention is only checked for length prefixed input, on the
+ way to annex-b.
+ */
+int nal_scan(int codec_id, const uint8_t* data, uint32_t size, int nal_length_size, nal_scan_t* scan);
+
+/*
+ parameters (annex-b, may be NULL) go in front of the first nal, after a
+ leading access unit delimiter, for NAL_FORMAT_ANNEXB only.
+ out needs nal_output_size bytes, returns the bytes written.
+ */
+uint32_t nal_output_size(const nal_scan_t* scan, int format, uint32_t parameters_size);
+uint32_t nal_convert(const uint8_t* data, uint32_t size, int nal_length_size, const nal_scan_t* scan, int format,
+                     const uint8_t* parameters, uint32_t parameters_size, uint8_t* out);
+
+/*
+ next nal of an access unit, nal_length_size 0 for start code delimited
+ input. [start, end) is the nal with its header. pos starts at 0.
+ returns 1, 0 at the end, -1 when a length runs past size.
+ */
+int nal_next(const uint8_t* data, uint32_t size, int nal_length_size, uint32_t* pos, uint32_t* start, uint32_t* end);
+
+/*
+ decoder configuration records with 4 byte lengths from in band parameter
+ sets, for transports that carry them inside the access units (mpeg-ts).
+ nal units include their header, no start code. info is the parsed sps,
+ hvcC takes chroma format and bit depths from it.
+ returns the bytes written, -1 when capacity is too small.
+ */
+int nal_build_avcc(const uint8_t* sps, uint32_t sps_size, const uint8_t* pps, uint32_t pps_size, uint8_t* out, uint32_t capacity);
+int nal_build_hvcc(const uint8_t* vps, uint32_t vps_size, const uint8_t* sps, uint32_t sps_size, const uint8_t* pps, uint32_t pps_size,
+                   const video_sps_info_t* info, uint8_t* out, uint32_t capacity);
+
+/*
+ 4 byte lengths to start codes without moving anything, for a scan with
+ no escapes and a buffer the caller owns
+ */
+void nal_length4_to_annexb_inplace(uint8_t* data, uint32_t size);
+
+#define NAL_SEI_TYPE_PIC_TIMING             1
+#define NAL_SEI_TYPE_USER_DATA_REGISTERED   4
+#define NAL_SEI_TYPE_USER_DATA_UNREGISTERED 5   /*  16 byte uuid, then encoder defined data */
+#define NAL_SEI_TYPE_TIME_CODE              136 /*  hevc                */
+
+/*
+ one sei message. payload points into the nal, zero copy, so when escaped is
+ set it still carries emulation prevention bytes, see nal_unescape.
+ */
+typedef struct nal_sei_s {
+    int payload_type;
+    int suffix;                 /*  hevc suffix sei                     */
+    int escaped;
+    const uint8_t* payload;
+    uint32_t size;              /*  bytes at payload                    */
+    uint32_t payload_size;      /*  after removing emulation prevention */
+} nal_sei_t;
+
+typedef void (*fn_nal_sei_callback_t)(void* opaque, const nal_sei_t* sei);
+
+/*
+ calls back for every sei message of a length prefixed access unit in
+ order, returns the number of messages. only sei nal units are read.
+ */
+int nal_for_each_sei(int codec_id, const uint8_t* data, uint32_t size, int nal_length_size, fn_nal_sei_callback_t callback, void* opaque);
+/*
+ drops emulation prevention bytes, dst may be src. returns the bytes written
+ */
+uint32_t nal_unescape(const uint8_t* src, uint32_t size, uint8_t* dst);
+
+#endif /* nal_format_h */
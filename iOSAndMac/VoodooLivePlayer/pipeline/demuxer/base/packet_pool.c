@@ -0,0 +1,202 @@
+//
+//  packet_pool.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#include "packet_pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/*
+ size classes 256B ~ 1MB, bigger packets are allocated and freed directly
+ */
+#define PACKET_POOL_MIN_BLOCK_SHIFT         8
+#define PACKET_POOL_CLASS_COUNT             13
+#define PACKET_POOL_OVERSIZE_CLASS          (-1)
+#define PACKET_POOL_DEFAULT_MAX_FREE        64
+#define PACKET_POOL_MAX_IDLE_BYTES_PER_CLASS    (1024 * 1024)
+
+struct packet_pool_s {
+    pthread_mutex_t lock;
+    demuxer_packet_t *free_list[PACKET_POOL_CLASS_COUNT];
+    uint32_t free_count[PACKET_POOL_CLASS_COUNT];
+    uint32_t max_free[PACKET_POOL_CLASS_COUNT];
+    int destroyed;
+
+    fn_demuxer_malloc_t malloc_fn;
+    fn_demuxer_free_t free_fn;
+    void *allocator_opaque;
+
+    packet_pool_stats_t stats;
+};
+
+static int packet_pool_size_class(uint32_t size) {
+    uint32_t block = 1U << PACKET_POOL_MIN_BLOCK_SHIFT;
+    for(int i = 0;i < PACKET_POOL_CLASS_COUNT;++i, block <<= 1) {
+        if(size <= block) {
+            return i;
+        }
+    }
+    return PACKET_POOL_OVERSIZE_CLASS;
+}
+
+packet_pool_t* packet_pool_create(uint32_t max_free_per_class, const demuxer_config_t* allocator) {
+    fn_demuxer_malloc_t malloc_fn;
+    fn_demuxer_free_t free_fn;
+    void *opaque;
+    demuxer_select_allocator(allocator, &malloc_fn, &free_fn, &opaque);
+
+    packet_pool_t *pool = (packet_pool_t*)malloc_fn(opaque, sizeof(packet_pool_t));
+    if(!pool) {
+        return NULL;
+    }
+    memset(pool, 0, sizeof(packet_pool_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    if(max_free_per_class == 0) {
+        max_free_per_class = PACKET_POOL_DEFAULT_MAX_FREE;
+    }
+    /*
+     大块按字节封顶，不然1MB那一档闲着就能压住64MB
+     */
+    for(int i = 0;i < PACKET_POOL_CLASS_COUNT;++i) {
+        uint32_t by_bytes = PACKET_POOL_MAX_IDLE_BYTES_PER_CLASS >> (PACKET_POOL_MIN_BLOCK_SHIFT + i);
+        by_bytes = by_bytes > 0 ? by_bytes : 1;
+        pool->max_free[i] = max_free_per_class < by_bytes ? max_free_per_class : by_bytes;
+    }
+    pool->malloc_fn = malloc_fn;
+    pool->free_fn = free_fn;
+    pool->allocator_opaque = opaque;
+    return pool;
+}
+
+static void packet_pool_free(packet_pool_t* pool) {
+    fn_demuxer_free_t free_fn = pool->free_fn;
+    void *opaque = pool->allocator_opaque;
+    pthread_mutex_destroy(&pool->lock);
+    free_fn(opaque, pool);
+}
+
+/*
+ lock held
+ */
+static void packet_pool_drain_free_lists(packet_pool_t* pool) {
+    for(int i = 0;i < PACKET_POOL_CLASS_COUNT;++i) {
+        demuxer_packet_t *packet = pool->free_list[i];
+        while(packet) {
+            demuxer_packet_t *next = packet->next;
+            pool->stats.bytes_pooled -= packet->capacity;
+            pool->free_fn(pool->allocator_opaque, packet);
+            packet = next;
+        }
+        pool->free_list[i] = NULL;
+        pool->free_count[i] = 0;
+    }
+}
+
+void packet_pool_destroy(packet_pool_t* pool) {
+    if(!pool) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->destroyed = 1;
+    packet_pool_drain_free_lists(pool);
+    int can_free = pool->stats.packets_in_flight == 0;
+    pthread_mutex_unlock(&pool->lock);
+    if(can_free) {
+        packet_pool_free(pool);
+    }
+}
+
+void packet_pool_get_stats(packet_pool_t* pool, packet_pool_stats_t* stats) {
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+demuxer_packet_t* packet_pool_alloc(packet_pool_t* pool, uint32_t size) {
+    int size_class = packet_pool_size_class(size);
+    uint32_t capacity = size_class == PACKET_POOL_OVERSIZE_CLASS ? size : (1U << (PACKET_POOL_MIN_BLOCK_SHIFT + size_class));
+    demuxer_packet_t *packet = NULL;
+
+    /*
+     在途计数和取空闲块放在同一次加锁里，分配失败再退回去
+     */
+    pthread_mutex_lock(&pool->lock);
+    if(size_class != PACKET_POOL_OVERSIZE_CLASS && pool->free_list[size_class]) {
+        packet = pool->free_list[size_class];
+        pool->free_list[size_class] = packet->next;
+        --pool->free_count[size_class];
+        pool->stats.bytes_pooled -= capacity;
+        ++pool->stats.hits;
+    } else {
+        ++pool->stats.misses;
+    }
+    ++pool->stats.packets_in_flight;
+    pool->stats.bytes_in_flight += capacity;
+    pthread_mutex_unlock(&pool->lock);
+
+    if(!packet) {
+        packet = (demuxer_packet_t*)pool->malloc_fn(pool->allocator_opaque, sizeof(demuxer_packet_t) + capacity);
+        if(!packet) {
+            pthread_mutex_lock(&pool->lock);
+            --pool->stats.packets_in_flight;
+            pool->stats.bytes_in_flight -= capacity;
+            int can_free = pool->destroyed && pool->stats.packets_in_flight == 0;
+            pthread_mutex_unlock(&pool->lock);
+            if(can_free) {
+                packet_pool_free(pool);
+            }
+            return NULL;
+        }
+    }
+
+    memset(packet, 0, sizeof(demuxer_packet_t));
+    packet->data = (uint8_t*)(packet+1);
+    packet->size = size;
+    packet->capacity = capacity;
+    packet->size_class = size_class;
+    packet->pool = pool;
+    packet->refcount = 1;
+    packet->pts = packet->dts = VOODOO_NOPTS_VALUE;
+    return packet;
+}
+
+void demuxer_packet_retain(demuxer_packet_t* packet) {
+    __atomic_add_fetch(&packet->refcount, 1, __ATOMIC_RELAXED);
+}
+
+void demuxer_packet_release(demuxer_packet_t* packet) {
+    if(__atomic_sub_fetch(&packet->refcount, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+    packet_pool_t *pool = packet->pool;
+    int size_class = packet->size_class;
+
+    pthread_mutex_lock(&pool->lock);
+    fn_demuxer_free_t free_fn = pool->free_fn;
+    void *opaque = pool->allocator_opaque;
+    --pool->stats.packets_in_flight;
+    pool->stats.bytes_in_flight -= packet->capacity;
+    if(!pool->destroyed &&
+       size_class != PACKET_POOL_OVERSIZE_CLASS &&
+       pool->free_count[size_class] < pool->max_free[size_class]) {
+        packet->next = pool->free_list[size_class];
+        pool->free_list[size_class] = packet;
+        ++pool->free_count[size_class];
+        pool->stats.bytes_pooled += packet->capacity;
+        packet = NULL;
+    }
+    int can_free = pool->destroyed && pool->stats.packets_in_flight == 0;
+    pthread_mutex_unlock(&pool->lock);
+
+    if(packet) {
+        free_fn(opaque, packet);
+    }
+    if(can_free) {
+        packet_pool_free(pool);
+    }
+}
@@ -0,0 +1,73 @@
+//
+//  packet_pool.h
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#ifndef packet_pool_h
+#define packet_pool_h
+
+#include "demuxer.h"
+
+#define VOODOO_STREAM_INDEX_VIDEO           0
+#define VOODOO_STREAM_INDEX_AUDIO           1
+
+typedef struct packet_pool_s packet_pool_t;
+
+/*
+ ref-counted packet from a packet pool.
+ the payload lives right behind the descriptor, it stays valid until
+ the last demuxer_packet_release.
+ */
+typedef struct demuxer_packet_s {
+    int type;               /*  VOODOO_DATA_TYPE_*      */
+    int stream_index;       /*  VOODOO_STREAM_INDEX_*   */
+    uint32_t flag;
+    int64_t pts;
+    int64_t dts;
+    uint8_t *data;
+    uint32_t size;
+
+    /*
+     private
+     */
+    int32_t refcount;
+    uint32_t capacity;
+    int size_class;
+    packet_pool_t *pool;
+    struct demuxer_packet_s *next;
+} demuxer_packet_t;
+
+typedef struct packet_pool_stats_s {
+    uint64_t hits;              /*  served from a free list     */
+    uint64_t misses;            /*  new block from the allocator */
+    uint64_t packets_in_flight;
+    uint64_t bytes_in_flight;
+    uint64_t bytes_pooled;      /*  idle bytes kept in free lists */
+} packet_pool_stats_t;
+
+typedef void (*fn_demuxer_packet_callback_t)(void* userdata, demuxer_packet_t* packet);
+
+/*
+ max_free_per_class idle blocks are kept for every power of two size
+ class, 0 uses the default, and never more than 1 MB of idle blocks in
+ one class. allocator may be NULL for malloc/free.
+ */
+packet_pool_t* packet_pool_create(uint32_t max_free_per_class, const demuxer_config_t* allocator);
+/*
+ packets still in flight keep the pool alive until they are released.
+ */
+void packet_pool_destroy(packet_pool_t* pool);
+void packet_pool_get_stats(packet_pool_t* pool, packet_pool_stats_t* stats);
+
+/*
+ returns a packet with refcount 1 and size bytes of payload.
+ */
+demuxer_packet_t* packet_pool_alloc(packet_pool_t* pool, uint32_t size);
+
+void demuxer_packet_retain(demuxer_packet_t* packet);
+void demuxer_packet_release(demuxer_packet_t* packet);
+
+#endif /* packet_pool_h */
@@ -0,0 +1,279 @@
+//
+//  packet_queue.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#include "packet_queue.h"
+#include "demuxer_trace.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PACKET_QUEUE_CACHE_LINE     64
+
+typedef struct packet_queue_slot_s {
+    demuxer_packet_t *packet;
+    uint64_t enqueue_ns;
+} packet_queue_slot_t;
+
+/*
+ 生产者和消费者各写各的字段，中间垫开缓存行，避免互相踢
+ */
+struct packet_queue_s {
+    packet_queue_slot_t *slots;
+    uint32_t mask;
+    uint32_t high_water;
+    uint32_t low_water;
+    fn_demuxer_malloc_t malloc_fn;
+    fn_demuxer_free_t free_fn;
+    void *allocator_opaque;
+    uint8_t pad0[PACKET_QUEUE_CACHE_LINE];
+
+    /*
+     producer
+     */
+    uint32_t head;
+    uint32_t cached_tail;
+    uint32_t max_depth;
+    uint64_t pushed;
+    uint64_t full;
+    uint64_t throttles;
+    uint64_t wakeups;
+    uint8_t pad1[PACKET_QUEUE_CACHE_LINE];
+
+    /*
+     consumer
+     */
+    uint32_t tail;
+    uint32_t cached_head;
+    uint64_t popped;
+    uint64_t wait_ns_total;
+    uint64_t wait_ns_max;
+    uint64_t wait_histogram[PACKET_QUEUE_WAIT_BUCKETS];
+    uint8_t pad2[PACKET_QUEUE_CACHE_LINE];
+
+    /*
+     handshakes, both sides
+     */
+    int consumer_idle;
+    int producer_throttled;
+};
+
+#define PACKET_QUEUE_STAT_ADD(field, n)     __atomic_store_n(&(field), __atomic_load_n(&(field), __ATOMIC_RELAXED) + (n), __ATOMIC_RELAXED)
+
+packet_queue_t* packet_queue_create(uint32_t capacity, uint32_t high_water, const demuxer_config_t* allocator) {
+    fn_demuxer_malloc_t malloc_fn;
+    fn_demuxer_free_t free_fn;
+    void *opaque;
+    demuxer_select_allocator(allocator, &malloc_fn, &free_fn, &opaque);
+    if(capacity < 2 || capacity > (1U << 30)) {
+        return NULL;
+    }
+    uint32_t size = 2;
+    while(size < capacity) {
+        size <<= 1;
+    }
+    if(high_water == 0 || high_water > size) {
+        high_water = size - size / 4;
+    }
+
+    packet_queue_t *queue = (packet_queue_t*)malloc_fn(opaque, sizeof(packet_queue_t));
+    if(!queue) {
+        return NULL;
+    }
+    memset(queue, 0, sizeof(packet_queue_t));
+    queue->slots = (packet_queue_slot_t*)malloc_fn(opaque, size * sizeof(packet_queue_slot_t));
+    if(!queue->slots) {
+        free_fn(opaque, queue);
+        return NULL;
+    }
+    memset(queue->slots, 0, size * sizeof(packet_queue_slot_t));
+    queue->mask = size - 1;
+    queue->high_water = high_water;
+    queue->low_water = high_water / 2;
+    queue->malloc_fn = malloc_fn;
+    queue->free_fn = free_fn;
+    queue->allocator_opaque = opaque;
+    /*
+     还没有东西可消费，第一次push就要叫醒消费者
+     */
+    queue->consumer_idle = 1;
+    return queue;
+}
+
+void packet_queue_destroy(packet_queue_t* queue) {
+    if(!queue) {
+        return;
+    }
+    for(uint32_t i = queue->tail;i != queue->head;++i) {
+        demuxer_packet_release(queue->slots[i & queue->mask].packet);
+    }
+    queue->free_fn(queue->allocator_opaque, queue->slots);
+    queue->free_fn(queue->allocator_opaque, queue);
+}
+
+int packet_queue_push(packet_queue_t* queue, demuxer_packet_t* packet) {
+    uint32_t head = queue->head;
+    if(head - queue->cached_tail > queue->mask) {
+        queue->cached_tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+        if(head - queue->cached_tail > queue->mask) {
+            PACKET_QUEUE_STAT_ADD(queue->full, 1);
+            return -1;
+        }
+    }
+    packet_queue_slot_t *slot = &queue->slots[head & queue->mask];
+    slot->packet = packet;
+    slot->enqueue_ns = demuxer_trace_now_ns();
+    /*
+     head和下面两个标志都用seq_cst，和消费者那边先写tail/idle再读对方的顺序配对，
+     两边至少有一边能看到对方，不会两边都睡着
+     */
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_SEQ_CST);
+    PACKET_QUEUE_STAT_ADD(queue->pushed, 1);
+
+    int result = 0;
+    if(__atomic_load_n(&queue->consumer_idle, __ATOMIC_SEQ_CST) && __atomic_exchange_n(&queue->consumer_idle, 0, __ATOMIC_SEQ_CST)) {
+        PACKET_QUEUE_STAT_ADD(queue->wakeups, 1);
+        result |= PACKET_QUEUE_WAKE_CONSUMER;
+    }
+
+    /*
+     cached_tail只会偏旧，估出来的深度只大不小，要当真用的时候再去读一次tail
+     */
+    uint32_t depth = head + 1 - queue->cached_tail;
+    if(depth > queue->max_depth || depth >= queue->high_water) {
+        queue->cached_tail = __atomic_load_n(&queue->tail, __ATOMIC_SEQ_CST);
+        depth = head + 1 - queue->cached_tail;
+    }
+    if(depth > queue->max_depth) {
+        __atomic_store_n(&queue->max_depth, depth, __ATOMIC_RELAXED);
+    }
+    if(depth >= queue->high_water && !__atomic_load_n(&queue->producer_throttled, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&queue->producer_throttled, 1, __ATOMIC_SEQ_CST);
+        PACKET_QUEUE_STAT_ADD(queue->throttles, 1);
+        /*
+         消费者可能刚好在标志立起来之前已经取空了，那就自己收回
+         */
+        uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_SEQ_CST);
+        if(head + 1 - tail <= queue->low_water) {
+            __atomic_exchange_n(&queue->producer_throttled, 0, __ATOMIC_SEQ_CST);
+        }
+    }
+    if(__atomic_load_n(&queue->producer_throttled, __ATOMIC_SEQ_CST)) {
+        result |= PACKET_QUEUE_THROTTLED;
+    }
+    return result;
+}
+
+static int packet_queue_wait_bucket(uint64_t wait_ns) {
+    uint64_t us = wait_ns / 1000;
+    int bucket = 0;
+    while(us > 0 && bucket < PACKET_QUEUE_WAIT_BUCKETS - 1) {
+        us >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+int packet_queue_pop(packet_queue_t* queue, demuxer_packet_t** packets, int max) {
+    uint32_t tail = queue->tail;
+    if(queue->cached_head == tail) {
+        queue->cached_head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    }
+    uint32_t count = queue->cached_head - tail;
+    if(max <= 0 || count == 0) {
+        return 0;
+    }
+    if(count > (uint32_t)max) {
+        count = (uint32_t)max;
+    }
+
+    uint64_t now = demuxer_trace_now_ns();
+    uint64_t wait_total = 0;
+    uint64_t wait_max = __atomic_load_n(&queue->wait_ns_max, __ATOMIC_RELAXED);
+    for(uint32_t i = 0;i < count;++i) {
+        packet_queue_slot_t *slot = &queue->slots[(tail + i) & queue->mask];
+        uint64_t wait = now > slot->enqueue_ns ? now - slot->enqueue_ns : 0;
+        packets[i] = slot->packet;
+        wait_total += wait;
+        if(wait > wait_max) {
+            wait_max = wait;
+        }
+        PACKET_QUEUE_STAT_ADD(queue->wait_histogram[packet_queue_wait_bucket(wait)], 1);
+    }
+    __atomic_store_n(&queue->tail, tail + count, __ATOMIC_SEQ_CST);
+    PACKET_QUEUE_STAT_ADD(queue->popped, count);
+    PACKET_QUEUE_STAT_ADD(queue->wait_ns_total, wait_total);
+    __atomic_store_n(&queue->wait_ns_max, wait_max, __ATOMIC_RELAXED);
+    return (int)count;
+}
+
+int packet_queue_consumer_idle(packet_queue_t* queue) {
+    __atomic_store_n(&queue->consumer_idle, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&queue->head, __ATOMIC_SEQ_CST) == queue->tail) {
+        return 1;
+    }
+    /*
+     刚好又来了，接着消费。生产者要是已经拿走了标志，多一次唤醒也无妨
+     */
+    __atomic_store_n(&queue->consumer_idle, 0, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+int packet_queue_resume_producer(packet_queue_t* queue) {
+    if(!__atomic_load_n(&queue->producer_throttled, __ATOMIC_SEQ_CST)) {
+        return 0;
+    }
+    if(__atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) - queue->tail > queue->low_water) {
+        return 0;
+    }
+    return __atomic_exchange_n(&queue->producer_throttled, 0, __ATOMIC_SEQ_CST) ? 1 : 0;
+}
+
+uint32_t packet_queue_depth(packet_queue_t* queue) {
+    uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
+
+void packet_queue_get_stats(packet_queue_t* queue, packet_queue_stats_t* stats) {
+    memset(stats, 0, sizeof(packet_queue_stats_t));
+    stats->capacity = queue->mask + 1;
+    stats->depth = packet_queue_depth(queue);
+    stats->max_depth = __atomic_load_n(&queue->max_depth, __ATOMIC_RELAXED);
+    stats->pushed = __atomic_load_n(&queue->pushed, __ATOMIC_RELAXED);
+    stats->popped = __atomic_load_n(&queue->popped, __ATOMIC_RELAXED);
+    stats->full = __atomic_load_n(&queue->full, __ATOMIC_RELAXED);
+    stats->throttles = __atomic_load_n(&queue->throttles, __ATOMIC_RELAXED);
+    stats->wakeups = __atomic_load_n(&queue->wakeups, __ATOMIC_RELAXED);
+    stats->wait_ns_total = __atomic_load_n(&queue->wait_ns_total, __ATOMIC_RELAXED);
+    stats->wait_ns_max = __atomic_load_n(&queue->wait_ns_max, __ATOMIC_RELAXED);
+    for(int i = 0;i < PACKET_QUEUE_WAIT_BUCKETS;++i) {
+        stats->wait_histogram[i] = __atomic_load_n(&queue->wait_histogram[i], __ATOMIC_RELAXED);
+    }
+}
+
+uint64_t packet_queue_wait_percentile_ns(const packet_queue_stats_t* stats, double percentile) {
+    uint64_t total = 0;
+    for(int i = 0;i < PACKET_QUEUE_WAIT_BUCKETS;++i) {
+        total += stats->wait_histogram[i];
+    }
+    if(total == 0) {
+        return 0;
+    }
+    uint64_t want = (uint64_t)(percentile * (double)total + 0.5);
+    if(want == 0) {
+        want = 1;
+    }
+    uint64_t seen = 0;
+    for(int i = 0;i < PACKET_QUEUE_WAIT_BUCKETS - 1;++i) {
+        seen += stats->wait_histogram[i];
+        if(seen >= want) {
+            uint64_t bound = (1ULL << i) * 1000;
+            return bound < stats->wait_ns_max ? bound : stats->wait_ns_max;
+        }
+    }
+    return stats->wait_ns_max;
+}
@@ -0,0 +1,93 @@
+//
+//  packet_queue.h
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#ifndef packet_queue_h
+#define packet_queue_h
+
+#include "packet_pool.h"
+
+/*
+ bounded lock-free ring of packet references between two pipeline stages,
+ one producer thread and one consumer thread. nothing blocks, the queue
+ tells each side when the other one has to be woken up:
+
+ producer
+     r = packet_queue_push(queue, packet);
+     r < 0                          full, the reference stays with the caller
+     r & PACKET_QUEUE_WAKE_CONSUMER the consumer went idle, schedule it
+     r & PACKET_QUEUE_THROTTLED     high water reached, pause until resumed
+
+ consumer
+     while((n = packet_queue_pop(queue, packets, max)) > 0 || !packet_queue_consumer_idle(queue)) {
+         ... n packets, one reference each ...
+         if(packet_queue_resume_producer(queue)) resume the producer
+     }
+
+ the queue starts with an idle consumer, so the first push wakes it.
+ */
+#define PACKET_QUEUE_WAKE_CONSUMER      1
+#define PACKET_QUEUE_THROTTLED          2
+
+/*
+ wait time buckets: bucket i counts waits below 2^i microseconds, the last
+ one everything longer
+ */
+#define PACKET_QUEUE_WAIT_BUCKETS       24
+
+typedef struct packet_queue_s packet_queue_t;
+
+/*
+ counters are written by one side each and readable from any thread
+ */
+typedef struct packet_queue_stats_s {
+    uint32_t capacity;
+    uint32_t depth;
+    uint32_t max_depth;
+    uint64_t pushed;
+    uint64_t popped;
+    uint64_t full;              /*  pushes refused                  */
+    uint64_t throttles;         /*  producer told to pause          */
+    uint64_t wakeups;           /*  consumer woken from idle        */
+    uint64_t wait_ns_total;     /*  push to pop, over popped        */
+    uint64_t wait_ns_max;
+    uint64_t wait_histogram[PACKET_QUEUE_WAIT_BUCKETS];
+} packet_queue_stats_t;
+
+/*
+ capacity is rounded up to a power of two. the producer is throttled at
+ high_water and resumed at half of it, 0 uses three quarters of capacity.
+ allocator may be NULL for malloc/free.
+ */
+packet_queue_t* packet_queue_create(uint32_t capacity, uint32_t high_water, const demuxer_config_t* allocator);
+/*
+ releases the packets still queued, neither side may be running
+ */
+void packet_queue_destroy(packet_queue_t* queue);
+
+int packet_queue_push(packet_queue_t* queue, demuxer_packet_t* packet);
+int packet_queue_pop(packet_queue_t* queue, demuxer_packet_t** packets, int max);
+/*
+ consumer, after a pop found nothing: 1 when it may go idle and will be
+ woken by the producer, 0 when packets came in meanwhile
+ */
+int packet_queue_consumer_idle(packet_queue_t* queue);
+/*
+ consumer, after popping: 1 exactly once for each throttle when the depth
+ is back at half the high water
+ */
+int packet_queue_resume_producer(packet_queue_t* queue);
+
+uint32_t packet_queue_depth(packet_queue_t* queue);
+void packet_queue_get_stats(packet_queue_t* queue, packet_queue_stats_t* stats);
+/*
+ wait time below which the given share of the popped packets fall,
+ from the histogram, so a bucket bound. 0 when nothing was popped
+ */
+uint64_t packet_queue_wait_percentile_ns(const packet_queue_stats_t* stats, double percentile);
+
+#endif /* packet_queue_h */
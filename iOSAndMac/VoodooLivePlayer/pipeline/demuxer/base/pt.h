@@ -12,31 +12,43 @@
 #include <inttypes.h>
 
 typedef struct ptc_s {int lc;void *data;const char *error_msg;const char *error_file;int error_line;} ptc_t;
-typedef struct pts_s { uint8_t *buf;uint32_t size;uint32_t pos; } pts_t;
+typedef struct pts_s { uint8_t *buf;uint32_t size;uint32_t pos;uint32_t want; } pts_t;
 
 #define PTR_ERROR                  (-1)
 #define PTR_YIELDED                1
 #define PTR_FINISHED               0
+#define PS_INIT(s,_buf,_size)      do { (s)->buf = (_buf);(s)->size = (_size);(s)->pos = 0;(s)->want = 0;} while(0)
 #define PT_DATA(ptc)               ((ptc)->data)
 #define PT_INIT(ptc,_data)         do { (ptc)->lc = 0;(ptc)->data=(_data);} while(0)
 #define PT_BEGIN(ptc)              switch((ptc)->lc) { case 0:
 #define PT_END(ptc)                break; default: break; } (ptc)->lc = 0; return PTR_FINISHED;
 #define PT_YIELD(ptc)              do {(ptc)->lc = __LINE__;return PTR_YIELDED;case __LINE__:;} while(0)
-#define PT_THROW_ERROR(ptc, err)   do {(ptc)->error_msg = (err), (ptc)->error_file = __FILE__, (ptc)->error_line = __LINE__; fprintf(stderr, "[PT ERROR] %s @ %s[%d]\n", (err), __FUNCTION__, __LINE__); return PTR_ERROR;}while(0)
+#define PT_THROW_ERROR(ptc, err)   do {(ptc)->error_msg = (err), (ptc)->error_file = __FILE__, (ptc)->error_line = __LINE__; return PTR_ERROR;}while(0)
 
 
 #define PS_PR_U8(s,_pos)           *((s)->buf+(s)->pos+(_pos))
 #define PS_PR_U24(s,_pos)          ((((uint32_t)PS_PR_U8(s,(_pos))) << 16)|(((uint32_t)PS_PR_U8(s,(_pos)+1)) << 8)|((uint32_t)PS_PR_U8(s,(_pos)+2)))
 #define PS_DR_U8(s)                *((s)->buf+(s)->pos++)
-#define PS_DR_U16(s)               ((((uint16_t)PS_DR_U8(s)) << 8) | ((uint16_t)PS_DR_U8(s)))
-#define PS_DR_U24(s)               ((((uint32_t)PS_DR_U8(s)) << 16)|(((uint32_t)PS_DR_U8(s)) << 8)|((uint32_t)PS_DR_U8(s)))
-#define PS_DR_U32(s)               ((((uint32_t)PS_DR_U8(s)) << 24)|(((uint32_t)PS_DR_U8(s)) << 16)|(((uint32_t)PS_DR_U8(s)) << 8)|((uint32_t)PS_DR_U8(s)))
-#define PS_DR_U64(s)               ((((uint64_t)PS_DR_U32(s)) << 32)|((uint64_t)PS_DR_U32(s)))
+/*
+ big endian reads from a byte pointer, no side effects
+ */
+#define PS_RB16(p)                 ((uint16_t)((((uint16_t)(p)[0]) << 8) | ((uint16_t)(p)[1])))
+#define PS_RB24(p)                 ((((uint32_t)(p)[0]) << 16)|(((uint32_t)(p)[1]) << 8)|((uint32_t)(p)[2]))
+#define PS_RB32(p)                 ((((uint32_t)(p)[0]) << 24)|(((uint32_t)(p)[1]) << 16)|(((uint32_t)(p)[2]) << 8)|((uint32_t)(p)[3]))
+#define PS_RB64(p)                 ((((uint64_t)PS_RB32(p)) << 32)|((uint64_t)PS_RB32((p)+4)))
+/*
+ advance first, then read behind pos. the bytes of one value must not be
+ read with several PS_DR_U8 in one expression, their order is unsequenced
+ */
+#define PS_DR_U16(s)               ((s)->pos += 2, PS_RB16((s)->buf+(s)->pos-2))
+#define PS_DR_U24(s)               ((s)->pos += 3, PS_RB24((s)->buf+(s)->pos-3))
+#define PS_DR_U32(s)               ((s)->pos += 4, PS_RB32((s)->buf+(s)->pos-4))
+#define PS_DR_U64(s)               ((s)->pos += 8, PS_RB64((s)->buf+(s)->pos-8))
 //static float PS_DR_F32(vpts_t *s)  { float f; *(uint32_t *) &f = PS_DR_U32(s); return f; }
 //static double PS_DR_F64(vpts_t *s) { double d; *(uint64_t *) &d = PS_DR_U64(s); return d; }
 #define PS_DR_BUF(s,_buf,_len)     memcpy((_buf), (s)->buf+(s)->pos, (_len)), (s)->pos += (_len)
 #define PS_DR_SKIP(s,len)          ((s)->pos += (len))
-#define PS_ENSURE(s,len)           while((s)->pos + (len) > (s)->size) {PT_YIELD(ptc);}
+#define PS_ENSURE(s,len)           while((s)->pos + (len) > (s)->size) {(s)->want = (s)->pos + (len);PT_YIELD(ptc);}
 #define PS_SR_U8(s,ubv)            do { PS_ENSURE(s,1); (ubv) = PS_DR_U8(s); } while(0)
 #define PS_SR_U16(s,usv)           do { PS_ENSURE(s,2); (usv) = PS_DR_U16(s); } while(0)
 #define PS_SR_U24(s,uiv)           do { PS_ENSURE(s,3); (uiv) = PS_DR_U24(s); } while(0)
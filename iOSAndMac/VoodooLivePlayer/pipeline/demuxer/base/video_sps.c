@@ -0,0 +1,791 @@
+//
+//  video_sps.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#include "video_sps.h"
+#include "bitreader.h"
+#include <string.h>
+
+#define VIDEO_SPS_MIN(a,b) ((a) < (b) ? (a) : (b))
+
+uint32_t video_nal_to_rbsp(const uint8_t *src, uint32_t size, uint8_t *dst, uint32_t dst_size) {
+    uint32_t zeros = 0, n = 0;
+    for(uint32_t i = 0;i < size && n < dst_size;++i) {
+        /*
+         00 00 03 xx，去掉03
+         */
+        if(zeros >= 2 && src[i] == 3) {
+            zeros = 0;
+            continue;
+        }
+        zeros = src[i] == 0 ? zeros + 1 : 0;
+        dst[n++] = src[i];
+    }
+    return n;
+}
+
+/*
+ Table E-1
+ */
+static const uint8_t video_sar_table[17][2] = {
+    {0, 1}, {1, 1}, {12, 11}, {10, 11}, {16, 11}, {40, 33}, {24, 11}, {20, 11}, {32, 11},
+    {80, 33}, {18, 11}, {15, 11}, {64, 33}, {160, 99}, {4, 3}, {3, 2}, {2, 1}
+};
+
+static void video_parse_sar(bitreader_t *br, video_sps_info_t *info) {
+    uint32_t aspect_ratio_idc = BR_READ(br, 8);
+    if(aspect_ratio_idc == 255) {
+        info->sar_num = (int)BR_READ(br, 16);
+        info->sar_den = (int)BR_READ(br, 16);
+    } else if(aspect_ratio_idc < 17) {
+        info->sar_num = video_sar_table[aspect_ratio_idc][0];
+        info->sar_den = video_sar_table[aspect_ratio_idc][1];
+    }
+}
+
+static void video_parse_signal_type(bitreader_t *br, video_sps_info_t *info) {
+    BR_SKIP(br, 3);                     //  video_format
+    info->full_range = (int)BR_READ_BIT(br);
+    if(BR_READ_BIT(br)) {               //  colour_description_present_flag
+        BR_SKIP(br, 24);
+    }
+}
+
+/*
+ ==================== H.264 ====================
+ */
+
+static void avc_skip_scaling_list(bitreader_t *br, int size) {
+    int last_scale = 8, next_scale = 8;
+    for(int j = 0;j < size;++j) {
+        if(next_scale != 0) {
+            int32_t delta_scale = BR_READ_SE(br);
+            next_scale = (last_scale + delta_scale + 256) % 256;
+        }
+        last_scale = next_scale == 0 ? last_scale : next_scale;
+    }
+}
+
+static void avc_skip_hrd(bitreader_t *br) {
+    uint32_t cpb_cnt = BR_READ_UE(br) + 1;
+    BR_SKIP(br, 8);                     //  bit_rate_scale, cpb_size_scale
+    for(uint32_t i = 0;i < cpb_cnt && i < 32;++i) {
+        BR_READ_UE(br);                 //  bit_rate_value_minus1
+        BR_READ_UE(br);                 //  cpb_size_value_minus1
+        BR_SKIP(br, 1);                 //  cbr_flag
+    }
+    BR_SKIP(br, 20);
+}
+
+static void avc_parse_vui(bitreader_t *br, video_sps_info_t *info) {
+    if(BR_READ_BIT(br)) {               //  aspect_ratio_info_present_flag
+        video_parse_sar(br, info);
+    }
+    if(BR_READ_BIT(br)) {               //  overscan_info_present_flag
+        BR_SKIP(br, 1);
+    }
+    if(BR_READ_BIT(br)) {               //  video_signal_type_present_flag
+        video_parse_signal_type(br, info);
+    }
+    if(BR_READ_BIT(br)) {               //  chroma_loc_info_present_flag
+        BR_READ_UE(br);
+        BR_READ_UE(br);
+    }
+    if(BR_READ_BIT(br)) {               //  timing_info_present_flag
+        info->num_units_in_tick = BR_READ(br, 32);
+        info->time_scale = BR_READ(br, 32);
+        BR_SKIP(br, 1);                 //  fixed_frame_rate_flag
+        if(info->num_units_in_tick > 0) {
+            /*
+             一帧两个field，所以是2倍的tick
+             */
+            info->frame_rate = (double)info->time_scale / (2.0 * info->num_units_in_tick);
+        }
+    }
+    int nal_hrd = (int)BR_READ_BIT(br);
+    if(nal_hrd) {
+        avc_skip_hrd(br);
+    }
+    int vcl_hrd = (int)BR_READ_BIT(br);
+    if(vcl_hrd) {
+        avc_skip_hrd(br);
+    }
+    if(nal_hrd || vcl_hrd) {
+        BR_SKIP(br, 1);                 //  low_delay_hrd_flag
+    }
+    BR_SKIP(br, 1);                     //  pic_struct_present_flag
+    if(BR_READ_BIT(br)) {               //  bitstream_restriction_flag
+        BR_SKIP(br, 1);                 //  motion_vectors_over_pic_boundaries_flag
+        BR_READ_UE(br);                 //  max_bytes_per_pic_denom
+        BR_READ_UE(br);                 //  max_bits_per_mb_denom
+        BR_READ_UE(br);                 //  log2_max_mv_length_horizontal
+        BR_READ_UE(br);                 //  log2_max_mv_length_vertical
+        info->max_num_reorder_frames = (int)BR_READ_UE(br);
+        info->max_dec_frame_buffering = (int)BR_READ_UE(br);
+    }
+}
+
+/*
+ Table A-1 MaxDpbMbs, MaxDpbFrames = Min(MaxDpbMbs / (PicWidthInMbs * FrameHeightInMbs), 16).
+ level_idc 11 with constraint_set3_flag is level 1b outside the high profiles
+ */
+static int avc_max_dpb_frames(int profile_idc, uint32_t constraint_flags, int level_idc, int frame_mbs) {
+    int max_dpb_mbs;
+    switch(level_idc) {
+        case 9: case 10: max_dpb_mbs = 396; break;
+        case 11:
+            max_dpb_mbs = (constraint_flags & 0x10) != 0 && (profile_idc == 66 || profile_idc == 77 || profile_idc == 88) ? 396 : 900;
+            break;
+        case 12: case 13: case 20: max_dpb_mbs = 2376; break;
+        case 21: max_dpb_mbs = 4752; break;
+        case 22: case 30: max_dpb_mbs = 8100; break;
+        case 31: max_dpb_mbs = 18000; break;
+        case 32: max_dpb_mbs = 20480; break;
+        case 40: case 41: max_dpb_mbs = 32768; break;
+        case 42: max_dpb_mbs = 34816; break;
+        case 50: max_dpb_mbs = 110400; break;
+        case 51: case 52: max_dpb_mbs = 184320; break;
+        default: max_dpb_mbs = 696320; break;
+    }
+    if(frame_mbs <= 0) {
+        return 16;
+    }
+    return VIDEO_SPS_MIN(max_dpb_mbs / frame_mbs, 16);
+}
+
+int avc_parse_sps(const uint8_t *nal, uint32_t size, video_sps_info_t *info) {
+    uint8_t rbsp[VIDEO_SPS_MAX_RBSP_SIZE];
+    bitreader_t reader;
+    bitreader_t *br = &reader;
+
+    if(size < 4 || (nal[0] & 0x1f) != 7) {
+        return -1;
+    }
+    uint32_t rbsp_size = video_nal_to_rbsp(nal + 1, size - 1, rbsp, sizeof(rbsp));
+    BR_INIT(br, rbsp, rbsp_size);
+
+    int nal_length_size = info->nal_length_size;
+    memset(info, 0, sizeof(*info));
+    info->nal_length_size = nal_length_size;
+    info->codec_id = VIDEO_CODEC_ID_H264;
+    info->max_num_reorder_frames = -1;
+    info->max_dec_frame_buffering = -1;
+
+    info->profile_idc = (int)BR_READ(br, 8);
+    uint32_t constraint_flags = BR_READ(br, 8);
+    info->level_idc = (int)BR_READ(br, 8);
+    BR_READ_UE(br);                     //  seq_parameter_set_id
+
+    info->chroma_format_idc = VIDEO_FRAME_FORMAT_YUV420;
+    info->bit_depth_luma = 8;
+    info->bit_depth_chroma = 8;
+    int separate_colour_plane = 0;
+    switch(info->profile_idc) {
+        case 100: case 110: case 122: case 244: case 44: case 83:
+        case 86: case 118: case 128: case 138: case 139: case 134: case 135:
+            info->chroma_format_idc = (int)BR_READ_UE(br);
+            if(info->chroma_format_idc == 3) {
+                separate_colour_plane = (int)BR_READ_BIT(br);
+            }
+            info->bit_depth_luma = (int)BR_READ_UE(br) + 8;
+            info->bit_depth_chroma = (int)BR_READ_UE(br) + 8;
+            BR_SKIP(br, 1);             //  qpprime_y_zero_transform_bypass_flag
+            if(BR_READ_BIT(br)) {       //  seq_scaling_matrix_present_flag
+                int count = info->chroma_format_idc != 3 ? 8 : 12;
+                for(int i = 0;i < count;++i) {
+                    if(BR_READ_BIT(br)) {
+                        avc_skip_scaling_list(br, i < 6 ? 16 : 64);
+                    }
+                }
+            }
+            break;
+        default:
+            break;
+    }
+    if(info->chroma_format_idc > 3) {
+        return -1;
+    }
+
+    BR_READ_UE(br);                     //  log2_max_frame_num_minus4
+    uint32_t pic_order_cnt_type = BR_READ_UE(br);
+    if(pic_order_cnt_type == 0) {
+        BR_READ_UE(br);                 //  log2_max_pic_order_cnt_lsb_minus4
+    } else if(pic_order_cnt_type == 1) {
+        BR_SKIP(br, 1);                 //  delta_pic_order_always_zero_flag
+        BR_READ_SE(br);                 //  offset_for_non_ref_pic
+        BR_READ_SE(br);                 //  offset_for_top_to_bottom_field
+        uint32_t cycle = BR_READ_UE(br);
+        if(cycle > 255) {
+            return -1;
+        }
+        for(uint32_t i = 0;i < cycle;++i) {
+            BR_READ_SE(br);
+        }
+    }
+    BR_READ_UE(br);                     //  max_num_ref_frames
+    BR_SKIP(br, 1);                     //  gaps_in_frame_num_value_allowed_flag
+    uint32_t width_in_mbs = BR_READ_UE(br) + 1;
+    uint32_t height_in_map_units = BR_READ_UE(br) + 1;
+    int frame_mbs_only = (int)BR_READ_BIT(br);
+    if(!frame_mbs_only) {
+        BR_SKIP(br, 1);                 //  mb_adaptive_frame_field_flag
+    }
+    BR_SKIP(br, 1);                     //  direct_8x8_inference_flag
+    uint32_t crop_left = 0, crop_right = 0, crop_top = 0, crop_bottom = 0;
+    if(BR_READ_BIT(br)) {               //  frame_cropping_flag
+        crop_left = BR_READ_UE(br);
+        crop_right = BR_READ_UE(br);
+        crop_top = BR_READ_UE(br);
+        crop_bottom = BR_READ_UE(br);
+    }
+    if(BR_ERROR(br) || width_in_mbs > 1024 || height_in_map_units > 1024) {
+        return -1;
+    }
+
+    uint32_t height_in_mbs = (2 - frame_mbs_only) * height_in_map_units;
+    int chroma_array_type = separate_colour_plane ? 0 : info->chroma_format_idc;
+    uint32_t crop_unit_x = (chroma_array_type == 1 || chroma_array_type == 2) ? 2 : 1;
+    uint32_t crop_unit_y = (chroma_array_type == 1 ? 2 : 1) * (2 - frame_mbs_only);
+    int64_t width = (int64_t)width_in_mbs * 16 - (int64_t)crop_unit_x * (crop_left + crop_right);
+    int64_t height = (int64_t)height_in_mbs * 16 - (int64_t)crop_unit_y * (crop_top + crop_bottom);
+    if(width <= 0 || height <= 0) {
+        return -1;
+    }
+    info->width = (int)width;
+    info->height = (int)height;
+    info->interlaced = !frame_mbs_only;
+    info->sar_num = 1;
+    info->sar_den = 1;
+
+    if(BR_READ_BIT(br)) {               //  vui_parameters_present_flag
+        avc_parse_vui(br, info);
+    }
+    if(BR_ERROR(br)) {
+        /*
+         vui之前的都已经读到了，vui坏掉不影响分辨率
+         */
+        info->frame_rate = 0;
+        info->max_num_reorder_frames = -1;
+        info->max_dec_frame_buffering = -1;
+    }
+
+    if(info->max_dec_frame_buffering < 0) {
+        int intra_only = (constraint_flags & 0x10) != 0 &&
+            (info->profile_idc == 44 || info->profile_idc == 86 || info->profile_idc == 100 ||
+             info->profile_idc == 110 || info->profile_idc == 122 || info->profile_idc == 244);
+        /*
+         E.2.1：没有bitstream_restriction时max_dec_frame_buffering推断为MaxDpbFrames，
+         max_num_reorder_frames等于它
+         */
+        int dpb_frames = avc_max_dpb_frames(info->profile_idc, constraint_flags, info->level_idc, (int)(width_in_mbs * height_in_mbs));
+        if(intra_only) {
+            info->max_num_reorder_frames = 0;
+            info->max_dec_frame_buffering = 0;
+        } else {
+            info->max_dec_frame_buffering = dpb_frames;
+            /*
+             baseline没有B帧，不会乱序
+             */
+            info->max_num_reorder_frames = info->profile_idc == 66 ? 0 : info->max_dec_frame_buffering;
+        }
+    }
+    return 0;
+}
+
+int avc_parse_decoder_config(const uint8_t *data, uint32_t size, video_sps_info_t *info) {
+    if(size < 7 || data[0] != 1) {
+        return -1;
+    }
+    uint32_t sps_count = data[5] & 0x1f;
+    uint32_t pos = 6;
+    for(uint32_t i = 0;i < sps_count;++i) {
+        if(pos + 2 > size) {
+            return -1;
+        }
+        uint32_t len = ((uint32_t)data[pos] << 8) | data[pos + 1];
+        pos += 2;
+        if(pos + len > size) {
+            return -1;
+        }
+        info->nal_length_size = (data[4] & 0x3) + 1;
+        if(avc_parse_sps(data + pos, len, info) == 0) {
+            return 0;
+        }
+        pos += len;
+    }
+    return -1;
+}
+
+/*
+ ==================== H.265 ====================
+ */
+
+static void hevc_parse_profile_tier_level(bitreader_t *br, uint32_t max_sub_layers_minus1, video_sps_info_t *info) {
+    uint8_t sub_layer_profile_present[8], sub_layer_level_present[8];
+
+    BR_SKIP(br, 3);                     //  general_profile_space, general_tier_flag
+    int profile_idc = (int)BR_READ(br, 5);
+    BR_SKIP(br, 32);                    //  general_profile_compatibility_flag
+    BR_SKIP(br, 32);                    //  progressive/interlaced/non_packed/frame_only + reserved
+    BR_SKIP(br, 16);
+    int level_idc = (int)BR_READ(br, 8);
+    if(info) {
+        info->profile_idc = profile_idc;
+        info->level_idc = level_idc;
+    }
+    for(uint32_t i = 0;i < max_sub_layers_minus1;++i) {
+        sub_layer_profile_present[i] = (uint8_t)BR_READ_BIT(br);
+        sub_layer_level_present[i] = (uint8_t)BR_READ_BIT(br);
+    }
+    if(max_sub_layers_minus1 > 0) {
+        BR_SKIP(br, 2 * (8 - max_sub_layers_minus1));
+    }
+    for(uint32_t i = 0;i < max_sub_layers_minus1;++i) {
+        if(sub_layer_profile_present[i]) {
+            BR_SKIP(br, 88);
+        }
+        if(sub_layer_level_present[i]) {
+            BR_SKIP(br, 8);
+        }
+    }
+}
+
+static void hevc_skip_scaling_list_data(bitreader_t *br) {
+    for(int size_id = 0;size_id < 4;++size_id) {
+        for(int matrix_id = 0;matrix_id < 6;matrix_id += (size_id == 3) ? 3 : 1) {
+            if(!BR_READ_BIT(br)) {      //  scaling_list_pred_mode_flag
+                BR_READ_UE(br);         //  scaling_list_pred_matrix_id_delta
+                continue;
+            }
+            int coef_num = VIDEO_SPS_MIN(64, 1 << (4 + (size_id << 1)));
+            if(size_id > 1) {
+                BR_READ_SE(br);         //  scaling_list_dc_coef_minus8
+            }
+            for(int i = 0;i < coef_num;++i) {
+                BR_READ_SE(br);
+            }
+        }
+    }
+}
+
+/*
+ 只为了跳过，记录每个集合的NumDeltaPocs给后面的预测用
+ */
+static int hevc_skip_short_term_ref_pic_sets(bitreader_t *br, uint32_t count) {
+    uint32_t num_delta_pocs[64];
+    for(uint32_t idx = 0;idx < count;++idx) {
+        int inter_ref_pic_set_prediction = 0;
+        if(idx != 0) {
+            inter_ref_pic_set_prediction = (int)BR_READ_BIT(br);
+        }
+        if(inter_ref_pic_set_prediction) {
+            BR_SKIP(br, 1);             //  delta_rps_sign
+            BR_READ_UE(br);             //  abs_delta_rps_minus1
+            uint32_t n = 0;
+            for(uint32_t j = 0;j <= num_delta_pocs[idx - 1];++j) {
+                int used_by_curr_pic = (int)BR_READ_BIT(br);
+                int use_delta = used_by_curr_pic ? 1 : (int)BR_READ_BIT(br);
+                n += use_delta;
+            }
+            num_delta_pocs[idx] = n;
+        } else {
+            uint32_t num_negative = BR_READ_UE(br);
+            uint32_t num_positive = BR_READ_UE(br);
+            if(num_negative > 16 || num_positive > 16) {
+                return -1;
+            }
+            for(uint32_t j = 0;j < num_negative + num_positive;++j) {
+                BR_READ_UE(br);         //  delta_poc_minus1
+                BR_SKIP(br, 1);         //  used_by_curr_pic_flag
+            }
+            num_delta_pocs[idx] = num_negative + num_positive;
+        }
+        if(BR_ERROR(br)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void hevc_parse_vui(bitreader_t *br, video_sps_info_t *info) {
+    if(BR_READ_BIT(br)) {               //  aspect_ratio_info_present_flag
+        video_parse_sar(br, info);
+    }
+    if(BR_READ_BIT(br)) {               //  overscan_info_present_flag
+        BR_SKIP(br, 1);
+    }
+    if(BR_READ_BIT(br)) {               //  video_signal_type_present_flag
+        video_parse_signal_type(br, info);
+    }
+    if(BR_READ_BIT(br)) {               //  chroma_loc_info_present_flag
+        BR_READ_UE(br);
+        BR_READ_UE(br);
+    }
+    BR_SKIP(br, 1);                     //  neutral_chroma_indication_flag
+    info->interlaced = (int)BR_READ_BIT(br);  //  field_seq_flag
+    BR_SKIP(br, 1);                     //  frame_field_info_present_flag
+    if(BR_READ_BIT(br)) {               //  default_display_window_flag
+        BR_READ_UE(br);
+        BR_READ_UE(br);
+        BR_READ_UE(br);
+        BR_READ_UE(br);
+    }
+    if(BR_READ_BIT(br)) {               //  vui_timing_info_present_flag
+        info->num_units_in_tick = BR_READ(br, 32);
+        info->time_scale = BR_READ(br, 32);
+        if(info->num_units_in_tick > 0) {
+            info->frame_rate = (double)info->time_scale / info->num_units_in_tick;
+        }
+    }
+}
+
+int hevc_parse_sps(const uint8_t *nal, uint32_t size, video_sps_info_t *info) {
+    uint8_t rbsp[VIDEO_SPS_MAX_RBSP_SIZE];
+    bitreader_t reader;
+    bitreader_t *br = &reader;
+
+    if(size < 4 || ((nal[0] >> 1) & 0x3f) != 33) {
+        return -1;
+    }
+    uint32_t rbsp_size = video_nal_to_rbsp(nal + 2, size - 2, rbsp, sizeof(rbsp));
+    BR_INIT(br, rbsp, rbsp_size);
+
+    int nal_length_size = info->nal_length_size;
+    memset(info, 0, sizeof(*info));
+    info->nal_length_size = nal_length_size;
+    info->codec_id = VIDEO_CODEC_ID_HEVC;
+    info->max_num_reorder_frames = -1;
+    info->max_dec_frame_buffering = -1;
+    info->sar_num = 1;
+    info->sar_den = 1;
+
+    BR_SKIP(br, 4);                     //  sps_video_parameter_set_id
+    uint32_t max_sub_layers_minus1 = BR_READ(br, 3);
+    BR_SKIP(br, 1);                     //  sps_temporal_id_nesting_flag
+    if(max_sub_layers_minus1 > 6) {
+        return -1;
+    }
+    hevc_parse_profile_tier_level(br, max_sub_layers_minus1, info);
+    BR_READ_UE(br);                     //  sps_seq_parameter_set_id
+    info->chroma_format_idc = (int)BR_READ_UE(br);
+    if(info->chroma_format_idc > 3) {
+        return -1;
+    }
+    int separate_colour_plane = 0;
+    if(info->chroma_format_idc == 3) {
+        separate_colour_plane = (int)BR_READ_BIT(br);
+    }
+    uint32_t width = BR_READ_UE(br);
+    uint32_t height = BR_READ_UE(br);
+    uint32_t conf_left = 0, conf_right = 0, conf_top = 0, conf_bottom = 0;
+    if(BR_READ_BIT(br)) {               //  conformance_window_flag
+        conf_left = BR_READ_UE(br);
+        conf_right = BR_READ_UE(br);
+        conf_top = BR_READ_UE(br);
+        conf_bottom = BR_READ_UE(br);
+    }
+    info->bit_depth_luma = (int)BR_READ_UE(br) + 8;
+    info->bit_depth_chroma = (int)BR_READ_UE(br) + 8;
+    uint32_t log2_max_poc_lsb = BR_READ_UE(br) + 4;
+    int sub_layer_ordering_info_present = (int)BR_READ_BIT(br);
+    for(uint32_t i = sub_layer_ordering_info_present ? 0 : max_sub_layers_minus1;i <= max_sub_layers_minus1;++i) {
+        /*
+         取最高的sub layer
+         */
+        info->max_dec_frame_buffering = (int)BR_READ_UE(br) + 1;
+        info->max_num_reorder_frames = (int)BR_READ_UE(br);
+        BR_READ_UE(br);                 //  sps_max_latency_increase_plus1
+    }
+    if(BR_ERROR(br) || width == 0 || height == 0 || width > 16888 || height > 16888 || log2_max_poc_lsb > 16) {
+        return -1;
+    }
+
+    int chroma_array_type = separate_colour_plane ? 0 : info->chroma_format_idc;
+    uint32_t sub_width = (chroma_array_type == 1 || chroma_array_type == 2) ? 2 : 1;
+    uint32_t sub_height = chroma_array_type == 1 ? 2 : 1;
+    int64_t w = (int64_t)width - (int64_t)sub_width * (conf_left + conf_right);
+    int64_t h = (int64_t)height - (int64_t)sub_height * (conf_top + conf_bottom);
+    if(w <= 0 || h <= 0) {
+        return -1;
+    }
+    info->width = (int)w;
+    info->height = (int)h;
+
+    /*
+     下面只为了走到VUI拿帧率，失败不影响前面的结果
+     */
+    BR_READ_UE(br);                     //  log2_min_luma_coding_block_size_minus3
+    BR_READ_UE(br);                     //  log2_diff_max_min_luma_coding_block_size
+    BR_READ_UE(br);                     //  log2_min_luma_transform_block_size_minus2
+    BR_READ_UE(br);                     //  log2_diff_max_min_luma_transform_block_size
+    BR_READ_UE(br);                     //  max_transform_hierarchy_depth_inter
+    BR_READ_UE(br);                     //  max_transform_hierarchy_depth_intra
+    if(BR_READ_BIT(br)) {               //  scaling_list_enabled_flag
+        if(BR_READ_BIT(br)) {           //  sps_scaling_list_data_present_flag
+            hevc_skip_scaling_list_data(br);
+        }
+    }
+    BR_SKIP(br, 2);                     //  amp_enabled_flag, sample_adaptive_offset_enabled_flag
+    if(BR_READ_BIT(br)) {               //  pcm_enabled_flag
+        BR_SKIP(br, 8);
+        BR_READ_UE(br);
+        BR_READ_UE(br);
+        BR_SKIP(br, 1);
+    }
+    uint32_t num_short_term_ref_pic_sets = BR_READ_UE(br);
+    if(num_short_term_ref_pic_sets > 64 ||
+       hevc_skip_short_term_ref_pic_sets(br, num_short_term_ref_pic_sets) < 0) {
+        return 0;
+    }
+    if(BR_READ_BIT(br)) {               //  long_term_ref_pics_present_flag
+        uint32_t num_long_term_ref_pics = BR_READ_UE(br);
+        if(num_long_term_ref_pics > 32) {
+            return 0;
+        }
+        for(uint32_t i = 0;i < num_long_term_ref_pics;++i) {
+            BR_SKIP(br, log2_max_poc_lsb + 1);
+        }
+    }
+    BR_SKIP(br, 2);                     //  sps_temporal_mvp_enabled_flag, strong_intra_smoothing_enabled_flag
+    if(BR_READ_BIT(br)) {               //  vui_parameters_present_flag
+        video_sps_info_t vui = *info;
+        hevc_parse_vui(br, &vui);
+        if(!BR_ERROR(br)) {
+            *info = vui;
+        }
+    }
+    return 0;
+}
+
+int hevc_parse_vps(const uint8_t *nal, uint32_t size, video_sps_info_t *info) {
+    uint8_t rbsp[VIDEO_SPS_MAX_RBSP_SIZE];
+    bitreader_t reader;
+    bitreader_t *br = &reader;
+
+    if(size < 4 || ((nal[0] >> 1) & 0x3f) != 32) {
+        return -1;
+    }
+    uint32_t rbsp_size = video_nal_to_rbsp(nal + 2, size - 2, rbsp, sizeof(rbsp));
+    BR_INIT(br, rbsp, rbsp_size);
+
+    BR_SKIP(br, 12);                    //  vps_video_parameter_set_id ~ vps_max_layers_minus1
+    uint32_t max_sub_layers_minus1 = BR_READ(br, 3);
+    BR_SKIP(br, 17);                    //  vps_temporal_id_nesting_flag, vps_reserved_0xffff_16bits
+    if(max_sub_layers_minus1 > 6) {
+        return -1;
+    }
+    hevc_parse_profile_tier_level(br, max_sub_layers_minus1, NULL);
+    int sub_layer_ordering_info_present = (int)BR_READ_BIT(br);
+    for(uint32_t i = sub_layer_ordering_info_present ? 0 : max_sub_layers_minus1;i <= max_sub_layers_minus1;++i) {
+        BR_READ_UE(br);
+        BR_READ_UE(br);
+        BR_READ_UE(br);
+    }
+    uint32_t max_layer_id = BR_READ(br, 6);
+    uint32_t num_layer_sets = BR_READ_UE(br) + 1;
+    if(num_layer_sets > 1024) {
+        return -1;
+    }
+    BR_SKIP(br, (num_layer_sets - 1) * (max_layer_id + 1));
+    if(BR_READ_BIT(br)) {               //  vps_timing_info_present_flag
+        uint32_t num_units_in_tick = BR_READ(br, 32);
+        uint32_t time_scale = BR_READ(br, 32);
+        if(!BR_ERROR(br) && info->frame_rate == 0 && num_units_in_tick > 0) {
+            info->num_units_in_tick = num_units_in_tick;
+            info->time_scale = time_scale;
+            info->frame_rate = (double)time_scale / num_units_in_tick;
+        }
+    }
+    return BR_ERROR(br) ? -1 : 0;
+}
+
+/*
+ HEVCDecoderConfigurationRecord，固定头部22字节，后面是NAL数组
+ */
+int hevc_parse_decoder_config(const uint8_t *data, uint32_t size, video_sps_info_t *info) {
+    const uint8_t *vps = NULL;
+    uint32_t vps_size = 0;
+    int sps_parsed = 0;
+
+    if(size < 23 || data[0] != 1) {
+        return -1;
+    }
+    info->nal_length_size = (data[21] & 0x3) + 1;
+    uint32_t num_arrays = data[22];
+    uint32_t pos = 23;
+    for(uint32_t i = 0;i < num_arrays;++i) {
+        if(pos + 3 > size) {
+            return -1;
+        }
+        uint32_t nal_type = data[pos] & 0x3f;
+        uint32_t num_nalus = ((uint32_t)data[pos + 1] << 8) | data[pos + 2];
+        pos += 3;
+        for(uint32_t j = 0;j < num_nalus;++j) {
+            if(pos + 2 > size) {
+                return -1;
+            }
+            uint32_t len = ((uint32_t)data[pos] << 8) | data[pos + 1];
+            pos += 2;
+            if(pos + len > size) {
+                return -1;
+            }
+            if(nal_type == 32 && !vps) {
+                vps = data + pos;
+                vps_size = len;
+            } else if(nal_type == 33 && !sps_parsed) {
+                sps_parsed = hevc_parse_sps(data + pos, len, info) == 0;
+            }
+            pos += len;
+        }
+    }
+    if(!sps_parsed) {
+        return -1;
+    }
+    if(vps) {
+        hevc_parse_vps(vps, vps_size, info);
+    }
+    return 0;
+}
+
+/*
+ ==================== AV1 ====================
+ */
+
+#define AV1_OBU_SEQUENCE_HEADER     1
+#define AV1_NUM_REF_FRAMES          8
+
+static uint32_t av1_read_uvlc(bitreader_t *br) {
+    uint32_t leading_zeros = 0;
+    while(!BR_READ_BIT(br)) {
+        if(++leading_zeros >= 32 || BR_ERROR(br)) {
+            return UINT32_MAX;
+        }
+    }
+    if(leading_zeros == 0) {
+        return 0;
+    }
+    return BR_READ(br, leading_zeros) + (1U << leading_zeros) - 1;
+}
+
+static int av1_parse_sequence_header(const uint8_t *data, uint32_t size, video_sps_info_t *info) {
+    bitreader_t reader;
+    bitreader_t *br = &reader;
+    BR_INIT(br, data, size);
+
+    BR_SKIP(br, 4);                     //  seq_profile, still_picture
+    if(BR_READ_BIT(br)) {               //  reduced_still_picture_header
+        BR_SKIP(br, 5);
+    } else {
+        int decoder_model_info_present = 0;
+        uint32_t buffer_delay_length = 0;
+        if(BR_READ_BIT(br)) {           //  timing_info_present_flag
+            info->num_units_in_tick = BR_READ(br, 32);
+            info->time_scale = BR_READ(br, 32);
+            uint32_t ticks_per_picture = 1;
+            if(BR_READ_BIT(br)) {       //  equal_picture_interval
+                uint32_t minus_1 = av1_read_uvlc(br);
+                ticks_per_picture = minus_1 == UINT32_MAX ? 1 : minus_1 + 1;
+            }
+            if(info->num_units_in_tick > 0) {
+                info->frame_rate = (double)info->time_scale / ((double)info->num_units_in_tick * ticks_per_picture);
+            }
+            decoder_model_info_present = (int)BR_READ_BIT(br);
+            if(decoder_model_info_present) {
+                buffer_delay_length = BR_READ(br, 5) + 1;
+                BR_SKIP(br, 32 + 5 + 5);
+            }
+        }
+        int initial_display_delay_present = (int)BR_READ_BIT(br);
+        uint32_t operating_points = BR_READ(br, 5) + 1;
+        for(uint32_t i = 0;i < operating_points;++i) {
+            BR_SKIP(br, 12);            //  operating_point_idc
+            if(BR_READ(br, 5) > 7) {    //  seq_level_idx
+                BR_SKIP(br, 1);
+            }
+            if(decoder_model_info_present && BR_READ_BIT(br)) {
+                BR_SKIP(br, buffer_delay_length * 2 + 1);
+            }
+            if(initial_display_delay_present && BR_READ_BIT(br)) {
+                BR_SKIP(br, 4);
+            }
+        }
+    }
+    uint32_t width_bits = BR_READ(br, 4) + 1;
+    uint32_t height_bits = BR_READ(br, 4) + 1;
+    info->width = (int)BR_READ(br, width_bits) + 1;
+    info->height = (int)BR_READ(br, height_bits) + 1;
+    return BR_ERROR(br) ? -1 : 0;
+}
+
+int av1_parse_decoder_config(const uint8_t *data, uint32_t size, video_sps_info_t *info) {
+    if(size < 4 || data[0] != 0x81) {   //  marker, version 1
+        return -1;
+    }
+    memset(info, 0, sizeof(*info));
+    info->codec_id = VIDEO_CODEC_ID_AV1;
+    info->profile_idc = data[1] >> 5;
+    info->level_idc = data[1] & 0x1f;
+    int high_bitdepth = (data[2] >> 6) & 1;
+    int twelve_bit = (data[2] >> 5) & 1;
+    int monochrome = (data[2] >> 4) & 1;
+    int subsampling_x = (data[2] >> 3) & 1;
+    int subsampling_y = (data[2] >> 2) & 1;
+    info->bit_depth_luma = high_bitdepth ? (twelve_bit ? 12 : 10) : 8;
+    info->bit_depth_chroma = info->bit_depth_luma;
+    if(monochrome) {
+        info->chroma_format_idc = VIDEO_FRAME_FORMAT_MONO;
+    } else if(subsampling_x) {
+        info->chroma_format_idc = subsampling_y ? VIDEO_FRAME_FORMAT_YUV420 : VIDEO_FRAME_FORMAT_YUV422;
+    } else {
+        info->chroma_format_idc = VIDEO_FRAME_FORMAT_YUV444;
+    }
+    info->sar_num = 1;
+    info->sar_den = 1;
+    info->max_num_reorder_frames = 0;
+    info->max_dec_frame_buffering = AV1_NUM_REF_FRAMES;
+
+    /*
+     configOBUs，找sequence header
+     */
+    uint32_t pos = 4;
+    while(pos < size) {
+        uint8_t header = data[pos++];
+        uint32_t obu_type = (header >> 3) & 0xf;
+        if(header & 0x4) {              //  obu_extension_flag
+            ++pos;
+        }
+        uint32_t obu_size = size > pos ? size - pos : 0;
+        if(header & 0x2) {              //  obu_has_size_field, leb128
+            /*
+             最多8个字节56位，超过32位的长度肯定不对
+             */
+            uint64_t value = 0;
+            for(int i = 0;i < 8;++i) {
+                if(pos >= size) {
+                    return -1;
+                }
+                uint8_t b = data[pos++];
+                value |= (uint64_t)(b & 0x7f) << (i * 7);
+                if(!(b & 0x80)) {
+                    break;
+                }
+            }
+            if(value > UINT32_MAX) {
+                return -1;
+            }
+            obu_size = (uint32_t)value;
+        }
+        if(pos > size || obu_size > size - pos) {
+            return -1;
+        }
+        if(obu_type == AV1_OBU_SEQUENCE_HEADER) {
+            return av1_parse_sequence_header(data + pos, obu_size, info);
+        }
+        pos += obu_size;
+    }
+    return -1;
+}
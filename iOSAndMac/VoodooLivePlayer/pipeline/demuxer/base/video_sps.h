@@ -0,0 +1,89 @@
+//
+//  video_sps.h
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#ifndef video_sps_h
+#define video_sps_h
+
+#include <stdint.h>
+
+#define VIDEO_CODEC_ID_H264     7
+#define VIDEO_CODEC_ID_HEVC     12
+#define VIDEO_CODEC_ID_AV1      13      /*  no legacy flv id, enhanced flv av01 */
+
+/*
+ frame format, same values as chroma_format_idc
+ */
+#define VIDEO_FRAME_FORMAT_MONO     0
+#define VIDEO_FRAME_FORMAT_YUV420   1
+#define VIDEO_FRAME_FORMAT_YUV422   2
+#define VIDEO_FRAME_FORMAT_YUV444   3
+
+/*
+ rbsp larger than this is truncated, the fields we need are all near the front
+ */
+#define VIDEO_SPS_MAX_RBSP_SIZE     1024
+
+/*
+ decoded from SPS (and VPS for hevc), sizes are after cropping.
+ frame_rate is 0 without VUI timing info.
+ max_num_reorder_frames / max_dec_frame_buffering come from the VUI bitstream
+ restriction (h264) or the highest sub layer (hevc). when h264 carries no
+ bitstream restriction they are derived from the profile and level limits.
+ */
+typedef struct video_sps_info_s {
+    int codec_id;               /*  VIDEO_CODEC_ID_*    */
+    int profile_idc;
+    int level_idc;
+    int chroma_format_idc;      /*  VIDEO_FRAME_FORMAT_* */
+    int bit_depth_luma;
+    int bit_depth_chroma;
+    int width;
+    int height;
+    int interlaced;
+    int sar_num;
+    int sar_den;
+    int full_range;
+
+    uint32_t num_units_in_tick;
+    uint32_t time_scale;
+    double frame_rate;
+
+    int max_num_reorder_frames;
+    int max_dec_frame_buffering;
+
+    int nal_length_size;        /*  from the decoder configuration record, 0 for av1 */
+} video_sps_info_t;
+
+/*
+ removes emulation prevention bytes, returns the rbsp size (at most dst_size)
+ */
+uint32_t video_nal_to_rbsp(const uint8_t *src, uint32_t size, uint8_t *dst, uint32_t dst_size);
+
+/*
+ nal includes the nal header. return 0 on success, -1 on error
+ */
+int avc_parse_sps(const uint8_t *nal, uint32_t size, video_sps_info_t *info);
+int hevc_parse_sps(const uint8_t *nal, uint32_t size, video_sps_info_t *info);
+/*
+ only fills frame rate when the SPS has no timing info
+ */
+int hevc_parse_vps(const uint8_t *nal, uint32_t size, video_sps_info_t *info);
+
+/*
+ AVCDecoderConfigurationRecord / HEVCDecoderConfigurationRecord,
+ parses the first SPS (and VPS) found
+ */
+int avc_parse_decoder_config(const uint8_t *data, uint32_t size, video_sps_info_t *info);
+int hevc_parse_decoder_config(const uint8_t *data, uint32_t size, video_sps_info_t *info);
+/*
+ AV1CodecConfigurationRecord, needs the sequence header obu in configOBUs.
+ av1 outputs frames in decode order, reorder depth is 0
+ */
+int av1_parse_decoder_config(const uint8_t *data, uint32_t size, video_sps_info_t *info);
+
+#endif /* video_sps_h */
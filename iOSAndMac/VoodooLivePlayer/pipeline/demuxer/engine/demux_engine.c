@@ -0,0 +1,603 @@
+//
+//  demux_engine.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#include "demux_engine.h"
+#include "flv.h"
+#include "rtmp.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define DEMUX_ENGINE_DEFAULT_BUDGET     (256*1024)
+#define DEMUX_ENGINE_DEQUE_SIZE         (1024)
+
+/*
+ release为空时数据跟在节点后面，和节点一起释放
+ */
+typedef struct demux_input_s {
+    struct demux_input_s *next;
+    const uint8_t *data;
+    uint32_t size;
+    int close;
+    fn_demux_input_release_t release;
+    void *opaque;
+} demux_input_t;
+
+struct demux_session_s {
+    demux_engine_t *engine;
+    int format;
+    void *demuxer;
+    void *userdata;
+    fn_demuxer_callback_t callback;
+    /*
+     只在运行这个session的worker上改
+     */
+    uint64_t callbacks;
+
+    int closed;
+    int32_t failed;
+    /*
+     用户句柄一个引用，被调度期间再持有一个
+     */
+    int32_t refcount;
+    int32_t scheduled;
+    /*
+     在worker的inbox里时的链表指针
+     */
+    demux_session_t *next_scheduled;
+
+    /*
+     输入是单生产者单消费者的无锁链表：feed线程只动tail，运行session的worker
+     只动head。head是已经消费过的节点（开始时是stub），它的next才是下一个输入，
+     所以最后消费的那个节点要等下一个输入取走或session释放时才释放
+     */
+    demux_input_t *head;
+    demux_input_t *tail;
+    demux_input_t stub;
+    demux_input_t close_input;
+};
+
+/*
+ scheduled sessions of a worker, no locks:
+ inbox      pushed by any thread, taken whole by whichever worker gets to it
+ deque      ring in [top, bottom), only the owner pushes, the owner and
+            thieves all take the oldest with a cas on top
+ */
+typedef struct demux_worker_s {
+    demux_engine_t *engine;
+    int index;
+    pthread_t thread;
+
+    demux_session_t *inbox;
+    demux_session_t **deque;
+    uint32_t top;
+    uint32_t bottom;
+    uint32_t seed;
+
+    uint64_t sessions_run;
+    uint64_t steals;
+    uint64_t bytes;
+    uint64_t callbacks;
+    uint64_t errors;
+} demux_worker_t;
+
+struct demux_engine_s {
+    demux_engine_config_t config;
+    demux_worker_t *workers;
+    int worker_count;
+    int running;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t idle_cond;
+    /*
+     sessions sitting in deques / scheduled or running / not yet released
+     */
+    int32_t queued;
+    int32_t idle_workers;
+    int32_t inflight;
+    int32_t sessions;
+    uint32_t next_worker;
+};
+
+static __thread demux_worker_t *demux_current_worker = NULL;
+
+static void* demux_engine_malloc(demux_engine_t *engine, size_t size) {
+    return engine->config.demuxer_config.malloc_fn(engine->config.demuxer_config.allocator_opaque, size);
+}
+
+static void demux_engine_free(demux_engine_t *engine, void *ptr) {
+    engine->config.demuxer_config.free_fn(engine->config.demuxer_config.allocator_opaque, ptr);
+}
+
+/*
+ owner only
+ */
+static int demux_worker_push(demux_worker_t *worker, demux_session_t *session) {
+    uint32_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED);
+    uint32_t top = __atomic_load_n(&worker->top, __ATOMIC_ACQUIRE);
+    if(bottom - top >= DEMUX_ENGINE_DEQUE_SIZE) {
+        return -1;
+    }
+    __atomic_store_n(&worker->deque[bottom & (DEMUX_ENGINE_DEQUE_SIZE - 1)], session, __ATOMIC_RELAXED);
+    __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static demux_session_t* demux_worker_take(demux_worker_t *worker) {
+    while(1) {
+        uint32_t top = __atomic_load_n(&worker->top, __ATOMIC_ACQUIRE);
+        uint32_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_ACQUIRE);
+        if((int32_t)(bottom - top) <= 0) {
+            return NULL;
+        }
+        /*
+         读到的槽位可能已被owner回绕覆盖，那样top也已经变了，cas会失败
+         */
+        demux_session_t *session = __atomic_load_n(&worker->deque[top & (DEMUX_ENGINE_DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+        if(__atomic_compare_exchange_n(&worker->top, &top, top + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            return session;
+        }
+    }
+}
+
+static void demux_worker_inbox_push(demux_worker_t *worker, demux_session_t *session) {
+    demux_session_t *head = __atomic_load_n(&worker->inbox, __ATOMIC_RELAXED);
+    do {
+        session->next_scheduled = head;
+    } while(!__atomic_compare_exchange_n(&worker->inbox, &head, session, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*
+ 把victim的inbox整个搬进worker自己的deque，按提交顺序排。
+ deque满了放不下的退回worker自己的inbox
+ */
+static void demux_worker_drain_inbox(demux_worker_t *worker, demux_worker_t *victim) {
+    if(!__atomic_load_n(&victim->inbox, __ATOMIC_RELAXED)) {
+        return;
+    }
+    demux_session_t *list = __atomic_exchange_n(&victim->inbox, NULL, __ATOMIC_ACQUIRE);
+    demux_session_t *reversed = NULL, *next;
+    while(list) {
+        next = list->next_scheduled;
+        list->next_scheduled = reversed;
+        reversed = list;
+        list = next;
+    }
+    while(reversed) {
+        next = reversed->next_scheduled;
+        if(demux_worker_push(worker, reversed) < 0) {
+            demux_worker_inbox_push(worker, reversed);
+        }
+        reversed = next;
+    }
+}
+
+static demux_session_t* demux_worker_steal(demux_worker_t *worker) {
+    demux_engine_t *engine = worker->engine;
+    demux_session_t *session = NULL;
+    worker->seed ^= worker->seed << 13;
+    worker->seed ^= worker->seed >> 17;
+    worker->seed ^= worker->seed << 5;
+    int start = (int)(worker->seed % (uint32_t)engine->worker_count);
+    for(int i = 0;i < engine->worker_count && !session;++i) {
+        demux_worker_t *victim = &engine->workers[(start + i) % engine->worker_count];
+        if(victim == worker) {
+            continue;
+        }
+        session = demux_worker_take(victim);
+        if(!session) {
+            /*
+             owner正忙着跑别的session时，它的inbox也可以拿过来
+             */
+            demux_worker_drain_inbox(worker, victim);
+            session = demux_worker_take(worker);
+        }
+    }
+    if(session) {
+        __atomic_add_fetch(&worker->steals, 1, __ATOMIC_RELAXED);
+    }
+    return session;
+}
+
+static void demux_engine_submit(demux_engine_t *engine, demux_session_t *session) {
+    demux_worker_t *worker = demux_current_worker;
+    if(worker && worker->engine == engine) {
+        if(demux_worker_push(worker, session) < 0) {
+            demux_worker_inbox_push(worker, session);
+        }
+    } else {
+        uint32_t next = __atomic_fetch_add(&engine->next_worker, 1, __ATOMIC_RELAXED);
+        demux_worker_inbox_push(&engine->workers[next % (uint32_t)engine->worker_count], session);
+    }
+    __atomic_add_fetch(&engine->queued, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&engine->idle_workers, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&engine->lock);
+        pthread_cond_signal(&engine->work_cond);
+        pthread_mutex_unlock(&engine->lock);
+    }
+}
+
+static void demux_session_schedule(demux_session_t *session) {
+    if(__atomic_exchange_n(&session->scheduled, 1, __ATOMIC_SEQ_CST) == 0) {
+        __atomic_add_fetch(&session->refcount, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&session->engine->inflight, 1, __ATOMIC_SEQ_CST);
+        demux_engine_submit(session->engine, session);
+    }
+}
+
+static void demux_input_free(demux_session_t *session, demux_input_t *input) {
+    if(input == &session->stub || input == &session->close_input) {
+        return;
+    }
+    if(input->release) {
+        input->release(input->opaque, input->data);
+    }
+    demux_engine_free(session->engine, input);
+}
+
+static void demux_session_release(demux_session_t *session) {
+    if(__atomic_sub_fetch(&session->refcount, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+    demux_engine_t *engine = session->engine;
+    demux_input_t *input = session->head;
+    while(input) {
+        demux_input_t *next = __atomic_load_n(&input->next, __ATOMIC_ACQUIRE);
+        demux_input_free(session, input);
+        input = next;
+    }
+    demux_engine_free(engine, session);
+
+    if(__atomic_sub_fetch(&engine->sessions, 1, __ATOMIC_SEQ_CST) == 0) {
+        pthread_mutex_lock(&engine->lock);
+        pthread_cond_broadcast(&engine->idle_cond);
+        pthread_mutex_unlock(&engine->lock);
+    }
+}
+
+static void demux_session_fint_demuxer(demux_session_t *session) {
+    if(!session->demuxer) {
+        return;
+    }
+    if(session->format == DEMUX_SESSION_RTMP) {
+        rtmp_demuxer_fint(session->demuxer);
+    } else {
+        flv_demuxer_fint(session->demuxer);
+    }
+    session->demuxer = NULL;
+}
+
+static void demux_session_callback(void* userdata, int type, void* data, int size, int64_t ts[], uint32_t flag) {
+    demux_session_t *session = (demux_session_t*)userdata;
+    session->callbacks++;
+    session->callback(session->userdata, type, data, size, ts, flag);
+}
+
+static void demux_worker_run_session(demux_worker_t *worker, demux_session_t *session) {
+    demux_engine_t *engine = worker->engine;
+    uint64_t callbacks = session->callbacks, bytes = 0;
+    int more = 0, ret;
+    demux_input_t *input;
+
+    while(1) {
+        input = __atomic_load_n(&session->head->next, __ATOMIC_ACQUIRE);
+        if(!input) {
+            break;
+        }
+        demux_input_free(session, session->head);
+        session->head = input;
+        if(input->close) {
+            /*
+             close之后不会再有输入
+             */
+            demux_session_fint_demuxer(session);
+            break;
+        }
+        if(!__atomic_load_n(&session->failed, __ATOMIC_RELAXED)) {
+            if(session->format == DEMUX_SESSION_RTMP) {
+                ret = rtmp_demuxer_feed(session->demuxer, input->data, (int)input->size);
+            } else {
+                ret = flv_demuxer_feed(session->demuxer, input->data, (int)input->size);
+            }
+            if(ret < 0) {
+                __atomic_store_n(&session->failed, 1, __ATOMIC_RELAXED);
+                __atomic_add_fetch(&worker->errors, 1, __ATOMIC_RELAXED);
+            }
+        }
+        bytes += input->size;
+        if(input->release) {
+            input->release(input->opaque, input->data);
+            input->release = NULL;
+        }
+        if(bytes >= engine->config.session_budget) {
+            more = 1;
+            break;
+        }
+    }
+
+    __atomic_add_fetch(&worker->sessions_run, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&worker->bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&worker->callbacks, session->callbacks - callbacks, __ATOMIC_RELAXED);
+
+    if(more && session->demuxer) {
+        /*
+         用完配额，排到自己队列末尾，仍然算调度中
+         */
+        demux_engine_submit(engine, session);
+        return;
+    }
+
+    __atomic_store_n(&session->scheduled, 0, __ATOMIC_SEQ_CST);
+    /*
+     feed可能在清标志之前看到scheduled为1而没有提交
+     */
+    more = __atomic_load_n(&session->head->next, __ATOMIC_SEQ_CST) != NULL;
+    if(more) {
+        demux_session_schedule(session);
+    }
+    demux_session_release(session);
+
+    if(__atomic_sub_fetch(&engine->inflight, 1, __ATOMIC_SEQ_CST) == 0) {
+        pthread_mutex_lock(&engine->lock);
+        pthread_cond_broadcast(&engine->idle_cond);
+        pthread_mutex_unlock(&engine->lock);
+    }
+}
+
+static void* demux_worker_main(void *arg) {
+    demux_worker_t *worker = (demux_worker_t*)arg;
+    demux_engine_t *engine = worker->engine;
+    demux_session_t *session;
+    int stop;
+
+    demux_current_worker = worker;
+    while(1) {
+        demux_worker_drain_inbox(worker, worker);
+        session = demux_worker_take(worker);
+        if(!session) {
+            session = demux_worker_steal(worker);
+        }
+        if(session) {
+            __atomic_sub_fetch(&engine->queued, 1, __ATOMIC_SEQ_CST);
+            demux_worker_run_session(worker, session);
+            continue;
+        }
+
+        pthread_mutex_lock(&engine->lock);
+        __atomic_add_fetch(&engine->idle_workers, 1, __ATOMIC_SEQ_CST);
+        while(engine->running && __atomic_load_n(&engine->queued, __ATOMIC_SEQ_CST) <= 0) {
+            pthread_cond_wait(&engine->work_cond, &engine->lock);
+        }
+        __atomic_sub_fetch(&engine->idle_workers, 1, __ATOMIC_SEQ_CST);
+        stop = !engine->running && __atomic_load_n(&engine->queued, __ATOMIC_SEQ_CST) <= 0;
+        pthread_mutex_unlock(&engine->lock);
+        if(stop) {
+            break;
+        }
+    }
+    demux_current_worker = NULL;
+    return NULL;
+}
+
+demux_engine_t* demux_engine_create(const demux_engine_config_t* config) {
+    demux_engine_config_t cfg;
+    if(config) {
+        cfg = *config;
+    } else {
+        memset(&cfg, 0, sizeof(cfg));
+    }
+    demuxer_select_allocator(&cfg.demuxer_config, &cfg.demuxer_config.malloc_fn, &cfg.demuxer_config.free_fn, &cfg.demuxer_config.allocator_opaque);
+    if(cfg.worker_count <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        cfg.worker_count = cpus > 0 ? (int)cpus : 1;
+    }
+    if(cfg.session_budget == 0) {
+        cfg.session_budget = DEMUX_ENGINE_DEFAULT_BUDGET;
+    }
+
+    demux_engine_t *engine = (demux_engine_t*)cfg.demuxer_config.malloc_fn(cfg.demuxer_config.allocator_opaque, sizeof(demux_engine_t));
+    if(!engine) {
+        return NULL;
+    }
+    memset(engine, 0, sizeof(demux_engine_t));
+    engine->config = cfg;
+    engine->running = 1;
+    pthread_mutex_init(&engine->lock, NULL);
+    pthread_cond_init(&engine->work_cond, NULL);
+    pthread_cond_init(&engine->idle_cond, NULL);
+
+    engine->workers = (demux_worker_t*)demux_engine_malloc(engine, cfg.worker_count * sizeof(demux_worker_t));
+    if(!engine->workers) {
+        demux_engine_free(engine, engine);
+        return NULL;
+    }
+    memset(engine->workers, 0, cfg.worker_count * sizeof(demux_worker_t));
+    for(int i = 0;i < cfg.worker_count;++i) {
+        demux_worker_t *worker = &engine->workers[i];
+        worker->engine = engine;
+        worker->index = i;
+        worker->seed = 0x9e3779b9u * (uint32_t)(i + 1);
+        worker->deque = (demux_session_t**)demux_engine_malloc(engine, DEMUX_ENGINE_DEQUE_SIZE * sizeof(demux_session_t*));
+        if(!worker->deque) {
+            break;
+        }
+        engine->worker_count = i + 1;
+    }
+    /*
+     先把worker都建好再启动线程，steal会访问所有worker
+     */
+    int started = 0;
+    if(engine->worker_count == cfg.worker_count) {
+        for(started = 0;started < engine->worker_count;++started) {
+            if(pthread_create(&engine->workers[started].thread, NULL, demux_worker_main, &engine->workers[started]) != 0) {
+                break;
+            }
+        }
+    }
+    if(started == 0 || started < cfg.worker_count) {
+        pthread_mutex_lock(&engine->lock);
+        engine->running = 0;
+        pthread_cond_broadcast(&engine->work_cond);
+        pthread_mutex_unlock(&engine->lock);
+        for(int i = 0;i < started;++i) {
+            pthread_join(engine->workers[i].thread, NULL);
+        }
+        for(int i = 0;i < cfg.worker_count;++i) {
+            if(engine->workers[i].deque) {
+                demux_engine_free(engine, engine->workers[i].deque);
+            }
+        }
+        demux_engine_free(engine, engine->workers);
+        pthread_cond_destroy(&engine->idle_cond);
+        pthread_cond_destroy(&engine->work_cond);
+        pthread_mutex_destroy(&engine->lock);
+        demux_engine_free(engine, engine);
+        return NULL;
+    }
+    return engine;
+}
+
+void demux_engine_destroy(demux_engine_t* engine) {
+    pthread_mutex_lock(&engine->lock);
+    while(__atomic_load_n(&engine->inflight, __ATOMIC_SEQ_CST) > 0 || __atomic_load_n(&engine->sessions, __ATOMIC_SEQ_CST) > 0) {
+        pthread_cond_wait(&engine->idle_cond, &engine->lock);
+    }
+    engine->running = 0;
+    pthread_cond_broadcast(&engine->work_cond);
+    pthread_mutex_unlock(&engine->lock);
+
+    for(int i = 0;i < engine->worker_count;++i) {
+        pthread_join(engine->workers[i].thread, NULL);
+    }
+    for(int i = 0;i < engine->worker_count;++i) {
+        demux_engine_free(engine, engine->workers[i].deque);
+    }
+    demux_engine_free(engine, engine->workers);
+    pthread_cond_destroy(&engine->idle_cond);
+    pthread_cond_destroy(&engine->work_cond);
+    pthread_mutex_destroy(&engine->lock);
+    demux_engine_free(engine, engine);
+}
+
+int demux_engine_worker_count(demux_engine_t* engine) {
+    return engine->worker_count;
+}
+
+void demux_engine_wait_idle(demux_engine_t* engine) {
+    pthread_mutex_lock(&engine->lock);
+    while(__atomic_load_n(&engine->inflight, __ATOMIC_SEQ_CST) > 0) {
+        pthread_cond_wait(&engine->idle_cond, &engine->lock);
+    }
+    pthread_mutex_unlock(&engine->lock);
+}
+
+void demux_engine_get_stats(demux_engine_t* engine, demux_engine_stats_t* stats) {
+    memset(stats, 0, sizeof(demux_engine_stats_t));
+    for(int i = 0;i < engine->worker_count;++i) {
+        demux_worker_t *worker = &engine->workers[i];
+        stats->sessions_run += __atomic_load_n(&worker->sessions_run, __ATOMIC_RELAXED);
+        stats->steals += __atomic_load_n(&worker->steals, __ATOMIC_RELAXED);
+        stats->bytes += __atomic_load_n(&worker->bytes, __ATOMIC_RELAXED);
+        stats->callbacks += __atomic_load_n(&worker->callbacks, __ATOMIC_RELAXED);
+        stats->errors += __atomic_load_n(&worker->errors, __ATOMIC_RELAXED);
+    }
+}
+
+demux_session_t* demux_engine_open_session(demux_engine_t* engine, int format, void* userdata, fn_demuxer_callback_t callback) {
+    if(format != DEMUX_SESSION_FLV && format != DEMUX_SESSION_RTMP) {
+        return NULL;
+    }
+    demux_session_t *session = (demux_session_t*)demux_engine_malloc(engine, sizeof(demux_session_t));
+    if(!session) {
+        return NULL;
+    }
+    memset(session, 0, sizeof(demux_session_t));
+    session->engine = engine;
+    session->format = format;
+    session->userdata = userdata;
+    session->callback = callback;
+    session->refcount = 1;
+    session->head = session->tail = &session->stub;
+    session->close_input.close = 1;
+    if(format == DEMUX_SESSION_RTMP) {
+        session->demuxer = rtmp_demuxer_init_with_config(session, demux_session_callback, &engine->config.demuxer_config);
+    } else {
+        session->demuxer = flv_demuxer_init_with_config(session, demux_session_callback, &engine->config.demuxer_config);
+    }
+    if(!session->demuxer) {
+        demux_engine_free(engine, session);
+        return NULL;
+    }
+    __atomic_add_fetch(&engine->sessions, 1, __ATOMIC_SEQ_CST);
+    return session;
+}
+
+/*
+ feed线程
+ */
+static void demux_session_append(demux_session_t *session, demux_input_t *input) {
+    input->next = NULL;
+    __atomic_store_n(&session->tail->next, input, __ATOMIC_SEQ_CST);
+    session->tail = input;
+    demux_session_schedule(session);
+}
+
+int demux_session_feed(demux_session_t* session, const void* data, int len) {
+    if(session->closed || __atomic_load_n(&session->failed, __ATOMIC_RELAXED)) {
+        return -1;
+    }
+    if(len <= 0) {
+        return 0;
+    }
+    demux_input_t *input = (demux_input_t*)demux_engine_malloc(session->engine, sizeof(demux_input_t) + (size_t)len);
+    if(!input) {
+        return -1;
+    }
+    memcpy(input + 1, data, (size_t)len);
+    input->data = (const uint8_t*)(input + 1);
+    input->size = (uint32_t)len;
+    input->close = 0;
+    input->release = NULL;
+    input->opaque = NULL;
+    demux_session_append(session, input);
+    return 0;
+}
+
+int demux_session_feed_buffer(demux_session_t* session, const void* data, int len, fn_demux_input_release_t release, void* opaque) {
+    if(session->closed || __atomic_load_n(&session->failed, __ATOMIC_RELAXED)) {
+        return -1;
+    }
+    if(len <= 0) {
+        if(release) {
+            release(opaque, data);
+        }
+        return 0;
+    }
+    demux_input_t *input = (demux_input_t*)demux_engine_malloc(session->engine, sizeof(demux_input_t));
+    if(!input) {
+        return -1;
+    }
+    input->data = (const uint8_t*)data;
+    input->size = (uint32_t)len;
+    input->close = 0;
+    input->release = release;
+    input->opaque = opaque;
+    demux_session_append(session, input);
+    return 0;
+}
+
+void demux_session_close(demux_session_t* session) {
+    if(session->closed) {
+        return;
+    }
+    session->closed = 1;
+    demux_session_append(session, &session->close_input);
+    demux_session_release(session);
+}
@@ -0,0 +1,89 @@
+//
+//  demux_engine.h
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#ifndef demux_engine_h
+#define demux_engine_h
+
+#include "demuxer.h"
+
+/*
+ runs many demuxer sessions on a fixed set of worker threads.
+ demux_session_feed_buffer hands the data to the session input queue and
+ schedules the session, a worker then runs the demuxer on it. a session is
+ only run by one worker at a time so its callbacks keep stream order, idle
+ workers steal scheduled sessions from busy ones. the input queues and the
+ worker queues are lock-free, a mutex is only taken to wake idle workers.
+ callbacks come from the worker threads.
+ */
+typedef struct demux_engine_s demux_engine_t;
+typedef struct demux_session_s demux_session_t;
+
+#define DEMUX_SESSION_FLV           0
+#define DEMUX_SESSION_RTMP          1
+
+/*
+ gives a fed buffer back, from a worker thread or the thread releasing the session
+ */
+typedef void (*fn_demux_input_release_t)(void* opaque, const void* data);
+
+typedef struct demux_engine_config_s {
+    int worker_count;               /*  0 uses the online cpu count */
+    /*
+     input bytes a session may consume before it goes back to the queue,
+     keeps one hot stream from starving the others. 0 uses the default.
+     */
+    uint32_t session_budget;
+    /*
+     for the demuxer of every session, the engine allocates with it too
+     */
+    demuxer_config_t demuxer_config;
+} demux_engine_config_t;
+
+typedef struct demux_engine_stats_s {
+    uint64_t sessions_run;          /*  times a worker picked up a session  */
+    uint64_t steals;                /*  sessions taken from another worker  */
+    uint64_t bytes;                 /*  input bytes demuxed                 */
+    uint64_t callbacks;             /*  demuxer callbacks delivered         */
+    uint64_t errors;                /*  feeds that failed                   */
+} demux_engine_stats_t;
+
+/*
+ config may be NULL
+ */
+demux_engine_t* demux_engine_create(const demux_engine_config_t* config);
+/*
+ all sessions must be closed, waits until they are released
+ */
+void demux_engine_destroy(demux_engine_t* engine);
+int demux_engine_worker_count(demux_engine_t* engine);
+/*
+ blocks until every queued input has been demuxed
+ */
+void demux_engine_wait_idle(demux_engine_t* engine);
+void demux_engine_get_stats(demux_engine_t* engine, demux_engine_stats_t* stats);
+
+demux_session_t* demux_engine_open_session(demux_engine_t* engine, int format, void* userdata, fn_demuxer_callback_t callback);
+/*
+ thread safe against the workers, one feeding thread per session, which
+ also closes it. returns 0, -1 when the session failed or is closed.
+ the buffer is demuxed in place, release is called once the demuxer is done
+ with it or the session is released, it may be NULL when the data outlives
+ the session. on -1 the buffer stays with the caller
+ */
+int demux_session_feed_buffer(demux_session_t* session, const void* data, int len, fn_demux_input_release_t release, void* opaque);
+/*
+ same, for data in a transient buffer: copies it first
+ */
+int demux_session_feed(demux_session_t* session, const void* data, int len);
+/*
+ queued input is still demuxed, then the demuxer is released on a worker.
+ the session must not be used after this call.
+ */
+void demux_session_close(demux_session_t* session);
+
+#endif /* demux_engine_h */
@@ -16,7 +16,7 @@ func flv_demuxer_callback(demuxerPtr:UnsafeMutableRawPointer?, type:Int32, data:
     var ts:[Int64] = [VOODOO_NOPTS_VALUE,VOODOO_NOPTS_VALUE]
     if let tsPtr = tsPointer {
         ts[0] = tsPtr.pointee
-        ts[1] = tsPtr.advanced(by: 8).pointee
+        ts[1] = tsPtr[1]
     }
     demuxer.handleCallback(type: type, dataPtr: data, dataSize: size, ts: ts, flag: flag)
 }
@@ -24,6 +24,29 @@ func flv_demuxer_callback(demuxerPtr:UnsafeMutableRawPointer?, type:Int32, data:
 class LiveFLVDemuxer : LiveDemuxer {
     
     private var flvDemuxerContext: UnsafeMutableRawPointer? = nil
+    private var packetPool: OpaquePointer? = nil
+    private static let packetBatchSize = 64
+    private let packetBatch = UnsafeMutablePointer<UnsafeMutablePointer<demuxer_packet_t>?>.allocate(capacity: LiveFLVDemuxer.packetBatchSize)
+    private var recorder: OpaquePointer? = nil
+
+    /*
+     set before start(), the recording runs from start() to stop()
+     */
+    var recordPathPrefix: String?
+    var recordSegmentMs: UInt32 = 0
+
+    /*
+     caps of the gop cache kept while muted, 0 for 10 s and 16 MB
+     */
+    var gopCacheMaxMs: UInt32 = 0
+    var gopCacheMaxBytes: UInt32 = 0
+    private var gopCache: OpaquePointer? = nil
+    /*
+     while muted only the gop cache and the recorder see the stream,
+     the media flag and metadata are held back for unmute
+     */
+    private(set) var muted = false
+    private var mutedCallbacks = [Int32: (Data, [Int64], UInt32)]()
         
     class func initDemuxer(demuxer:inout LiveFLVDemuxer) {
         let selfPtr = withUnsafeMutablePointer(to: &demuxer, {return $0})
@@ -33,7 +56,11 @@ class LiveFLVDemuxer : LiveDemuxer {
     override init(delegate:LiveDemuxerDelegate? = nil, delegateQueue: DispatchQueue? = nil) {
         super.init(delegate: delegate, delegateQueue: delegateQueue)
         let selfPtr = Unmanaged<LiveFLVDemuxer>.passUnretained(self).toOpaque()
-        self.flvDemuxerContext = flv_demuxer_init(selfPtr, flv_demuxer_callback)
+        // default config: a small cache that grows only for tags straddling two feeds
+        self.flvDemuxerContext = flv_demuxer_init_with_config(selfPtr, flv_demuxer_callback, nil)
+        flv_demuxer_set_resync(self.flvDemuxerContext, 1)
+        self.packetPool = packet_pool_create(0, nil)
+        flv_demuxer_set_packet_pool(self.flvDemuxerContext, self.packetPool, nil)
     }
     
     deinit {
@@ -41,9 +68,140 @@ class LiveFLVDemuxer : LiveDemuxer {
             flv_demuxer_fint(self.flvDemuxerContext)
             self.flvDemuxerContext = nil
         }
+        stopRecording()
+        if self.gopCache != nil {
+            gop_cache_destroy(self.gopCache)
+            self.gopCache = nil
+        }
+        if self.packetPool != nil {
+            packet_pool_destroy(self.packetPool)
+            self.packetPool = nil
+        }
+        packetBatch.deallocate()
+    }
+
+    override func start() -> Bool {
+        if let prefix = recordPathPrefix, recorder == nil {
+            var config = fmp4_recorder_config_t()
+            config.segment_ms = recordSegmentMs
+            config.index = 1
+            // handlePacket pushes on the demux thread, keep the disk off it
+            config.async = 1
+            recorder = prefix.withCString { (path) -> OpaquePointer? in
+                config.path_prefix = path
+                return fmp4_recorder_create(&config, nil)
+            }
+            if recorder == nil {
+                print("FLV RECORDER \(prefix) FAILED")
+            }
+        }
+        return true
+    }
+
+    override func stop() {
+        stopRecording()
+        if let cache = self.gopCache {
+            flv_demuxer_set_gop_cache(self.flvDemuxerContext, nil)
+            gop_cache_clear(cache)
+        }
+        muted = false
+        mutedCallbacks.removeAll()
+    }
+
+    /*
+     before start(). the stream is demuxed but kept in the gop cache
+     instead of handed on, unmute() replays it
+     */
+    func mute() -> Bool {
+        if gopCache == nil {
+            var config = gop_cache_config_t()
+            config.max_bytes = gopCacheMaxBytes
+            config.max_duration_ms = gopCacheMaxMs
+            gopCache = gop_cache_create(&config, nil)
+        }
+        guard let cache = self.gopCache else { return false }
+        flv_demuxer_set_gop_cache(self.flvDemuxerContext, cache)
+        muted = true
+        return true
+    }
+
+    /*
+     hands on the held back media flag and metadata, the sequence headers and
+     the cached gop, then the stream goes on live. willReplay gets the dts
+     targetLatencyMs behind the newest packet before anything is delivered,
+     the packets ahead of it are only there to be decoded
+     */
+    func unmute(targetLatencyMs: Int64, willReplay: (Int64) -> Void) {
+        guard muted, let cache = self.gopCache else { return }
+        muted = false
+        var stats = gop_cache_stats_t()
+        gop_cache_get_stats(cache, &stats)
+        let capacity = Int(stats.packets) + 2
+        let packets = UnsafeMutablePointer<UnsafeMutablePointer<demuxer_packet_t>?>.allocate(capacity: capacity)
+        defer { packets.deallocate() }
+        var presentIndex: Int32 = 0
+        let count = Int(max(gop_cache_snapshot(cache, targetLatencyMs, packets, Int32(capacity), &presentIndex), 0))
+        /*
+         the snapshot holds its own references, live needs no cache
+         */
+        flv_demuxer_set_gop_cache(self.flvDemuxerContext, nil)
+        gop_cache_clear(cache)
+
+        willReplay(Int(presentIndex) < count ? packets[Int(presentIndex)]!.pointee.dts : VOODOO_NOPTS_VALUE)
+        for type in [Int32(VOODOO_DATA_TYPE_MEDIA_FLAG), Int32(VOODOO_DATA_TYPE_METADATA)] {
+            guard let callback = mutedCallbacks[type] else { continue }
+            var data = callback.0
+            data.withUnsafeMutableBytes { (ptr) -> Void in
+                handleCallback(type: type, dataPtr: ptr.baseAddress, dataSize: Int32(ptr.count), ts: callback.1, flag: callback.2)
+            }
+        }
+        mutedCallbacks.removeAll()
+        for i in 0..<count {
+            handlePacket(packet: packets[i]!)
+        }
+    }
+
+    private func stopRecording() {
+        if let recorder = self.recorder {
+            var stats = fmp4_recorder_stats_t()
+            fmp4_recorder_get_stats(recorder, &stats)
+            fmp4_recorder_destroy(recorder)
+            self.recorder = nil
+            print(">> FLV RECORDED \(stats.files) FILES \(stats.fragments) FRAGMENTS \(stats.bytes) BYTES, \(stats.write_errors) WRITE ERRORS")
+        }
     }
     
     fileprivate func handleCallback(type:Int32, dataPtr: UnsafeMutableRawPointer?, dataSize:Int32, ts:[Int64], flag:UInt32) {
+        /*
+         called in the middle of a feed, the packets queued so far go first
+         */
+        drainPackets()
+        if let recorder = self.recorder, type == VOODOO_DATA_TYPE_MEDIA_FLAG {
+            fmp4_recorder_set_media_flag(recorder, flag)
+        }
+        if muted {
+            if type == VOODOO_DATA_TYPE_MEDIA_FLAG || type == VOODOO_DATA_TYPE_METADATA {
+                let data = dataPtr != nil && dataSize > 0 ? Data(bytes: dataPtr!, count: Int(dataSize)) : Data()
+                mutedCallbacks[type] = (data, ts, flag)
+            }
+            return
+        }
+        if let queue = self.packetQueue {
+            /*
+             a packet as well, so it stays in order with the packets around it
+             */
+            if let packet = packet_pool_alloc(self.packetPool, UInt32(max(dataSize, 0))) {
+                packet.pointee.type = type
+                packet.pointee.flag = flag
+                packet.pointee.pts = ts[0]
+                packet.pointee.dts = ts[1]
+                if let dataPtr = dataPtr, dataSize > 0 {
+                    memcpy(packet.pointee.data, dataPtr, Int(dataSize))
+                }
+                queue.push(packet)
+            }
+            return
+        }
         var data: Data?
         if dataPtr != nil {
             data = Data(bytesNoCopy: dataPtr!, count: Int(dataSize), deallocator: .none)
@@ -60,6 +218,27 @@ class LiveFLVDemuxer : LiveDemuxer {
         
     }
     
+    private func handlePacket(packet:UnsafeMutablePointer<demuxer_packet_t>) {
+        if let queue = self.packetQueue {
+            queue.push(packet)
+            return
+        }
+        /*
+         the Data takes over the reference from read_packets,
+         so downstream can keep it without copying
+         */
+        let data = Data(bytesNoCopy: UnsafeMutableRawPointer(packet.pointee.data), count: Int(packet.pointee.size), deallocator: .custom({ _, _ in
+            demuxer_packet_release(packet)
+        }))
+        let ts:[Int64] = [packet.pointee.pts, packet.pointee.dts]
+        
+        if let dataType = LivePipelineDataType(rawValue: Int(packet.pointee.type)) {
+            delegate?.handle(demuxerData: data, withType: dataType, ts: ts, flag: packet.pointee.flag)
+        } else {
+            print("UNKNOWN FLV DATA TYPE VALUE: \(packet.pointee.type)")
+        }
+    }
+    
     override func feed(data:Data) {
         let dataLength = data.count
         data.withUnsafeBytes { (ptr) -> Void in
@@ -67,5 +246,30 @@ class LiveFLVDemuxer : LiveDemuxer {
                 flv_demuxer_feed(self.flvDemuxerContext, dataPtr, Int32(dataLength))
             }
         }
+        drainPackets()
+    }
+    
+    private func drainPackets() {
+        while true {
+            let count = Int(flv_demuxer_read_packets(self.flvDemuxerContext, packetBatch, Int32(LiveFLVDemuxer.packetBatchSize)))
+            if count == 0 { break }
+            for i in 0..<count {
+                let packet = packetBatch[i]!
+                if let recorder = self.recorder {
+                    /*
+                     the recorder keeps its own reference, the bytes are written from this very packet
+                     */
+                    fmp4_recorder_push(recorder, packet)
+                }
+                if muted {
+                    /*
+                     the gop cache has its own reference
+                     */
+                    demuxer_packet_release(packet)
+                    continue
+                }
+                handlePacket(packet: packet)
+            }
+        }
     }
 }
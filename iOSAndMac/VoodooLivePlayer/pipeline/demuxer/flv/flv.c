@@ -8,9 +8,20 @@
 
 #include "flv.h"
 #include "pt.h"
-#include <stdio.h>
+#include "packet_pool.h"
+#include "gop_cache.h"
+#include "amf0.h"
+#include "video_sps.h"
+#include "nal_format.h"
+#include "demuxer_trace.h"
+#include <inttypes.h>
 #include <string.h>
 #include <stdlib.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #define VOODOO_READ_STATE_INIT       0
 #define VOODOO_READ_STATE_PROBE      1
@@ -19,9 +30,24 @@
 #define VOODOO_READ_STATE_NEW_TAG    4
 #define VOODOO_READ_STATE_TAG_HEADER 5
 #define VOODOO_READ_STATE_TAG_BODY   6
+#define VOODOO_READ_STATE_RESYNC     7
 
 #define VOODOO_STREAM_CACHE_SIZE    (8*1024*1024)
+#define VOODOO_STREAM_INITIAL_CACHE_SIZE    (64*1024)
 #define VOODOO_STREAM_PADDING_SIZE  (128)
+#define VOODOO_INDEX_INITIAL_SIZE   (256)
+#define VOODOO_FLV_TAG_HEADER_SIZE  (11)
+#define VOODOO_FLV_VIDEO_HEADER_MAX_SIZE  (8)
+#define VOODOO_FLV_PREV_TAG_SIZE    (4)
+#define VOODOO_FLV_MAX_HEADER_SKIP  (1024)
+#define VOODOO_FLV_RESYNC_WINDOW    (64)
+/*
+ resync时不在buffer里的tag要等body，先看大小：64 KB以内直接等，
+ 2 MB以内要时间戳离上一个好的tag不超过30秒，再大的不等
+ */
+#define VOODOO_FLV_RESYNC_TRUST_SIZE    (64*1024)
+#define VOODOO_FLV_RESYNC_MAX_TAG_SIZE  (2*1024*1024)
+#define VOODOO_FLV_RESYNC_MAX_TS_JUMP   (30*1000)
 
 
 typedef struct flv_demuxer_context_s {
@@ -34,6 +60,15 @@ typedef struct flv_demuxer_context_s {
     
     int read_state;
     pts_t stream;
+    uint8_t *cache;
+    uint32_t cache_size;
+    uint32_t cache_high_water;
+    demuxer_config_t config;
+
+    /*
+     counters, event ring and log callback, nothing goes to stdio
+     */
+    demuxer_trace_t trace;
     
     /*
      video and audio config
@@ -74,41 +109,275 @@ typedef struct flv_demuxer_context_s {
     
     int64_t first_dts;
     int skip_frames;
+
+    /*
+     VOODOO_DROP_*，升级马上生效，降级等到下一个关键帧，
+     drop_request可以从其它线程设置
+     */
+    int drop_level;
+    int drop_request;
+    int max_temporal_id;
+
+    /*
+     framing errors scan forward to the next plausible tag instead of stopping
+     */
+    int resync_enabled;
+    int resync_pending;
+    uint32_t resync_skipped;
+    int resync_ts_valid;
+    uint32_t resync_ts;         /*  timestamp of the last tag whose PreTagSize matched */
+    int resync_codec[2];        /*  voodoo_tag_codec of the last audio and video tag, -1 before one */
+
     int seek_to_next_i_frame;
     
     uint64_t frame_count;
+
+    /*
+     chunked mode, tag body is delivered in fragments
+     */
+    int chunked_mode;
+    int frag_type;
+    uint32_t frag_flag;
+    uint32_t frag_header;
+    uint32_t frag_left;
+    uint32_t frag_offset;
+    demuxer_packet_t *frag_packet;
+
+    /*
+     packets are copied into pooled ref-counted buffers when set
+     */
+    packet_pool_t *packet_pool;
+    fn_demuxer_packet_callback_t packet_callback;
+    /*
+     every pooled packet is also pushed here when set
+     */
+    gop_cache_t *gop_cache;
+    /*
+     without packet_callback, packets wait here for flv_demuxer_read_packets
+     */
+    demuxer_packet_t *queue_head;
+    demuxer_packet_t *queue_tail;
+    uint32_t queue_count;
+
+    /*
+     keyframe index, sorted by dts
+     */
+    int header_parsed;
+    int index_enabled;
+    flv_index_entry_t *index;
+    uint32_t index_count;
+    uint32_t index_capacity;
+
+    flv_metadata_t metadata;
+
+    /*
+     decoded from the sequence header, video_width/height/frame_format follow it
+     */
+    int video_info_parsed;
+    video_sps_info_t video_info;
+
+    /*
+     VOODOO_NAL_FORMAT_*，参数集是最近一个sequence header转成的annex-b，
+     没有packet pool时转换结果放在nal_scratch里回调
+     */
+    int nal_format;
+    int sei_enabled;
+    /*
+     有pool时sei先拷成packet挂在这里，视频packet发出后再依次发出
+     */
+    demuxer_packet_t *sei_head;
+    demuxer_packet_t *sei_tail;
+    int nal_codec_id;
+    int nal_length_size;
+    int frame_codec_id;
+    uint8_t *nal_parameters;
+    uint32_t nal_parameters_size;
+    uint32_t nal_parameters_capacity;
+    uint8_t *nal_scratch;
+    uint32_t nal_scratch_capacity;
 } flv_demuxer_context_t;
 
 void* flv_demuxer_init(void* userdata, fn_demuxer_callback_t callback) {
-    flv_demuxer_context_t* ctx = (flv_demuxer_context_t*)malloc(sizeof(flv_demuxer_context_t) + VOODOO_STREAM_CACHE_SIZE + VOODOO_STREAM_PADDING_SIZE);
+    demuxer_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.initial_cache_size = VOODOO_STREAM_CACHE_SIZE;
+    return flv_demuxer_init_with_config(userdata, callback, &config);
+}
+
+void* flv_demuxer_init_with_config(void* userdata, fn_demuxer_callback_t callback, const demuxer_config_t* config) {
+    demuxer_config_t cfg;
+    if(config) {
+        cfg = *config;
+    } else {
+        memset(&cfg, 0, sizeof(cfg));
+    }
+    demuxer_select_allocator(&cfg, &cfg.malloc_fn, &cfg.free_fn, &cfg.allocator_opaque);
+    if(cfg.max_cache_size == 0) cfg.max_cache_size = VOODOO_STREAM_CACHE_SIZE;
+    if(cfg.initial_cache_size == 0) cfg.initial_cache_size = VOODOO_STREAM_INITIAL_CACHE_SIZE;
+    if(cfg.initial_cache_size > cfg.max_cache_size) cfg.initial_cache_size = cfg.max_cache_size;
+    if(cfg.cache_growth_step == 0) cfg.cache_growth_step = VOODOO_STREAM_INITIAL_CACHE_SIZE;
+
+    flv_demuxer_context_t* ctx = (flv_demuxer_context_t*)cfg.malloc_fn(cfg.allocator_opaque, sizeof(flv_demuxer_context_t));
+    if(!ctx) {
+        return NULL;
+    }
     
     memset(ctx, 0, sizeof(flv_demuxer_context_t));
+    ctx->config = cfg;
+
+    ctx->cache = (uint8_t*)cfg.malloc_fn(cfg.allocator_opaque, cfg.initial_cache_size + VOODOO_STREAM_PADDING_SIZE);
+    if(!ctx->cache) {
+        cfg.free_fn(cfg.allocator_opaque, ctx);
+        return NULL;
+    }
+    ctx->cache_size = cfg.initial_cache_size;
     
     ctx->userdata = userdata;
     ctx->callback = callback;
     
     ctx->dts = ctx->pts = ctx->first_dts = VOODOO_NOPTS_VALUE;
+    ctx->resync_codec[0] = ctx->resync_codec[1] = -1;
     
-    ctx->stream.buf = (uint8_t*)(ctx+1);
-    ctx->stream.pos = ctx->stream.size = 0;
+    ctx->stream.buf = ctx->cache;
+    ctx->stream.pos = ctx->stream.size = ctx->stream.want = 0;
 
     PT_INIT(&ctx->ptc, ctx);
     ctx->is_running = 1;
     ctx->read_state = VOODOO_READ_STATE_INIT;
+    demuxer_trace_init(&ctx->trace);
 
-    printf("FLV DEMUXER INITED!\n");
-    
     return (void*)ctx;
 }
 
+/*
+ 还没被read_packets取走的包
+ */
+static void voodoo_release_queue(flv_demuxer_context_t *state) {
+    while(state->queue_head) {
+        demuxer_packet_t *packet = state->queue_head;
+        state->queue_head = packet->next;
+        demuxer_packet_release(packet);
+    }
+    state->queue_tail = NULL;
+    state->queue_count = 0;
+}
+
 void flv_demuxer_fint(void* ctx) {
     flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    demuxer_config_t cfg = demuxer_ctx->config;
     demuxer_ctx->is_running = 0;
     demuxer_ctx->stream.buf = NULL;
     demuxer_ctx->stream.pos = demuxer_ctx->stream.size = 0;
     demuxer_ctx->userdata = NULL;
-    free(ctx);
-    printf("FLV DEMUXER FINTED!\n");
+    if(demuxer_ctx->frag_packet) {
+        demuxer_packet_release(demuxer_ctx->frag_packet);
+        demuxer_ctx->frag_packet = NULL;
+    }
+    voodoo_release_queue(demuxer_ctx);
+    if(demuxer_ctx->index) {
+        cfg.free_fn(cfg.allocator_opaque, demuxer_ctx->index);
+    }
+    if(demuxer_ctx->nal_parameters) {
+        cfg.free_fn(cfg.allocator_opaque, demuxer_ctx->nal_parameters);
+    }
+    if(demuxer_ctx->nal_scratch) {
+        cfg.free_fn(cfg.allocator_opaque, demuxer_ctx->nal_scratch);
+    }
+    cfg.free_fn(cfg.allocator_opaque, demuxer_ctx->cache);
+    cfg.free_fn(cfg.allocator_opaque, ctx);
+}
+
+uint32_t flv_demuxer_cache_size(void* ctx) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    return demuxer_ctx->cache_size;
+}
+
+uint32_t flv_demuxer_cache_high_water(void* ctx) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    return demuxer_ctx->cache_high_water;
+}
+
+uint64_t flv_demuxer_cache_bytes_moved(void* ctx) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    return demuxer_ctx->trace.stats.bytes_moved;
+}
+
+void flv_demuxer_get_stats(void* ctx, demuxer_stats_t* stats) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    demuxer_trace_get_stats(&demuxer_ctx->trace, stats);
+}
+
+int flv_demuxer_read_events(void* ctx, demuxer_event_t* events, int max) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    return demuxer_trace_read_events(&demuxer_ctx->trace, events, max);
+}
+
+void flv_demuxer_set_log_callback(void* ctx, fn_demuxer_log_callback_t callback, void* opaque, int level) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    demuxer_trace_set_log_callback(&demuxer_ctx->trace, callback, opaque, level);
+}
+
+/*
+ 记录一个事件，有log回调时同时输出
+ */
+static void voodoo_trace_event(flv_demuxer_context_t *state, int type, int level, uint32_t value, const char *message) {
+    demuxer_trace_event(&state->trace, type, level, state->dts, (uint64_t)state->tag_pos, value);
+    DEMUXER_LOG(&state->trace, level, "flv: %s (%u) dts %" PRId64 " @ %" PRId64, message, value, state->dts, state->tag_pos);
+}
+
+static void voodoo_count_tag(flv_demuxer_context_t *state) {
+    switch(state->tag_type) {
+        case 8: DEMUXER_STAT_ADD(&state->trace, audio_tags, 1); break;
+        case 9: DEMUXER_STAT_ADD(&state->trace, video_tags, 1); break;
+        case 18: DEMUXER_STAT_ADD(&state->trace, script_tags, 1); break;
+        default: DEMUXER_STAT_ADD(&state->trace, other_tags, 1); break;
+    }
+}
+
+static void voodoo_tag_failed(flv_demuxer_context_t *state) {
+    DEMUXER_STAT_ADD(&state->trace, malformed_tags, 1);
+    voodoo_trace_event(state, VOODOO_EVENT_TAG_FAILED, VOODOO_LOG_WARN, state->tag_type, state->tag_type == 8 ? "parse audio data failed" : "parse video data failed");
+}
+
+/*
+ 保证cache至少有size字节，按配置的策略扩容，
+ keep指向的keep_len字节会保留到新cache的开头。
+ 返回1表示cache重新分配过，0表示不需要扩容。
+ */
+static int flv_demuxer_reserve_cache(flv_demuxer_context_t *state, uint32_t size, const uint8_t *keep, uint32_t keep_len) {
+    if(size > state->cache_high_water) {
+        state->cache_high_water = size;
+    }
+    if(size <= state->cache_size) {
+        return 0;
+    }
+    if(size > state->config.max_cache_size) {
+        voodoo_trace_event(state, VOODOO_EVENT_CACHE_LIMIT, VOODOO_LOG_ERROR, size, "stream cache limit reached");
+        return -1;
+    }
+    uint64_t new_size = state->cache_size;
+    while(new_size < size) {
+        if(state->config.cache_growth == VOODOO_CACHE_GROWTH_LINEAR) {
+            new_size += state->config.cache_growth_step;
+        } else {
+            new_size = new_size > 0 ? new_size * 2 : VOODOO_STREAM_INITIAL_CACHE_SIZE;
+        }
+    }
+    new_size = VPMIN(new_size, (uint64_t)state->config.max_cache_size);
+
+    uint8_t *cache = (uint8_t*)state->config.malloc_fn(state->config.allocator_opaque, (size_t)new_size + VOODOO_STREAM_PADDING_SIZE);
+    if(!cache) {
+        voodoo_trace_event(state, VOODOO_EVENT_ALLOC_FAILED, VOODOO_LOG_ERROR, (uint32_t)new_size, "stream cache alloc failed");
+        return -1;
+    }
+    if(keep_len > 0) {
+        memcpy(cache, keep, keep_len);
+        DEMUXER_STAT_ADD(&state->trace, bytes_moved, keep_len);
+    }
+    state->config.free_fn(state->config.allocator_opaque, state->cache);
+    state->cache = cache;
+    state->cache_size = (uint32_t)new_size;
+    return 1;
 }
 
 void flv_demuxer_seek_to_next_i_frame(void* ctx) {
@@ -121,159 +390,655 @@ void flv_demuxer_set_skip_frames(void* ctx, int skip) {
     demuxer_ctx->skip_frames = skip;
 }
 
+void flv_demuxer_set_drop_level(void* ctx, int level) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    level = VPMAX(VOODOO_DROP_NONE, VPMIN(level, VOODOO_DROP_TO_KEYFRAMES));
+    __atomic_store_n(&demuxer_ctx->drop_request, level, __ATOMIC_RELAXED);
+}
+
+int flv_demuxer_drop_level(void* ctx) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    return __atomic_load_n(&demuxer_ctx->drop_level, __ATOMIC_RELAXED);
+}
+
+void flv_demuxer_set_nal_format(void* ctx, int format) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    demuxer_ctx->nal_format = format;
+}
+
+void flv_demuxer_set_sei_extraction(void* ctx, int enable) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    demuxer_ctx->sei_enabled = enable;
+}
+
+void flv_demuxer_set_resync(void* ctx, int enable) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    demuxer_ctx->resync_enabled = enable;
+}
+
+void flv_demuxer_set_chunked_mode(void* ctx, int enable) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    demuxer_ctx->chunked_mode = enable;
+}
+
+void flv_demuxer_set_packet_pool(void* ctx, packet_pool_t* pool, fn_demuxer_packet_callback_t callback) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    demuxer_ctx->packet_pool = pool;
+    demuxer_ctx->packet_callback = callback;
+}
+
+void flv_demuxer_set_gop_cache(void* ctx, gop_cache_t* cache) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    demuxer_ctx->gop_cache = cache;
+}
+
+int flv_demuxer_read_packets(void* ctx, demuxer_packet_t** packets, int max) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    int count = 0;
+    while(count < max && demuxer_ctx->queue_head) {
+        demuxer_packet_t *packet = demuxer_ctx->queue_head;
+        demuxer_ctx->queue_head = packet->next;
+        packet->next = NULL;
+        packets[count++] = packet;
+    }
+    if(!demuxer_ctx->queue_head) {
+        demuxer_ctx->queue_tail = NULL;
+    }
+    demuxer_ctx->queue_count -= (uint32_t)count;
+    return count;
+}
+
+void flv_demuxer_enable_index(void* ctx, int enable) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    demuxer_ctx->index_enabled = enable;
+}
+
+int flv_demuxer_get_index(void* ctx, const flv_index_entry_t** entries) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    *entries = demuxer_ctx->index;
+    return (int)demuxer_ctx->index_count;
+}
+
+/*
+ 按dts插入，已有相同dts的entry直接覆盖
+ */
+static void voodoo_index_add(flv_demuxer_context_t *state, int64_t dts, int64_t pos) {
+    if(dts == VOODOO_NOPTS_VALUE || pos < 0) {
+        return;
+    }
+    uint32_t lo = 0, hi = state->index_count;
+    if(hi > 0 && state->index[hi-1].dts < dts) {
+        lo = hi;
+    } else {
+        while(lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if(state->index[mid].dts < dts) lo = mid + 1; else hi = mid;
+        }
+        if(lo < state->index_count && state->index[lo].dts == dts) {
+            state->index[lo].pos = pos;
+            return;
+        }
+    }
+    if(state->index_count == state->index_capacity) {
+        uint32_t capacity = state->index_capacity > 0 ? state->index_capacity * 2 : VOODOO_INDEX_INITIAL_SIZE;
+        flv_index_entry_t *index = (flv_index_entry_t*)state->config.malloc_fn(state->config.allocator_opaque, capacity * sizeof(flv_index_entry_t));
+        if(!index) {
+            return;
+        }
+        if(state->index) {
+            memcpy(index, state->index, state->index_count * sizeof(flv_index_entry_t));
+            state->config.free_fn(state->config.allocator_opaque, state->index);
+        }
+        state->index = index;
+        state->index_capacity = capacity;
+    }
+    memmove(state->index + lo + 1, state->index + lo, (state->index_count - lo) * sizeof(flv_index_entry_t));
+    state->index[lo].dts = dts;
+    state->index[lo].pos = pos;
+    ++state->index_count;
+}
+
+int64_t flv_demuxer_seek(void* ctx, int64_t ts) {
+    flv_demuxer_context_t* state = (flv_demuxer_context_t*)ctx;
+    if(state->index_count == 0 || !state->header_parsed) {
+        return -1;
+    }
+    /*
+     找到最后一个dts <= ts的关键帧，ts比第一个还小就从第一个开始
+     */
+    uint32_t lo = 0, hi = state->index_count;
+    while(lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if(state->index[mid].dts <= ts) lo = mid + 1; else hi = mid;
+    }
+    const flv_index_entry_t *entry = &state->index[lo > 0 ? lo - 1 : 0];
+
+    /*
+     丢弃缓存的数据和还没取走的包，解析器从下一个tag头开始
+     */
+    if(state->frag_packet) {
+        demuxer_packet_release(state->frag_packet);
+        state->frag_packet = NULL;
+    }
+    voodoo_release_queue(state);
+    state->frag_left = 0;
+    state->resync_pending = 0;
+    state->resync_skipped = 0;
+    state->resync_ts_valid = 0;
+    state->stream.buf = state->cache;
+    state->stream.pos = state->stream.size = state->stream.want = 0;
+    state->stream_start = state->stream_end = entry->pos;
+    state->dts = state->pts = VOODOO_NOPTS_VALUE;
+    state->seek_to_next_i_frame = 0;
+    state->is_running = 1;
+    PT_INIT(&state->ptc, state);
+    return entry->pos;
+}
+
+const flv_metadata_t* flv_demuxer_get_metadata(void* ctx) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    return demuxer_ctx->metadata.parsed ? &demuxer_ctx->metadata : NULL;
+}
+
+const video_sps_info_t* flv_demuxer_get_video_info(void* ctx) {
+    flv_demuxer_context_t* demuxer_ctx = (flv_demuxer_context_t*)ctx;
+    return demuxer_ctx->video_info_parsed ? &demuxer_ctx->video_info : NULL;
+}
+
+const flv_metadata_entry_t* flv_metadata_find(const flv_metadata_t* metadata, const char* key) {
+    for(uint32_t i = 0;i < metadata->entry_count;++i) {
+        if(strcmp(metadata->entries[i].key, key) == 0) {
+            return &metadata->entries[i];
+        }
+    }
+    return NULL;
+}
+
 static int flv_demux_parse_stream(ptc_t* ptc);
+static int voodoo_feed_stream(flv_demuxer_context_t *state, const uint8_t *ptr, uint32_t left);
 
+/*
+ * 输入数据优先直接在调用方的buffer上解析（零拷贝），
+ * 只有跨越两次feed的tag尾部才会拷贝进stream cache。
+ * 调用返回后demuxer不再引用data，调用方可以立即释放或复用。
+ */
 int flv_demuxer_feed(void* ctx, const void* data, int len) {
     flv_demuxer_context_t *state = (flv_demuxer_context_t*)ctx;
     if(!state->is_running) {
-        fprintf(stderr, "FLV DEMUXER IS ABORTED.\n");
+        DEMUXER_LOG(&state->trace, VOODOO_LOG_DEBUG, "flv: feed after the demuxer stopped");
         return -1;
     }
-    /*
-    ++_voodoo_decode_times;
-    if((_voodoo_decode_times % 100) == 0 &&
-       _voodoo_check_timeout() < 0) {
-        printf("VOODOO IS ABORTED.\n");
-        return -1;
-    }
-     */
     
-    //printf("VOODOO DECODE: (%u)[%u]\n", data, len);
+    int ret;
+    uint64_t feed_start = demuxer_trace_now_ns();
+
+    DEMUXER_STAT_ADD(&state->trace, bytes_fed, (uint32_t)len);
+    DEMUXER_STAT_ADD(&state->trace, feeds, 1);
+    ret = voodoo_feed_stream(state, (const uint8_t *)data, (uint32_t)len);
+    DEMUXER_STAT_MAX(&state->trace, max_feed_ns, demuxer_trace_now_ns() - feed_start);
+    return ret;
+}
 
+static int voodoo_feed_stream(flv_demuxer_context_t *state, const uint8_t *ptr, uint32_t left) {
     int ret;
     pts_t *stream = &state->stream;
-    uint32_t cache_space, copy_len;
+    uint32_t copy_len, tail_len;
 
-    for(;;) {
-        cache_space = VOODOO_STREAM_CACHE_SIZE - stream->size;
-        if(cache_space == 0) {
-            fprintf(stderr, "VOODOO STREAM CACHE SIZE[%u] IS TOO SAMLL FOR DECODING...\n", (uint32_t)VOODOO_STREAM_CACHE_SIZE);
-            return -1;
+    while(left > 0) {
+        copy_len = 0;
+        if(stream->pos < stream->size) {
+            /*
+             cache里有上次剩下的半个tag，只补齐解析器需要的字节数
+             */
+            if(flv_demuxer_reserve_cache(state, stream->want, stream->buf, stream->size) < 0) {
+                state->is_running = 0;
+                return -1;
+            }
+            stream->buf = state->cache;
+            copy_len = VPMIN(stream->want - stream->size, left);
+            memcpy(stream->buf + stream->size, ptr, copy_len);
+            DEMUXER_STAT_ADD(&state->trace, bytes_moved, copy_len);
+            stream->size += copy_len;
+            state->stream_end += copy_len;
+            ptr += copy_len;
+            left -= copy_len;
+            if(stream->size < stream->want) {
+                break;
+            }
+            memset(stream->buf + stream->size, 0, VOODOO_STREAM_PADDING_SIZE);
+        } else {
+            /*
+             cache已经消耗完，直接在调用方的数据上解析
+             */
+            stream->buf = (uint8_t*)ptr;
+            stream->size = left;
+            stream->pos = 0;
+            state->stream_start = state->stream_end;
+            state->stream_end += left;
+            ptr += left;
+            left = 0;
         }
 
-        copy_len = VPMIN(cache_space, (uint32_t)len);
-        memcpy(stream->buf + stream->size, data, copy_len);
-
-        stream->size += copy_len;
-        state->stream_end += copy_len;
-
-        memset(stream->buf + stream->size, 0, VOODOO_STREAM_PADDING_SIZE);
-
         ret = flv_demux_parse_stream(&state->ptc);
 
         if(ret == PTR_ERROR) {
             state->is_running = 0;
+            demuxer_trace_event(&state->trace, VOODOO_EVENT_PARSE_ERROR, VOODOO_LOG_ERROR, state->dts, (uint64_t)state->stream_start + stream->pos, (uint32_t)state->ptc.error_line);
+            DEMUXER_LOG(&state->trace, VOODOO_LOG_ERROR, "flv: %s @ %s[%d]", state->ptc.error_msg, state->ptc.error_file, state->ptc.error_line);
             return -1;
         } else if(ret == PTR_FINISHED) {
-            printf("VOODOO FINISHED!\n");
+            DEMUXER_LOG(&state->trace, VOODOO_LOG_INFO, "flv: finished");
             state->is_running = 0;
             return 0;
-        } else if(stream->pos == 0 && len > copy_len) {
-            fprintf(stderr, "VOODOO STREAM CACHE SIZE[%u] IS TOO SMALL\n", (uint32_t) VOODOO_STREAM_CACHE_SIZE);
-            state->is_running = 0;
-            return -1;
         }
         /*
-         * 有消耗的数据，直接移出stream。
+         * 有消耗的数据，直接移出stream，未消耗的尾部保存到cache。
          */
-        if(stream->pos > 0) {
-            if(stream->pos < stream->size) {
-                stream->size -= stream->pos;
-                memmove(stream->buf, stream->buf + stream->pos, stream->size);
-                state->stream_start += stream->pos;
-                stream->pos = 0;
-            } else {
-                state->stream_start = state->stream_end;
-                stream->size = stream->pos = 0;
+        tail_len = stream->size - stream->pos;
+        if(stream->buf == state->cache && tail_len > 0 && tail_len <= copy_len) {
+            /*
+             剩下的字节都是这次从调用方拷进来的，退回去直接在调用方的buffer上继续，
+             resync扫描垃圾数据时不会被一段段拷进cache
+             */
+            ptr -= tail_len;
+            left += tail_len;
+            state->stream_end -= tail_len;
+            stream->size = stream->pos;
+            tail_len = 0;
+        }
+        if(stream->buf == state->cache) {
+            ret = flv_demuxer_reserve_cache(state, tail_len, stream->buf + stream->pos, tail_len);
+            if(ret < 0) {
+                state->is_running = 0;
+                return -1;
+            }
+            if(ret == 0 && tail_len > 0 && stream->pos > 0) {
+                memmove(state->cache, stream->buf + stream->pos, tail_len);
+                DEMUXER_STAT_ADD(&state->trace, bytes_moved, tail_len);
+            }
+        } else if(tail_len > 0) {
+            if(flv_demuxer_reserve_cache(state, tail_len, NULL, 0) < 0) {
+                state->is_running = 0;
+                return -1;
             }
+            memcpy(state->cache, stream->buf + stream->pos, tail_len);
+            DEMUXER_STAT_ADD(&state->trace, bytes_moved, tail_len);
         }
+        state->stream_start += stream->pos;
+        stream->want -= stream->pos;
+        stream->buf = state->cache;
+        stream->size = tail_len;
+        stream->pos = 0;
+    }
+    return 0;
+}
 
-        len -= copy_len;
-        if(len == 0) {
-            break;
+static int voodoo_parse_tag_header(flv_demuxer_context_t *state, uint32_t *flag);
+static int voodoo_parse_tag(flv_demuxer_context_t *state);
+static void voodoo_emit_data(flv_demuxer_context_t *state, int type, const uint8_t *data, uint32_t size, uint32_t flag);
+static void voodoo_parse_script_tag(flv_demuxer_context_t *state);
+static void voodoo_begin_fragments(flv_demuxer_context_t *state);
+static void voodoo_emit_fragment(flv_demuxer_context_t *state, const uint8_t *data, uint32_t size);
+
+int flv_demuxer_feed_tag(void* ctx, int tag_type, uint32_t timestamp, const void* data, uint32_t size) {
+    flv_demuxer_context_t *state = (flv_demuxer_context_t*)ctx;
+    if(tag_type != 8 && tag_type != 9 && tag_type != 18) {
+        return 0;
+    }
+    /*
+     借用stream指向调用方的数据，解析完恢复
+     */
+    pts_t saved = state->stream;
+    state->stream.buf = (uint8_t*)data;
+    state->stream.size = size;
+    state->stream.pos = 0;
+    state->tag_type = (uint8_t)tag_type;
+    state->tag_size = size;
+    state->tag_start = 0;
+    state->tag_pos = state->stream_start + VOODOO_FLV_TAG_HEADER_SIZE;
+    state->dts = state->pts = timestamp;
+    state->frag_header = tag_type == 8 ? 2 : 5;
+    voodoo_count_tag(state);
+    int ret = 0;
+    if(tag_type == 18) {
+        voodoo_parse_script_tag(state);
+    } else if(voodoo_parse_tag(state) < 0) {
+        voodoo_tag_failed(state);
+        ret = -1;
+    }
+    state->stream = saved;
+    return ret;
+}
+
+static void voodoo_begin_resync(flv_demuxer_context_t *state, uint32_t value) {
+    state->resync_pending = 1;
+    state->resync_skipped = 0;
+    DEMUXER_STAT_ADD(&state->trace, resyncs, 1);
+    DEMUXER_STAT_ADD(&state->trace, malformed_tags, 1);
+    demuxer_trace_event(&state->trace, VOODOO_EVENT_RESYNC, VOODOO_LOG_WARN, state->dts, (uint64_t)state->stream_start + state->stream.pos, value);
+    DEMUXER_LOG(&state->trace, VOODOO_LOG_WARN, "flv: framing lost (%u) in state %d, resyncing", value, state->read_state);
+}
+
+static void voodoo_resync_skip(flv_demuxer_context_t *state, uint32_t len) {
+    state->resync_skipped += len;
+    DEMUXER_STAT_ADD(&state->trace, resync_bytes_skipped, len);
+}
+
+/*
+ tag头候选：类型是8/9/18并且stream id三个字节都是0。
+ 返回第一个候选的偏移，没有候选时返回最后不足一个tag头的位置。
+ 一次比较16个字节，随机数据里候选的概率大约是3/256 * 2^-24。
+ */
+static uint32_t voodoo_scan_tag_header(const uint8_t *p, uint32_t len) {
+    uint32_t i = 0, end;
+    if(len < VOODOO_FLV_TAG_HEADER_SIZE) {
+        return 0;
+    }
+    end = len - VOODOO_FLV_TAG_HEADER_SIZE + 1;
+#if defined(__SSE2__)
+    const __m128i v8 = _mm_set1_epi8(8), v9 = _mm_set1_epi8(9), v18 = _mm_set1_epi8(18), zero = _mm_setzero_si128();
+    for(;i + 16 <= end;i += 16) {
+        __m128i type = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i id = _mm_or_si128(_mm_or_si128(_mm_loadu_si128((const __m128i*)(p + i + 8)),
+                                               _mm_loadu_si128((const __m128i*)(p + i + 9))),
+                                  _mm_loadu_si128((const __m128i*)(p + i + 10)));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(type, v8), _mm_cmpeq_epi8(type, v9)), _mm_cmpeq_epi8(type, v18));
+        int mask = _mm_movemask_epi8(_mm_and_si128(hit, _mm_cmpeq_epi8(id, zero)));
+        if(mask) {
+            return i + (uint32_t)__builtin_ctz((unsigned)mask);
         }
-        data += copy_len;
     }
-    return 0;
+#elif defined(__ARM_NEON)
+    const uint8x16_t v8 = vdupq_n_u8(8), v9 = vdupq_n_u8(9), v18 = vdupq_n_u8(18), zero = vdupq_n_u8(0);
+    for(;i + 16 <= end;i += 16) {
+        uint8x16_t type = vld1q_u8(p + i);
+        uint8x16_t id = vorrq_u8(vorrq_u8(vld1q_u8(p + i + 8), vld1q_u8(p + i + 9)), vld1q_u8(p + i + 10));
+        uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(type, v8), vceqq_u8(type, v9)), vceqq_u8(type, v18));
+        hit = vandq_u8(hit, vceqq_u8(id, zero));
+        /*
+         neon没有movemask，窄化成每字节4位的64位掩码
+         */
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+        if(mask) {
+            return i + (uint32_t)(__builtin_ctzll(mask) >> 2);
+        }
+    }
+#endif
+    for(;i < end;++i) {
+        if((p[i] == 8 || p[i] == 9 || p[i] == 18) && (p[i + 8] | p[i + 9] | p[i + 10]) == 0) {
+            return i;
+        }
+    }
+    return end;
+}
+
+static void voodoo_check_stream_id(flv_demuxer_context_t *state, uint32_t stream_id) {
+    if(stream_id != 0) {
+        voodoo_trace_event(state, VOODOO_EVENT_STREAM_ID, VOODOO_LOG_WARN, stream_id, "stream id is not zero");
+    }
+}
+
+static int voodoo_check_prev_tag_size(flv_demuxer_context_t *state, uint32_t prev_tag_size) {
+    if(prev_tag_size != VOODOO_FLV_TAG_HEADER_SIZE + state->tag_size) {
+        DEMUXER_STAT_ADD(&state->trace, malformed_tags, 1);
+        voodoo_trace_event(state, VOODOO_EVENT_PREV_TAG_SIZE, VOODOO_LOG_WARN, prev_tag_size, "invalid prev tag size");
+        return -1;
+    }
+    state->resync_ts = (uint32_t)state->dts;
+    state->resync_ts_valid = 1;
     return 0;
 }
 
-static void voodoo_show_hex(const char* title, const uint8_t *buf, uint32_t len) {
-    printf("(%s) {", title);
-    for(uint32_t u = 0;u < len; ++u) {
-        if((u % 64 == 0)) {
-           printf("\n");
-        }
-        printf("%02x ", buf[u]);
+/*
+ body第一个字节里的编码：音频是sound format，视频是codec id，enhanced的视频只看ExHeader位
+ */
+static int voodoo_tag_codec(uint8_t tag_type, uint8_t b) {
+    if(tag_type == 8) {
+        return b >> 4;
     }
-    printf("\n}\n");
+    return (b & 0x80) ? 0x80 : (b & 0x0f);
 }
 
-static int voodoo_parse_audio_tag(flv_demuxer_context_t *state);
-static int voodoo_parse_video_tag(flv_demuxer_context_t *state);
+/*
+ resync时判断h处的tag头能不能信，h后面至少有一个tag头和body的第一个字节。
+ 整个tag和PreTagSize已经在buffer里的交给PreTagSize去判断；
+ 否则要等body，大小、时间戳和编码不像的不等，乱数据不会把cache撑到几MB
+ */
+static int voodoo_plausible_tag(flv_demuxer_context_t *state, const uint8_t *h, uint32_t available) {
+    uint8_t tag_type = h[0] & 0x1f;
+    uint32_t tag_size = PS_RB24(h + 1);
+    uint32_t ts = PS_RB24(h + 4) | ((uint32_t)h[7] << 24);
+    int32_t jump = (int32_t)(ts - state->resync_ts);
+    uint8_t b = h[VOODOO_FLV_TAG_HEADER_SIZE];
+    if((h[0] & 0xc0) != 0 || (tag_type != 8 && tag_type != 9 && tag_type != 18) ||
+       tag_size + VOODOO_FLV_TAG_HEADER_SIZE + VOODOO_FLV_PREV_TAG_SIZE > state->config.max_cache_size) {
+        return 0;
+    }
+    if(tag_size + VOODOO_FLV_TAG_HEADER_SIZE + VOODOO_FLV_PREV_TAG_SIZE <= available ||
+       tag_size <= VOODOO_FLV_RESYNC_TRUST_SIZE) {
+        return 1;
+    }
+    if(tag_size > VOODOO_FLV_RESYNC_MAX_TAG_SIZE || PS_RB24(h + 8) != 0 ||
+       (state->resync_ts_valid && (jump > VOODOO_FLV_RESYNC_MAX_TS_JUMP || jump < -VOODOO_FLV_RESYNC_MAX_TS_JUMP))) {
+        return 0;
+    }
+    if(tag_type == 18) {
+        return b == 2;
+    }
+    if((h[0] & 0x20) != 0) {
+        return 1;
+    }
+    if(tag_type == 9 && (((b >> 4) & 7) < 1 || ((b >> 4) & 7) > 5)) {
+        return 0;
+    }
+    return state->resync_codec[tag_type == 9] < 0 || state->resync_codec[tag_type == 9] == voodoo_tag_codec(tag_type, b);
+}
+
+/*
+ 整个tag body已经在stream里，从pos开始解析，pos移到body末尾
+ */
+static void voodoo_parse_tag_body(flv_demuxer_context_t *state) {
+    pts_t *s = &state->stream;
+    state->tag_start = s->pos;
+    state->tag_pos = state->tag_start + state->stream_start;
+    if(state->tag_type != 18 && !state->tag_encrypted && state->tag_size > 0) {
+        state->resync_codec[state->tag_type == 9] = voodoo_tag_codec(state->tag_type, s->buf[s->pos]);
+    }
+    if(state->tag_type == 18) {
+        voodoo_parse_script_tag(state);
+    } else if(voodoo_parse_tag(state) < 0) {
+        voodoo_tag_failed(state);
+    }
+    s->pos = state->tag_start + state->tag_size;
+}
 
 static int flv_demux_parse_stream(ptc_t* ptc) {
     flv_demuxer_context_t* state = PT_DATA(ptc);
     pts_t* s = &state->stream;
-    uint32_t tmp32;
+    uint32_t tmp32, frag_len;
     PT_BEGIN(ptc);
     {
-        /*
-            read probe
-         */
-        {
-            state->read_state = VOODOO_READ_STATE_PROBE;
-            PS_SR_BUF(s,&tmp32, 4);
-            if(strncmp((char*)&tmp32, "FLV", 3) != 0) {
-                voodoo_show_hex("NO SIGNATURE", s->buf, VPMIN(64,s->size));
-                PT_THROW_ERROR(ptc, "NO FLV FILE SIGNATURE");
-            }
-            if(((uint8_t *)&tmp32)[3] != 0x01) {
-                voodoo_show_hex("NO SIGNATURE", s->buf, VPMIN(64,s->size));
-                PT_THROW_ERROR(ptc, "FLV FILE TYPE NOT 0X01");
+        if(!state->header_parsed) {
+            /*
+                read probe
+             */
+            {
+                state->read_state = VOODOO_READ_STATE_PROBE;
+                PS_SR_BUF(s,&tmp32, 4);
+                if(strncmp((char*)&tmp32, "FLV", 3) != 0) {
+                    PT_THROW_ERROR(ptc, "NO FLV FILE SIGNATURE");
+                }
+                if(((uint8_t *)&tmp32)[3] != 0x01) {
+                    PT_THROW_ERROR(ptc, "FLV FILE TYPE NOT 0X01");
+                }
             }
-        }
 
-        {
-            state->read_state = VOODOO_READ_STATE_HEADER;
-            PS_SR_U8(s,state->file_flag);
-            printf("FILE FLAG READ, %s, %s\n", (state->file_flag & 4) != 0 ? "HAS AUDIO" : "NO AUDIO", (state->file_flag & 1) != 0 ? "HAS VIDEO" : "NO VIDEO" );
+            {
+                state->read_state = VOODOO_READ_STATE_HEADER;
+                PS_SR_U8(s,state->file_flag);
+                DEMUXER_LOG(&state->trace, VOODOO_LOG_INFO, "flv: file flag %s, %s", (state->file_flag & 4) != 0 ? "has audio" : "no audio", (state->file_flag & 1) != 0 ? "has video" : "no video");
             
-            //uint8_t flag_array[2] = { ((state->file_flag & 1) != 0 ? 1 : 0), ((state->file_flag & 4) != 0 ? 1 : 0) };
+                //uint8_t flag_array[2] = { ((state->file_flag & 1) != 0 ? 1 : 0), ((state->file_flag & 4) != 0 ? 1 : 0) };
 
-            /*
-             callback media flags
-             */
-            state->callback(state->userdata, VOODOO_DATA_TYPE_MEDIA_FLAG, NULL, 0, NULL, (uint32_t)state->file_flag);
+                /*
+                 callback media flags
+                 */
+                state->callback(state->userdata, VOODOO_DATA_TYPE_MEDIA_FLAG, NULL, 0, NULL, (uint32_t)state->file_flag);
+
+                PS_SR_U32(s,state->tmp32);
+                if(state->tmp32 < 9 || (state->resync_enabled && state->tmp32 - 9 > VOODOO_FLV_MAX_HEADER_SKIP)) {
+                    if(!state->resync_enabled) PT_THROW_ERROR(ptc, "offset less than 9");
+                    voodoo_begin_resync(state, state->tmp32);
+                } else {
+                    PS_SR_SKIP(s,state->tmp32-9);
+                }
+            }
 
-            PS_SR_U32(s,state->tmp32);
-            if(state->tmp32 < 9) PT_THROW_ERROR(ptc, "offset less than 9");
-            PS_SR_SKIP(s,state->tmp32-9);
+            if(!state->resync_pending) {
+                state->read_state = VOODOO_READ_STATE_PRE_TAG;
+                //  prev tag size, must be zero
+                PS_SR_U32(s,state->tmp32);
+                if(state->tmp32 != 0) {
+                    if(!state->resync_enabled) PT_THROW_ERROR(ptc, "prev tag size not zero");
+                    voodoo_begin_resync(state, state->tmp32);
+                }
+            }
+            state->header_parsed = 1;
         }
 
         {
-            state->read_state = VOODOO_READ_STATE_PRE_TAG;
-            //  prev tag size, must be zero
-            PS_SR_U32(s,state->tmp32);
-            if(state->tmp32 != 0) PT_THROW_ERROR(ptc, "prev tag size not zero");
-
             while(state->is_running) {
+                if(state->resync_pending) {
+                    /*
+                     向后找第一个类型、大小合理，并且PreTagSize对得上的tag头
+                     */
+                    state->read_state = VOODOO_READ_STATE_RESYNC;
+                    while(1) {
+                        tmp32 = voodoo_scan_tag_header(s->buf + s->pos, PS_SIZE(s));
+                        voodoo_resync_skip(state, tmp32);
+                        PS_DR_SKIP(s,tmp32);
+                        if(PS_SIZE(s) <= VOODOO_FLV_TAG_HEADER_SIZE) {
+                            /*
+                             剩下不到一个tag头加body的第一个字节，多要一些再扫，这样补进cache的数据
+                             能盖住剩下的字节，feed会退回调用方的buffer继续
+                             */
+                            PS_ENSURE(s,VOODOO_FLV_RESYNC_WINDOW);
+                            continue;
+                        }
+                        if(voodoo_plausible_tag(state, s->buf + s->pos, PS_SIZE(s))) {
+                            state->tag_size = PS_PR_U24(s,1);
+                            PS_ENSURE(s,state->tag_size + VOODOO_FLV_TAG_HEADER_SIZE + VOODOO_FLV_PREV_TAG_SIZE);
+                            tmp32 = (PS_PR_U24(s,state->tag_size + VOODOO_FLV_TAG_HEADER_SIZE) << 8) | PS_PR_U8(s,state->tag_size + VOODOO_FLV_TAG_HEADER_SIZE + 3);
+                            if(tmp32 == state->tag_size + VOODOO_FLV_TAG_HEADER_SIZE) {
+                                break;
+                            }
+                        }
+                        voodoo_resync_skip(state, 1);
+                        PS_DR_SKIP(s,1);
+                    }
+                    state->resync_pending = 0;
+                    demuxer_trace_event(&state->trace, VOODOO_EVENT_RESYNCED, VOODOO_LOG_INFO, state->dts, (uint64_t)state->stream_start + s->pos, state->resync_skipped);
+                    DEMUXER_LOG(&state->trace, VOODOO_LOG_INFO, "flv: resynced after %u bytes", state->resync_skipped);
+                }
+                /*
+                 快速路径：tag头、body和PreTagSize都已经在buffer里时直线解析，
+                 不经过PS_SR的yield点，只有buffer末尾不完整的tag和异常tag走下面的协程
+                 */
+                while(state->is_running && PS_SIZE(s) >= VOODOO_FLV_TAG_HEADER_SIZE) {
+                    const uint8_t *h = s->buf + s->pos;
+                    uint8_t tag_type = h[0] & 0x1f;
+                    uint32_t tag_size = PS_RB24(h + 1);
+                    if((h[0] & 0xc0) != 0 ||
+                       (tag_type != 8 && tag_type != 9 && tag_type != 18) ||
+                       (uint64_t)tag_size + VOODOO_FLV_TAG_HEADER_SIZE + VOODOO_FLV_PREV_TAG_SIZE > PS_SIZE(s) ||
+                       (state->resync_enabled && tag_size + VOODOO_FLV_TAG_HEADER_SIZE + VOODOO_FLV_PREV_TAG_SIZE > state->config.max_cache_size)) {
+                        break;
+                    }
+                    if(state->resync_enabled && PS_RB32(h + VOODOO_FLV_TAG_HEADER_SIZE + tag_size) != tag_size + VOODOO_FLV_TAG_HEADER_SIZE) {
+                        /*
+                         PreTagSize对不上，tag头多半是错位的，不解析，从下一个字节开始扫
+                         */
+                        voodoo_begin_resync(state, PS_RB32(h + VOODOO_FLV_TAG_HEADER_SIZE + tag_size));
+                        PS_DR_SKIP(s,1);
+                        break;
+                    }
+                    state->tag_encrypted = ((h[0] & 0x20) != 0);
+                    state->tag_type = tag_type;
+                    state->tag_size = tag_size;
+                    voodoo_count_tag(state);
+                    state->dts = PS_RB24(h + 4) | ((uint32_t)h[7] << 24);
+                    voodoo_check_stream_id(state, PS_RB24(h + 8));
+                    state->read_state = VOODOO_READ_STATE_TAG_BODY;
+                    state->frag_header = tag_type == 8 ? 2 : 5;
+                    s->pos += VOODOO_FLV_TAG_HEADER_SIZE;
+                    voodoo_parse_tag_body(state);
+                    voodoo_check_prev_tag_size(state, PS_RB32(s->buf + s->pos));
+                    s->pos += VOODOO_FLV_PREV_TAG_SIZE;
+                }
+                if(!state->is_running) {
+                    break;
+                }
+                if(state->resync_pending) {
+                    continue;
+                }
+
                 state->read_state = VOODOO_READ_STATE_NEW_TAG;
+                if(state->resync_enabled) {
+                    /*
+                     先只看不取，tag头不像或者PreTagSize对不上时从tag头的下一个字节开始扫。
+                     分片模式等不到PreTagSize，只看tag头
+                     */
+                    PS_ENSURE(s,VOODOO_FLV_TAG_HEADER_SIZE + 1);
+                    if(!voodoo_plausible_tag(state, s->buf + s->pos, PS_SIZE(s))) {
+                        voodoo_begin_resync(state, PS_PR_U24(s,1));
+                        PS_DR_SKIP(s,1);
+                        continue;
+                    }
+                    if(!state->chunked_mode) {
+                        state->tag_size = PS_PR_U24(s,1);
+                        PS_ENSURE(s,state->tag_size + VOODOO_FLV_TAG_HEADER_SIZE + VOODOO_FLV_PREV_TAG_SIZE);
+                        tmp32 = PS_RB32(s->buf + s->pos + VOODOO_FLV_TAG_HEADER_SIZE + state->tag_size);
+                        if(tmp32 != state->tag_size + VOODOO_FLV_TAG_HEADER_SIZE) {
+                            voodoo_begin_resync(state, tmp32);
+                            PS_DR_SKIP(s,1);
+                            continue;
+                        }
+                    }
+                }
                 PS_SR_U8(s, state->tag_type);
                 /*
                  parse encrypt flag
                  */
-                if((state->tag_type & 0xc0) != 0) PT_THROW_ERROR(ptc, "Reserved for FMS is not zero");
+                if((state->tag_type & 0xc0) != 0) {
+                    if(!state->resync_enabled) PT_THROW_ERROR(ptc, "Reserved for FMS is not zero");
+                    voodoo_begin_resync(state, state->tag_type);
+                    continue;
+                }
                 state->tag_encrypted = ((state->tag_type & 0x20) != 0);
                 state->tag_type &= 0x1f;
                 
                 PS_SR_U24(s, state->tag_size);
+                voodoo_count_tag(state);
                 if(state->tag_type != 8 &&
                    state->tag_type != 9 &&
                    state->tag_type != 18) {
+                    if(state->resync_enabled) {
+                        /*
+                         flv只定义了这三种tag，其他类型多半是帧同步丢了。
+                         size的3个字节还在buffer里，退回去一起扫
+                         */
+                        s->pos -= 3;
+                        voodoo_begin_resync(state, state->tag_type);
+                        continue;
+                    }
                     PS_SR_SKIP(s,state->tag_size+11);
                     continue;
                 }
+                if(state->resync_enabled && state->tag_size + VOODOO_FLV_TAG_HEADER_SIZE + VOODOO_FLV_PREV_TAG_SIZE > state->config.max_cache_size) {
+                    s->pos -= 3;
+                    voodoo_begin_resync(state, state->tag_size);
+                    continue;
+                }
                 state->read_state = VOODOO_READ_STATE_TAG_HEADER;
                 //  timestamp
                 PS_SR_U24(s, state->tmp32);
@@ -293,34 +1058,52 @@ static int flv_demux_parse_stream(ptc_t* ptc) {
 
                 //  stream id
                 PS_SR_U24(s, state->tmp32);
-                if(state->tmp32 != 0) {
-                    fprintf(stderr, "[WARN] stream id %u is not zero\n", state->tmp32);
-                }
+                voodoo_check_stream_id(state, state->tmp32);
                 state->read_state = VOODOO_READ_STATE_TAG_BODY;
-                /**
-                 * todo: 这里后面应改为按照流模式读取，不使用ENSURE。避免一个tag的大小超过STREAM CACHE的情况。
-                 */
-                PS_ENSURE(s,state->tag_size);
-                state->tag_start = s->pos;
-                state->tag_pos = state->tag_start + state->stream_start;
-                if(state->tag_type == 8) {
-                    if(voodoo_parse_audio_tag(state) < 0) {
-                        fprintf(stderr, "[WARN] parse audio data failed\n");
+                state->frag_header = state->tag_type == 8 ? 2 : 5;
+                if(state->chunked_mode &&
+                   state->tag_type != 18 &&
+                   state->tag_size >= state->frag_header &&
+                   PS_SIZE(s) < state->tag_size) {
+                    /*
+                     分片模式：只需要tag头部完整，body按收到的数据分段回调
+                     */
+                    PS_ENSURE(s,state->tag_type == 8 ? state->frag_header : VPMIN(state->tag_size, VOODOO_FLV_VIDEO_HEADER_MAX_SIZE));
+                    state->tag_start = s->pos;
+                    state->tag_pos = state->tag_start + state->stream_start;
+                    state->frag_flag = 0;
+                    state->frag_type = voodoo_parse_tag_header(state, &state->frag_flag);
+                    if(state->frag_type < 0) {
+                        voodoo_tag_failed(state);
                     }
-                } else if(state->tag_type == 9) {
-                    if(voodoo_parse_video_tag(state) < 0) {
-                        fprintf(stderr, "[WARN] parse video data failed\n");
+                    if(state->frag_type == VOODOO_DATA_TYPE_AUDIO_PARAMETERS ||
+                       state->frag_type == VOODOO_DATA_TYPE_VIDEO_PARAMETERS) {
+                        /*
+                         parameters need whole tag
+                         */
+                        PS_ENSURE(s,state->tag_size);
+                        voodoo_emit_data(state, state->frag_type, s->buf + s->pos + state->frag_header, state->tag_size - state->frag_header, state->frag_flag);
+                        PS_DR_SKIP(s,state->tag_size);
+                    } else {
+                        PS_DR_SKIP(s,state->frag_header);
+                        state->frag_left = state->tag_size - state->frag_header;
+                        voodoo_begin_fragments(state);
+                        while(state->frag_left > 0) {
+                            PS_ENSURE(s,1);
+                            frag_len = VPMIN(PS_SIZE(s), state->frag_left);
+                            state->frag_left -= frag_len;
+                            voodoo_emit_fragment(state, s->buf + s->pos, frag_len);
+                            PS_DR_SKIP(s,frag_len);
+                        }
                     }
-                } else if(state->tag_type == 18) {
-                    fprintf(stderr, "[WARN] SKIP SCRIPT DATA\n");
                 } else {
-                    fprintf(stderr,"[WARN] UNSUPPORTED TAG [%d]\n", (int) state->tag_type);
+                    PS_ENSURE(s,state->tag_size);
+                    voodoo_parse_tag_body(state);
                 }
-                s->pos = state->tag_start + state->tag_size;
                 //  prev tag size
                 PS_SR_U32(s,state->tmp32);
-                if(state->tmp32 != 11 + state->tag_size) {
-                    fprintf(stderr, "[WARN] Invalid PreTagSize: %u\n", state->tmp32);
+                if(voodoo_check_prev_tag_size(state, state->tmp32) < 0 && state->resync_enabled) {
+                    voodoo_begin_resync(state, state->tmp32);
                 }
             }
         }
@@ -344,32 +1127,26 @@ static int flv_demux_parse_stream(ptc_t* ptc) {
 #define FLV_AUDIO_MONO      0
 #define FLV_AUDIO_STEREO    1
 
-static int voodoo_parse_audio_tag(flv_demuxer_context_t *state) {
+/*
+ 解析音频tag头部（2字节），返回需要回调的数据类型，0表示不回调
+ */
+static int voodoo_parse_audio_tag_header(flv_demuxer_context_t *state, const uint8_t *p, uint32_t *flag) {
     if(state->tag_size < 2) {
-        fprintf(stderr, "TAG SIZE IS TOO SMALL FOR VIDEO TAG\n");
+        DEMUXER_LOG(&state->trace, VOODOO_LOG_DEBUG, "flv: tag size %u is too small for audio tag", state->tag_size);
         return -1;
     }
     
-    pts_t stream = { state->stream.buf + state->stream.pos, state->tag_size, 0};
-    pts_t *s = &stream;
-
-    PS_DR_U8(s);
-    uint8_t packetType = PS_DR_U8(s);
+    uint8_t packetType = p[1];
     
     if(state->tag_size == 2) { return 0; }
     if(packetType == 0) {
-        /*
-         parameters need whole tag
-         */
-        state->callback(state->userdata, VOODOO_DATA_TYPE_AUDIO_PARAMETERS, s->buf + s->pos, s->size - 2, state->ts, 0);
-    } else {
-        if(state->skip_frames ||
-           state->seek_to_next_i_frame) {
-            return 0;
-        }
-        state->callback(state->userdata, VOODOO_DATA_TYPE_AUDIO_PACKET, s->buf + s->pos, s->size - 2, state->ts, 0);
+        return VOODOO_DATA_TYPE_AUDIO_PARAMETERS;
     }
-    return 0;
+    if(state->skip_frames ||
+       state->seek_to_next_i_frame) {
+        return 0;
+    }
+    return VOODOO_DATA_TYPE_AUDIO_PACKET;
 }
 
 #define FLV_FRAME_KEY            1 ///<< FLV_VIDEO_FRAMETYPE_OFFSET, ///< key frame (for AVC, a seekable frame)
@@ -378,84 +1155,729 @@ static int voodoo_parse_audio_tag(flv_demuxer_context_t *state) {
 #define FLV_FRAME_GENERATED_KEY  4 ///<< FLV_VIDEO_FRAMETYPE_OFFSET, ///< generated key frame (reserved for server use only)
 #define FLV_FRAME_VIDEO_INFO_CMD 5 ///<< FLV_VIDEO_FRAMETYPE_OFFSET, ///< video info/command frame
 
+#define HEVC_NAL_RSV_VCL_N14     14
+#define HEVC_NAL_VCL_MAX         31
+
 #define FLV_VIDEO_CODECID_MASK    0x0fU
 #define FLV_VIDEO_FRAMETYPE_MASK  0xf0U
 
+/*
+ enhanced flv, IsExHeader置位时低4位是PacketType，后面跟4字节FourCC
+ */
+#define FLV_VIDEO_EX_HEADER_MASK        0x80U
+#define FLV_VIDEO_EX_FRAMETYPE_MASK     0x70U
+#define FLV_VIDEO_EX_PACKETTYPE_MASK    0x0fU
+
+#define FLV_EX_PACKET_SEQUENCE_START    0
+#define FLV_EX_PACKET_CODED_FRAMES      1
+#define FLV_EX_PACKET_SEQUENCE_END      2
+#define FLV_EX_PACKET_CODED_FRAMES_X    3
+#define FLV_EX_PACKET_METADATA          4
+
+#define FLV_FOURCC(a,b,c,d) (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+
 //#define VOODOO_NOPTS_VALUE  ((int64_t)UINT64_C(0x8000000000000000))
 
-static int voodoo_parse_video_tag(flv_demuxer_context_t *state) {
+static int voodoo_video_codec_from_fourcc(uint32_t fourcc) {
+    switch(fourcc) {
+        case FLV_FOURCC('a','v','c','1'): return VIDEO_CODEC_ID_H264;
+        case FLV_FOURCC('h','v','c','1'): return VIDEO_CODEC_ID_HEVC;
+        case FLV_FOURCC('a','v','0','1'): return VIDEO_CODEC_ID_AV1;
+        default: return -1;
+    }
+}
+
+/*
+ 非关键帧最低在哪一级可以丢：
+ VOODOO_DROP_NON_REFERENCE   flv disposable inter，avc的nal_ref_idc为0，
+                             hevc最高时域层的sub-layer non-reference(_N)
+ VOODOO_DROP_TEMPORAL_LAYERS hevc TemporalId > 0，只会被更高层参考
+ VOODOO_DROP_TO_KEYFRAMES    其它帧，丢了之后要等下一个关键帧
+ 同一帧所有slice的nal_ref_idc/nal_unit_type/TemporalId都相同，看第一个vcl nal就够了。
+ p是avcc格式的nal数据，只看已经收到的部分，找不到vcl nal就当作参考帧
+ */
+static int voodoo_video_frame_drop_level(flv_demuxer_context_t *state, int video_codec, uint8_t frame_type, const uint8_t *p, uint32_t size) {
+    if(frame_type == FLV_FRAME_DISP_INTER) {
+        return VOODOO_DROP_NON_REFERENCE;
+    }
+    if(video_codec != VIDEO_CODEC_ID_H264 && video_codec != VIDEO_CODEC_ID_HEVC) {
+        return VOODOO_DROP_TO_KEYFRAMES;
+    }
+    uint32_t nal_length_size = state->video_info_parsed && state->video_info.nal_length_size > 0 ? (uint32_t)state->video_info.nal_length_size : 4;
+    uint32_t pos = 0;
+    while(pos + nal_length_size + 2 <= size) {
+        uint32_t nal_size = 0;
+        for(uint32_t i = 0;i < nal_length_size;++i) {
+            nal_size = (nal_size << 8) | p[pos + i];
+        }
+        pos += nal_length_size;
+        const uint8_t *nal = p + pos;
+        if(video_codec == VIDEO_CODEC_ID_H264) {
+            int nal_type = nal[0] & 0x1f;
+            if(nal_type >= 1 && nal_type <= 5) {
+                return (nal[0] & 0x60) == 0 ? VOODOO_DROP_NON_REFERENCE : VOODOO_DROP_TO_KEYFRAMES;
+            }
+        } else {
+            int nal_type = (nal[0] >> 1) & 0x3f;
+            int temporal_id = (nal[1] & 0x07) - 1;
+            if(nal_type <= HEVC_NAL_VCL_MAX) {
+                state->max_temporal_id = VPMAX(state->max_temporal_id, temporal_id);
+                if(nal_type <= HEVC_NAL_RSV_VCL_N14 && (nal_type & 1) == 0 && temporal_id >= state->max_temporal_id) {
+                    return VOODOO_DROP_NON_REFERENCE;
+                }
+                return temporal_id > 0 ? VOODOO_DROP_TEMPORAL_LAYERS : VOODOO_DROP_TO_KEYFRAMES;
+            }
+        }
+        if(nal_size > size - pos) {
+            break;
+        }
+        pos += nal_size;
+    }
+    return VOODOO_DROP_TO_KEYFRAMES;
+}
+
+/*
+ 升级马上生效；降级要等关键帧，之前丢掉的帧可能还被后面的帧参考。
+ 只丢了不参考帧时可以马上降
+ */
+static void voodoo_update_drop_level(flv_demuxer_context_t *state, int is_key_frame) {
+    int request = __atomic_load_n(&state->drop_request, __ATOMIC_RELAXED);
+    if(request == state->drop_level) {
+        return;
+    }
+    if(request > state->drop_level || is_key_frame || state->drop_level == VOODOO_DROP_NON_REFERENCE) {
+        __atomic_store_n(&state->drop_level, request, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+ 解析视频tag头部，legacy是5字节，enhanced是5或8字节，实际长度写到frag_header。
+ 返回需要回调的数据类型，0表示不回调
+ */
+static int voodoo_parse_video_tag_header(flv_demuxer_context_t *state, const uint8_t *p, uint32_t *flag) {
     if(state->tag_size < 5) {
-        fprintf(stderr, "TAG SIZE IS TOO SMALL FOR VIDEO TAG\n");
+        DEMUXER_LOG(&state->trace, VOODOO_LOG_DEBUG, "flv: tag size %u is too small for video tag", state->tag_size);
         return -1;
     }
     
-    pts_t stream = { state->stream.buf + state->stream.pos, state->tag_size, 0};
+    pts_t stream;
     pts_t *s = &stream;
+    PS_INIT(s, (uint8_t *)p, VPMIN(state->tag_size, VOODOO_FLV_VIDEO_HEADER_MAX_SIZE));
     
     uint8_t spec = PS_DR_U8(s);
+    uint8_t frame_type;
+    int video_codec;
+    int is_parameters = 0, is_frame = 0;
+    int32_t cts = 0;
 
-    uint8_t frame_type = (spec & (uint8_t )FLV_VIDEO_FRAMETYPE_MASK) >> 4;
-    uint8_t video_codec = spec & (uint8_t )FLV_VIDEO_CODECID_MASK;
-
-    if(video_codec != 7) {
-        fprintf(stderr, "unsupported video codec %u\n", (uint32_t) video_codec);
-        return -1;
-    }
-
-    if(frame_type == FLV_FRAME_VIDEO_INFO_CMD) {
-        return 0;
+    if(spec & FLV_VIDEO_EX_HEADER_MASK) {
+        frame_type = (spec & (uint8_t )FLV_VIDEO_EX_FRAMETYPE_MASK) >> 4;
+        uint8_t packet_type = spec & (uint8_t )FLV_VIDEO_EX_PACKETTYPE_MASK;
+        uint32_t fourcc = FLV_FOURCC(p[1], p[2], p[3], p[4]);
+        PS_DR_SKIP(s,4);
+        video_codec = voodoo_video_codec_from_fourcc(fourcc);
+        if(video_codec < 0) {
+            DEMUXER_LOG(&state->trace, VOODOO_LOG_DEBUG, "flv: unsupported video fourcc %08x", fourcc);
+            return -1;
+        }
+        state->frag_header = 5;
+        if(frame_type == FLV_FRAME_VIDEO_INFO_CMD && packet_type != FLV_EX_PACKET_METADATA) {
+            return 0;
+        }
+        if(packet_type == FLV_EX_PACKET_SEQUENCE_START) {
+            is_parameters = 1;
+        } else if(packet_type == FLV_EX_PACKET_CODED_FRAMES) {
+            /*
+             av1没有composition time
+             */
+            if(video_codec != VIDEO_CODEC_ID_AV1) {
+                if(state->tag_size < 8) {
+                    return -1;
+                }
+                cts = (PS_DR_U24(s) + 0xff800000) ^ 0xff800000;
+                state->frag_header = 8;
+            }
+            is_frame = 1;
+        } else if(packet_type == FLV_EX_PACKET_CODED_FRAMES_X) {
+            is_frame = 1;
+        } else {
+            return 0;
+        }
+    } else {
+        frame_type = (spec & (uint8_t )FLV_VIDEO_FRAMETYPE_MASK) >> 4;
+        video_codec = spec & (uint8_t )FLV_VIDEO_CODECID_MASK;
+        if(video_codec != VIDEO_CODEC_ID_H264 && video_codec != VIDEO_CODEC_ID_HEVC) {
+            DEMUXER_LOG(&state->trace, VOODOO_LOG_DEBUG, "flv: unsupported video codec %u", (uint32_t) video_codec);
+            return -1;
+        }
+        state->frag_header = 5;
+        if(frame_type == FLV_FRAME_VIDEO_INFO_CMD) {
+            return 0;
+        }
+        uint8_t packetType = PS_DR_U8(s);
+        cts = (PS_DR_U24(s) + 0xff800000) ^ 0xff800000;
+        is_parameters = packetType == 0;   // AVCDecoderConfigurationRecord / HEVCDecoderConfigurationRecord
+        is_frame = packetType == 1;        // One or more Nalus
+        if(!is_parameters && !is_frame) {
+            return packetType == 2 ? 0 : -1;
+        }
     }
 
-    uint8_t packetType = PS_DR_U8(s);
-    int32_t cts = (PS_DR_U24(s) + 0xff800000) ^ 0xff800000;
     state->pts = state->dts + cts;
     if (cts < 0) { // dts might be wrong
         if (!state->wrong_dts)
             state->wrong_dts = 1;
+        DEMUXER_STAT_ADD(&state->trace, wrong_dts, 1);
+        voodoo_trace_event(state, VOODOO_EVENT_WRONG_DTS, VOODOO_LOG_DEBUG, (uint32_t)cts, "negative composition time");
     } else if (VPABS(state->dts - state->pts) > 1000*60*15) {
         state->dts = state->pts = VOODOO_NOPTS_VALUE;
     }
     
-    if(state->tag_size == 5) {
+    if(state->tag_size == state->frag_header) {
         return 0;
     }
 
-    if(packetType == 0) {// AVCDecoderConfigurationRecord
-        state->callback(state->userdata, VOODOO_DATA_TYPE_VIDEO_PARAMETERS, s->buf + s->pos, state->tag_size - 5, state->ts, (uint32_t)video_codec);
-    } else if(packetType == 1) {// One or more Nalus
+    if(is_parameters) {
+        *flag = (uint32_t)video_codec;
+        return VOODOO_DATA_TYPE_VIDEO_PARAMETERS;
+    }
         
-        if (frame_type == FLV_FRAME_KEY) {
-            //printf("KEY FRAME AT %llu\n", state->frame_count);
+    if (frame_type == FLV_FRAME_KEY) {
+        DEMUXER_STAT_ADD(&state->trace, keyframes, 1);
+    }
+    
+    ++state->frame_count;
+    
+    if(state->index_enabled && frame_type == FLV_FRAME_KEY) {
+        voodoo_index_add(state, state->dts, state->tag_pos - VOODOO_FLV_TAG_HEADER_SIZE);
+    }
+    
+    /*
+        按丢帧级别丢视频，音频不受影响
+    */
+    voodoo_update_drop_level(state, frame_type == FLV_FRAME_KEY);
+    if(frame_type != FLV_FRAME_KEY &&
+       (state->drop_level != VOODOO_DROP_NONE || video_codec == VIDEO_CODEC_ID_HEVC)) {
+        uint32_t available = VPMIN(PS_SIZE(&state->stream), state->tag_size);
+        int frame_level = voodoo_video_frame_drop_level(state, video_codec, frame_type, p + state->frag_header, available - state->frag_header);
+        if(frame_level <= state->drop_level) {
+            if(frame_level == VOODOO_DROP_NON_REFERENCE) {
+                DEMUXER_STAT_ADD(&state->trace, dropped_non_reference, 1);
+            } else if(frame_level == VOODOO_DROP_TEMPORAL_LAYERS) {
+                DEMUXER_STAT_ADD(&state->trace, dropped_temporal_layers, 1);
+            } else {
+                DEMUXER_STAT_ADD(&state->trace, dropped_inter_frames, 1);
+            }
+            return 0;
         }
-        
-        ++state->frame_count;
-        
-        /*
-            跳帧，直接返回，不解析
-        */
-        if(state->skip_frames) {
+    }
+
+    /*
+        跳帧，直接返回，不解析
+    */
+    if(state->skip_frames) {
+        return 0;
+    }
+    /*
+        seek到下一个i帧
+    */
+    if(state->seek_to_next_i_frame) {
+        if(frame_type != FLV_FRAME_KEY) {
             return 0;
         }
+        state->seek_to_next_i_frame = 0;
+    }
+    
+    state->frame_codec_id = video_codec;
+    *flag = frame_type == FLV_FRAME_KEY ? VOODOO_VIDEO_PACKET_FLAG_IS_KEY_FRAME : 0;
+    return VOODOO_DATA_TYPE_VIDEO_PACKET;
+}
+
+static int voodoo_parse_tag_header(flv_demuxer_context_t *state, uint32_t *flag) {
+    const uint8_t *p = state->stream.buf + state->stream.pos;
+    if(state->tag_type == 8) {
+        return voodoo_parse_audio_tag_header(state, p, flag);
+    }
+    return voodoo_parse_video_tag_header(state, p, flag);
+}
+
+/*
+ 整个tag已经在stream中，头部解析完直接回调整个body
+ */
+static int voodoo_parse_tag(flv_demuxer_context_t *state) {
+    uint32_t flag = 0;
+    int type = voodoo_parse_tag_header(state, &flag);
+    if(type > 0) {
+        voodoo_emit_data(state, type, state->stream.buf + state->stream.pos + state->frag_header, state->tag_size - state->frag_header, flag);
+    }
+    return type;
+}
+
+static void voodoo_emit_packet(flv_demuxer_context_t *state, demuxer_packet_t *packet, int type, uint32_t flag) {
+    packet->type = type;
+    packet->stream_index = state->tag_type == 8 ? VOODOO_STREAM_INDEX_AUDIO : VOODOO_STREAM_INDEX_VIDEO;
+    packet->flag = flag;
+    packet->pts = state->pts;
+    packet->dts = state->dts;
+    if(state->gop_cache) {
+        gop_cache_push(state->gop_cache, packet);
+    }
+    if(!state->packet_callback) {
         /*
-            seek到下一个i帧
-        */
-        if(state->seek_to_next_i_frame) {
-            if(frame_type != FLV_FRAME_KEY) {
-                return 0;
+         拉取模式，引用交给队列，由flv_demuxer_read_packets取走
+         */
+        packet->next = NULL;
+        if(state->queue_tail) {
+            state->queue_tail->next = packet;
+        } else {
+            state->queue_head = packet;
+        }
+        state->queue_tail = packet;
+        ++state->queue_count;
+        return;
+    }
+    /*
+     回调里需要保留packet的话自己retain
+     */
+    state->packet_callback(state->userdata, packet);
+    demuxer_packet_release(packet);
+}
+
+/*
+ sequence header里的SPS，解析出分辨率、帧率和重排深度
+ */
+static void voodoo_parse_video_parameters(flv_demuxer_context_t *state, const uint8_t *data, uint32_t size, uint32_t codec_id) {
+    video_sps_info_t info;
+    memset(&info, 0, sizeof(info));
+    int ret;
+    switch(codec_id) {
+        case VIDEO_CODEC_ID_HEVC: ret = hevc_parse_decoder_config(data, size, &info); break;
+        case VIDEO_CODEC_ID_AV1: ret = av1_parse_decoder_config(data, size, &info); break;
+        default: ret = avc_parse_decoder_config(data, size, &info); break;
+    }
+    if(ret < 0) {
+        voodoo_trace_event(state, VOODOO_EVENT_SEQUENCE_HEADER, VOODOO_LOG_WARN, codec_id, "parse video sequence header failed");
+        return;
+    }
+    state->video_info = info;
+    state->video_info_parsed = 1;
+    state->video_codec_id = (int)codec_id;
+    state->video_width = info.width;
+    state->video_height = info.height;
+    state->video_frame_format = info.chroma_format_idc;
+}
+
+/*
+ 按需扩大state拥有的buffer，内容不保留
+ */
+static int voodoo_reserve_buffer(flv_demuxer_context_t *state, uint8_t **buf, uint32_t *capacity, uint32_t size) {
+    if(*capacity >= size) {
+        return 0;
+    }
+    uint8_t *p = (uint8_t*)state->config.malloc_fn(state->config.allocator_opaque, size);
+    if(!p) {
+        voodoo_trace_event(state, VOODOO_EVENT_ALLOC_FAILED, VOODOO_LOG_WARN, size, "alloc nal buffer failed");
+        return -1;
+    }
+    if(*buf) {
+        state->config.free_fn(state->config.allocator_opaque, *buf);
+    }
+    *buf = p;
+    *capacity = size;
+    return 0;
+}
+
+/*
+ 每个sequence header都转一份annex-b参数集，中途切换格式也能马上用
+ */
+static void voodoo_update_nal_parameters(flv_demuxer_context_t *state, const uint8_t *data, uint32_t size, uint32_t codec_id) {
+    int nal_length_size = 0;
+    int len = nal_parameter_sets_to_annexb((int)codec_id, data, size, NULL, 0, &nal_length_size);
+    state->nal_codec_id = (int)codec_id;
+    state->nal_length_size = 0;
+    state->nal_parameters_size = 0;
+    if(len < 0 || voodoo_reserve_buffer(state, &state->nal_parameters, &state->nal_parameters_capacity, (uint32_t)len) < 0) {
+        return;
+    }
+    nal_parameter_sets_to_annexb((int)codec_id, data, size, state->nal_parameters, state->nal_parameters_capacity, NULL);
+    state->nal_parameters_size = (uint32_t)len;
+    state->nal_length_size = nal_length_size;
+}
+
+static void voodoo_sei_callback(void* opaque, const nal_sei_t* sei) {
+    flv_demuxer_context_t *state = (flv_demuxer_context_t*)opaque;
+    uint32_t flag = (uint32_t)sei->payload_type & VOODOO_SEI_FLAG_PAYLOAD_TYPE_MASK;
+    if(sei->escaped) {
+        flag |= VOODOO_SEI_FLAG_ESCAPED;
+    }
+    if(sei->suffix) {
+        flag |= VOODOO_SEI_FLAG_SUFFIX;
+    }
+    if(!state->packet_pool) {
+        state->callback(state->userdata, VOODOO_DATA_TYPE_SEI, (void*)sei->payload, (int)sei->size, state->ts, flag);
+        return;
+    }
+    /*
+     有pool时payload拷进自己的packet，和视频packet走同一条路，顺序和生命周期都由packet决定
+     */
+    demuxer_packet_t *packet = packet_pool_alloc(state->packet_pool, sei->size);
+    if(!packet) {
+        voodoo_trace_event(state, VOODOO_EVENT_ALLOC_FAILED, VOODOO_LOG_WARN, sei->size, "alloc packet failed");
+        return;
+    }
+    memcpy(packet->data, sei->payload, sei->size);
+    packet->flag = flag;
+    packet->next = NULL;
+    if(state->sei_tail) {
+        state->sei_tail->next = packet;
+    } else {
+        state->sei_head = packet;
+    }
+    state->sei_tail = packet;
+}
+
+/*
+ 在改写之前的原始数据上找sei，只读sei nal本身。没有pool时直接回调，
+ 所以要在视频packet回调之后调用；有pool时拷出来等voodoo_flush_sei
+ */
+static void voodoo_collect_sei(flv_demuxer_context_t *state, const uint8_t *data, uint32_t size) {
+    if(state->nal_length_size == 0 || state->frame_codec_id != state->nal_codec_id) {
+        return;
+    }
+    nal_for_each_sei(state->nal_codec_id, data, size, state->nal_length_size, voodoo_sei_callback, state);
+}
+
+static void voodoo_flush_sei(flv_demuxer_context_t *state) {
+    demuxer_packet_t *packet = state->sei_head;
+    state->sei_head = state->sei_tail = NULL;
+    while(packet) {
+        demuxer_packet_t *next = packet->next;
+        voodoo_emit_packet(state, packet, VOODOO_DATA_TYPE_SEI, packet->flag);
+        packet = next;
+    }
+}
+
+/*
+ 按nal_format改写后回调，返回0表示不用改，按原样回调。
+ owned是已经装着data的pooled packet（分片模式拼好的），能原地改就直接用，
+ 返回1时owned已经交出去或释放
+ */
+static int voodoo_emit_nal_format(flv_demuxer_context_t *state, int type, const uint8_t *data, uint32_t size, uint32_t flag, demuxer_packet_t *owned) {
+    int format = state->nal_format;
+    int hevc = state->nal_codec_id == VIDEO_CODEC_ID_HEVC;
+    demuxer_packet_t *packet = NULL;
+    uint8_t *out;
+    uint32_t out_size;
+    nal_scan_t scan;
+    /*
+     长度已经是4字节，没有要补的参数集和防竞争字节，只需把长度改成起始码
+     */
+    int swap_start_codes = 0;
+
+    if(state->nal_length_size == 0) {
+        return 0;
+    }
+    if(type == VOODOO_DATA_TYPE_VIDEO_PARAMETERS) {
+        /*
+         length4输出时记录里的lengthSizeMinusOne也要改成3
+         */
+        if(format != VOODOO_NAL_FORMAT_LENGTH4 || state->nal_length_size == 4) {
+            return 0;
+        }
+        out_size = size;
+    } else {
+        if(state->frame_codec_id != state->nal_codec_id) {
+            return 0;
+        }
+        if(nal_scan(state->nal_codec_id, data, size, state->nal_length_size, &scan) < 0) {
+            voodoo_trace_event(state, VOODOO_EVENT_NAL_FORMAT, VOODOO_LOG_DEBUG, size, "video packet is neither length prefixed nor annex-b");
+            return 0;
+        }
+        const int inject = format == VOODOO_NAL_FORMAT_ANNEXB && (flag & VOODOO_VIDEO_PACKET_FLAG_IS_KEY_FRAME) && !scan.has_parameter_sets;
+        if(scan.input_annexb ? format == VOODOO_NAL_FORMAT_ANNEXB && !inject : format == VOODOO_NAL_FORMAT_LENGTH4 && state->nal_length_size == 4) {
+            return 0;
+        }
+        swap_start_codes = format == VOODOO_NAL_FORMAT_ANNEXB && !scan.input_annexb && state->nal_length_size == 4 && scan.escapes == 0 && !inject;
+        out_size = swap_start_codes ? size : nal_output_size(&scan, format, (flag & VOODOO_VIDEO_PACKET_FLAG_IS_KEY_FRAME) ? state->nal_parameters_size : 0);
+        if(owned && swap_start_codes) {
+            nal_length4_to_annexb_inplace(owned->data, size);
+            voodoo_emit_packet(state, owned, type, flag);
+            return 1;
+        }
+    }
+
+    if(state->packet_pool) {
+        packet = packet_pool_alloc(state->packet_pool, out_size);
+        if(!packet) {
+            voodoo_trace_event(state, VOODOO_EVENT_ALLOC_FAILED, VOODOO_LOG_WARN, out_size, "alloc packet failed");
+            if(owned) {
+                demuxer_packet_release(owned);
             }
-            state->seek_to_next_i_frame = 0;
+            return 1;
         }
-        
+        out = packet->data;
+    } else {
+        if(voodoo_reserve_buffer(state, &state->nal_scratch, &state->nal_scratch_capacity, out_size) < 0) {
+            return 1;
+        }
+        out = state->nal_scratch;
+    }
+
+    if(type == VOODOO_DATA_TYPE_VIDEO_PARAMETERS) {
+        memcpy(out, data, size);
+        out[hevc ? 21 : 4] |= 0x3;
+    } else if(swap_start_codes) {
         /*
-         todo: need to fix leading bytes for android muxer
+         拷过去原地改起始码
          */
-        state->callback(state->userdata, VOODOO_DATA_TYPE_VIDEO_PACKET, s->buf + s->pos, state->tag_size - 5, state->ts, frame_type == FLV_FRAME_KEY ? VOODOO_VIDEO_PACKET_FLAG_IS_KEY_FRAME : 0);
-        
-        
-    } else if(packetType == 2) {
-        return 0;
+        memcpy(out, data, size);
+        nal_length4_to_annexb_inplace(out, size);
     } else {
-        return -1;
+        nal_convert(data, size, state->nal_length_size, &scan, format,
+                    (flag & VOODOO_VIDEO_PACKET_FLAG_IS_KEY_FRAME) ? state->nal_parameters : NULL, state->nal_parameters_size, out);
     }
-    return 0;
+
+    if(owned) {
+        demuxer_packet_release(owned);
+    }
+    if(packet) {
+        voodoo_emit_packet(state, packet, type, flag);
+    } else {
+        state->callback(state->userdata, type, out, (int)out_size, state->ts, flag);
+    }
+    return 1;
+}
+
+static void voodoo_deliver_data(flv_demuxer_context_t *state, int type, const uint8_t *data, uint32_t size, uint32_t flag) {
+    if(state->nal_format != VOODOO_NAL_FORMAT_PASSTHROUGH &&
+       (type == VOODOO_DATA_TYPE_VIDEO_PACKET || type == VOODOO_DATA_TYPE_VIDEO_PARAMETERS) &&
+       voodoo_emit_nal_format(state, type, data, size, flag, NULL)) {
+        return;
+    }
+    if(!state->packet_pool) {
+        state->callback(state->userdata, type, (void*)data, (int)size, state->ts, flag);
+        return;
+    }
+    demuxer_packet_t *packet = packet_pool_alloc(state->packet_pool, size);
+    if(!packet) {
+        voodoo_trace_event(state, VOODOO_EVENT_ALLOC_FAILED, VOODOO_LOG_WARN, size, "alloc packet failed");
+        return;
+    }
+    memcpy(packet->data, data, size);
+    voodoo_emit_packet(state, packet, type, flag);
+}
+
+static void voodoo_emit_data(flv_demuxer_context_t *state, int type, const uint8_t *data, uint32_t size, uint32_t flag) {
+    if(type == VOODOO_DATA_TYPE_VIDEO_PARAMETERS) {
+        voodoo_parse_video_parameters(state, data, size, flag);
+        voodoo_update_nal_parameters(state, data, size, flag);
+    }
+    voodoo_deliver_data(state, type, data, size, flag);
+    /*
+     tag body还在，sei跟在它的视频packet后面
+     */
+    if(state->sei_enabled && type == VOODOO_DATA_TYPE_VIDEO_PACKET) {
+        voodoo_collect_sei(state, data, size);
+        voodoo_flush_sei(state);
+    }
+}
+
+/*
+ 分片模式下有packet pool时，分片直接拼进一个完整的packet里
+ */
+static void voodoo_begin_fragments(flv_demuxer_context_t *state) {
+    state->frag_flag |= VOODOO_PACKET_FLAG_FRAGMENT | VOODOO_PACKET_FLAG_FRAGMENT_BEGIN;
+    state->frag_offset = 0;
+    if(state->frag_type > 0 && state->packet_pool) {
+        state->frag_packet = packet_pool_alloc(state->packet_pool, state->frag_left);
+        if(!state->frag_packet) {
+            voodoo_trace_event(state, VOODOO_EVENT_ALLOC_FAILED, VOODOO_LOG_WARN, state->frag_left, "alloc packet failed");
+        }
+    }
+}
+
+static void voodoo_emit_fragment(flv_demuxer_context_t *state, const uint8_t *data, uint32_t size) {
+    if(state->frag_type <= 0) {
+        return;
+    }
+    if(!state->packet_pool) {
+        state->callback(state->userdata, state->frag_type, (void*)data, (int)size, state->ts, state->frag_flag | (state->frag_left == 0 ? VOODOO_PACKET_FLAG_FRAGMENT_END : 0));
+        state->frag_flag &= ~VOODOO_PACKET_FLAG_FRAGMENT_BEGIN;
+        return;
+    }
+    if(!state->frag_packet) {
+        return;
+    }
+    memcpy(state->frag_packet->data + state->frag_offset, data, size);
+    state->frag_offset += size;
+    if(state->frag_left == 0) {
+        demuxer_packet_t *packet = state->frag_packet;
+        uint32_t flag = state->frag_flag & ~(VOODOO_PACKET_FLAG_FRAGMENT | VOODOO_PACKET_FLAG_FRAGMENT_BEGIN);
+        state->frag_packet = NULL;
+        /*
+         packet会被交出去或原地改写，sei先拷出来，等视频packet发出后再发
+         */
+        if(state->sei_enabled && state->frag_type == VOODOO_DATA_TYPE_VIDEO_PACKET) {
+            voodoo_collect_sei(state, packet->data, packet->size);
+        }
+        if(state->nal_format == VOODOO_NAL_FORMAT_PASSTHROUGH ||
+           state->frag_type != VOODOO_DATA_TYPE_VIDEO_PACKET ||
+           !voodoo_emit_nal_format(state, state->frag_type, packet->data, packet->size, flag, packet)) {
+            voodoo_emit_packet(state, packet, state->frag_type, flag);
+        }
+        voodoo_flush_sei(state);
+    }
+}
+
+/*
+ onMetaData里的keyframes.filepositions/times，开启索引时加进索引
+ */
+static void voodoo_parse_keyframes(flv_demuxer_context_t *state, amf0_reader_t *r) {
+    const char *key;
+    uint32_t key_len;
+    int marker;
+    int64_t count, positions_count = -1, times_count = -1;
+    amf0_reader_t positions, times;
+
+    if(amf0_read_container(r, &marker, &count) < 0 || marker == AMF0_STRICT_ARRAY) {
+        return;
+    }
+    while(!r->error && !amf0_is_object_end(r)) {
+        if(amf0_read_key(r, &key, &key_len) < 0) {
+            return;
+        }
+        if(amf0_peek_type(r) == AMF0_STRICT_ARRAY &&
+           (AMF0_KEY_IS(key, key_len, "filepositions") || AMF0_KEY_IS(key, key_len, "times"))) {
+            amf0_reader_t *arr = AMF0_KEY_IS(key, key_len, "times") ? &times : &positions;
+            amf0_read_container(r, &marker, AMF0_KEY_IS(key, key_len, "times") ? &times_count : &positions_count);
+            *arr = *r;
+            r->pos -= 5;
+        }
+        amf0_skip_value(r);
+    }
+    if(positions_count < 0 || positions_count != times_count) {
+        return;
+    }
+    state->metadata.keyframe_count = (uint32_t)positions_count;
+    if(!state->index_enabled) {
+        return;
+    }
+    for(int64_t i = 0;i < positions_count;++i) {
+        double pos, time;
+        if(amf0_read_number(&positions, &pos) < 0 || amf0_read_number(&times, &time) < 0) {
+            return;
+        }
+        voodoo_index_add(state, (int64_t)(time * 1000), (int64_t)pos);
+    }
+}
+
+static void voodoo_metadata_set(flv_demuxer_context_t *state, const char *key, double value) {
+    flv_metadata_t *m = &state->metadata;
+    if(strcmp(key, "duration") == 0) m->duration = value;
+    else if(strcmp(key, "width") == 0) m->width = value;
+    else if(strcmp(key, "height") == 0) m->height = value;
+    else if(strcmp(key, "framerate") == 0) m->framerate = value;
+    else if(strcmp(key, "videodatarate") == 0) m->videodatarate = value;
+    else if(strcmp(key, "videocodecid") == 0) m->videocodecid = value;
+    else if(strcmp(key, "audiodatarate") == 0) m->audiodatarate = value;
+    else if(strcmp(key, "audiosamplerate") == 0) m->audiosamplerate = value;
+    else if(strcmp(key, "audiosamplesize") == 0) m->audiosamplesize = value;
+    else if(strcmp(key, "audiocodecid") == 0) m->audiocodecid = value;
+    else if(strcmp(key, "stereo") == 0) m->stereo = value != 0;
+    else if(strcmp(key, "filesize") == 0) m->filesize = value;
+}
+
+/*
+ 标量属性拍平到entries里，嵌套对象的key用"parent.child"
+ */
+static void voodoo_parse_metadata_object(flv_demuxer_context_t *state, amf0_reader_t *r, const char *prefix, uint32_t prefix_len, int depth) {
+    const char *key, *str;
+    uint32_t key_len, str_len;
+    int marker, type;
+    int64_t count;
+    flv_metadata_t *m = &state->metadata;
+
+    if(amf0_read_container(r, &marker, &count) < 0 || marker == AMF0_STRICT_ARRAY) {
+        return;
+    }
+    while(!r->error && !amf0_is_object_end(r)) {
+        if(amf0_read_key(r, &key, &key_len) < 0) {
+            return;
+        }
+        type = amf0_peek_type(r);
+        if(depth == 0 && AMF0_KEY_IS(key, key_len, "keyframes") && (type == AMF0_OBJECT || type == AMF0_ECMA_ARRAY)) {
+            voodoo_parse_keyframes(state, r);
+            continue;
+        }
+        if(prefix_len + key_len + 1 >= FLV_METADATA_KEY_SIZE) {
+            amf0_skip_value(r);
+            continue;
+        }
+        char full_key[FLV_METADATA_KEY_SIZE];
+        memcpy(full_key, prefix, prefix_len);
+        memcpy(full_key + prefix_len, key, key_len);
+        full_key[prefix_len + key_len] = 0;
+
+        if((type == AMF0_OBJECT || type == AMF0_ECMA_ARRAY) && depth < 1) {
+            full_key[prefix_len + key_len] = '.';
+            voodoo_parse_metadata_object(state, r, full_key, prefix_len + key_len + 1, depth + 1);
+            continue;
+        }
+        if((type != AMF0_NUMBER && type != AMF0_BOOLEAN && type != AMF0_STRING) ||
+           m->entry_count >= FLV_METADATA_MAX_ENTRIES) {
+            amf0_skip_value(r);
+            continue;
+        }
+        flv_metadata_entry_t *entry = &m->entries[m->entry_count];
+        memset(entry, 0, sizeof(flv_metadata_entry_t));
+        memcpy(entry->key, full_key, prefix_len + key_len + 1);
+        if(type == AMF0_NUMBER) {
+            if(amf0_read_number(r, &entry->number) < 0) return;
+            entry->type = FLV_METADATA_TYPE_NUMBER;
+        } else if(type == AMF0_BOOLEAN) {
+            int b;
+            if(amf0_read_boolean(r, &b) < 0) return;
+            entry->number = b;
+            entry->type = FLV_METADATA_TYPE_BOOLEAN;
+        } else {
+            if(amf0_read_string(r, &str, &str_len) < 0) return;
+            str_len = VPMIN(str_len, FLV_METADATA_STRING_SIZE - 1);
+            memcpy(entry->string, str, str_len);
+            entry->type = FLV_METADATA_TYPE_STRING;
+        }
+        if(depth == 0 && type != AMF0_STRING) {
+            voodoo_metadata_set(state, entry->key, entry->number);
+        }
+        ++m->entry_count;
+    }
+}
+
+static void voodoo_parse_script_tag(flv_demuxer_context_t *state) {
+    amf0_reader_t reader;
+    amf0_reader_t *r = &reader;
+    const char *name;
+    uint32_t name_len;
+
+    AMF0_INIT(r, state->stream.buf + state->stream.pos, state->tag_size);
+    if(amf0_read_string(r, &name, &name_len) < 0) {
+        return;
+    }
+    /*
+     rtmp推流过来的是@setDataFrame + onMetaData
+     */
+    if(AMF0_KEY_IS(name, name_len, "@setDataFrame") && amf0_read_string(r, &name, &name_len) < 0) {
+        return;
+    }
+    if(!AMF0_KEY_IS(name, name_len, "onMetaData")) {
+        return;
+    }
+    memset(&state->metadata, 0, sizeof(flv_metadata_t));
+    voodoo_parse_metadata_object(state, r, "", 0, 0);
+    state->metadata.parsed = 1;
+
+    if(state->video_width == 0 && state->video_height == 0) {
+        state->video_width = (int)state->metadata.width;
+        state->video_height = (int)state->metadata.height;
+    }
+    state->callback(state->userdata, VOODOO_DATA_TYPE_METADATA, &state->metadata, (int)sizeof(flv_metadata_t), state->ts, 0);
 }
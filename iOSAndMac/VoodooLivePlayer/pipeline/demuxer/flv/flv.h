@@ -10,12 +10,213 @@
 #define flv_h
 
 #include "demuxer.h"
+#include "packet_pool.h"
+#include "gop_cache.h"
+#include "video_sps.h"
+#include "nal_format.h"
+#include "demuxer_trace.h"
 
 void* flv_demuxer_init(void* userdata, fn_demuxer_callback_t callback);
+void* flv_demuxer_init_with_config(void* userdata, fn_demuxer_callback_t callback, const demuxer_config_t* config);
 void flv_demuxer_fint(void* ctx);
 int flv_demuxer_feed(void* ctx, const void* data, int len);
 
+/*
+ one complete tag body (no 11 byte tag header, no prev tag size) from a
+ transport that frames tags itself, e.g. rtmp audio/video/data messages.
+ goes through the same header parsing and delivery as flv_demuxer_feed.
+ */
+int flv_demuxer_feed_tag(void* ctx, int tag_type, uint32_t timestamp, const void* data, uint32_t size);
+
 void flv_demuxer_seek_to_next_i_frame(void* ctx);
+/*
+ drops every audio and video packet while set, prefer flv_demuxer_set_drop_level
+ */
 void flv_demuxer_set_skip_frames(void* ctx, int skip);
 
+/*
+ graduated video frame dropping for a decoder that falls behind, audio is
+ never dropped. each level also drops what the levels below it drop:
+ NON_REFERENCE    frames nothing refers to: flv disposable inter, avc
+                  nal_ref_idc 0, hevc sub-layer non-reference pictures of
+                  the highest temporal layer
+ TEMPORAL_LAYERS  hevc pictures with TemporalId > 0
+ TO_KEYFRAMES     every frame but keyframes
+ raising takes effect at once, lowering waits for the next keyframe so the
+ decoder never sees a frame whose references were dropped. may be called
+ from any thread. counted in dropped_* of demuxer_stats_t by frame kind.
+ */
+#define VOODOO_DROP_NONE                0
+#define VOODOO_DROP_NON_REFERENCE       1
+#define VOODOO_DROP_TEMPORAL_LAYERS     2
+#define VOODOO_DROP_TO_KEYFRAMES        3
+
+void flv_demuxer_set_drop_level(void* ctx, int level);
+/*
+ level in effect, may lag the requested one until a keyframe
+ */
+int flv_demuxer_drop_level(void* ctx);
+/*
+ tag body not fully buffered is delivered in fragments flagged with
+ VOODOO_PACKET_FLAG_FRAGMENT_BEGIN/END instead of waiting for the whole tag.
+ */
+void flv_demuxer_set_chunked_mode(void* ctx, int enable);
+/*
+ framing of h264/hevc video packets:
+ PASSTHROUGH  as muxed, the default
+ ANNEXB       start codes, missing emulation prevention bytes added, the
+              parameter sets of the latest sequence header in front of every
+              keyframe that does not carry its own
+ LENGTH4      4 byte lengths whatever lengthSizeMinusOne says, payloads some
+              android muxers write with start codes are converted as well.
+              parameters packets get lengthSizeMinusOne patched to match
+ parameters packets stay decoder configuration records. pooled packets with
+ 4 byte lengths are rewritten in place. chunked mode without a pool delivers
+ fragments as received, av1 always passes through.
+ */
+#define VOODOO_NAL_FORMAT_PASSTHROUGH   0
+#define VOODOO_NAL_FORMAT_ANNEXB        NAL_FORMAT_ANNEXB
+#define VOODOO_NAL_FORMAT_LENGTH4       NAL_FORMAT_LENGTH4
+
+void flv_demuxer_set_nal_format(void* ctx, int format);
+
+/*
+ h264/hevc sei messages (user_data_unregistered encoder clocks, pic timing,
+ time codes) of every video packet are delivered as VOODOO_DATA_TYPE_SEI
+ right after the packet. without a pool through fn_demuxer_callback_t,
+ pointing into the tag, nothing copied. with a pool each payload is copied
+ into a pooled packet that goes the way of the video packets, to the packet
+ callback or the read_packets queue, so it keeps its order and lives as
+ long as its reference. nothing is scanned while disabled, only sei nal
+ units are read. chunked mode without a pool delivers none.
+ */
+void flv_demuxer_set_sei_extraction(void* ctx, int enable);
+
+/*
+ on a framing error (reserved tag type bits, unknown tag type, oversized tag,
+ bad header offset, PreTagSize not matching the tag) scan forward from the
+ byte after the bad tag's start to the next tag whose type, stream id and
+ PreTagSize are consistent instead of stopping. a tag is only delivered
+ once its PreTagSize matched, chunked mode excepted. a tag that is not in
+ the buffer yet is only waited for when it is up to 64 KB, or up to 2 MB
+ with a timestamp within 30 s of the last good tag and the same codec, so
+ garbage never grows the cache to max_cache_size. counted in resyncs and
+ resync_bytes_skipped of demuxer_stats_t.
+ */
+void flv_demuxer_set_resync(void* ctx, int enable);
+
+/*
+ current stream cache size and the most bytes it ever held
+ */
+uint32_t flv_demuxer_cache_size(void* ctx);
+uint32_t flv_demuxer_cache_high_water(void* ctx);
+/*
+ bytes copied or moved into the stream cache so far
+ */
+uint64_t flv_demuxer_cache_bytes_moved(void* ctx);
+
+/*
+ counters are safe to read from any thread while feeding. events are
+ drained oldest first by a single reader, returns the number copied.
+ log callback is called on the feeding thread for messages at or below level.
+ */
+void flv_demuxer_get_stats(void* ctx, demuxer_stats_t* stats);
+int flv_demuxer_read_events(void* ctx, demuxer_event_t* events, int max);
+void flv_demuxer_set_log_callback(void* ctx, fn_demuxer_log_callback_t callback, void* opaque, int level);
+
+/*
+ audio/video parameters and packets are copied into ref-counted packets
+ from pool and delivered through callback instead of fn_demuxer_callback_t,
+ media flags still use fn_demuxer_callback_t. pass a NULL pool to switch back.
+ with a NULL callback packets are queued for flv_demuxer_read_packets.
+ */
+void flv_demuxer_set_packet_pool(void* ctx, packet_pool_t* pool, fn_demuxer_packet_callback_t callback);
+/*
+ pooled packets are also pushed into cache, which keeps the current gop for
+ consumers that attach later. needs a packet pool, NULL detaches.
+ the cache is not owned by the demuxer.
+ */
+void flv_demuxer_set_gop_cache(void* ctx, gop_cache_t* cache);
+/*
+ moves up to max queued packets into packets in stream order and returns
+ the count, the caller owns one reference of each. drain after every feed,
+ and from fn_demuxer_callback_t before handling it: the packets queued so
+ far came before that callback in the stream.
+ */
+int flv_demuxer_read_packets(void* ctx, demuxer_packet_t** packets, int max);
+
+/*
+ keyframe index for recorded flv, built from keyframe tags while parsing
+ and from onMetaData keyframes.filepositions/times.
+ pos is the absolute offset of the tag header.
+ */
+typedef struct flv_index_entry_s {
+    int64_t dts;
+    int64_t pos;
+} flv_index_entry_t;
+
+void flv_demuxer_enable_index(void* ctx, int enable);
+/*
+ entries sorted by dts, valid until the next feed or seek
+ */
+int flv_demuxer_get_index(void* ctx, const flv_index_entry_t** entries);
+/*
+ finds the last keyframe at or before ts (ms) and resets the parser to a tag
+ boundary. returns the byte offset to resume feeding from, -1 when no index.
+ */
+int64_t flv_demuxer_seek(void* ctx, int64_t ts);
+
+/*
+ onMetaData decoded into fixed size storage, delivered once per script tag
+ through fn_demuxer_callback_t as VOODOO_DATA_TYPE_METADATA.
+ number/boolean/string properties are kept in entries, nested objects
+ flattened to "parent.child" keys, keyframes arrays go to the index.
+ */
+#define FLV_METADATA_MAX_ENTRIES    32
+#define FLV_METADATA_KEY_SIZE       32
+#define FLV_METADATA_STRING_SIZE    64
+
+#define FLV_METADATA_TYPE_NUMBER    0
+#define FLV_METADATA_TYPE_BOOLEAN   1
+#define FLV_METADATA_TYPE_STRING    2
+
+typedef struct flv_metadata_entry_s {
+    char key[FLV_METADATA_KEY_SIZE];
+    int type;                   /*  FLV_METADATA_TYPE_*     */
+    double number;              /*  number and boolean      */
+    char string[FLV_METADATA_STRING_SIZE];
+} flv_metadata_entry_t;
+
+typedef struct flv_metadata_s {
+    int parsed;
+    double duration;
+    double width;
+    double height;
+    double framerate;
+    double videodatarate;
+    double videocodecid;
+    double audiodatarate;
+    double audiosamplerate;
+    double audiosamplesize;
+    double audiocodecid;
+    double filesize;
+    int stereo;
+    uint32_t keyframe_count;
+
+    uint32_t entry_count;
+    flv_metadata_entry_t entries[FLV_METADATA_MAX_ENTRIES];
+} flv_metadata_t;
+
+/*
+ NULL before the first onMetaData
+ */
+const flv_metadata_t* flv_demuxer_get_metadata(void* ctx);
+const flv_metadata_entry_t* flv_metadata_find(const flv_metadata_t* metadata, const char* key);
+
+/*
+ SPS of the last sequence header, NULL before the first one.
+ parsed before VOODOO_DATA_TYPE_VIDEO_PARAMETERS is delivered.
+ */
+const video_sps_info_t* flv_demuxer_get_video_info(void* ctx);
+
 #endif /* flv_h */
@@ -0,0 +1,449 @@
+//
+//  flv_probe.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#include "flv_probe.h"
+#include "pt.h"
+#include "amf0.h"
+#include "bitreader.h"
+#include "video_sps.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FLV_PROBE_HEADER_SIZE       9
+#define FLV_PROBE_TAG_HEADER_SIZE   11
+#define FLV_PROBE_PREV_TAG_SIZE     4
+
+#define FLV_PROBE_STATE_HEADER      0
+#define FLV_PROBE_STATE_TAG_HEADER  1
+#define FLV_PROBE_STATE_TAG_BODY    2
+#define FLV_PROBE_STATE_SKIP        3
+
+/*
+ 先只收tag body开头这么多，够判断是不是sequence header/关键帧
+ */
+#define FLV_PROBE_AUDIO_PEEK        2
+#define FLV_PROBE_VIDEO_PEEK        5
+
+#define FLV_PROBE_FOURCC(a,b,c,d)   (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+
+/*
+ demuxer的protothread要整个tag都在缓存里，这里只能留tag开头一小段，
+ 所以自己按状态逐段收：需要的字节拷进buffer，其余直接跳过
+ */
+struct flv_probe_s {
+    flv_probe_info_t info;
+    uint32_t max_bytes;
+    uint32_t max_ms;
+    fn_demuxer_free_t free_fn;
+    void *allocator_opaque;
+
+    int result;
+    int state;
+    uint32_t want;              /*  bytes buffer should hold    */
+    uint32_t fill;
+    uint32_t skip;
+
+    uint8_t tag_type;
+    uint32_t tag_size;
+    int64_t tag_dts;
+    uint64_t tag_offset;
+    int64_t first_dts;
+    uint32_t seen_flag;         /*  media actually found in tags */
+
+    uint8_t buffer[FLV_PROBE_BUFFER_SIZE];
+};
+
+static const int flv_probe_sound_rates[4] = { 5512, 11025, 22050, 44100 };
+static const int flv_probe_aac_rates[13] = { 96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350 };
+
+flv_probe_t* flv_probe_create(uint32_t max_bytes, uint32_t max_ms, const demuxer_config_t* allocator) {
+    fn_demuxer_malloc_t malloc_fn;
+    fn_demuxer_free_t free_fn;
+    void *opaque;
+    demuxer_select_allocator(allocator, &malloc_fn, &free_fn, &opaque);
+    flv_probe_t *probe = (flv_probe_t*)malloc_fn(opaque, sizeof(flv_probe_t));
+    if(!probe) {
+        return NULL;
+    }
+    probe->max_bytes = max_bytes ? max_bytes : FLV_PROBE_DEFAULT_MAX_BYTES;
+    probe->max_ms = max_ms ? max_ms : FLV_PROBE_DEFAULT_MAX_MS;
+    probe->free_fn = free_fn;
+    probe->allocator_opaque = opaque;
+    flv_probe_reset(probe);
+    return probe;
+}
+
+void flv_probe_destroy(flv_probe_t* probe) {
+    if(!probe) {
+        return;
+    }
+    probe->free_fn(probe->allocator_opaque, probe);
+}
+
+void flv_probe_reset(flv_probe_t* probe) {
+    /*
+     buffer不用清，fill归零就行
+     */
+    memset(&probe->info, 0, sizeof(flv_probe_info_t));
+    probe->info.audio_format = -1;
+    probe->info.keyframe_dts = VOODOO_NOPTS_VALUE;
+    probe->result = FLV_PROBE_NEED_MORE;
+    probe->state = FLV_PROBE_STATE_HEADER;
+    probe->want = FLV_PROBE_HEADER_SIZE;
+    probe->fill = 0;
+    probe->skip = 0;
+    probe->tag_type = 0;
+    probe->tag_size = 0;
+    probe->tag_dts = 0;
+    probe->tag_offset = 0;
+    probe->first_dts = VOODOO_NOPTS_VALUE;
+    probe->seen_flag = 0;
+}
+
+const flv_probe_info_t* flv_probe_get_info(flv_probe_t* probe) {
+    return &probe->info;
+}
+
+uint32_t flv_probe_memory_size(void) {
+    return (uint32_t)sizeof(flv_probe_t);
+}
+
+/*
+ 头里的音视频标志不一定可靠，有的服务器写0，有的纯视频也写5。
+ 头里说有的和tag里真看到的都算上，都没有就当音视频都有，等超时兜底
+ */
+static int flv_probe_is_complete(flv_probe_t *probe) {
+    const flv_probe_info_t *info = &probe->info;
+    uint32_t expect = info->media_flag | probe->seen_flag;
+    if(expect == 0) {
+        expect = FLV_PROBE_MEDIA_VIDEO | FLV_PROBE_MEDIA_AUDIO;
+    }
+    if((expect & FLV_PROBE_MEDIA_VIDEO) &&
+       (info->found & (FLV_PROBE_FOUND_VIDEO_CONFIG | FLV_PROBE_FOUND_KEYFRAME)) != (FLV_PROBE_FOUND_VIDEO_CONFIG | FLV_PROBE_FOUND_KEYFRAME)) {
+        return 0;
+    }
+    if((expect & FLV_PROBE_MEDIA_AUDIO) && !(info->found & FLV_PROBE_FOUND_AUDIO_CONFIG)) {
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ 只取顶层的数值属性，keyframes之类的大对象都在后面，被截断了也不影响前面已经取到的
+ */
+static void flv_probe_parse_script(flv_probe_t *probe) {
+    amf0_reader_t reader;
+    amf0_reader_t *r = &reader;
+    const char *name, *key;
+    uint32_t name_len, key_len;
+    int marker;
+    int64_t count;
+    double value;
+    flv_probe_info_t *info = &probe->info;
+
+    AMF0_INIT(r, probe->buffer, probe->fill);
+    if(amf0_read_string(r, &name, &name_len) < 0) {
+        return;
+    }
+    if(AMF0_KEY_IS(name, name_len, "@setDataFrame") && amf0_read_string(r, &name, &name_len) < 0) {
+        return;
+    }
+    if(!AMF0_KEY_IS(name, name_len, "onMetaData")) {
+        return;
+    }
+    if(amf0_read_container(r, &marker, &count) < 0 || marker == AMF0_STRICT_ARRAY) {
+        return;
+    }
+    info->found |= FLV_PROBE_FOUND_METADATA;
+    while(!r->error && !amf0_is_object_end(r)) {
+        if(amf0_read_key(r, &key, &key_len) < 0) {
+            return;
+        }
+        if(amf0_peek_type(r) != AMF0_NUMBER) {
+            amf0_skip_value(r);
+            continue;
+        }
+        if(amf0_read_number(r, &value) < 0) {
+            return;
+        }
+        if(AMF0_KEY_IS(key, key_len, "duration")) info->duration = value;
+        else if(AMF0_KEY_IS(key, key_len, "width")) info->meta_width = value;
+        else if(AMF0_KEY_IS(key, key_len, "height")) info->meta_height = value;
+        else if(AMF0_KEY_IS(key, key_len, "framerate")) info->meta_frame_rate = value;
+        else if(AMF0_KEY_IS(key, key_len, "videodatarate")) info->video_data_rate = value;
+        else if(AMF0_KEY_IS(key, key_len, "audiodatarate")) info->audio_data_rate = value;
+    }
+}
+
+/*
+ AudioSpecificConfig：object type、采样率和声道。
+ 显式带SBR/PS的按扩展后的采样率算，PS解出来是立体声
+ */
+static void flv_probe_parse_asc(flv_probe_info_t *info, const uint8_t *p, uint32_t size) {
+    bitreader_t br;
+    BR_INIT(&br, p, size);
+    int object_type = (int)BR_READ(&br, 5);
+    if(object_type == 31) {
+        object_type = 32 + (int)BR_READ(&br, 6);
+    }
+    uint32_t index = BR_READ(&br, 4);
+    int sample_rate = index == 15 ? (int)BR_READ(&br, 24) : index < 13 ? flv_probe_aac_rates[index] : 0;
+    int channel_config = (int)BR_READ(&br, 4);
+    if(object_type == 5 || object_type == 29) {
+        index = BR_READ(&br, 4);
+        sample_rate = index == 15 ? (int)BR_READ(&br, 24) : index < 13 ? flv_probe_aac_rates[index] : 0;
+        if(object_type == 29 && channel_config == 1) {
+            channel_config = 2;
+        }
+    }
+    if(BR_ERROR(&br)) {
+        return;
+    }
+    info->audio_object_type = object_type;
+    if(sample_rate > 0) {
+        info->sample_rate = sample_rate;
+    }
+    /*
+     0是PCE里写的，就用tag头里的
+     */
+    if(channel_config >= 1 && channel_config <= 6) {
+        info->channels = channel_config;
+    } else if(channel_config == 7) {
+        info->channels = 8;
+    }
+}
+
+/*
+ 返回还要多收到多少字节再来一次，0表示这个tag看完了
+ */
+static uint32_t flv_probe_audio_tag(flv_probe_t *probe) {
+    flv_probe_info_t *info = &probe->info;
+    const uint8_t *p = probe->buffer;
+    if(probe->fill < 1) {
+        return 0;
+    }
+    probe->seen_flag |= FLV_PROBE_MEDIA_AUDIO;
+    int format = p[0] >> 4;
+    info->audio_format = format;
+    info->sample_rate = flv_probe_sound_rates[(p[0] >> 2) & 0x03];
+    info->channels = (p[0] & 0x01) + 1;
+    if(format != FLV_PROBE_AUDIO_AAC) {
+        info->found |= FLV_PROBE_FOUND_AUDIO_CONFIG;
+        return 0;
+    }
+    /*
+     aac要等到sequence header，前面的raw帧只看头两个字节
+     */
+    if(probe->fill < 2 || p[1] != 0) {
+        return 0;
+    }
+    if(probe->fill < probe->tag_size && probe->fill < FLV_PROBE_BUFFER_SIZE) {
+        return (probe->tag_size < FLV_PROBE_BUFFER_SIZE ? probe->tag_size : FLV_PROBE_BUFFER_SIZE) - probe->fill;
+    }
+    flv_probe_parse_asc(info, p + 2, probe->fill - 2);
+    info->found |= FLV_PROBE_FOUND_AUDIO_CONFIG;
+    return 0;
+}
+
+static uint32_t flv_probe_video_tag(flv_probe_t *probe) {
+    flv_probe_info_t *info = &probe->info;
+    const uint8_t *p = probe->buffer;
+    uint8_t frame_type;
+    int codec_id;
+    int is_config = 0, is_frame = 0;
+
+    if(probe->fill < FLV_PROBE_VIDEO_PEEK) {
+        return 0;
+    }
+    probe->seen_flag |= FLV_PROBE_MEDIA_VIDEO;
+    if(p[0] & 0x80) {
+        frame_type = (p[0] & 0x70) >> 4;
+        uint8_t packet_type = p[0] & 0x0f;
+        switch(FLV_PROBE_FOURCC(p[1], p[2], p[3], p[4])) {
+            case FLV_PROBE_FOURCC('a','v','c','1'): codec_id = VIDEO_CODEC_ID_H264; break;
+            case FLV_PROBE_FOURCC('h','v','c','1'): codec_id = VIDEO_CODEC_ID_HEVC; break;
+            case FLV_PROBE_FOURCC('a','v','0','1'): codec_id = VIDEO_CODEC_ID_AV1; break;
+            default: return 0;
+        }
+        is_config = packet_type == 0;
+        is_frame = packet_type == 1 || packet_type == 3;
+    } else {
+        frame_type = p[0] >> 4;
+        codec_id = p[0] & 0x0f;
+        if(codec_id != VIDEO_CODEC_ID_H264 && codec_id != VIDEO_CODEC_ID_HEVC) {
+            /*
+             老编码没有sequence header，看到帧就算拿到了
+             */
+            info->video_codec_id = codec_id;
+            info->found |= FLV_PROBE_FOUND_VIDEO_CONFIG;
+            is_frame = 1;
+        } else {
+            is_config = p[1] == 0;
+            is_frame = p[1] == 1;
+        }
+    }
+    if(frame_type == 5) {
+        return 0;
+    }
+
+    if(is_config && !(info->found & FLV_PROBE_FOUND_VIDEO_CONFIG)) {
+        if(probe->fill < probe->tag_size && probe->fill < FLV_PROBE_BUFFER_SIZE) {
+            return (probe->tag_size < FLV_PROBE_BUFFER_SIZE ? probe->tag_size : FLV_PROBE_BUFFER_SIZE) - probe->fill;
+        }
+        video_sps_info_t sps;
+        int ret;
+        memset(&sps, 0, sizeof(sps));
+        if(codec_id == VIDEO_CODEC_ID_H264) {
+            ret = avc_parse_decoder_config(p + FLV_PROBE_VIDEO_PEEK, probe->fill - FLV_PROBE_VIDEO_PEEK, &sps);
+        } else if(codec_id == VIDEO_CODEC_ID_HEVC) {
+            ret = hevc_parse_decoder_config(p + FLV_PROBE_VIDEO_PEEK, probe->fill - FLV_PROBE_VIDEO_PEEK, &sps);
+        } else {
+            ret = av1_parse_decoder_config(p + FLV_PROBE_VIDEO_PEEK, probe->fill - FLV_PROBE_VIDEO_PEEK, &sps);
+        }
+        info->video_codec_id = codec_id;
+        if(ret >= 0) {
+            info->profile_idc = sps.profile_idc;
+            info->level_idc = sps.level_idc;
+            info->bit_depth = sps.bit_depth_luma;
+            info->width = sps.width;
+            info->height = sps.height;
+            info->frame_rate = sps.frame_rate;
+        }
+        info->found |= FLV_PROBE_FOUND_VIDEO_CONFIG;
+    } else if(is_frame && frame_type == 1 && !(info->found & FLV_PROBE_FOUND_KEYFRAME)) {
+        info->keyframe_offset = probe->tag_offset;
+        info->keyframe_dts = probe->tag_dts;
+        info->found |= FLV_PROBE_FOUND_KEYFRAME;
+    }
+    return 0;
+}
+
+static void flv_probe_begin_tag(flv_probe_t *probe, uint64_t offset) {
+    probe->state = FLV_PROBE_STATE_TAG_HEADER;
+    probe->want = FLV_PROBE_TAG_HEADER_SIZE;
+    probe->fill = 0;
+    probe->tag_offset = offset;
+}
+
+static void flv_probe_skip(flv_probe_t *probe, uint32_t skip, uint64_t offset) {
+    if(skip == 0) {
+        flv_probe_begin_tag(probe, offset);
+        return;
+    }
+    probe->state = FLV_PROBE_STATE_SKIP;
+    probe->skip = skip;
+}
+
+/*
+ buffer收满want之后调用，offset是已经消费的字节数
+ */
+static int flv_probe_process(flv_probe_t *probe, uint64_t offset) {
+    flv_probe_info_t *info = &probe->info;
+    const uint8_t *h = probe->buffer;
+
+    if(probe->state == FLV_PROBE_STATE_HEADER) {
+        if(h[0] != 'F' || h[1] != 'L' || h[2] != 'V') {
+            return FLV_PROBE_ERROR;
+        }
+        uint32_t data_offset = PS_RB32(h + 5);
+        if(data_offset < FLV_PROBE_HEADER_SIZE) {
+            return FLV_PROBE_ERROR;
+        }
+        info->media_flag = h[4] & (FLV_PROBE_MEDIA_VIDEO | FLV_PROBE_MEDIA_AUDIO);
+        info->found |= FLV_PROBE_FOUND_HEADER;
+        flv_probe_skip(probe, data_offset - FLV_PROBE_HEADER_SIZE + FLV_PROBE_PREV_TAG_SIZE, offset);
+        return FLV_PROBE_NEED_MORE;
+    }
+
+    if(probe->state == FLV_PROBE_STATE_TAG_HEADER) {
+        probe->tag_type = h[0] & 0x1f;
+        probe->tag_size = PS_RB24(h + 1);
+        probe->tag_dts = PS_RB24(h + 4) | ((uint32_t)h[7] << 24);
+        if(probe->tag_type == 8 || probe->tag_type == 9) {
+            if(probe->first_dts == VOODOO_NOPTS_VALUE) {
+                probe->first_dts = probe->tag_dts;
+            } else if(probe->tag_dts - probe->first_dts > (int64_t)probe->max_ms) {
+                return FLV_PROBE_DONE;
+            }
+        }
+        uint32_t want = 0;
+        if(probe->tag_type == 18 && !(info->found & FLV_PROBE_FOUND_METADATA)) {
+            want = FLV_PROBE_BUFFER_SIZE;
+        } else if(probe->tag_type == 8 && !(info->found & FLV_PROBE_FOUND_AUDIO_CONFIG)) {
+            want = FLV_PROBE_AUDIO_PEEK;
+        } else if(probe->tag_type == 9 &&
+                  (info->found & (FLV_PROBE_FOUND_VIDEO_CONFIG | FLV_PROBE_FOUND_KEYFRAME)) != (FLV_PROBE_FOUND_VIDEO_CONFIG | FLV_PROBE_FOUND_KEYFRAME)) {
+            want = FLV_PROBE_VIDEO_PEEK;
+        }
+        /*
+         加密的tag内容看不了，和不需要的tag一样整个跳过
+         */
+        if((h[0] & 0x20) != 0) {
+            want = 0;
+        }
+        want = want < probe->tag_size ? want : probe->tag_size;
+        if(want == 0) {
+            flv_probe_skip(probe, probe->tag_size + FLV_PROBE_PREV_TAG_SIZE, offset);
+            return FLV_PROBE_NEED_MORE;
+        }
+        probe->state = FLV_PROBE_STATE_TAG_BODY;
+        probe->want = want;
+        probe->fill = 0;
+        return FLV_PROBE_NEED_MORE;
+    }
+
+    uint32_t more = 0;
+    if(probe->tag_type == 18) {
+        flv_probe_parse_script(probe);
+    } else if(probe->tag_type == 8) {
+        more = flv_probe_audio_tag(probe);
+    } else {
+        more = flv_probe_video_tag(probe);
+    }
+    if(more > 0) {
+        probe->want += more;
+        return FLV_PROBE_NEED_MORE;
+    }
+    if(flv_probe_is_complete(probe)) {
+        return FLV_PROBE_DONE;
+    }
+    flv_probe_skip(probe, probe->tag_size - probe->fill + FLV_PROBE_PREV_TAG_SIZE, offset);
+    return FLV_PROBE_NEED_MORE;
+}
+
+int flv_probe_feed(flv_probe_t* probe, const void* data, uint32_t len) {
+    const uint8_t *p = (const uint8_t*)data;
+    flv_probe_info_t *info = &probe->info;
+
+    while(len > 0 && probe->result == FLV_PROBE_NEED_MORE) {
+        uint32_t n;
+        if(probe->state == FLV_PROBE_STATE_SKIP) {
+            n = probe->skip < len ? probe->skip : len;
+            probe->skip -= n;
+            info->bytes_probed += n;
+            if(probe->skip == 0) {
+                flv_probe_begin_tag(probe, info->bytes_probed);
+            }
+        } else {
+            n = probe->want - probe->fill;
+            n = n < len ? n : len;
+            memcpy(probe->buffer + probe->fill, p, n);
+            probe->fill += n;
+            info->bytes_probed += n;
+            if(probe->fill == probe->want) {
+                probe->result = flv_probe_process(probe, info->bytes_probed);
+            }
+        }
+        p += n;
+        len -= n;
+        if(probe->result == FLV_PROBE_NEED_MORE && info->bytes_probed >= probe->max_bytes) {
+            probe->result = (info->found & FLV_PROBE_FOUND_HEADER) ? FLV_PROBE_DONE : FLV_PROBE_ERROR;
+        }
+    }
+    return probe->result;
+}
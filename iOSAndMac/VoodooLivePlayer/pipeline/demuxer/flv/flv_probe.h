@@ -0,0 +1,127 @@
+//
+//  flv_probe.h
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#ifndef flv_probe_h
+#define flv_probe_h
+
+#include "demuxer.h"
+
+/*
+ stream info without a demuxer: reads the flv header, onMetaData, the first
+ audio and video sequence headers and the first video keyframe, then stops.
+ nothing is allocated past flv_probe_create, every tag body is skipped
+ except its first FLV_PROBE_BUFFER_SIZE bytes, so a probe costs a few KB
+ and hundreds of them can run side by side.
+
+     flv_probe_t *probe = flv_probe_create(0, 0, NULL);
+     for each chunk downloaded
+         if(flv_probe_feed(probe, data, len) != FLV_PROBE_NEED_MORE) cancel the download
+     info = flv_probe_get_info(probe);
+     flv_probe_destroy(probe);
+
+ the info is usable at any point, found tells what has been seen so far.
+ */
+#define FLV_PROBE_NEED_MORE     0
+#define FLV_PROBE_DONE          1
+#define FLV_PROBE_ERROR         (-1)
+
+/*
+ enough for any avc/hevc/av1 decoder configuration record seen in practice
+ and the scalars at the front of onMetaData
+ */
+#define FLV_PROBE_BUFFER_SIZE   4096
+
+#define FLV_PROBE_DEFAULT_MAX_BYTES     (1024 * 1024)
+#define FLV_PROBE_DEFAULT_MAX_MS        3000
+
+#define FLV_PROBE_FOUND_HEADER          0x01
+#define FLV_PROBE_FOUND_METADATA        0x02
+#define FLV_PROBE_FOUND_VIDEO_CONFIG    0x04
+#define FLV_PROBE_FOUND_AUDIO_CONFIG    0x08
+#define FLV_PROBE_FOUND_KEYFRAME        0x10
+
+/*
+ media_flag bits, as in the flv header
+ */
+#define FLV_PROBE_MEDIA_VIDEO   0x01
+#define FLV_PROBE_MEDIA_AUDIO   0x04
+
+/*
+ flv sound format of the audio tag header
+ */
+#define FLV_PROBE_AUDIO_MP3     2
+#define FLV_PROBE_AUDIO_AAC     10
+
+typedef struct flv_probe_info_s {
+    uint32_t found;             /*  FLV_PROBE_FOUND_*   */
+    uint32_t media_flag;        /*  FLV_PROBE_MEDIA_* from the flv header */
+    uint64_t bytes_probed;
+
+    /*
+     video sequence header, the size is 0 when the SPS could not be parsed
+     */
+    int video_codec_id;         /*  VIDEO_CODEC_ID_*, 0 before the sequence header */
+    int profile_idc;
+    int level_idc;
+    int bit_depth;
+    int width;
+    int height;
+    double frame_rate;
+
+    /*
+     audio tag header, refined by the AudioSpecificConfig for aac
+     */
+    int audio_format;           /*  FLV_PROBE_AUDIO_* or another flv sound format, -1 before the first audio tag */
+    int audio_object_type;      /*  aac only    */
+    int sample_rate;
+    int channels;
+
+    /*
+     onMetaData, 0 when absent. data rates are kbps
+     */
+    double duration;
+    double video_data_rate;
+    double audio_data_rate;
+    double meta_width;
+    double meta_height;
+    double meta_frame_rate;
+
+    /*
+     first video keyframe: tag offset from the start of the stream and its dts
+     */
+    uint64_t keyframe_offset;
+    int64_t keyframe_dts;
+} flv_probe_info_t;
+
+typedef struct flv_probe_s flv_probe_t;
+
+/*
+ the probe gives up once max_bytes were fed or the tag timestamps moved
+ max_ms past the first one, 0 uses the defaults. allocator may be NULL
+ */
+flv_probe_t* flv_probe_create(uint32_t max_bytes, uint32_t max_ms, const demuxer_config_t* allocator);
+void flv_probe_destroy(flv_probe_t* probe);
+/*
+ clears the state for the next stream, keeping the limits
+ */
+void flv_probe_reset(flv_probe_t* probe);
+
+/*
+ FLV_PROBE_DONE once every stream the header announces has its sequence
+ header and video its first keyframe, or a limit was reached.
+ FLV_PROBE_ERROR when the data is not flv. after either the rest is ignored
+ */
+int flv_probe_feed(flv_probe_t* probe, const void* data, uint32_t len);
+const flv_probe_info_t* flv_probe_get_info(flv_probe_t* probe);
+
+/*
+ bytes a probe holds, for sizing a batch
+ */
+uint32_t flv_probe_memory_size(void);
+
+#endif /* flv_probe_h */
@@ -0,0 +1,532 @@
+//
+//  rtmp.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#include "rtmp.h"
+#include "flv.h"
+#include "pt.h"
+#include "demuxer_trace.h"
+#include <string.h>
+#include <stdlib.h>
+
+/*
+ basic header 3 + message header 11 + extended timestamp 4
+ */
+#define RTMP_MAX_HEADER_SIZE        (18)
+#define RTMP_CACHE_SIZE             (64)
+#define RTMP_MAX_CHUNK_STREAMS      (64)
+#define RTMP_MAX_CHUNK_SIZE         (0xffffff)
+#define RTMP_MAX_MESSAGE_SIZE       (16*1024*1024)
+#define RTMP_MIN_MESSAGE_BUFFER     (4096)
+#define RTMP_FLV_CACHE_SIZE         (4096)
+
+#define RTMP_AGGREGATE_TAG_HEADER_SIZE  (11)
+
+static const uint8_t rtmp_message_header_sizes[4] = { 11, 7, 3, 0 };
+
+/*
+ 每个chunk stream保存上一个消息头，fmt 1~3压缩掉的字段从这里取
+ */
+typedef struct rtmp_chunk_stream_s {
+    uint32_t csid;
+    int has_header;
+    int extended;
+    uint8_t type;
+    uint32_t stream_id;
+    uint32_t timestamp;
+    uint32_t delta;
+    uint32_t length;
+    /*
+     reassembly buffer, messages interleave across chunk streams
+     */
+    uint32_t received;
+    uint32_t capacity;
+    uint8_t *buf;
+} rtmp_chunk_stream_t;
+
+typedef struct rtmp_demuxer_context_s {
+    void *userdata;
+    fn_demuxer_callback_t callback;
+    fn_rtmp_message_callback_t message_callback;
+    demuxer_config_t config;
+
+    void *flv;
+    int media_flag_sent;
+
+    int is_running;
+    ptc_t ptc;
+    pts_t stream;
+    uint8_t cache[RTMP_CACHE_SIZE];
+    uint64_t bytes_received;
+
+    uint32_t chunk_size;
+    uint8_t fmt;
+    uint32_t csid;
+    uint32_t ts_field;
+    uint32_t chunk_left;
+    rtmp_chunk_stream_t *cs;
+
+    rtmp_chunk_stream_t *streams;
+    uint32_t stream_count;
+    uint32_t stream_capacity;
+
+    /*
+     chunk layer only, tag counters live in the inner flv demuxer
+     */
+    demuxer_trace_t trace;
+} rtmp_demuxer_context_t;
+
+void* rtmp_demuxer_init(void* userdata, fn_demuxer_callback_t callback) {
+    return rtmp_demuxer_init_with_config(userdata, callback, NULL);
+}
+
+void* rtmp_demuxer_init_with_config(void* userdata, fn_demuxer_callback_t callback, const demuxer_config_t* config) {
+    demuxer_config_t cfg;
+    if(config) {
+        cfg = *config;
+    } else {
+        memset(&cfg, 0, sizeof(cfg));
+    }
+    demuxer_select_allocator(&cfg, &cfg.malloc_fn, &cfg.free_fn, &cfg.allocator_opaque);
+
+    rtmp_demuxer_context_t* ctx = (rtmp_demuxer_context_t*)cfg.malloc_fn(cfg.allocator_opaque, sizeof(rtmp_demuxer_context_t));
+    if(!ctx) {
+        return NULL;
+    }
+    memset(ctx, 0, sizeof(rtmp_demuxer_context_t));
+    ctx->config = cfg;
+
+    /*
+     内部的flv demuxer只走flv_demuxer_feed_tag，不需要大cache
+     */
+    demuxer_config_t flv_cfg = cfg;
+    flv_cfg.initial_cache_size = RTMP_FLV_CACHE_SIZE;
+    flv_cfg.max_cache_size = RTMP_FLV_CACHE_SIZE;
+    ctx->flv = flv_demuxer_init_with_config(userdata, callback, &flv_cfg);
+    if(!ctx->flv) {
+        cfg.free_fn(cfg.allocator_opaque, ctx);
+        return NULL;
+    }
+
+    ctx->userdata = userdata;
+    ctx->callback = callback;
+    ctx->chunk_size = RTMP_DEFAULT_CHUNK_SIZE;
+
+    ctx->stream.buf = ctx->cache;
+    ctx->stream.pos = ctx->stream.size = ctx->stream.want = 0;
+
+    PT_INIT(&ctx->ptc, ctx);
+    ctx->is_running = 1;
+    demuxer_trace_init(&ctx->trace);
+    return (void*)ctx;
+}
+
+void rtmp_demuxer_fint(void* ctx) {
+    rtmp_demuxer_context_t* demuxer_ctx = (rtmp_demuxer_context_t*)ctx;
+    demuxer_config_t cfg = demuxer_ctx->config;
+    demuxer_ctx->is_running = 0;
+    for(uint32_t i = 0;i < demuxer_ctx->stream_count;++i) {
+        if(demuxer_ctx->streams[i].buf) {
+            cfg.free_fn(cfg.allocator_opaque, demuxer_ctx->streams[i].buf);
+        }
+    }
+    if(demuxer_ctx->streams) {
+        cfg.free_fn(cfg.allocator_opaque, demuxer_ctx->streams);
+    }
+    flv_demuxer_fint(demuxer_ctx->flv);
+    cfg.free_fn(cfg.allocator_opaque, ctx);
+}
+
+void rtmp_demuxer_set_message_callback(void* ctx, fn_rtmp_message_callback_t callback) {
+    rtmp_demuxer_context_t* demuxer_ctx = (rtmp_demuxer_context_t*)ctx;
+    demuxer_ctx->message_callback = callback;
+}
+
+void rtmp_demuxer_set_packet_pool(void* ctx, packet_pool_t* pool, fn_demuxer_packet_callback_t callback) {
+    rtmp_demuxer_context_t* demuxer_ctx = (rtmp_demuxer_context_t*)ctx;
+    flv_demuxer_set_packet_pool(demuxer_ctx->flv, pool, callback);
+}
+
+void rtmp_demuxer_set_gop_cache(void* ctx, gop_cache_t* cache) {
+    rtmp_demuxer_context_t* demuxer_ctx = (rtmp_demuxer_context_t*)ctx;
+    flv_demuxer_set_gop_cache(demuxer_ctx->flv, cache);
+}
+
+void rtmp_demuxer_set_drop_level(void* ctx, int level) {
+    rtmp_demuxer_context_t* demuxer_ctx = (rtmp_demuxer_context_t*)ctx;
+    flv_demuxer_set_drop_level(demuxer_ctx->flv, level);
+}
+
+void rtmp_demuxer_set_nal_format(void* ctx, int format) {
+    rtmp_demuxer_context_t* demuxer_ctx = (rtmp_demuxer_context_t*)ctx;
+    flv_demuxer_set_nal_format(demuxer_ctx->flv, format);
+}
+
+void rtmp_demuxer_set_sei_extraction(void* ctx, int enable) {
+    rtmp_demuxer_context_t* demuxer_ctx = (rtmp_demuxer_context_t*)ctx;
+    flv_demuxer_set_sei_extraction(demuxer_ctx->flv, enable);
+}
+
+int rtmp_demuxer_read_packets(void* ctx, demuxer_packet_t** packets, int max) {
+    rtmp_demuxer_context_t* demuxer_ctx = (rtmp_demuxer_context_t*)ctx;
+    return flv_demuxer_read_packets(demuxer_ctx->flv, packets, max);
+}
+
+void* rtmp_demuxer_flv_context(void* ctx) {
+    rtmp_demuxer_context_t* demuxer_ctx = (rtmp_demuxer_context_t*)ctx;
+    return demuxer_ctx->flv;
+}
+
+uint32_t rtmp_demuxer_chunk_size(void* ctx) {
+    rtmp_demuxer_context_t* demuxer_ctx = (rtmp_demuxer_context_t*)ctx;
+    return demuxer_ctx->chunk_size;
+}
+
+uint64_t rtmp_demuxer_bytes_received(void* ctx) {
+    rtmp_demuxer_context_t* demuxer_ctx = (rtmp_demuxer_context_t*)ctx;
+    return demuxer_ctx->bytes_received;
+}
+
+void rtmp_demuxer_get_stats(void* ctx, demuxer_stats_t* stats) {
+    rtmp_demuxer_context_t* demuxer_ctx = (rtmp_demuxer_context_t*)ctx;
+    demuxer_stats_t chunk;
+    flv_demuxer_get_stats(demuxer_ctx->flv, stats);
+    demuxer_trace_get_stats(&demuxer_ctx->trace, &chunk);
+    /*
+     flv_demuxer_feed_tag不经过feed，字节数和耗时以chunk层为准
+     */
+    stats->bytes_fed = chunk.bytes_fed;
+    stats->feeds = chunk.feeds;
+    stats->max_feed_ns = chunk.max_feed_ns;
+    stats->bytes_moved += chunk.bytes_moved;
+    stats->malformed_tags += chunk.malformed_tags;
+    stats->events_dropped += chunk.events_dropped;
+}
+
+int rtmp_demuxer_read_events(void* ctx, demuxer_event_t* events, int max) {
+    rtmp_demuxer_context_t* demuxer_ctx = (rtmp_demuxer_context_t*)ctx;
+    int count = demuxer_trace_read_events(&demuxer_ctx->trace, events, max);
+    return count + flv_demuxer_read_events(demuxer_ctx->flv, events + count, max - count);
+}
+
+void rtmp_demuxer_set_log_callback(void* ctx, fn_demuxer_log_callback_t callback, void* opaque, int level) {
+    rtmp_demuxer_context_t* demuxer_ctx = (rtmp_demuxer_context_t*)ctx;
+    demuxer_trace_set_log_callback(&demuxer_ctx->trace, callback, opaque, level);
+    flv_demuxer_set_log_callback(demuxer_ctx->flv, callback, opaque, level);
+}
+
+static rtmp_chunk_stream_t* rtmp_find_chunk_stream(rtmp_demuxer_context_t *state, uint32_t csid) {
+    for(uint32_t i = 0;i < state->stream_count;++i) {
+        if(state->streams[i].csid == csid) {
+            return &state->streams[i];
+        }
+    }
+    return NULL;
+}
+
+static rtmp_chunk_stream_t* rtmp_get_chunk_stream(rtmp_demuxer_context_t *state, uint32_t csid) {
+    rtmp_chunk_stream_t *cs = rtmp_find_chunk_stream(state, csid);
+    if(cs) {
+        return cs;
+    }
+    if(state->stream_count == state->stream_capacity) {
+        if(state->stream_capacity >= RTMP_MAX_CHUNK_STREAMS) {
+            return NULL;
+        }
+        uint32_t capacity = state->stream_capacity ? state->stream_capacity * 2 : 8;
+        rtmp_chunk_stream_t *streams = (rtmp_chunk_stream_t*)state->config.malloc_fn(state->config.allocator_opaque, capacity * sizeof(rtmp_chunk_stream_t));
+        if(!streams) {
+            return NULL;
+        }
+        if(state->streams) {
+            memcpy(streams, state->streams, state->stream_count * sizeof(rtmp_chunk_stream_t));
+            state->config.free_fn(state->config.allocator_opaque, state->streams);
+        }
+        state->streams = streams;
+        state->stream_capacity = capacity;
+    }
+    cs = &state->streams[state->stream_count++];
+    memset(cs, 0, sizeof(rtmp_chunk_stream_t));
+    cs->csid = csid;
+    return cs;
+}
+
+static int rtmp_reserve_message(rtmp_demuxer_context_t *state, rtmp_chunk_stream_t *cs) {
+    if(cs->capacity >= cs->length && cs->buf) {
+        return 0;
+    }
+    uint32_t capacity = cs->capacity ? cs->capacity : RTMP_MIN_MESSAGE_BUFFER;
+    while(capacity < cs->length) {
+        capacity *= 2;
+    }
+    /*
+     received之前的数据要保留
+     */
+    uint8_t *buf = (uint8_t*)state->config.malloc_fn(state->config.allocator_opaque, capacity);
+    if(!buf) {
+        return -1;
+    }
+    if(cs->buf) {
+        memcpy(buf, cs->buf, cs->received);
+        state->config.free_fn(state->config.allocator_opaque, cs->buf);
+    }
+    cs->buf = buf;
+    cs->capacity = capacity;
+    return 0;
+}
+
+#define RTMP_RB32(p)    ((((uint32_t)(p)[0]) << 24) | (((uint32_t)(p)[1]) << 16) | (((uint32_t)(p)[2]) << 8) | (uint32_t)(p)[3])
+#define RTMP_RB24(p)    ((((uint32_t)(p)[0]) << 16) | (((uint32_t)(p)[1]) << 8) | (uint32_t)(p)[2])
+#define RTMP_RL32(p)    ((((uint32_t)(p)[3]) << 24) | (((uint32_t)(p)[2]) << 16) | (((uint32_t)(p)[1]) << 8) | (uint32_t)(p)[0])
+
+static void rtmp_feed_media(rtmp_demuxer_context_t *state, uint8_t type, uint32_t timestamp, const uint8_t *data, uint32_t size) {
+    if(!state->media_flag_sent) {
+        /*
+         rtmp没有flv头，先当作音视频都有
+         */
+        state->media_flag_sent = 1;
+        state->callback(state->userdata, VOODOO_DATA_TYPE_MEDIA_FLAG, NULL, 0, NULL, 5);
+    }
+    flv_demuxer_feed_tag(state->flv, type, timestamp, data, size);
+}
+
+/*
+ aggregate消息体是一串flv tag，时间戳相对第一个tag平移到消息时间戳
+ */
+static void rtmp_parse_aggregate(rtmp_demuxer_context_t *state, uint32_t timestamp, const uint8_t *data, uint32_t size) {
+    uint32_t pos = 0;
+    uint32_t first_ts = 0;
+    int first = 1;
+    while(pos + RTMP_AGGREGATE_TAG_HEADER_SIZE <= size) {
+        const uint8_t *p = data + pos;
+        uint8_t type = p[0] & 0x1f;
+        uint32_t tag_size = RTMP_RB24(p + 1);
+        uint32_t tag_ts = RTMP_RB24(p + 4) | ((uint32_t)p[7] << 24);
+        if(tag_size > size - pos - RTMP_AGGREGATE_TAG_HEADER_SIZE) {
+            DEMUXER_STAT_ADD(&state->trace, malformed_tags, 1);
+            demuxer_trace_event(&state->trace, VOODOO_EVENT_AGGREGATE, VOODOO_LOG_WARN, timestamp, state->bytes_received, size);
+            DEMUXER_LOG(&state->trace, VOODOO_LOG_WARN, "rtmp: truncated aggregate message, size %u", size);
+            return;
+        }
+        if(first) {
+            first_ts = tag_ts;
+            first = 0;
+        }
+        rtmp_feed_media(state, type, timestamp + (tag_ts - first_ts), p + RTMP_AGGREGATE_TAG_HEADER_SIZE, tag_size);
+        pos += RTMP_AGGREGATE_TAG_HEADER_SIZE + tag_size + 4;
+    }
+}
+
+static void rtmp_handle_message(rtmp_demuxer_context_t *state, rtmp_chunk_stream_t *cs, const uint8_t *data, uint32_t size) {
+    switch(cs->type) {
+        case RTMP_MESSAGE_SET_CHUNK_SIZE:
+            if(size >= 4) {
+                uint32_t chunk_size = RTMP_RB32(data) & 0x7fffffff;
+                if(chunk_size > 0) {
+                    state->chunk_size = VPMIN(chunk_size, RTMP_MAX_CHUNK_SIZE);
+                }
+            }
+            break;
+        case RTMP_MESSAGE_ABORT:
+            if(size >= 4) {
+                rtmp_chunk_stream_t *aborted = rtmp_find_chunk_stream(state, RTMP_RB32(data));
+                if(aborted) {
+                    aborted->received = 0;
+                }
+            }
+            break;
+        case RTMP_MESSAGE_AUDIO:
+        case RTMP_MESSAGE_VIDEO:
+        case RTMP_MESSAGE_DATA_AMF0:
+            rtmp_feed_media(state, cs->type, cs->timestamp, data, size);
+            return;
+        case RTMP_MESSAGE_AGGREGATE:
+            rtmp_parse_aggregate(state, cs->timestamp, data, size);
+            return;
+        default:
+            break;
+    }
+    if(state->message_callback) {
+        state->message_callback(state->userdata, cs->csid, cs->type, cs->stream_id, cs->timestamp, data, size);
+    }
+}
+
+static int rtmp_demux_parse_stream(ptc_t* ptc) {
+    rtmp_demuxer_context_t* state = PT_DATA(ptc);
+    pts_t* s = &state->stream;
+    uint8_t basic;
+    uint32_t len;
+    PT_BEGIN(ptc);
+    while(state->is_running) {
+        /*
+         basic header
+         */
+        PS_SR_U8(s, basic);
+        state->fmt = basic >> 6;
+        state->csid = basic & 0x3f;
+        if(state->csid == 0) {
+            PS_SR_U8(s, basic);
+            state->csid = 64 + basic;
+        } else if(state->csid == 1) {
+            PS_ENSURE(s, 2);
+            state->csid = 64 + PS_PR_U8(s, 0) + ((uint32_t)PS_PR_U8(s, 1) << 8);
+            PS_DR_SKIP(s, 2);
+        }
+        state->cs = rtmp_get_chunk_stream(state, state->csid);
+        if(!state->cs) PT_THROW_ERROR(ptc, "too many chunk streams");
+
+        /*
+         message header
+         */
+        PS_ENSURE(s, rtmp_message_header_sizes[state->fmt]);
+        if(state->fmt <= 2) {
+            state->ts_field = PS_PR_U24(s, 0);
+            if(state->fmt <= 1) {
+                state->cs->length = PS_PR_U24(s, 3);
+                state->cs->type = PS_PR_U8(s, 6);
+            }
+            if(state->fmt == 0) {
+                state->cs->stream_id = RTMP_RL32(s->buf + s->pos + 7);
+            }
+            PS_DR_SKIP(s, rtmp_message_header_sizes[state->fmt]);
+            state->cs->extended = state->ts_field == 0xffffff;
+            if(state->cs->extended) {
+                PS_ENSURE(s, 4);
+                state->ts_field = RTMP_RB32(s->buf + s->pos);
+                PS_DR_SKIP(s, 4);
+            }
+            if(state->cs->received != 0) {
+                demuxer_trace_event(&state->trace, VOODOO_EVENT_CHUNK_STREAM, VOODOO_LOG_WARN, state->cs->timestamp, state->bytes_received, state->csid);
+                DEMUXER_LOG(&state->trace, VOODOO_LOG_WARN, "rtmp: chunk stream %u: new message header before the last message completed", state->csid);
+                state->cs->received = 0;
+            }
+            if(state->fmt == 0) {
+                state->cs->timestamp = state->ts_field;
+                state->cs->delta = 0;
+            } else {
+                state->cs->delta = state->ts_field;
+                state->cs->timestamp += state->cs->delta;
+            }
+            state->cs->has_header = 1;
+        } else {
+            if(!state->cs->has_header) PT_THROW_ERROR(ptc, "chunk without message header");
+            if(state->cs->extended) {
+                /*
+                 前一个头用了扩展时间戳，fmt 3后面也跟着4字节
+                 */
+                PS_ENSURE(s, 4);
+                PS_DR_SKIP(s, 4);
+            }
+            if(state->cs->received == 0) {
+                state->cs->timestamp += state->cs->delta;
+            }
+        }
+        if(state->cs->length > RTMP_MAX_MESSAGE_SIZE) PT_THROW_ERROR(ptc, "message too large");
+
+        /*
+         chunk payload
+         */
+        state->chunk_left = VPMIN(state->chunk_size, state->cs->length - state->cs->received);
+        if(state->cs->received == 0 && state->chunk_left == state->cs->length && PS_SIZE(s) >= state->chunk_left) {
+            /*
+             整条消息在一个chunk里并且已经收全，直接在输入数据上回调
+             */
+            len = state->chunk_left;
+            rtmp_handle_message(state, state->cs, s->buf + s->pos, len);
+            PS_DR_SKIP(s, len);
+            continue;
+        }
+        if(rtmp_reserve_message(state, state->cs) < 0) PT_THROW_ERROR(ptc, "alloc message buffer failed");
+        while(state->chunk_left > 0) {
+            PS_ENSURE(s, 1);
+            len = VPMIN(PS_SIZE(s), state->chunk_left);
+            memcpy(state->cs->buf + state->cs->received, s->buf + s->pos, len);
+            DEMUXER_STAT_ADD(&state->trace, bytes_moved, len);
+            state->cs->received += len;
+            state->chunk_left -= len;
+            PS_DR_SKIP(s, len);
+        }
+        if(state->cs->received == state->cs->length) {
+            state->cs->received = 0;
+            rtmp_handle_message(state, state->cs, state->cs->buf, state->cs->length);
+        }
+    }
+    PT_END(ptc);
+}
+
+static int rtmp_feed_stream(rtmp_demuxer_context_t *state, const uint8_t *ptr, uint32_t left);
+
+int rtmp_demuxer_feed(void* ctx, const void* data, int len) {
+    rtmp_demuxer_context_t *state = (rtmp_demuxer_context_t*)ctx;
+    if(!state->is_running) {
+        return -1;
+    }
+
+    int ret;
+    uint64_t feed_start = demuxer_trace_now_ns();
+    state->bytes_received += (uint32_t)len;
+    DEMUXER_STAT_ADD(&state->trace, bytes_fed, (uint32_t)len);
+    DEMUXER_STAT_ADD(&state->trace, feeds, 1);
+    ret = rtmp_feed_stream(state, (const uint8_t *)data, (uint32_t)len);
+    DEMUXER_STAT_MAX(&state->trace, max_feed_ns, demuxer_trace_now_ns() - feed_start);
+    return ret;
+}
+
+static int rtmp_feed_stream(rtmp_demuxer_context_t *state, const uint8_t *ptr, uint32_t left) {
+    int ret;
+    pts_t *stream = &state->stream;
+    uint32_t copy_len, tail_len;
+
+    while(left > 0) {
+        if(stream->pos < stream->size) {
+            /*
+             cache里只会剩半个chunk头，补齐到解析器需要的字节数
+             */
+            copy_len = VPMIN(stream->want - stream->size, left);
+            memcpy(state->cache + stream->size, ptr, copy_len);
+            stream->buf = state->cache;
+            stream->size += copy_len;
+            ptr += copy_len;
+            left -= copy_len;
+            if(stream->size < stream->want) {
+                break;
+            }
+        } else {
+            /*
+             chunk体直接在调用方的数据上解析
+             */
+            stream->buf = (uint8_t*)ptr;
+            stream->size = left;
+            stream->pos = 0;
+            ptr += left;
+            left = 0;
+        }
+
+        ret = rtmp_demux_parse_stream(&state->ptc);
+        if(ret != PTR_YIELDED) {
+            state->is_running = 0;
+            if(ret == PTR_ERROR) {
+                demuxer_trace_event(&state->trace, VOODOO_EVENT_PARSE_ERROR, VOODOO_LOG_ERROR, VOODOO_NOPTS_VALUE, state->bytes_received, (uint32_t)state->ptc.error_line);
+                DEMUXER_LOG(&state->trace, VOODOO_LOG_ERROR, "rtmp: %s @ %s[%d]", state->ptc.error_msg, state->ptc.error_file, state->ptc.error_line);
+            }
+            return -1;
+        }
+
+        tail_len = stream->size - stream->pos;
+        if(tail_len > RTMP_MAX_HEADER_SIZE) {
+            demuxer_trace_event(&state->trace, VOODOO_EVENT_PARSE_ERROR, VOODOO_LOG_ERROR, VOODOO_NOPTS_VALUE, state->bytes_received, tail_len);
+            state->is_running = 0;
+            return -1;
+        }
+        memmove(state->cache, stream->buf + stream->pos, tail_len);
+        stream->want -= stream->pos;
+        stream->buf = state->cache;
+        stream->size = tail_len;
+        stream->pos = 0;
+    }
+    return 0;
+}
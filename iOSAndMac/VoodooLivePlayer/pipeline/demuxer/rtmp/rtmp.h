@@ -0,0 +1,84 @@
+//
+//  rtmp.h
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#ifndef rtmp_h
+#define rtmp_h
+
+#include "demuxer.h"
+#include "packet_pool.h"
+#include "gop_cache.h"
+#include "demuxer_trace.h"
+
+/*
+ rtmp chunk stream demuxer, fed with the bytes after the handshake.
+ audio(8)/video(9)/data(18)/aggregate(22) messages are handed to an inner
+ flv demuxer, so they come out exactly like http-flv: fn_demuxer_callback_t,
+ or the packet pool / read_packets when set.
+ set chunk size(1) and abort(2) are applied here, every other message goes
+ to the message callback.
+ */
+#define RTMP_MESSAGE_SET_CHUNK_SIZE     1
+#define RTMP_MESSAGE_ABORT              2
+#define RTMP_MESSAGE_ACKNOWLEDGEMENT    3
+#define RTMP_MESSAGE_USER_CONTROL       4
+#define RTMP_MESSAGE_WINDOW_ACK_SIZE    5
+#define RTMP_MESSAGE_SET_PEER_BANDWIDTH 6
+#define RTMP_MESSAGE_AUDIO              8
+#define RTMP_MESSAGE_VIDEO              9
+#define RTMP_MESSAGE_DATA_AMF3          15
+#define RTMP_MESSAGE_COMMAND_AMF3       17
+#define RTMP_MESSAGE_DATA_AMF0          18
+#define RTMP_MESSAGE_COMMAND_AMF0       20
+#define RTMP_MESSAGE_AGGREGATE          22
+
+#define RTMP_DEFAULT_CHUNK_SIZE         128
+
+/*
+ data is only valid during the callback
+ */
+typedef void (*fn_rtmp_message_callback_t)(void* userdata, uint32_t csid, uint8_t type, uint32_t stream_id, uint32_t timestamp, const void* data, uint32_t size);
+
+void* rtmp_demuxer_init(void* userdata, fn_demuxer_callback_t callback);
+void* rtmp_demuxer_init_with_config(void* userdata, fn_demuxer_callback_t callback, const demuxer_config_t* config);
+void rtmp_demuxer_fint(void* ctx);
+/*
+ returns 0, -1 on a broken chunk stream (the demuxer stops)
+ */
+int rtmp_demuxer_feed(void* ctx, const void* data, int len);
+
+void rtmp_demuxer_set_message_callback(void* ctx, fn_rtmp_message_callback_t callback);
+void rtmp_demuxer_set_packet_pool(void* ctx, packet_pool_t* pool, fn_demuxer_packet_callback_t callback);
+int rtmp_demuxer_read_packets(void* ctx, demuxer_packet_t** packets, int max);
+void rtmp_demuxer_set_gop_cache(void* ctx, gop_cache_t* cache);
+/*
+ see flv_demuxer_set_drop_level / set_nal_format / set_sei_extraction
+ */
+void rtmp_demuxer_set_drop_level(void* ctx, int level);
+void rtmp_demuxer_set_nal_format(void* ctx, int format);
+void rtmp_demuxer_set_sei_extraction(void* ctx, int enable);
+
+/*
+ the inner flv demuxer, for flv_demuxer_get_video_info / get_metadata etc.
+ */
+void* rtmp_demuxer_flv_context(void* ctx);
+
+uint32_t rtmp_demuxer_chunk_size(void* ctx);
+/*
+ total bytes fed, for the acknowledgement window
+ */
+uint64_t rtmp_demuxer_bytes_received(void* ctx);
+
+/*
+ inner flv demuxer counters merged with the chunk layer. events from the
+ chunk layer are returned before the flv ones. the log callback is shared.
+ */
+void rtmp_demuxer_get_stats(void* ctx, demuxer_stats_t* stats);
+int rtmp_demuxer_read_events(void* ctx, demuxer_event_t* events, int max);
+void rtmp_demuxer_set_log_callback(void* ctx, fn_demuxer_log_callback_t callback, void* opaque, int level);
+
+#endif /* rtmp_h */
@@ -0,0 +1,122 @@
+//
+//  LiveTSDemuxer.swift
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+import Foundation
+
+func ts_demuxer_callback(demuxerPtr:UnsafeMutableRawPointer?, type:Int32, data: UnsafeMutableRawPointer?, size:Int32, tsPointer:UnsafeMutablePointer<Int64>?, flag:UInt32) {
+    if demuxerPtr == nil { return }
+    let demuxer = Unmanaged<LiveTSDemuxer>.fromOpaque(demuxerPtr!).takeUnretainedValue()
+    demuxer.handleCallback(type: type, flag: flag)
+}
+
+/*
+ mpeg-ts (hls segments), same data types and packets as LiveFLVDemuxer
+ */
+class LiveTSDemuxer : LiveDemuxer {
+    
+    private var tsDemuxerContext: UnsafeMutableRawPointer? = nil
+    private var packetPool: OpaquePointer? = nil
+    private static let packetBatchSize = 64
+    private let packetBatch = UnsafeMutablePointer<UnsafeMutablePointer<demuxer_packet_t>?>.allocate(capacity: LiveTSDemuxer.packetBatchSize)
+    
+    override init(delegate:LiveDemuxerDelegate? = nil, delegateQueue: DispatchQueue? = nil) {
+        super.init(delegate: delegate, delegateQueue: delegateQueue)
+        let selfPtr = Unmanaged<LiveTSDemuxer>.passUnretained(self).toOpaque()
+        self.tsDemuxerContext = ts_demuxer_init(selfPtr, ts_demuxer_callback)
+        self.packetPool = packet_pool_create(0, nil)
+        ts_demuxer_set_packet_pool(self.tsDemuxerContext, self.packetPool, nil)
+    }
+    
+    deinit {
+        if self.tsDemuxerContext != nil {
+            ts_demuxer_fint(self.tsDemuxerContext)
+            self.tsDemuxerContext = nil
+        }
+        if self.packetPool != nil {
+            packet_pool_destroy(self.packetPool)
+            self.packetPool = nil
+        }
+        packetBatch.deallocate()
+    }
+    
+    /*
+     pull mode leaves only the media flag on the callback. it comes in the
+     middle of a feed, the packets queued so far go first
+     */
+    fileprivate func handleCallback(type:Int32, flag:UInt32) {
+        drainPackets()
+        if let queue = self.packetQueue {
+            if let packet = packet_pool_alloc(self.packetPool, 0) {
+                packet.pointee.type = type
+                packet.pointee.flag = flag
+                packet.pointee.pts = VOODOO_NOPTS_VALUE
+                packet.pointee.dts = VOODOO_NOPTS_VALUE
+                queue.push(packet)
+            }
+            return
+        }
+        if let dataType = LivePipelineDataType(rawValue: Int(type)) {
+            delegate?.handle(demuxerData: Data(), withType: dataType, ts: [VOODOO_NOPTS_VALUE, VOODOO_NOPTS_VALUE], flag: flag)
+        } else {
+            print("UNKNOWN TS DATA TYPE VALUE: \(type)")
+        }
+    }
+    
+    private func handlePacket(packet:UnsafeMutablePointer<demuxer_packet_t>) {
+        if let queue = self.packetQueue {
+            queue.push(packet)
+            return
+        }
+        let data = Data(bytesNoCopy: UnsafeMutableRawPointer(packet.pointee.data), count: Int(packet.pointee.size), deallocator: .custom({ _, _ in
+            demuxer_packet_release(packet)
+        }))
+        let ts:[Int64] = [packet.pointee.pts, packet.pointee.dts]
+        
+        if let dataType = LivePipelineDataType(rawValue: Int(packet.pointee.type)) {
+            delegate?.handle(demuxerData: data, withType: dataType, ts: ts, flag: packet.pointee.flag)
+        } else {
+            print("UNKNOWN TS DATA TYPE VALUE: \(packet.pointee.type)")
+        }
+    }
+    
+    override func feed(data:Data) {
+        let dataLength = data.count
+        data.withUnsafeBytes { (ptr) -> Void in
+            if let dataPtr = ptr.baseAddress {
+                ts_demuxer_feed(self.tsDemuxerContext, dataPtr, Int32(dataLength))
+            }
+        }
+        drainPackets()
+    }
+    
+    /*
+     end of a segment, the last pes has no following packet to close it
+     */
+    func flush() {
+        ts_demuxer_flush(self.tsDemuxerContext)
+        drainPackets()
+    }
+    
+    /*
+     hls discontinuity or seek
+     */
+    func reset() {
+        ts_demuxer_reset(self.tsDemuxerContext)
+        drainPackets()
+    }
+    
+    private func drainPackets() {
+        while true {
+            let count = Int(ts_demuxer_read_packets(self.tsDemuxerContext, packetBatch, Int32(LiveTSDemuxer.packetBatchSize)))
+            if count == 0 { break }
+            for i in 0..<count {
+                handlePacket(packet: packetBatch[i]!)
+            }
+        }
+    }
+}
@@ -0,0 +1,940 @@
+//
+//  ts.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#include "ts.h"
+#include "nal_format.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define TS_PACKET_SIZE              188
+#define TS_SYNC_BYTE                0x47
+#define TS_SYNC_CHECK_SIZE          (2 * TS_PACKET_SIZE)
+#define TS_PID_PAT                  0x0000
+#define TS_PID_NULL                 0x1fff
+#define TS_MAX_SECTION_SIZE         (1024 + 4)
+#define TS_TABLE_ID_PAT             0x00
+#define TS_TABLE_ID_PMT             0x02
+
+#define TS_STREAM_TYPE_AAC          0x0f    /*  adts    */
+#define TS_STREAM_TYPE_H264         0x1b
+#define TS_STREAM_TYPE_HEVC         0x24
+
+#define TS_PES_INITIAL_SIZE         (64*1024)
+#define TS_PES_MAX_SIZE             (16*1024*1024)
+#define TS_PES_HEADER_SIZE          9
+#define TS_MAX_PARAMETERS_SIZE      (4*1024)
+#define TS_TIMESTAMP_WRAP           (1LL << 33)
+#define TS_CLOCK_RATE               90000
+#define TS_AAC_FRAME_SAMPLES        1024
+#define TS_ADTS_HEADER_SIZE         7
+
+#define TS_MEDIA_FLAG_VIDEO         1
+#define TS_MEDIA_FLAG_AUDIO         4
+
+#define AVC_NAL_IDR                 5
+#define AVC_NAL_SPS                 7
+#define AVC_NAL_PPS                 8
+#define HEVC_NAL_BLA_W_LP           16
+#define HEVC_NAL_RSV_IRAP_23        23
+#define HEVC_NAL_VPS                32
+#define HEVC_NAL_SPS                33
+#define HEVC_NAL_PPS                34
+
+static const uint32_t ts_adts_sample_rates[16] = {
+    96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350, 0, 0, 0
+};
+
+/*
+ 一个pid上正在拼的pes
+ */
+typedef struct ts_pes_stream_s {
+    int pid;                    /*  -1 没有这路流   */
+    int stream_type;
+    int continuity;             /*  上一个带负载包的continuity_counter，-1 未知 */
+    int started;                /*  见过payload_unit_start_indicator */
+    int random_access;
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t capacity;
+    uint32_t expected;          /*  PES_packet_length不为0时整个pes的大小 */
+} ts_pes_stream_t;
+
+typedef struct ts_demuxer_context_s {
+    void *userdata;
+    fn_demuxer_callback_t callback;
+    demuxer_config_t config;
+    demuxer_trace_t trace;
+
+    packet_pool_t *packet_pool;
+    fn_demuxer_packet_callback_t packet_callback;
+    demuxer_packet_t *queue_head;
+    demuxer_packet_t *queue_tail;
+    uint32_t queue_count;
+
+    /*
+     跨feed的半个ts包，失去同步时最多要看三个包
+     */
+    uint8_t carry[TS_SYNC_CHECK_SIZE + TS_PACKET_SIZE];
+    uint32_t carry_size;
+    uint64_t offset;            /*  已处理的输入字节    */
+    int synced;
+    uint32_t resync_skipped;
+
+    int pmt_pid;
+    int pmt_version;
+    uint32_t media_flag;
+    uint8_t section[TS_MAX_SECTION_SIZE];
+    uint32_t section_size;
+    int section_pid;
+
+    ts_pes_stream_t video;
+    ts_pes_stream_t audio;
+    int video_codec_id;
+
+    int64_t ts_reference;       /*  上一个展开后的90k时间戳 */
+    int64_t pts;                /*  ms  */
+    int64_t dts;
+
+    uint8_t parameters[TS_MAX_PARAMETERS_SIZE];
+    uint32_t parameters_size;
+    uint8_t record[TS_MAX_PARAMETERS_SIZE];
+    int waiting_keyframe;
+    video_sps_info_t video_info;
+
+    uint8_t audio_config[2];
+    int audio_config_sent;
+
+    uint8_t *scratch;
+    uint32_t scratch_capacity;
+} ts_demuxer_context_t;
+
+static void ts_reset_stream(ts_pes_stream_t *s) {
+    s->continuity = -1;
+    s->started = 0;
+    s->random_access = 0;
+    s->size = 0;
+    s->expected = 0;
+}
+
+static void ts_init_stream(ts_pes_stream_t *s) {
+    memset(s, 0, sizeof(ts_pes_stream_t));
+    s->pid = -1;
+    ts_reset_stream(s);
+}
+
+void* ts_demuxer_init(void* userdata, fn_demuxer_callback_t callback) {
+    return ts_demuxer_init_with_config(userdata, callback, NULL);
+}
+
+void* ts_demuxer_init_with_config(void* userdata, fn_demuxer_callback_t callback, const demuxer_config_t* config) {
+    demuxer_config_t cfg;
+    if(config) {
+        cfg = *config;
+    } else {
+        memset(&cfg, 0, sizeof(cfg));
+    }
+    demuxer_select_allocator(&cfg, &cfg.malloc_fn, &cfg.free_fn, &cfg.allocator_opaque);
+
+    ts_demuxer_context_t* ctx = (ts_demuxer_context_t*)cfg.malloc_fn(cfg.allocator_opaque, sizeof(ts_demuxer_context_t));
+    if(!ctx) {
+        return NULL;
+    }
+    memset(ctx, 0, sizeof(ts_demuxer_context_t));
+    ctx->config = cfg;
+    ctx->userdata = userdata;
+    ctx->callback = callback;
+    ctx->pmt_pid = -1;
+    ctx->pmt_version = -1;
+    ctx->section_pid = -1;
+    ctx->synced = 1;
+    ctx->waiting_keyframe = 1;
+    ctx->ts_reference = ctx->pts = ctx->dts = VOODOO_NOPTS_VALUE;
+    ts_init_stream(&ctx->video);
+    ts_init_stream(&ctx->audio);
+    demuxer_trace_init(&ctx->trace);
+    return (void*)ctx;
+}
+
+/*
+ 拉取模式队列里还没取走的packet
+ */
+static void ts_release_queue(ts_demuxer_context_t *state) {
+    while(state->queue_head) {
+        demuxer_packet_t *packet = state->queue_head;
+        state->queue_head = packet->next;
+        demuxer_packet_release(packet);
+    }
+    state->queue_tail = NULL;
+    state->queue_count = 0;
+}
+
+void ts_demuxer_fint(void* ctx) {
+    ts_demuxer_context_t* demuxer_ctx = (ts_demuxer_context_t*)ctx;
+    demuxer_config_t cfg = demuxer_ctx->config;
+    ts_release_queue(demuxer_ctx);
+    if(demuxer_ctx->video.buf) {
+        cfg.free_fn(cfg.allocator_opaque, demuxer_ctx->video.buf);
+    }
+    if(demuxer_ctx->audio.buf) {
+        cfg.free_fn(cfg.allocator_opaque, demuxer_ctx->audio.buf);
+    }
+    if(demuxer_ctx->scratch) {
+        cfg.free_fn(cfg.allocator_opaque, demuxer_ctx->scratch);
+    }
+    cfg.free_fn(cfg.allocator_opaque, demuxer_ctx);
+}
+
+void ts_demuxer_set_packet_pool(void* ctx, packet_pool_t* pool, fn_demuxer_packet_callback_t callback) {
+    ts_demuxer_context_t* demuxer_ctx = (ts_demuxer_context_t*)ctx;
+    demuxer_ctx->packet_pool = pool;
+    demuxer_ctx->packet_callback = callback;
+}
+
+int ts_demuxer_read_packets(void* ctx, demuxer_packet_t** packets, int max) {
+    ts_demuxer_context_t* demuxer_ctx = (ts_demuxer_context_t*)ctx;
+    int count = 0;
+    while(count < max && demuxer_ctx->queue_head) {
+        demuxer_packet_t *packet = demuxer_ctx->queue_head;
+        demuxer_ctx->queue_head = packet->next;
+        packet->next = NULL;
+        packets[count++] = packet;
+    }
+    if(!demuxer_ctx->queue_head) {
+        demuxer_ctx->queue_tail = NULL;
+    }
+    demuxer_ctx->queue_count -= (uint32_t)count;
+    return count;
+}
+
+const video_sps_info_t* ts_demuxer_get_video_info(void* ctx) {
+    ts_demuxer_context_t* demuxer_ctx = (ts_demuxer_context_t*)ctx;
+    return demuxer_ctx->video_info.codec_id ? &demuxer_ctx->video_info : NULL;
+}
+
+void ts_demuxer_get_stats(void* ctx, demuxer_stats_t* stats) {
+    ts_demuxer_context_t* demuxer_ctx = (ts_demuxer_context_t*)ctx;
+    demuxer_trace_get_stats(&demuxer_ctx->trace, stats);
+}
+
+int ts_demuxer_read_events(void* ctx, demuxer_event_t* events, int max) {
+    ts_demuxer_context_t* demuxer_ctx = (ts_demuxer_context_t*)ctx;
+    return demuxer_trace_read_events(&demuxer_ctx->trace, events, max);
+}
+
+void ts_demuxer_set_log_callback(void* ctx, fn_demuxer_log_callback_t callback, void* opaque, int level) {
+    ts_demuxer_context_t* demuxer_ctx = (ts_demuxer_context_t*)ctx;
+    demuxer_trace_set_log_callback(&demuxer_ctx->trace, callback, opaque, level);
+}
+
+static void ts_trace_event(ts_demuxer_context_t *state, int type, int level, uint32_t value, const char *message) {
+    demuxer_trace_event(&state->trace, type, level, state->dts, state->offset, value);
+    DEMUXER_LOG(&state->trace, level, "ts: %s (%u) dts %" PRId64 " @ %" PRIu64, message, value, state->dts, state->offset);
+}
+
+static void ts_malformed(ts_demuxer_context_t *state, int type, uint32_t value, const char *message) {
+    DEMUXER_STAT_ADD(&state->trace, malformed_tags, 1);
+    ts_trace_event(state, type, VOODOO_LOG_WARN, value, message);
+}
+
+/*
+ mpeg-2 crc32，整个section（带crc）算出来是0
+ */
+static uint32_t ts_crc32(const uint8_t *p, uint32_t size) {
+    uint32_t crc = 0xffffffff;
+    for(uint32_t i = 0;i < size;++i) {
+        crc ^= (uint32_t)p[i] << 24;
+        for(int k = 0;k < 8;++k) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+/*
+ ---------------------------------------------------------------- 输出
+ */
+static void ts_emit_packet(ts_demuxer_context_t *state, demuxer_packet_t *packet, int type, uint32_t flag) {
+    packet->type = type;
+    packet->stream_index = (type == VOODOO_DATA_TYPE_AUDIO_PARAMETERS || type == VOODOO_DATA_TYPE_AUDIO_PACKET) ? VOODOO_STREAM_INDEX_AUDIO : VOODOO_STREAM_INDEX_VIDEO;
+    packet->flag = flag;
+    packet->pts = state->pts;
+    packet->dts = state->dts;
+    if(!state->packet_callback) {
+        packet->next = NULL;
+        if(state->queue_tail) {
+            state->queue_tail->next = packet;
+        } else {
+            state->queue_head = packet;
+        }
+        state->queue_tail = packet;
+        ++state->queue_count;
+        return;
+    }
+    state->packet_callback(state->userdata, packet);
+    demuxer_packet_release(packet);
+}
+
+/*
+ 输出的目的地：有packet pool时直接写进池子里的包，否则写进scratch再回调
+ */
+static uint8_t* ts_output_begin(ts_demuxer_context_t *state, uint32_t size, demuxer_packet_t **packet) {
+    *packet = NULL;
+    if(state->packet_pool) {
+        *packet = packet_pool_alloc(state->packet_pool, size);
+        if(!*packet) {
+            ts_trace_event(state, VOODOO_EVENT_ALLOC_FAILED, VOODOO_LOG_ERROR, size, "packet alloc failed");
+            return NULL;
+        }
+        return (*packet)->data;
+    }
+    if(size > state->scratch_capacity) {
+        uint32_t capacity = size > TS_PES_INITIAL_SIZE ? size : TS_PES_INITIAL_SIZE;
+        uint8_t *scratch = (uint8_t*)state->config.malloc_fn(state->config.allocator_opaque, capacity);
+        if(!scratch) {
+            ts_trace_event(state, VOODOO_EVENT_ALLOC_FAILED, VOODOO_LOG_ERROR, size, "scratch alloc failed");
+            return NULL;
+        }
+        if(state->scratch) {
+            state->config.free_fn(state->config.allocator_opaque, state->scratch);
+        }
+        state->scratch = scratch;
+        state->scratch_capacity = capacity;
+    }
+    return state->scratch;
+}
+
+static void ts_output_end(ts_demuxer_context_t *state, demuxer_packet_t *packet, int type, uint8_t *data, uint32_t size, uint32_t flag) {
+    if(packet) {
+        packet->size = size;
+        ts_emit_packet(state, packet, type, flag);
+    } else if(state->callback) {
+        int64_t ts[2] = { state->pts, state->dts };
+        state->callback(state->userdata, type, data, (int)size, ts, flag);
+    }
+}
+
+static void ts_emit_data(ts_demuxer_context_t *state, int type, const uint8_t *data, uint32_t size, uint32_t flag) {
+    if(!state->packet_pool) {
+        if(state->callback) {
+            int64_t ts[2] = { state->pts, state->dts };
+            state->callback(state->userdata, type, (void*)data, (int)size, ts, flag);
+        }
+        return;
+    }
+    demuxer_packet_t *packet;
+    uint8_t *out = ts_output_begin(state, size, &packet);
+    if(out) {
+        memcpy(out, data, size);
+        ts_output_end(state, packet, type, out, size, flag);
+    }
+}
+
+static void ts_emit_media_flag(ts_demuxer_context_t *state, uint32_t flag) {
+    if(state->callback) {
+        state->callback(state->userdata, VOODOO_DATA_TYPE_MEDIA_FLAG, NULL, 0, NULL, flag);
+    }
+}
+
+/*
+ 33位90k时钟展开成连续的值，音视频共用一个参考，回绕时两路一起过
+ */
+static int64_t ts_unwrap(ts_demuxer_context_t *state, int64_t value) {
+    if(value == VOODOO_NOPTS_VALUE) {
+        return value;
+    }
+    if(state->ts_reference != VOODOO_NOPTS_VALUE) {
+        value += state->ts_reference - (state->ts_reference & (TS_TIMESTAMP_WRAP - 1));
+        if(value - state->ts_reference > TS_TIMESTAMP_WRAP / 2) {
+            value -= TS_TIMESTAMP_WRAP;
+        } else if(state->ts_reference - value > TS_TIMESTAMP_WRAP / 2) {
+            value += TS_TIMESTAMP_WRAP;
+        }
+    }
+    state->ts_reference = value;
+    return value;
+}
+
+static int64_t ts_to_ms(int64_t value) {
+    return value == VOODOO_NOPTS_VALUE ? value : value / (TS_CLOCK_RATE / 1000);
+}
+
+static int64_t ts_read_timestamp(const uint8_t *p) {
+    return (int64_t)((p[0] >> 1) & 7) << 30 | (int64_t)p[1] << 22 | (int64_t)(p[2] >> 1) << 15 | (int64_t)p[3] << 7 | p[4] >> 1;
+}
+
+/*
+ ---------------------------------------------------------------- 视频
+ */
+static int ts_is_keyframe(int codec_id, int nal_type) {
+    if(codec_id == VIDEO_CODEC_ID_HEVC) {
+        return nal_type >= HEVC_NAL_BLA_W_LP && nal_type <= HEVC_NAL_RSV_IRAP_23;
+    }
+    return nal_type == AVC_NAL_IDR;
+}
+
+/*
+ 访问单元里带的参数集和上次发出去的不一样时重新生成avcC/hvcC
+ */
+static void ts_update_parameters(ts_demuxer_context_t *state, const uint8_t *vps, uint32_t vps_size,
+                                 const uint8_t *sps, uint32_t sps_size, const uint8_t *pps, uint32_t pps_size) {
+    int hevc = state->video_codec_id == VIDEO_CODEC_ID_HEVC;
+    video_sps_info_t info;
+    int size;
+    if(!sps || !pps || (hevc && !vps)) {
+        return;
+    }
+    memset(&info, 0, sizeof(info));
+    if((hevc ? hevc_parse_sps(sps, sps_size, &info) : avc_parse_sps(sps, sps_size, &info)) < 0) {
+        ts_malformed(state, VOODOO_EVENT_SEQUENCE_HEADER, (uint32_t)state->video_codec_id, "sps parse failed");
+        return;
+    }
+    if(hevc) {
+        size = nal_build_hvcc(vps, vps_size, sps, sps_size, pps, pps_size, &info, state->record, sizeof(state->record));
+    } else {
+        size = nal_build_avcc(sps, sps_size, pps, pps_size, state->record, sizeof(state->record));
+    }
+    if(size < 0) {
+        ts_malformed(state, VOODOO_EVENT_SEQUENCE_HEADER, sps_size + pps_size + vps_size, "parameter sets too large");
+        return;
+    }
+    if((uint32_t)size == state->parameters_size && memcmp(state->record, state->parameters, (size_t)size) == 0) {
+        return;
+    }
+    memcpy(state->parameters, state->record, (size_t)size);
+    state->parameters_size = (uint32_t)size;
+    info.codec_id = state->video_codec_id;
+    info.nal_length_size = 4;
+    state->video_info = info;
+    ts_emit_data(state, VOODOO_DATA_TYPE_VIDEO_PARAMETERS, state->parameters, state->parameters_size, (uint32_t)state->video_codec_id);
+}
+
+static void ts_emit_video(ts_demuxer_context_t *state, const uint8_t *data, uint32_t size) {
+    int hevc = state->video_codec_id == VIDEO_CODEC_ID_HEVC;
+    const uint8_t *vps = NULL, *sps = NULL, *pps = NULL;
+    uint32_t vps_size = 0, sps_size = 0, pps_size = 0;
+    uint32_t pos = 0, start, end;
+    int key = 0;
+    nal_scan_t scan;
+
+    if(nal_scan(state->video_codec_id, data, size, 0, &scan) < 0 || !scan.input_annexb) {
+        ts_malformed(state, VOODOO_EVENT_NAL_FORMAT, size, "no start code in video pes");
+        return;
+    }
+    while(nal_next(data, size, 0, &pos, &start, &end) > 0) {
+        if(end <= start) {
+            continue;
+        }
+        int nal_type = hevc ? (data[start] >> 1) & 0x3f : data[start] & 0x1f;
+        const uint8_t **nal = NULL;
+        uint32_t *nal_size = NULL;
+        if(hevc) {
+            if(nal_type == HEVC_NAL_VPS) { nal = &vps; nal_size = &vps_size; }
+            else if(nal_type == HEVC_NAL_SPS) { nal = &sps; nal_size = &sps_size; }
+            else if(nal_type == HEVC_NAL_PPS) { nal = &pps; nal_size = &pps_size; }
+        } else {
+            if(nal_type == AVC_NAL_SPS) { nal = &sps; nal_size = &sps_size; }
+            else if(nal_type == AVC_NAL_PPS) { nal = &pps; nal_size = &pps_size; }
+        }
+        if(nal && !*nal) {
+            *nal = data + start;
+            *nal_size = end - start;
+        }
+        key |= ts_is_keyframe(state->video_codec_id, nal_type);
+    }
+    ts_update_parameters(state, vps, vps_size, sps, sps_size, pps, pps_size);
+
+    /*
+     没有参数集或者还没到关键帧之前的帧解不出来
+     */
+    if(state->parameters_size == 0 || (state->waiting_keyframe && !key)) {
+        return;
+    }
+    state->waiting_keyframe = 0;
+
+    demuxer_packet_t *packet;
+    uint32_t out_size = nal_output_size(&scan, NAL_FORMAT_LENGTH4, 0);
+    uint8_t *out = ts_output_begin(state, out_size, &packet);
+    if(!out) {
+        return;
+    }
+    out_size = nal_convert(data, size, 0, &scan, NAL_FORMAT_LENGTH4, NULL, 0, out);
+    DEMUXER_STAT_ADD(&state->trace, video_tags, 1);
+    if(key) {
+        DEMUXER_STAT_ADD(&state->trace, keyframes, 1);
+    }
+    ts_output_end(state, packet, VOODOO_DATA_TYPE_VIDEO_PACKET, out, out_size, key ? VOODOO_VIDEO_PACKET_FLAG_IS_KEY_FRAME : 0);
+}
+
+/*
+ ---------------------------------------------------------------- 音频
+ */
+
+/*
+ 一个pes里可以有多个adts帧，第i帧的时间戳是pes的pts加i*1024个采样
+ */
+static void ts_emit_audio(ts_demuxer_context_t *state, const uint8_t *data, uint32_t size, int64_t pts) {
+    uint32_t pos = 0, index = 0;
+    while(pos + TS_ADTS_HEADER_SIZE <= size) {
+        const uint8_t *p = data + pos;
+        if(p[0] != 0xff || (p[1] & 0xf6) != 0xf0) {
+            ts_malformed(state, VOODOO_EVENT_TAG_FAILED, TS_STREAM_TYPE_AAC, "adts sync lost");
+            return;
+        }
+        uint32_t header_size = (p[1] & 1) ? TS_ADTS_HEADER_SIZE : TS_ADTS_HEADER_SIZE + 2;
+        uint32_t profile = p[2] >> 6;
+        uint32_t sample_rate_index = (p[2] >> 2) & 0xf;
+        uint32_t channels = (uint32_t)(p[2] & 1) << 2 | p[3] >> 6;
+        uint32_t frame_size = (uint32_t)(p[3] & 3) << 11 | (uint32_t)p[4] << 3 | p[5] >> 5;
+        uint32_t sample_rate = ts_adts_sample_rates[sample_rate_index];
+        if(frame_size <= header_size || pos + frame_size > size || sample_rate == 0) {
+            ts_malformed(state, VOODOO_EVENT_TAG_FAILED, frame_size, "broken adts frame");
+            return;
+        }
+
+        /*
+         AudioSpecificConfig: audioObjectType(5) samplingFrequencyIndex(4) channelConfiguration(4)
+         */
+        uint8_t config[2];
+        config[0] = (uint8_t)((profile + 1) << 3 | sample_rate_index >> 1);
+        config[1] = (uint8_t)((sample_rate_index & 1) << 7 | channels << 3);
+        if(!state->audio_config_sent || memcmp(config, state->audio_config, sizeof(config)) != 0) {
+            memcpy(state->audio_config, config, sizeof(config));
+            state->audio_config_sent = 1;
+            ts_emit_data(state, VOODOO_DATA_TYPE_AUDIO_PARAMETERS, state->audio_config, sizeof(state->audio_config), 0);
+        }
+
+        if(pts != VOODOO_NOPTS_VALUE) {
+            state->pts = state->dts = ts_to_ms(pts + (int64_t)index * TS_AAC_FRAME_SAMPLES * TS_CLOCK_RATE / sample_rate);
+        }
+        DEMUXER_STAT_ADD(&state->trace, audio_tags, 1);
+        ts_emit_data(state, VOODOO_DATA_TYPE_AUDIO_PACKET, p + header_size, frame_size - header_size, 0);
+        pos += frame_size;
+        ++index;
+    }
+}
+
+/*
+ ---------------------------------------------------------------- pes
+ */
+static void ts_parse_pes(ts_demuxer_context_t *state, ts_pes_stream_t *s) {
+    const uint8_t *p = s->buf;
+    uint32_t size = s->expected && s->expected < s->size ? s->expected : s->size;
+    int64_t pts = VOODOO_NOPTS_VALUE, dts = VOODOO_NOPTS_VALUE;
+    if(size < TS_PES_HEADER_SIZE || p[0] != 0 || p[1] != 0 || p[2] != 1) {
+        ts_malformed(state, VOODOO_EVENT_TAG_FAILED, (uint32_t)s->pid, "bad pes start code");
+        return;
+    }
+    uint32_t header_size = TS_PES_HEADER_SIZE + p[8];
+    int flags = p[7] >> 6;
+    if(header_size > size || (flags == 2 && p[8] < 5) || (flags == 3 && p[8] < 10)) {
+        ts_malformed(state, VOODOO_EVENT_TAG_FAILED, (uint32_t)s->pid, "bad pes header");
+        return;
+    }
+    if(flags & 2) {
+        pts = ts_unwrap(state, ts_read_timestamp(p + 9));
+        dts = flags == 3 ? ts_unwrap(state, ts_read_timestamp(p + 14)) : pts;
+    }
+    state->pts = ts_to_ms(pts);
+    state->dts = ts_to_ms(dts);
+    if(s == &state->video) {
+        ts_emit_video(state, p + header_size, size - header_size);
+    } else {
+        ts_emit_audio(state, p + header_size, size - header_size, pts);
+    }
+}
+
+static int ts_pes_append(ts_demuxer_context_t *state, ts_pes_stream_t *s, const uint8_t *data, uint32_t size) {
+    if(s->size + size > s->capacity) {
+        uint32_t capacity = s->capacity ? s->capacity : TS_PES_INITIAL_SIZE;
+        while(capacity < s->size + size) {
+            capacity *= 2;
+        }
+        if(capacity > TS_PES_MAX_SIZE) {
+            ts_trace_event(state, VOODOO_EVENT_CACHE_LIMIT, VOODOO_LOG_WARN, s->size + size, "pes too large");
+            return -1;
+        }
+        uint8_t *buf = (uint8_t*)state->config.malloc_fn(state->config.allocator_opaque, capacity);
+        if(!buf) {
+            ts_trace_event(state, VOODOO_EVENT_ALLOC_FAILED, VOODOO_LOG_ERROR, capacity, "pes alloc failed");
+            return -1;
+        }
+        if(s->buf) {
+            memcpy(buf, s->buf, s->size);
+            state->config.free_fn(state->config.allocator_opaque, s->buf);
+        }
+        DEMUXER_STAT_ADD(&state->trace, bytes_moved, s->size);
+        s->buf = buf;
+        s->capacity = capacity;
+    }
+    memcpy(s->buf + s->size, data, size);
+    s->size += size;
+    return 0;
+}
+
+static void ts_pes_complete(ts_demuxer_context_t *state, ts_pes_stream_t *s) {
+    if(s->started && s->size > 0) {
+        ts_parse_pes(state, s);
+    }
+    s->started = 0;
+    s->size = 0;
+    s->expected = 0;
+}
+
+static void ts_pes_push(ts_demuxer_context_t *state, ts_pes_stream_t *s, int unit_start, int continuity, int discontinuity,
+                        int random_access, const uint8_t *payload, uint32_t size) {
+    if(s->continuity >= 0 && !discontinuity) {
+        if(continuity == s->continuity) {
+            /*
+             重复包
+             */
+            return;
+        }
+        if(continuity != ((s->continuity + 1) & 0xf)) {
+            ts_malformed(state, VOODOO_EVENT_TS_CONTINUITY, (uint32_t)s->pid, "continuity counter jump, pes dropped");
+            s->started = 0;
+            s->size = 0;
+            s->expected = 0;
+        }
+    }
+    s->continuity = continuity;
+    if(unit_start) {
+        ts_pes_complete(state, s);
+        s->started = 1;
+        s->random_access = random_access;
+    }
+    if(!s->started) {
+        return;
+    }
+    if(ts_pes_append(state, s, payload, size) < 0) {
+        s->started = 0;
+        s->size = 0;
+        s->expected = 0;
+        return;
+    }
+    if(s->expected == 0 && s->size >= 6) {
+        uint32_t length = (uint32_t)s->buf[4] << 8 | s->buf[5];
+        s->expected = length ? length + 6 : 0;
+    }
+    if(s->expected && s->size >= s->expected) {
+        ts_pes_complete(state, s);
+    }
+}
+
+/*
+ ---------------------------------------------------------------- psi
+ */
+static void ts_parse_pat(ts_demuxer_context_t *state, const uint8_t *p, uint32_t size) {
+    if(!(p[5] & 1)) {
+        return;
+    }
+    for(uint32_t i = 8;i + 4 <= size - 4;i += 4) {
+        int program_number = p[i] << 8 | p[i + 1];
+        int pid = (p[i + 2] & 0x1f) << 8 | p[i + 3];
+        if(program_number == 0) {
+            /*
+             network pid
+             */
+            continue;
+        }
+        if(pid != state->pmt_pid) {
+            state->pmt_pid = pid;
+            state->pmt_version = -1;
+        }
+        return;
+    }
+}
+
+static void ts_select_stream(ts_pes_stream_t *s, int pid, int stream_type) {
+    if(s->pid != pid || s->stream_type != stream_type) {
+        ts_reset_stream(s);
+        s->pid = pid;
+        s->stream_type = stream_type;
+    }
+}
+
+static void ts_parse_pmt(ts_demuxer_context_t *state, const uint8_t *p, uint32_t size) {
+    int version = (p[5] >> 1) & 0x1f;
+    int video_pid = -1, video_type = 0, audio_pid = -1;
+    if(!(p[5] & 1) || version == state->pmt_version || size < 16) {
+        return;
+    }
+    state->pmt_version = version;
+    uint32_t i = 12 + ((uint32_t)(p[10] & 0x0f) << 8 | p[11]);
+    while(i + 5 <= size - 4) {
+        int stream_type = p[i];
+        int pid = (p[i + 1] & 0x1f) << 8 | p[i + 2];
+        if(video_pid < 0 && (stream_type == TS_STREAM_TYPE_H264 || stream_type == TS_STREAM_TYPE_HEVC)) {
+            video_pid = pid;
+            video_type = stream_type;
+        } else if(audio_pid < 0 && stream_type == TS_STREAM_TYPE_AAC) {
+            audio_pid = pid;
+        }
+        i += 5 + ((uint32_t)(p[i + 3] & 0x0f) << 8 | p[i + 4]);
+    }
+
+    int video_codec_id = video_type == TS_STREAM_TYPE_HEVC ? VIDEO_CODEC_ID_HEVC : VIDEO_CODEC_ID_H264;
+    if(video_pid != state->video.pid || video_codec_id != state->video_codec_id) {
+        state->parameters_size = 0;
+        state->waiting_keyframe = 1;
+        memset(&state->video_info, 0, sizeof(video_sps_info_t));
+    }
+    if(audio_pid != state->audio.pid) {
+        state->audio_config_sent = 0;
+    }
+    state->video_codec_id = video_codec_id;
+    ts_select_stream(&state->video, video_pid, video_type);
+    ts_select_stream(&state->audio, audio_pid, TS_STREAM_TYPE_AAC);
+
+    uint32_t media_flag = (video_pid >= 0 ? TS_MEDIA_FLAG_VIDEO : 0) | (audio_pid >= 0 ? TS_MEDIA_FLAG_AUDIO : 0);
+    if(media_flag != state->media_flag) {
+        state->media_flag = media_flag;
+        ts_emit_media_flag(state, media_flag);
+    }
+}
+
+/*
+ section可能跨包，拼完整并且crc对了再解析
+ */
+static void ts_parse_psi(ts_demuxer_context_t *state, int pid, int unit_start, const uint8_t *payload, uint32_t size) {
+    if(unit_start) {
+        uint32_t pointer = payload[0];
+        if(1 + pointer >= size) {
+            return;
+        }
+        payload += 1 + pointer;
+        size -= 1 + pointer;
+        state->section_size = 0;
+        state->section_pid = pid;
+    } else if(state->section_pid != pid || state->section_size == 0) {
+        return;
+    }
+    uint32_t n = TS_MAX_SECTION_SIZE - state->section_size;
+    n = size < n ? size : n;
+    memcpy(state->section + state->section_size, payload, n);
+    state->section_size += n;
+    if(state->section_size < 3) {
+        return;
+    }
+    uint32_t total = 3 + ((uint32_t)(state->section[1] & 0x0f) << 8 | state->section[2]);
+    if(total > TS_MAX_SECTION_SIZE || total < 12) {
+        state->section_size = 0;
+        ts_malformed(state, VOODOO_EVENT_TAG_FAILED, (uint32_t)pid, "bad section length");
+        return;
+    }
+    if(state->section_size < total) {
+        return;
+    }
+    state->section_size = 0;
+    if(ts_crc32(state->section, total) != 0) {
+        ts_malformed(state, VOODOO_EVENT_TAG_FAILED, (uint32_t)pid, "section crc mismatch");
+        return;
+    }
+    if(pid == TS_PID_PAT && state->section[0] == TS_TABLE_ID_PAT) {
+        ts_parse_pat(state, state->section, total);
+    } else if(pid == state->pmt_pid && state->section[0] == TS_TABLE_ID_PMT) {
+        ts_parse_pmt(state, state->section, total);
+    }
+}
+
+/*
+ ---------------------------------------------------------------- ts包
+ */
+static void ts_parse_packet(ts_demuxer_context_t *state, const uint8_t *p) {
+    int pid = (p[1] & 0x1f) << 8 | p[2];
+    int unit_start = p[1] & 0x40;
+    int adaptation = (p[3] >> 4) & 3;
+    int continuity = p[3] & 0x0f;
+    int discontinuity = 0, random_access = 0;
+    uint32_t pos = 4;
+
+    if(pid == TS_PID_NULL) {
+        return;
+    }
+    if(p[1] & 0x80) {
+        /*
+         transport_error_indicator
+         */
+        ts_malformed(state, VOODOO_EVENT_TAG_FAILED, (uint32_t)pid, "transport error");
+        return;
+    }
+    if(adaptation & 2) {
+        uint32_t length = p[4];
+        if(length > TS_PACKET_SIZE - 5) {
+            ts_malformed(state, VOODOO_EVENT_TAG_FAILED, (uint32_t)pid, "bad adaptation field");
+            return;
+        }
+        if(length > 0) {
+            discontinuity = p[5] & 0x80;
+            random_access = p[5] & 0x40;
+        }
+        pos += 1 + length;
+    }
+    if(!(adaptation & 1) || pos >= TS_PACKET_SIZE) {
+        return;
+    }
+    if(pid == TS_PID_PAT || pid == state->pmt_pid) {
+        ts_parse_psi(state, pid, unit_start, p + pos, TS_PACKET_SIZE - pos);
+    } else if(pid == state->video.pid) {
+        ts_pes_push(state, &state->video, unit_start, continuity, discontinuity, random_access, p + pos, TS_PACKET_SIZE - pos);
+    } else if(pid == state->audio.pid) {
+        ts_pes_push(state, &state->audio, unit_start, continuity, discontinuity, random_access, p + pos, TS_PACKET_SIZE - pos);
+    }
+}
+
+/*
+ 同步字节候选：p[i]、p[i+188]、p[i+376]都是0x47。
+ 返回第一个候选的偏移，没有时返回还不能判断的第一个位置。
+ */
+static uint32_t ts_scan_sync(const uint8_t *p, uint32_t len) {
+    uint32_t i = 0, end;
+    if(len <= TS_SYNC_CHECK_SIZE) {
+        return 0;
+    }
+    end = len - TS_SYNC_CHECK_SIZE;
+#if defined(__SSE2__)
+    const __m128i sync = _mm_set1_epi8(TS_SYNC_BYTE);
+    for(;i + 16 <= end;i += 16) {
+        __m128i hit = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i)), sync),
+                                                  _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i + TS_PACKET_SIZE)), sync)),
+                                    _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i + 2 * TS_PACKET_SIZE)), sync));
+        int mask = _mm_movemask_epi8(hit);
+        if(mask) {
+            return i + (uint32_t)__builtin_ctz((unsigned)mask);
+        }
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t sync = vdupq_n_u8(TS_SYNC_BYTE);
+    for(;i + 16 <= end;i += 16) {
+        uint8x16_t hit = vandq_u8(vandq_u8(vceqq_u8(vld1q_u8(p + i), sync), vceqq_u8(vld1q_u8(p + i + TS_PACKET_SIZE), sync)),
+                                  vceqq_u8(vld1q_u8(p + i + 2 * TS_PACKET_SIZE), sync));
+        /*
+         neon没有movemask，窄化成每字节4位的64位掩码
+         */
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+        if(mask) {
+            return i + (uint32_t)(__builtin_ctzll(mask) >> 2);
+        }
+    }
+#endif
+    for(;i < end;++i) {
+        if(p[i] == TS_SYNC_BYTE && p[i + TS_PACKET_SIZE] == TS_SYNC_BYTE && p[i + 2 * TS_PACKET_SIZE] == TS_SYNC_BYTE) {
+            return i;
+        }
+    }
+    return end;
+}
+
+static void ts_sync_lost(ts_demuxer_context_t *state, uint32_t value) {
+    state->synced = 0;
+    state->resync_skipped = 0;
+    DEMUXER_STAT_ADD(&state->trace, resyncs, 1);
+    ts_malformed(state, VOODOO_EVENT_RESYNC, value, "sync byte lost, resyncing");
+}
+
+/*
+ 解析[0, len)里完整的包，返回用掉的字节数，剩下的不够一个包或者还确认不了同步
+ */
+static uint32_t ts_consume(ts_demuxer_context_t *state, const uint8_t *p, uint32_t len) {
+    uint32_t pos = 0;
+    while(pos < len) {
+        if(!state->synced || p[pos] != TS_SYNC_BYTE) {
+            if(state->synced) {
+                ts_sync_lost(state, p[pos]);
+            }
+            uint32_t skip = ts_scan_sync(p + pos, len - pos);
+            state->resync_skipped += skip;
+            state->offset += skip;
+            DEMUXER_STAT_ADD(&state->trace, resync_bytes_skipped, skip);
+            pos += skip;
+            if(len - pos <= TS_SYNC_CHECK_SIZE) {
+                return pos;
+            }
+            state->synced = 1;
+            ts_trace_event(state, VOODOO_EVENT_RESYNCED, VOODOO_LOG_INFO, state->resync_skipped, "sync byte found");
+        }
+        if(len - pos < TS_PACKET_SIZE) {
+            return pos;
+        }
+        ts_parse_packet(state, p + pos);
+        state->offset += TS_PACKET_SIZE;
+        pos += TS_PACKET_SIZE;
+    }
+    return pos;
+}
+
+int ts_demuxer_feed(void* ctx, const void* data, int len) {
+    ts_demuxer_context_t* state = (ts_demuxer_context_t*)ctx;
+    const uint8_t *p = (const uint8_t*)data;
+    uint32_t left = len > 0 ? (uint32_t)len : 0;
+    uint64_t t0 = demuxer_trace_now_ns();
+    DEMUXER_STAT_ADD(&state->trace, bytes_fed, left);
+    DEMUXER_STAT_ADD(&state->trace, feeds, 1);
+
+    /*
+     上次剩下的字节先和新数据的开头拼起来解析，carry里的旧字节用完后
+     没用到的新字节退回去，从调用者的buffer上接着解析
+     */
+    while(state->carry_size > 0) {
+        uint32_t old = state->carry_size;
+        uint32_t n = (uint32_t)sizeof(state->carry) - old;
+        n = left < n ? left : n;
+        memcpy(state->carry + old, p, n);
+        state->carry_size += n;
+        p += n;
+        left -= n;
+        uint32_t used = ts_consume(state, state->carry, state->carry_size);
+        if(used >= old) {
+            uint32_t back = state->carry_size - used;
+            p -= back;
+            left += back;
+            state->carry_size = 0;
+            break;
+        }
+        memmove(state->carry, state->carry + used, state->carry_size - used);
+        state->carry_size -= used;
+        if(left == 0) {
+            goto done;
+        }
+    }
+
+    /*
+     完整的包直接在调用者的buffer上解析，不拷贝
+     */
+    uint32_t used = ts_consume(state, p, left);
+    memcpy(state->carry, p + used, left - used);
+    state->carry_size = left - used;
+
+done:
+    DEMUXER_STAT_MAX(&state->trace, max_feed_ns, demuxer_trace_now_ns() - t0);
+    return 0;
+}
+
+void ts_demuxer_flush(void* ctx) {
+    ts_demuxer_context_t* state = (ts_demuxer_context_t*)ctx;
+    ts_pes_complete(state, &state->video);
+    ts_pes_complete(state, &state->audio);
+}
+
+void ts_demuxer_reset(void* ctx) {
+    ts_demuxer_context_t* state = (ts_demuxer_context_t*)ctx;
+    ts_release_queue(state);
+    state->carry_size = 0;
+    state->section_size = 0;
+    state->synced = 1;
+    state->waiting_keyframe = 1;
+    state->ts_reference = state->pts = state->dts = VOODOO_NOPTS_VALUE;
+    ts_reset_stream(&state->video);
+    ts_reset_stream(&state->audio);
+}
@@ -0,0 +1,65 @@
+//
+//  ts.h
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#ifndef ts_h
+#define ts_h
+
+#include "demuxer.h"
+#include "packet_pool.h"
+#include "video_sps.h"
+#include "demuxer_trace.h"
+
+/*
+ mpeg-ts demuxer for hls segments and ts over http, same callback contract
+ as flv.c so one pipeline serves both:
+ VOODOO_DATA_TYPE_MEDIA_FLAG        flv style flags (1 video, 4 audio) once the pmt is known
+ VOODOO_DATA_TYPE_VIDEO_PARAMETERS  avcC / hvcC built from the in band parameter sets,
+                                    flag is the VIDEO_CODEC_ID_*, again whenever they change
+ VOODOO_DATA_TYPE_VIDEO_PACKET      one access unit, 4 byte length prefixed
+ VOODOO_DATA_TYPE_AUDIO_PARAMETERS  AudioSpecificConfig from the adts header
+ VOODOO_DATA_TYPE_AUDIO_PACKET      one raw aac frame, adts header stripped
+ timestamps are milliseconds with the 33 bit 90 kHz wrap unrolled. the
+ first program's first h264/hevc and adts aac streams are played, video
+ starts at the first keyframe after its parameter sets.
+ audio_tags/video_tags of demuxer_stats_t count frames.
+ */
+void* ts_demuxer_init(void* userdata, fn_demuxer_callback_t callback);
+/*
+ only the allocator of config is used
+ */
+void* ts_demuxer_init_with_config(void* userdata, fn_demuxer_callback_t callback, const demuxer_config_t* config);
+void ts_demuxer_fint(void* ctx);
+/*
+ any chunking, bad input is skipped by scanning for the next sync byte.
+ returns 0
+ */
+int ts_demuxer_feed(void* ctx, const void* data, int len);
+/*
+ delivers the pes still being reassembled, at the end of a stream
+ */
+void ts_demuxer_flush(void* ctx);
+/*
+ after a seek or an hls discontinuity: drops partial packets, the packets
+ not yet taken by ts_demuxer_read_packets and the timestamp history, keeps
+ the program and parameters. flush and read first to keep the last ones
+ */
+void ts_demuxer_reset(void* ctx);
+
+/*
+ see flv_demuxer_set_packet_pool / flv_demuxer_read_packets
+ */
+void ts_demuxer_set_packet_pool(void* ctx, packet_pool_t* pool, fn_demuxer_packet_callback_t callback);
+int ts_demuxer_read_packets(void* ctx, demuxer_packet_t** packets, int max);
+
+const video_sps_info_t* ts_demuxer_get_video_info(void* ctx);
+
+void ts_demuxer_get_stats(void* ctx, demuxer_stats_t* stats);
+int ts_demuxer_read_events(void* ctx, demuxer_event_t* events, int max);
+void ts_demuxer_set_log_callback(void* ctx, fn_demuxer_log_callback_t callback, void* opaque, int level);
+
+#endif /* ts_h */
@@ -86,4 +86,16 @@ public final class LiveVideoCodedFrame : LiveVideoFrame {
                                  Unmanaged.passUnretained(value ? kCFBooleanTrue : kCFBooleanFalse).toOpaque())
         }
     }
+
+    /*
+     the layer still decodes it, the frames after it depend on it
+     */
+    func setDoNotDisplay(_ value:Bool) {
+        if let buffer = self.sampleBuffer, let attachmentArray = CMSampleBufferGetSampleAttachmentsArray(buffer, createIfNecessary: true) {
+            let dic = unsafeBitCast(CFArrayGetValueAtIndex(attachmentArray, 0), to: CFMutableDictionary.self)
+            CFDictionarySetValue(dic,
+                                 Unmanaged.passUnretained(kCMSampleAttachmentKey_DoNotDisplay).toOpaque(),
+                                 Unmanaged.passUnretained(value ? kCFBooleanTrue : kCFBooleanFalse).toOpaque())
+        }
+    }
 }
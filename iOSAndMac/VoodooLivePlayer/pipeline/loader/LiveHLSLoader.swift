@@ -8,17 +8,279 @@
 
 import Foundation
 
-class LiveHLSLoader : LiveLoaderProtocol {
+/*
+ hls over URLSession, the fetching decisions are made by hls_scheduler.
+ segments and parts are fetched in parallel and handed out as .rawData
+ (mpeg-ts) in playlist order, each one announced with handle(loaderBoundaryWithDiscontinuity:)
+ */
+class LiveHLSLoader : NSObject, LiveLoaderProtocol, URLSessionDataDelegate {
     var delegate: LiveLoaderDelegate?
-    
+
     var delegateQueue: DispatchQueue?
-    
+
+    let source: LiveStreamSource
+    let lowLatency: Bool
+
+    private static let maxPlaylistFailures: UInt32 = 3
+
+    private class LiveHLSTask {
+        let requestID: UInt32
+        let type: Int32
+        var data = Data()
+        var parser: OpaquePointer?
+        var sequence: UInt64 = 0
+        var part: Int32 = -1
+        var programDateTime: Int64 = Int64.min
+        var duration: UInt32 = 0
+
+        init(requestID: UInt32, type: Int32) {
+            self.requestID = requestID
+            self.type = type
+        }
+    }
+
+    private var session: URLSession?
+    private var scheduler: OpaquePointer?
+    private var playlistURL: URL
+    private var tasks = [Int: LiveHLSTask]()
+    private var finished = [UInt32: LiveHLSTask]()
+    private var wakeup: DispatchWorkItem?
+    private var startTime: UInt64 = 0
+    private var firstDelivered = false
+    private var lastLoggedSequence: UInt64 = UInt64.max
+
+    init(source: LiveStreamSource, lowLatency: Bool = true) {
+        self.source = source
+        self.lowLatency = lowLatency
+        self.playlistURL = source.url
+    }
+
+    deinit {
+        if let scheduler = self.scheduler {
+            hls_scheduler_destroy(scheduler)
+        }
+    }
+
     func start() -> Bool {
-        true
+        if self.session == nil {
+            let queue = OperationQueue()
+            queue.underlyingQueue = delegateQueue
+            queue.maxConcurrentOperationCount = 1
+            self.session = URLSession(configuration: .ephemeral, delegate: self, delegateQueue: queue)
+        }
+        guard self.session != nil else { return false }
+
+        var config = hls_scheduler_config_t()
+        config.low_latency = lowLatency ? 1 : 0
+        if let scheduler = self.scheduler {
+            hls_scheduler_destroy(scheduler)
+        }
+        self.scheduler = hls_scheduler_create(&config)
+        guard self.scheduler != nil else { return false }
+
+        playlistURL = source.url
+        startTime = DispatchTime.now().uptimeNanoseconds
+        firstDelivered = false
+        print(">> URL \(self.source.url) REQUESTED")
+        pump()
+        return true
     }
-    
+
     func stop() {
-        
+        wakeup?.cancel()
+        wakeup = nil
+        for (_, task) in tasks {
+            if let parser = task.parser {
+                hls_playlist_parser_destroy(parser)
+            }
+        }
+        tasks.removeAll()
+        finished.removeAll()
+        session?.invalidateAndCancel()
+        session = nil
+        if let scheduler = self.scheduler {
+            hls_scheduler_destroy(scheduler)
+            self.scheduler = nil
+        }
+    }
+
+    private func nowMs() -> Int64 {
+        return Int64(DispatchTime.now().uptimeNanoseconds / 1_000_000)
+    }
+
+    /*
+     issue whatever the scheduler wants, deliver what is ready in order
+     */
+    private func pump() {
+        guard let scheduler = self.scheduler else { return }
+        var req = hls_request_t()
+        while hls_scheduler_next_request(scheduler, nowMs(), &req) != 0 {
+            issue(request: &req)
+        }
+        deliver()
+
+        if hls_scheduler_finished(scheduler) != 0 && finished.isEmpty {
+            var stats = hls_scheduler_stats_t()
+            hls_scheduler_get_stats(scheduler, &stats)
+            if stats.in_flight == 0 {
+                print(">> HLS \(self.source.url) FINISHED")
+                return
+            }
+        }
+
+        wakeup?.cancel()
+        wakeup = nil
+        let next = hls_scheduler_next_wakeup(scheduler)
+        if next != Int64.max, let queue = delegateQueue {
+            let item = DispatchWorkItem { [weak self] in self?.pump() }
+            wakeup = item
+            queue.asyncAfter(deadline: .now() + .milliseconds(Int(max(0, next - nowMs()))), execute: item)
+        }
+    }
+
+    private func issue(request req: inout hls_request_t) {
+        guard let session = self.session else { return }
+        let uri = withUnsafePointer(to: &req.uri) {
+            $0.withMemoryRebound(to: CChar.self, capacity: Int(HLS_MAX_URI_SIZE)) { String(cString: $0) }
+        }
+        let query = withUnsafePointer(to: &req.query) {
+            $0.withMemoryRebound(to: CChar.self, capacity: 64) { String(cString: $0) }
+        }
+
+        var url: URL?
+        var timeout = 10.0
+        if req.type == HLS_REQUEST_PLAYLIST {
+            if var components = URLComponents(url: playlistURL, resolvingAgainstBaseURL: true) {
+                if !query.isEmpty {
+                    components.percentEncodedQuery = (components.percentEncodedQuery.map { $0 + "&" } ?? "") + query
+                    /*
+                     the server holds a blocking reload up to three target durations
+                     */
+                    timeout = 30.0
+                }
+                url = components.url
+            }
+        } else {
+            url = URL(string: uri, relativeTo: playlistURL)?.absoluteURL
+        }
+
+        let task = LiveHLSTask(requestID: req.id, type: req.type)
+        task.sequence = req.sequence
+        task.part = req.part
+        task.programDateTime = req.program_date_time_ms
+        task.duration = req.duration_ms
+        guard let requestURL = url else {
+            complete(task: task, ok: false)
+            return
+        }
+        if req.type == HLS_REQUEST_PLAYLIST {
+            task.parser = hls_playlist_parser_create()
+        }
+
+        let request = URLRequest(url: requestURL, cachePolicy: .reloadIgnoringLocalAndRemoteCacheData, timeoutInterval: timeout)
+        let dataTask = session.dataTask(with: request)
+        tasks[dataTask.taskIdentifier] = task
+        dataTask.resume()
+    }
+
+    private func complete(task: LiveHLSTask, ok: Bool) {
+        guard let scheduler = self.scheduler else { return }
+        if task.type == HLS_REQUEST_PLAYLIST {
+            var playlist: UnsafeMutablePointer<hls_playlist_t>? = nil
+            if let parser = task.parser {
+                playlist = hls_playlist_parser_finish(parser)
+                hls_playlist_parser_destroy(parser)
+                task.parser = nil
+            }
+            if !ok && playlist != nil {
+                hls_playlist_free(playlist)
+                playlist = nil
+            }
+            if let master = playlist, master.pointee.type == HLS_PLAYLIST_MASTER {
+                /*
+                 the first variant is the one the author wants to start with
+                 */
+                let variantURL = master.pointee.variant_count > 0 ? URL(string: String(cString: master.pointee.variants[0].uri), relativeTo: playlistURL)?.absoluteURL : nil
+                hls_playlist_free(master)
+                if let url = variantURL {
+                    print(">> HLS VARIANT \(url)")
+                    playlistURL = url
+                    var req = hls_request_t()
+                    req.id = task.requestID
+                    req.type = HLS_REQUEST_PLAYLIST
+                    req.part = -1
+                    issue(request: &req)
+                    return
+                }
+                playlist = nil
+            }
+            hls_scheduler_playlist_loaded(scheduler, task.requestID, playlist, nowMs())
+
+            var stats = hls_scheduler_stats_t()
+            hls_scheduler_get_stats(scheduler, &stats)
+            if stats.playlist_failures >= LiveHLSLoader.maxPlaylistFailures {
+                print("HLS PLAYLIST \(playlistURL) FAILED \(stats.playlist_failures) TIMES")
+                stop()
+                delegate?.handle(loaderError: URLError(.resourceUnavailable))
+                return
+            }
+        } else {
+            if ok {
+                finished[task.requestID] = task
+            }
+            hls_scheduler_media_loaded(scheduler, task.requestID, ok ? 1 : 0)
+        }
+        pump()
+    }
+
+    private func deliver() {
+        guard let scheduler = self.scheduler else { return }
+        var requestID: UInt32 = 0
+        var discontinuity: Int32 = 0
+        while hls_scheduler_pop_ready(scheduler, &requestID, &discontinuity) != 0 {
+            guard let task = finished.removeValue(forKey: requestID) else { continue }
+            if !firstDelivered {
+                firstDelivered = true
+                print(">> HLS FIRST MEDIA AFTER \((DispatchTime.now().uptimeNanoseconds - startTime) / 1_000_000) ms")
+            }
+            if task.programDateTime != Int64.min && task.sequence != lastLoggedSequence {
+                /*
+                 how far behind the live edge this data ends, needs EXT-X-PROGRAM-DATE-TIME
+                 */
+                lastLoggedSequence = task.sequence
+                let end = task.programDateTime + Int64(task.duration)
+                print(">> HLS SEQUENCE \(task.sequence) LATENCY \(Int64(Date().timeIntervalSince1970 * 1000) - end) ms")
+            }
+            delegate?.handle(loaderBoundaryWithDiscontinuity: discontinuity != 0)
+            delegate?.handle(loaderData: task.data, withType: .rawData)
+        }
+    }
+
+    func urlSession(_ session: URLSession, dataTask: URLSessionDataTask, didReceive data: Data) {
+        guard let task = tasks[dataTask.taskIdentifier] else { return }
+        if let parser = task.parser {
+            data.withUnsafeBytes { (ptr) -> Void in
+                if let dataPtr = ptr.baseAddress {
+                    _ = hls_playlist_parser_feed(parser, dataPtr, UInt32(data.count))
+                }
+            }
+        } else {
+            task.data.append(data)
+        }
+    }
+
+    func urlSession(_ session: URLSession, task: URLSessionTask, didCompleteWithError error: Error?) {
+        guard let loaderTask = tasks.removeValue(forKey: task.taskIdentifier) else { return }
+        if let urlError = error as? URLError, urlError.code == URLError.Code.cancelled {
+            return
+        }
+        var ok = error == nil
+        if let response = task.response as? HTTPURLResponse, !(200..<300).contains(response.statusCode) {
+            ok = false
+        }
+        if !ok {
+            print("HLS REQUEST \(task.originalRequest?.url?.absoluteString ?? "") FAILED -", error ?? "HTTP \((task.response as? HTTPURLResponse)?.statusCode ?? 0)")
+        }
+        complete(task: loaderTask, ok: ok)
     }
-    
 }
@@ -10,7 +10,16 @@ import Foundation
 
 protocol LiveLoaderDelegate : class {
     func handle(loaderData data: Data, withType type: LivePipelineDataType)
+    /**
+     loaders that demux by themselves (rtmp) hand out demuxer data
+     */
+    func handle(loaderData data: Data, withType type: LivePipelineDataType, ts: [Int64], flag: UInt32)
     func handle(loaderError error: Error?)
+    /**
+     loaders that fetch in pieces (hls) call this before each segment or part,
+     discontinuity means the timestamps and codec parameters may start over
+     */
+    func handle(loaderBoundaryWithDiscontinuity discontinuity: Bool)
 }
 
 protocol LiveLoaderProtocol : LivePlayerComponent {
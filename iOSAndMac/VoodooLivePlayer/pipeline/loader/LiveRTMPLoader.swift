@@ -43,26 +43,10 @@ class LiveRTMPLoader : LiveLoaderProtocol, RTMPNetConnectionDelegate, RTMPUnderl
     /// RTMPNetConnectionDelegate
     func handleMessage(_ message: RTMPMessage) {
         //print("RTMP MESSAGE: \(message.type)")
-        
-        
-        if message.type == 0x08 {
-            if gotfirstAudioPacket {
-                //dataType = da
-                delegate?.handle(loaderData: message.data, withType: .audioPacket)
-            } else {
-                gotfirstAudioPacket = true
-                delegate?.handle(loaderData: message.data, withType: .audioParameters)
-            }
-        } else if message.type == 0x09 {
-            if gotFirstVideoPacket {
-                delegate?.handle(loaderData: message.data, withType: .videoPacket)
-            } else {
-                gotFirstVideoPacket = true
-                delegate?.handle(loaderData: message.data, withType: .videoParameters)
-            }
-        } else {
-            return
-        }
+    }
+    
+    func handleMedia(_ data: Data, withType type: LivePipelineDataType, ts: [Int64], flag: UInt32) {
+        delegate?.handle(loaderData: data, withType: type, ts: ts, flag: flag)
     }
     
     func handleError(_ error: RTMPError) {
@@ -77,10 +61,6 @@ class LiveRTMPLoader : LiveLoaderProtocol, RTMPNetConnectionDelegate, RTMPUnderl
         }
     }
     
-    /// loader state
-    var gotFirstVideoPacket = false
-    var gotfirstAudioPacket = false
-    
     let address: RTMPAddress
     let rtmpNetConnection: RTMPNetConnection
 
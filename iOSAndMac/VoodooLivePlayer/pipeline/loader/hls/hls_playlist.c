@@ -0,0 +1,554 @@
+//
+//  hls_playlist.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#include "hls_playlist.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define HLS_MAX_LINE_SIZE           (64*1024)
+#define HLS_MAX_ATTRIBUTE_SIZE      (4*1024)
+#define HLS_INITIAL_CAPACITY        (16)
+
+struct hls_playlist_parser_s {
+    hls_playlist_t *playlist;
+    int failed;
+    int header_seen;
+
+    char *line;
+    uint32_t line_size;
+    uint32_t line_capacity;
+
+    /*
+     EXTINF / EXT-X-PART / EXT-X-DISCONTINUITY都作用于下一个uri行
+     */
+    hls_segment_t pending;
+    int pending_extinf;
+    int64_t next_date;
+
+    int pending_variant;
+    hls_variant_t variant;
+};
+
+static char* hls_strdup(const char *s, uint32_t size) {
+    char *copy = (char*)malloc(size + 1);
+    if(copy) {
+        memcpy(copy, s, size);
+        copy[size] = 0;
+    }
+    return copy;
+}
+
+static int hls_reserve(void **items, uint32_t *capacity, uint32_t count, size_t item_size) {
+    if(count < *capacity) {
+        return 0;
+    }
+    uint32_t n = *capacity ? *capacity * 2 : HLS_INITIAL_CAPACITY;
+    void *p = realloc(*items, n * item_size);
+    if(!p) {
+        return -1;
+    }
+    *items = p;
+    *capacity = n;
+    return 0;
+}
+
+static void hls_free_segment(hls_segment_t *segment) {
+    for(uint32_t i = 0;i < segment->part_count;++i) {
+        free(segment->parts[i].uri);
+    }
+    free(segment->parts);
+    free(segment->uri);
+}
+
+void hls_playlist_free(hls_playlist_t* playlist) {
+    if(!playlist) {
+        return;
+    }
+    for(uint32_t i = 0;i < playlist->segment_count;++i) {
+        hls_free_segment(&playlist->segments[i]);
+    }
+    for(uint32_t i = 0;i < playlist->variant_count;++i) {
+        free(playlist->variants[i].uri);
+        free(playlist->variants[i].codecs);
+    }
+    free(playlist->segments);
+    free(playlist->variants);
+    free(playlist->preload_hint_uri);
+    free(playlist);
+}
+
+static void hls_parser_reset(hls_playlist_parser_t *parser) {
+    hls_playlist_free(parser->playlist);
+    hls_free_segment(&parser->pending);
+    free(parser->variant.codecs);
+    parser->playlist = (hls_playlist_t*)calloc(1, sizeof(hls_playlist_t));
+    parser->failed = parser->playlist == NULL;
+    parser->header_seen = 0;
+    parser->line_size = 0;
+    memset(&parser->pending, 0, sizeof(hls_segment_t));
+    parser->pending_extinf = 0;
+    parser->next_date = HLS_NO_DATE;
+    parser->pending_variant = 0;
+    memset(&parser->variant, 0, sizeof(hls_variant_t));
+}
+
+hls_playlist_parser_t* hls_playlist_parser_create(void) {
+    hls_playlist_parser_t *parser = (hls_playlist_parser_t*)calloc(1, sizeof(hls_playlist_parser_t));
+    if(!parser) {
+        return NULL;
+    }
+    hls_parser_reset(parser);
+    return parser;
+}
+
+void hls_playlist_parser_destroy(hls_playlist_parser_t* parser) {
+    hls_playlist_free(parser->playlist);
+    hls_free_segment(&parser->pending);
+    free(parser->variant.codecs);
+    free(parser->line);
+    free(parser);
+}
+
+/*
+ ---------------------------------------------------------------- 属性
+ */
+
+/*
+ KEY=VALUE,KEY="QUOTED,VALUE",...里取name的值，去掉引号
+ */
+static int hls_attribute(const char *list, const char *name, char *out, uint32_t capacity) {
+    size_t name_size = strlen(name);
+    const char *p = list;
+    while(*p) {
+        const char *key = p;
+        while(*p && *p != '=' && *p != ',') ++p;
+        size_t key_size = (size_t)(p - key);
+        const char *value = p, *value_end = p;
+        if(*p == '=') {
+            ++p;
+            if(*p == '"') {
+                value = ++p;
+                while(*p && *p != '"') ++p;
+                value_end = p;
+                if(*p == '"') ++p;
+            } else {
+                value = p;
+                while(*p && *p != ',') ++p;
+                value_end = p;
+            }
+        }
+        if(key_size == name_size && memcmp(key, name, name_size) == 0) {
+            size_t size = (size_t)(value_end - value);
+            if(size + 1 > capacity) {
+                return 0;
+            }
+            memcpy(out, value, size);
+            out[size] = 0;
+            return 1;
+        }
+        while(*p && *p != ',') ++p;
+        if(*p == ',') ++p;
+    }
+    return 0;
+}
+
+static uint32_t hls_seconds_to_ms(const char *s) {
+    double seconds = strtod(s, NULL);
+    return seconds > 0 ? (uint32_t)(seconds * 1000 + 0.5) : 0;
+}
+
+static uint32_t hls_attribute_ms(const char *list, const char *name) {
+    char value[64];
+    return hls_attribute(list, name, value, sizeof(value)) ? hls_seconds_to_ms(value) : 0;
+}
+
+static int hls_attribute_yes(const char *list, const char *name) {
+    char value[16];
+    return hls_attribute(list, name, value, sizeof(value)) && strcmp(value, "YES") == 0;
+}
+
+static int64_t hls_days_from_civil(int64_t y, int m, int d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/*
+ iso 8601: 2026-10-17T08:00:00.000Z / +08:00 / +0800
+ */
+static int64_t hls_parse_date(const char *s) {
+    int year, month, day, hour, minute;
+    double second;
+    if(sscanf(s, "%d-%d-%dT%d:%d:%lf", &year, &month, &day, &hour, &minute, &second) != 6) {
+        return HLS_NO_DATE;
+    }
+    int64_t ms = (hls_days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60) * 1000 + (int64_t)(second * 1000 + 0.5);
+    const char *zone = strchr(s, 'T');
+    while(*zone && *zone != 'Z' && *zone != '+' && *zone != '-') ++zone;
+    if(*zone == '+' || *zone == '-') {
+        int zh = 0, zm = 0;
+        if(sscanf(zone + 1, "%2d:%2d", &zh, &zm) < 1) {
+            sscanf(zone + 1, "%2d%2d", &zh, &zm);
+        }
+        int64_t offset = (zh * 60 + zm) * 60000LL;
+        ms += *zone == '+' ? -offset : offset;
+    }
+    return ms;
+}
+
+/*
+ ---------------------------------------------------------------- 行
+ */
+static int hls_add_segment(hls_playlist_parser_t *parser, char *uri) {
+    hls_playlist_t *playlist = parser->playlist;
+    if(hls_reserve((void**)&playlist->segments, &playlist->segment_capacity, playlist->segment_count, sizeof(hls_segment_t)) < 0) {
+        free(uri);
+        return -1;
+    }
+    hls_segment_t *segment = &playlist->segments[playlist->segment_count];
+    *segment = parser->pending;
+    segment->uri = uri;
+    segment->sequence = playlist->media_sequence + playlist->segment_count;
+    if(!parser->pending_extinf) {
+        /*
+         只有part的半个分片
+         */
+        segment->duration_ms = 0;
+        for(uint32_t i = 0;i < segment->part_count;++i) {
+            segment->duration_ms += segment->parts[i].duration_ms;
+        }
+    }
+    segment->program_date_time_ms = parser->next_date;
+    if(parser->next_date != HLS_NO_DATE) {
+        parser->next_date += segment->duration_ms;
+    }
+    ++playlist->segment_count;
+    playlist->type = HLS_PLAYLIST_MEDIA;
+    memset(&parser->pending, 0, sizeof(hls_segment_t));
+    parser->pending_extinf = 0;
+    return 0;
+}
+
+static int hls_add_part(hls_playlist_parser_t *parser, const char *attributes) {
+    char *uri = (char*)malloc(HLS_MAX_ATTRIBUTE_SIZE);
+    if(!uri) {
+        return -1;
+    }
+    if(!hls_attribute(attributes, "URI", uri, HLS_MAX_ATTRIBUTE_SIZE)
+       || hls_reserve((void**)&parser->pending.parts, &parser->pending.part_capacity, parser->pending.part_count, sizeof(hls_part_t)) < 0) {
+        free(uri);
+        return 0;
+    }
+    hls_part_t *part = &parser->pending.parts[parser->pending.part_count++];
+    part->uri = uri;
+    part->duration_ms = hls_attribute_ms(attributes, "DURATION");
+    part->independent = hls_attribute_yes(attributes, "INDEPENDENT");
+    part->gap = hls_attribute_yes(attributes, "GAP");
+    return 0;
+}
+
+static int hls_add_variant(hls_playlist_parser_t *parser, char *uri) {
+    hls_playlist_t *playlist = parser->playlist;
+    if(hls_reserve((void**)&playlist->variants, &playlist->variant_capacity, playlist->variant_count, sizeof(hls_variant_t)) < 0) {
+        free(uri);
+        return -1;
+    }
+    parser->variant.uri = uri;
+    playlist->variants[playlist->variant_count++] = parser->variant;
+    playlist->type = HLS_PLAYLIST_MASTER;
+    memset(&parser->variant, 0, sizeof(hls_variant_t));
+    parser->pending_variant = 0;
+    return 0;
+}
+
+static void hls_parse_stream_inf(hls_playlist_parser_t *parser, const char *attributes) {
+    char value[HLS_MAX_ATTRIBUTE_SIZE];
+    free(parser->variant.codecs);
+    memset(&parser->variant, 0, sizeof(hls_variant_t));
+    if(hls_attribute(attributes, "BANDWIDTH", value, sizeof(value))) {
+        parser->variant.bandwidth = (uint32_t)strtoul(value, NULL, 10);
+    }
+    if(hls_attribute(attributes, "RESOLUTION", value, sizeof(value))) {
+        sscanf(value, "%dx%d", &parser->variant.width, &parser->variant.height);
+    }
+    if(hls_attribute(attributes, "CODECS", value, sizeof(value))) {
+        parser->variant.codecs = hls_strdup(value, (uint32_t)strlen(value));
+    }
+    parser->pending_variant = 1;
+}
+
+#define HLS_TAG(line, tag)      (strncmp((line), (tag), sizeof(tag) - 1) == 0 ? (line) + sizeof(tag) - 1 : NULL)
+
+static int hls_parse_line(hls_playlist_parser_t *parser, char *line, uint32_t size) {
+    hls_playlist_t *playlist = parser->playlist;
+    const char *v;
+    char value[HLS_MAX_ATTRIBUTE_SIZE];
+    while(size > 0 && (line[size - 1] == '\r' || line[size - 1] == ' ' || line[size - 1] == '\t')) {
+        line[--size] = 0;
+    }
+    if(!parser->header_seen) {
+        /*
+         utf-8 bom
+         */
+        if(size >= 3 && (uint8_t)line[0] == 0xef && (uint8_t)line[1] == 0xbb && (uint8_t)line[2] == 0xbf) {
+            line += 3;
+        }
+        if(strncmp(line, "#EXTM3U", 7) != 0) {
+            return -1;
+        }
+        parser->header_seen = 1;
+        return 0;
+    }
+    if(size == 0) {
+        return 0;
+    }
+    if(line[0] != '#') {
+        char *uri = hls_strdup(line, size);
+        if(!uri) {
+            return -1;
+        }
+        return parser->pending_variant ? hls_add_variant(parser, uri) : hls_add_segment(parser, uri);
+    }
+
+    if((v = HLS_TAG(line, "#EXTINF:"))) {
+        parser->pending.duration_ms = hls_seconds_to_ms(v);
+        parser->pending_extinf = 1;
+    } else if((v = HLS_TAG(line, "#EXT-X-PART:"))) {
+        return hls_add_part(parser, v);
+    } else if((v = HLS_TAG(line, "#EXT-X-PROGRAM-DATE-TIME:"))) {
+        parser->next_date = hls_parse_date(v);
+    } else if(HLS_TAG(line, "#EXT-X-DISCONTINUITY-SEQUENCE:")) {
+        playlist->discontinuity_sequence = strtoull(line + sizeof("#EXT-X-DISCONTINUITY-SEQUENCE:") - 1, NULL, 10);
+    } else if(HLS_TAG(line, "#EXT-X-DISCONTINUITY")) {
+        parser->pending.discontinuity = 1;
+    } else if((v = HLS_TAG(line, "#EXT-X-MEDIA-SEQUENCE:"))) {
+        playlist->media_sequence = strtoull(v, NULL, 10);
+    } else if((v = HLS_TAG(line, "#EXT-X-TARGETDURATION:"))) {
+        playlist->target_duration_ms = hls_seconds_to_ms(v);
+    } else if((v = HLS_TAG(line, "#EXT-X-VERSION:"))) {
+        playlist->version = atoi(v);
+    } else if(HLS_TAG(line, "#EXT-X-ENDLIST")) {
+        playlist->endlist = 1;
+    } else if((v = HLS_TAG(line, "#EXT-X-PART-INF:"))) {
+        playlist->part_target_ms = hls_attribute_ms(v, "PART-TARGET");
+    } else if((v = HLS_TAG(line, "#EXT-X-SERVER-CONTROL:"))) {
+        playlist->can_block_reload = hls_attribute_yes(v, "CAN-BLOCK-RELOAD");
+        playlist->hold_back_ms = hls_attribute_ms(v, "HOLD-BACK");
+        playlist->part_hold_back_ms = hls_attribute_ms(v, "PART-HOLD-BACK");
+    } else if((v = HLS_TAG(line, "#EXT-X-PRELOAD-HINT:"))) {
+        if(hls_attribute(v, "TYPE", value, sizeof(value)) && strcmp(value, "PART") == 0
+           && hls_attribute(v, "URI", value, sizeof(value))) {
+            free(playlist->preload_hint_uri);
+            playlist->preload_hint_uri = hls_strdup(value, (uint32_t)strlen(value));
+        }
+    } else if((v = HLS_TAG(line, "#EXT-X-STREAM-INF:"))) {
+        hls_parse_stream_inf(parser, v);
+    }
+    return 0;
+}
+
+int hls_playlist_parser_feed(hls_playlist_parser_t* parser, const void* data, uint32_t size) {
+    const char *p = (const char*)data, *end = p + size;
+    if(parser->failed) {
+        return -1;
+    }
+    while(p < end) {
+        const char *eol = (const char*)memchr(p, '\n', (size_t)(end - p));
+        uint32_t n = (uint32_t)((eol ? eol : end) - p);
+        if(parser->line_size + n + 1 > parser->line_capacity) {
+            uint32_t capacity = parser->line_capacity ? parser->line_capacity : 256;
+            while(capacity < parser->line_size + n + 1) capacity *= 2;
+            char *line = capacity <= HLS_MAX_LINE_SIZE ? (char*)realloc(parser->line, capacity) : NULL;
+            if(!line) {
+                parser->failed = 1;
+                return -1;
+            }
+            parser->line = line;
+            parser->line_capacity = capacity;
+        }
+        memcpy(parser->line + parser->line_size, p, n);
+        parser->line_size += n;
+        p += n;
+        if(!eol) {
+            break;
+        }
+        ++p;
+        parser->line[parser->line_size] = 0;
+        uint32_t line_size = parser->line_size;
+        parser->line_size = 0;
+        if(hls_parse_line(parser, parser->line, line_size) < 0) {
+            parser->failed = 1;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+const hls_playlist_t* hls_playlist_parser_peek(hls_playlist_parser_t* parser) {
+    return parser->failed ? NULL : parser->playlist;
+}
+
+hls_playlist_t* hls_playlist_parser_finish(hls_playlist_parser_t* parser) {
+    hls_playlist_t *playlist = NULL;
+    if(!parser->failed && parser->line_size > 0) {
+        parser->line[parser->line_size] = 0;
+        if(hls_parse_line(parser, parser->line, parser->line_size) < 0) {
+            parser->failed = 1;
+        }
+        parser->line_size = 0;
+    }
+    if(!parser->failed && parser->header_seen) {
+        /*
+         列表末尾只有EXT-X-PART没有uri的是正在生成的分片
+         */
+        if(parser->pending.part_count > 0 && hls_add_segment(parser, NULL) < 0) {
+            parser->failed = 1;
+        }
+    }
+    if(!parser->failed && parser->header_seen) {
+        playlist = parser->playlist;
+        if(playlist->type == 0) {
+            playlist->type = HLS_PLAYLIST_MEDIA;
+        }
+        parser->playlist = NULL;
+    }
+    hls_parser_reset(parser);
+    return playlist;
+}
+
+hls_playlist_t* hls_playlist_parse(const void* data, uint32_t size) {
+    hls_playlist_parser_t *parser = hls_playlist_parser_create();
+    if(!parser) {
+        return NULL;
+    }
+    hls_playlist_parser_feed(parser, data, size);
+    hls_playlist_t *playlist = hls_playlist_parser_finish(parser);
+    hls_playlist_parser_destroy(parser);
+    return playlist;
+}
+
+const hls_segment_t* hls_playlist_find_segment(const hls_playlist_t* playlist, uint64_t sequence) {
+    if(!playlist || sequence < playlist->media_sequence || sequence - playlist->media_sequence >= playlist->segment_count) {
+        return NULL;
+    }
+    return &playlist->segments[sequence - playlist->media_sequence];
+}
+
+/*
+ ---------------------------------------------------------------- uri
+ */
+static int hls_has_scheme(const char *uri) {
+    const char *p = uri;
+    if(!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z'))) {
+        return 0;
+    }
+    while((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9') || *p == '+' || *p == '-' || *p == '.') ++p;
+    return *p == ':';
+}
+
+/*
+ rfc 3986 5.2.4，原地处理path里的.和..
+ */
+static void hls_remove_dot_segments(char *path) {
+    char *out = path, *in = path;
+    while(*in) {
+        if(strncmp(in, "/./", 3) == 0) {
+            in += 2;
+        } else if(strcmp(in, "/.") == 0) {
+            in[1] = 0;
+        } else if(strncmp(in, "/../", 4) == 0 || strcmp(in, "/..") == 0) {
+            in += 3;
+            if(*in == 0) {
+                *--in = '/';
+            }
+            while(out > path && *--out != '/');
+        } else {
+            do {
+                *out++ = *in++;
+            } while(*in && *in != '/');
+        }
+    }
+    *out = 0;
+}
+
+int hls_resolve_uri(const char* base, const char* ref, char* out, uint32_t capacity) {
+    size_t ref_size = strlen(ref);
+    if(hls_has_scheme(ref) || !hls_has_scheme(base)) {
+        if(ref_size + 1 > capacity) {
+            return -1;
+        }
+        memcpy(out, ref, ref_size + 1);
+        return (int)ref_size;
+    }
+    const char *scheme_end = strchr(base, ':');
+    const char *authority_end = scheme_end + 1;
+    if(strncmp(authority_end, "//", 2) == 0) {
+        authority_end += 2;
+        while(*authority_end && *authority_end != '/' && *authority_end != '?' && *authority_end != '#') ++authority_end;
+    }
+    const char *path_end = base + strcspn(base, "?#");
+
+    size_t prefix;
+    if(strncmp(ref, "//", 2) == 0) {
+        prefix = (size_t)(scheme_end + 1 - base);
+    } else if(ref[0] == '/') {
+        prefix = (size_t)(authority_end - base);
+    } else if(ref[0] == '?' || ref[0] == '#' || ref_size == 0) {
+        prefix = (size_t)(ref[0] == '#' ? base + strcspn(base, "#") - base : path_end - base);
+    } else {
+        const char *slash = path_end;
+        while(slash > authority_end && slash[-1] != '/') --slash;
+        prefix = (size_t)(slash - base);
+        if(slash == authority_end) {
+            /*
+             http://host?x 这种没有path的
+             */
+            if(prefix + 1 + ref_size + 1 > capacity) {
+                return -1;
+            }
+            memcpy(out, base, prefix);
+            out[prefix] = '/';
+            memcpy(out + prefix + 1, ref, ref_size + 1);
+            prefix = (size_t)(authority_end - base);
+            goto dots;
+        }
+    }
+    if(prefix + ref_size + 1 > capacity) {
+        return -1;
+    }
+    memcpy(out, base, prefix);
+    memcpy(out + prefix, ref, ref_size + 1);
+    if(strncmp(ref, "//", 2) == 0 || ref[0] == '?' || ref[0] == '#' || ref_size == 0) {
+        return (int)strlen(out);
+    }
+    prefix = (size_t)(authority_end - base);
+
+dots:
+    {
+        /*
+         只处理path部分，query原样保留
+         */
+        char *path = out + prefix;
+        char *query = path + strcspn(path, "?#");
+        char saved[HLS_MAX_ATTRIBUTE_SIZE];
+        size_t query_size = strlen(query);
+        if(query_size >= sizeof(saved)) {
+            return -1;
+        }
+        memcpy(saved, query, query_size + 1);
+        *query = 0;
+        hls_remove_dot_segments(path);
+        size_t path_size = strlen(path);
+        memcpy(path + path_size, saved, query_size + 1);
+    }
+    return (int)strlen(out);
+}
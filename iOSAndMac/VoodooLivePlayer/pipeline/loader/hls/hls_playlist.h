@@ -0,0 +1,114 @@
+//
+//  hls_playlist.h
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#ifndef hls_playlist_h
+#define hls_playlist_h
+
+#include <stdint.h>
+
+/*
+ m3u8 master and media playlists, including the low latency tags
+ (EXT-X-PART, EXT-X-PART-INF, EXT-X-SERVER-CONTROL, EXT-X-PRELOAD-HINT).
+ the parser is fed the response body as it arrives, segments are usable
+ before the download completes. uris are kept as written, resolve them with
+ hls_resolve_uri against the playlist url.
+ */
+#define HLS_PLAYLIST_MEDIA      1
+#define HLS_PLAYLIST_MASTER     2
+
+#define HLS_NO_DATE             INT64_MIN
+
+typedef struct hls_part_s {
+    char *uri;
+    uint32_t duration_ms;
+    int independent;
+    int gap;
+} hls_part_t;
+
+typedef struct hls_segment_s {
+    char *uri;                  /*  NULL while the server is still producing it, parts only */
+    uint64_t sequence;          /*  media sequence number   */
+    uint32_t duration_ms;
+    int discontinuity;          /*  EXT-X-DISCONTINUITY before this segment */
+    int64_t program_date_time_ms;   /*  unix ms, carried forward from the last EXT-X-PROGRAM-DATE-TIME */
+    hls_part_t *parts;
+    uint32_t part_count;
+    uint32_t part_capacity;
+} hls_segment_t;
+
+typedef struct hls_variant_s {
+    char *uri;
+    uint32_t bandwidth;
+    int width;
+    int height;
+    char *codecs;
+} hls_variant_t;
+
+typedef struct hls_playlist_s {
+    int type;                   /*  HLS_PLAYLIST_*  */
+    int version;
+    uint32_t target_duration_ms;
+    uint32_t part_target_ms;    /*  0 without EXT-X-PART-INF    */
+    uint64_t media_sequence;
+    uint64_t discontinuity_sequence;
+    int endlist;
+
+    int can_block_reload;       /*  _HLS_msn / _HLS_part supported  */
+    uint32_t hold_back_ms;
+    uint32_t part_hold_back_ms;
+
+    char *preload_hint_uri;     /*  EXT-X-PRELOAD-HINT TYPE=PART, the part after the last listed one */
+
+    hls_segment_t *segments;
+    uint32_t segment_count;
+    uint32_t segment_capacity;
+
+    hls_variant_t *variants;
+    uint32_t variant_count;
+    uint32_t variant_capacity;
+} hls_playlist_t;
+
+typedef struct hls_playlist_parser_s hls_playlist_parser_t;
+
+hls_playlist_parser_t* hls_playlist_parser_create(void);
+void hls_playlist_parser_destroy(hls_playlist_parser_t* parser);
+/*
+ any chunking, complete lines are applied as they arrive.
+ returns -1 when the body does not start with #EXTM3U or memory runs out,
+ the parser then ignores input until hls_playlist_parser_finish.
+ */
+int hls_playlist_parser_feed(hls_playlist_parser_t* parser, const void* data, uint32_t size);
+/*
+ what has been parsed so far, complete segments only, valid until the next feed
+ */
+const hls_playlist_t* hls_playlist_parser_peek(hls_playlist_parser_t* parser);
+/*
+ end of the body. hands over the playlist (NULL on error) and resets the
+ parser for the next reload, free it with hls_playlist_free
+ */
+hls_playlist_t* hls_playlist_parser_finish(hls_playlist_parser_t* parser);
+
+void hls_playlist_free(hls_playlist_t* playlist);
+/*
+ whole body at once
+ */
+hls_playlist_t* hls_playlist_parse(const void* data, uint32_t size);
+
+/*
+ segment by media sequence number, NULL outside the playlist window
+ */
+const hls_segment_t* hls_playlist_find_segment(const hls_playlist_t* playlist, uint64_t sequence);
+
+/*
+ rfc 3986 reference resolution for the usual cases: absolute uris,
+ network path (//host), absolute path and relative path with dot segments.
+ returns the length written, -1 when capacity is too small.
+ */
+int hls_resolve_uri(const char* base, const char* ref, char* out, uint32_t capacity);
+
+#endif /* hls_playlist_h */
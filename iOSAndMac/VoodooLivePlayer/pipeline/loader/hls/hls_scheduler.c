@@ -0,0 +1,528 @@
+//
+//  hls_scheduler.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#include "hls_scheduler.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define HLS_DEFAULT_PREFETCH_COUNT      3
+#define HLS_DEFAULT_MAX_RETRIES         2
+#define HLS_MAX_SLOTS                   64
+#define HLS_DEFAULT_TARGET_DURATION     (6*1000)
+#define HLS_PLAYLIST_RETRY_MS           (1000)
+/*
+ 阻塞刷新连续这么多次没等到要的位置，就当服务器不支持
+ */
+#define HLS_MAX_UNBLOCKED_RELOADS       2
+
+#define HLS_SLOT_RETRY                  1
+#define HLS_SLOT_IN_FLIGHT              2
+#define HLS_SLOT_DONE                   3
+#define HLS_SLOT_FAILED                 4
+
+typedef struct hls_slot_s {
+    hls_request_t req;
+    int state;
+    uint32_t retries;
+} hls_slot_t;
+
+struct hls_scheduler_s {
+    hls_scheduler_config_t config;
+    hls_playlist_t *playlist;
+    uint32_t next_id;
+
+    /*
+     下一个要取的位置，next_part是next_sequence分片里part的下标
+     */
+    int started;
+    uint64_t next_sequence;
+    uint32_t next_part;
+    int pending_discontinuity;      /*  给下一个发出去的请求 */
+    int delivery_discontinuity;     /*  给下一个交付的请求   */
+
+    /*
+     媒体请求按播放顺序排的环
+     */
+    hls_slot_t slots[HLS_MAX_SLOTS];
+    uint32_t head;
+    uint32_t count;
+
+    uint32_t playlist_id;           /*  在途的列表请求，0 没有  */
+    int reload_wanted;
+    int64_t next_reload_ms;
+    int64_t last_load_ms;
+    int want_blocking;
+    uint64_t want_sequence;
+    int want_part;                  /*  -1 整个分片 */
+    int blocking_in_flight;
+    uint32_t unblocked_reloads;
+    int blocking_disabled;
+
+    /*
+     发出去的预加载提示，列表刷新后按uri核对它到底是哪个part
+     */
+    int hint_issued;
+    uint32_t hint_id;
+    uint64_t hint_sequence;
+    uint32_t hint_part;
+    char hint_uri[HLS_MAX_URI_SIZE];
+
+    hls_scheduler_stats_t stats;
+};
+
+hls_scheduler_t* hls_scheduler_create(const hls_scheduler_config_t* config) {
+    hls_scheduler_t *scheduler = (hls_scheduler_t*)calloc(1, sizeof(hls_scheduler_t));
+    if(!scheduler) {
+        return NULL;
+    }
+    if(config) {
+        scheduler->config = *config;
+    }
+    if(scheduler->config.prefetch_count == 0) scheduler->config.prefetch_count = HLS_DEFAULT_PREFETCH_COUNT;
+    if(scheduler->config.prefetch_count > HLS_MAX_SLOTS) scheduler->config.prefetch_count = HLS_MAX_SLOTS;
+    if(scheduler->config.max_retries == 0) scheduler->config.max_retries = HLS_DEFAULT_MAX_RETRIES;
+    scheduler->next_id = 1;
+    scheduler->reload_wanted = 1;
+    return scheduler;
+}
+
+void hls_scheduler_destroy(hls_scheduler_t* scheduler) {
+    hls_playlist_free(scheduler->playlist);
+    free(scheduler);
+}
+
+const hls_playlist_t* hls_scheduler_playlist(hls_scheduler_t* scheduler) {
+    return scheduler->playlist;
+}
+
+void hls_scheduler_get_stats(hls_scheduler_t* scheduler, hls_scheduler_stats_t* stats) {
+    *stats = scheduler->stats;
+    stats->in_flight = scheduler->count;
+}
+
+static hls_slot_t* hls_slot_at(hls_scheduler_t* scheduler, uint32_t i) {
+    return &scheduler->slots[(scheduler->head + i) % HLS_MAX_SLOTS];
+}
+
+static uint32_t hls_target_duration(const hls_playlist_t *playlist) {
+    return playlist && playlist->target_duration_ms ? playlist->target_duration_ms : HLS_DEFAULT_TARGET_DURATION;
+}
+
+static int hls_last_segment_has_parts(const hls_playlist_t *playlist) {
+    return playlist->segment_count > 0 && playlist->segments[playlist->segment_count - 1].part_count > 0;
+}
+
+/*
+ ---------------------------------------------------------------- 起播位置
+ */
+
+/*
+ 从列表末尾往前累计hold_back，低延迟时落在最近的independent part上
+ */
+static void hls_choose_start(hls_scheduler_t* scheduler) {
+    const hls_playlist_t *pl = scheduler->playlist;
+    scheduler->next_sequence = pl->media_sequence;
+    scheduler->next_part = 0;
+    if(pl->endlist || pl->segment_count == 0) {
+        return;
+    }
+    if(scheduler->config.low_latency && pl->part_target_ms > 0 && hls_last_segment_has_parts(pl)) {
+        uint32_t hold = pl->part_hold_back_ms ? pl->part_hold_back_ms : 3 * pl->part_target_ms;
+        uint32_t acc = 0;
+        for(uint32_t i = pl->segment_count;i > 0;--i) {
+            const hls_segment_t *seg = &pl->segments[i - 1];
+            if(seg->part_count == 0) {
+                break;
+            }
+            for(uint32_t k = seg->part_count;k > 0;--k) {
+                acc += seg->parts[k - 1].duration_ms;
+                if(acc < hold) {
+                    continue;
+                }
+                /*
+                 往前找能独立解码的part，本分片里没有就从分片开头
+                 */
+                while(k > 1 && !seg->parts[k - 1].independent) --k;
+                scheduler->next_sequence = seg->sequence;
+                scheduler->next_part = seg->parts[k - 1].independent ? k - 1 : 0;
+                return;
+            }
+        }
+    }
+    uint32_t hold = scheduler->config.hold_back_ms ? scheduler->config.hold_back_ms
+                  : pl->hold_back_ms ? pl->hold_back_ms : 3 * hls_target_duration(pl);
+    uint32_t acc = 0;
+    for(uint32_t i = pl->segment_count;i > 0;--i) {
+        const hls_segment_t *seg = &pl->segments[i - 1];
+        if(!seg->uri) {
+            continue;
+        }
+        acc += seg->duration_ms;
+        scheduler->next_sequence = seg->sequence;
+        if(acc >= hold) {
+            break;
+        }
+    }
+}
+
+/*
+ ---------------------------------------------------------------- 请求
+ */
+static void hls_fill_media(hls_scheduler_t* scheduler, hls_request_t* req, const hls_segment_t* seg, int part, const char* uri) {
+    memset(req, 0, sizeof(hls_request_t));
+    req->id = scheduler->next_id++;
+    req->type = part < 0 ? HLS_REQUEST_SEGMENT : HLS_REQUEST_PART;
+    snprintf(req->uri, sizeof(req->uri), "%s", uri);
+    req->sequence = seg ? seg->sequence : scheduler->next_sequence;
+    req->part = part;
+    req->program_date_time_ms = HLS_NO_DATE;
+    if(seg) {
+        uint32_t offset = 0;
+        for(int k = 0;k < part && (uint32_t)k < seg->part_count;++k) {
+            offset += seg->parts[k].duration_ms;
+        }
+        if(seg->program_date_time_ms != HLS_NO_DATE) {
+            req->program_date_time_ms = seg->program_date_time_ms + offset;
+        }
+        req->duration_ms = part < 0 ? seg->duration_ms : (uint32_t)part < seg->part_count ? seg->parts[part].duration_ms : 0;
+        if(part <= 0 && seg->discontinuity) {
+            scheduler->pending_discontinuity = 1;
+        }
+    }
+    req->discontinuity = scheduler->pending_discontinuity;
+    scheduler->pending_discontinuity = 0;
+}
+
+static void hls_push_slot(hls_scheduler_t* scheduler, const hls_request_t* req) {
+    hls_slot_t *slot = hls_slot_at(scheduler, scheduler->count++);
+    slot->req = *req;
+    slot->state = HLS_SLOT_IN_FLIGHT;
+    slot->retries = 0;
+    if(scheduler->count > scheduler->stats.max_in_flight) {
+        scheduler->stats.max_in_flight = scheduler->count;
+    }
+    if(req->type == HLS_REQUEST_SEGMENT) {
+        scheduler->stats.segments++;
+    } else {
+        scheduler->stats.parts++;
+    }
+}
+
+/*
+ 要的位置还不在列表里：能阻塞刷新就马上带着位置去要，否则按间隔刷新
+ */
+static void hls_starved(hls_scheduler_t* scheduler, int64_t now_ms, int part) {
+    const hls_playlist_t *pl = scheduler->playlist;
+    /*
+     在途的刷新回来会重新判断，这时再要一次会在它之后马上多刷一次
+     */
+    if(pl->endlist || scheduler->reload_wanted || scheduler->playlist_id != 0) {
+        return;
+    }
+    scheduler->reload_wanted = 1;
+    scheduler->want_sequence = scheduler->next_sequence;
+    scheduler->want_part = part;
+    if(pl->can_block_reload && !scheduler->blocking_disabled) {
+        scheduler->want_blocking = 1;
+        scheduler->next_reload_ms = now_ms;
+        return;
+    }
+    scheduler->want_blocking = 0;
+    uint32_t interval = part >= 0 && pl->part_target_ms ? pl->part_target_ms : hls_target_duration(pl) / 2;
+    scheduler->next_reload_ms = scheduler->last_load_ms + interval;
+}
+
+/*
+ hint指的是列表里最后一个part的下一个
+ */
+static int hls_hint_matches(hls_scheduler_t* scheduler) {
+    const hls_playlist_t *pl = scheduler->playlist;
+    if(!pl->preload_hint_uri || pl->segment_count == 0) {
+        return 0;
+    }
+    const hls_segment_t *last = &pl->segments[pl->segment_count - 1];
+    uint64_t sequence = last->uri ? last->sequence + 1 : last->sequence;
+    uint32_t part = last->uri ? 0 : last->part_count;
+    if(scheduler->next_sequence != sequence || scheduler->next_part != part) {
+        return 0;
+    }
+    if(scheduler->hint_issued && scheduler->hint_sequence == sequence && scheduler->hint_part == part) {
+        return 0;
+    }
+    return 1;
+}
+
+static hls_slot_t* hls_find_slot(hls_scheduler_t* scheduler, uint32_t id) {
+    for(uint32_t i = 0;i < scheduler->count;++i) {
+        hls_slot_t *slot = hls_slot_at(scheduler, i);
+        if(slot->req.id == id) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+/*
+ hint发出去时只能按当时的列表猜它是哪个part，刷新后核对：
+ - 服务器先结束了当时还开着的分片，hint其实是下一个分片的第一个part，
+   挪过去接着取它后面的，不能再取一遍，也不是断流
+ - 列表里那个位置的uri对不上，hint取到的不是它，回头重取并标断流
+ */
+static void hls_check_hint(hls_scheduler_t* scheduler) {
+    const hls_playlist_t *pl = scheduler->playlist;
+    if(!scheduler->hint_issued || scheduler->next_sequence != scheduler->hint_sequence || scheduler->next_part != scheduler->hint_part + 1) {
+        return;
+    }
+    const hls_segment_t *seg = hls_playlist_find_segment(pl, scheduler->hint_sequence);
+    if(!seg) {
+        return;
+    }
+    hls_slot_t *slot = hls_find_slot(scheduler, scheduler->hint_id);
+    if(scheduler->hint_part < seg->part_count) {
+        scheduler->hint_issued = 0;
+        if(strcmp(seg->parts[scheduler->hint_part].uri, scheduler->hint_uri) != 0) {
+            scheduler->next_part = scheduler->hint_part;
+            scheduler->pending_discontinuity = 1;
+        } else if(scheduler->hint_part == 0 && seg->discontinuity && slot) {
+            slot->req.discontinuity = 1;
+        }
+        return;
+    }
+    if(seg->uri && seg->part_count > 0 && scheduler->hint_part == seg->part_count) {
+        scheduler->hint_sequence = seg->sequence + 1;
+        scheduler->hint_part = 0;
+        scheduler->next_sequence = scheduler->hint_sequence;
+        scheduler->next_part = 1;
+        if(slot) {
+            slot->req.sequence = scheduler->hint_sequence;
+            slot->req.part = 0;
+        }
+    }
+}
+
+static int hls_next_media(hls_scheduler_t* scheduler, int64_t now_ms, hls_request_t* req) {
+    const hls_playlist_t *pl = scheduler->playlist;
+    if(!scheduler->started) {
+        hls_choose_start(scheduler);
+        scheduler->started = 1;
+    }
+    for(;;) {
+        const hls_segment_t *seg = hls_playlist_find_segment(pl, scheduler->next_sequence);
+        if(!seg && scheduler->next_sequence < pl->media_sequence) {
+            /*
+             落后到列表窗口外了，跳到窗口开头
+             */
+            scheduler->stats.skipped += pl->media_sequence - scheduler->next_sequence;
+            scheduler->next_sequence = pl->media_sequence;
+            scheduler->next_part = 0;
+            scheduler->pending_discontinuity = 1;
+            seg = hls_playlist_find_segment(pl, scheduler->next_sequence);
+        }
+        if(scheduler->hint_issued) {
+            hls_check_hint(scheduler);
+            seg = hls_playlist_find_segment(pl, scheduler->next_sequence);
+        }
+        int low_latency = scheduler->config.low_latency && pl->part_target_ms > 0;
+        if(!seg) {
+            if(low_latency && hls_hint_matches(scheduler)) {
+                goto hint;
+            }
+            hls_starved(scheduler, now_ms, low_latency ? 0 : -1);
+            return 0;
+        }
+        if(scheduler->next_part == 0 && seg->uri) {
+            hls_fill_media(scheduler, req, seg, -1, seg->uri);
+            scheduler->next_sequence++;
+            return 1;
+        }
+        if(!low_latency) {
+            /*
+             不用part时等分片完整
+             */
+            hls_starved(scheduler, now_ms, -1);
+            return 0;
+        }
+        if(scheduler->next_part < seg->part_count) {
+            hls_fill_media(scheduler, req, seg, (int)scheduler->next_part, seg->parts[scheduler->next_part].uri);
+            scheduler->next_part++;
+            if(seg->uri && scheduler->next_part == seg->part_count) {
+                scheduler->next_sequence++;
+                scheduler->next_part = 0;
+            }
+            return 1;
+        }
+        if(seg->uri) {
+            /*
+             part都取完了分片才结束，接着下一个分片；
+             否则是part已经从列表里删掉，分片剩下的部分拿不到了
+             */
+            if(scheduler->next_part != seg->part_count) {
+                scheduler->pending_discontinuity = 1;
+            }
+            scheduler->next_sequence++;
+            scheduler->next_part = 0;
+            continue;
+        }
+        if(hls_hint_matches(scheduler)) {
+            goto hint;
+        }
+        hls_starved(scheduler, now_ms, (int)scheduler->next_part);
+        return 0;
+    }
+
+hint:
+    /*
+     预加载提示：服务器会挂住这个请求直到part生成
+     */
+    {
+        const hls_segment_t *seg = hls_playlist_find_segment(pl, scheduler->next_sequence);
+        hls_fill_media(scheduler, req, seg, (int)scheduler->next_part, pl->preload_hint_uri);
+        scheduler->hint_issued = 1;
+        scheduler->hint_id = req->id;
+        snprintf(scheduler->hint_uri, sizeof(scheduler->hint_uri), "%s", pl->preload_hint_uri);
+        scheduler->hint_sequence = scheduler->next_sequence;
+        scheduler->hint_part = scheduler->next_part;
+        scheduler->next_part++;
+        /*
+         hint之后的请求还是要靠刷新列表
+         */
+        return 1;
+    }
+}
+
+int hls_scheduler_next_request(hls_scheduler_t* scheduler, int64_t now_ms, hls_request_t* req) {
+    for(uint32_t i = 0;i < scheduler->count;++i) {
+        hls_slot_t *slot = hls_slot_at(scheduler, i);
+        if(slot->state == HLS_SLOT_RETRY) {
+            slot->state = HLS_SLOT_IN_FLIGHT;
+            scheduler->stats.retries++;
+            *req = slot->req;
+            return 1;
+        }
+    }
+    if(scheduler->playlist && scheduler->playlist->type == HLS_PLAYLIST_MEDIA && scheduler->count < scheduler->config.prefetch_count
+       && !hls_scheduler_finished(scheduler)) {
+        if(hls_next_media(scheduler, now_ms, req)) {
+            hls_push_slot(scheduler, req);
+            return 1;
+        }
+    }
+    if(scheduler->playlist_id == 0 && scheduler->reload_wanted && now_ms >= scheduler->next_reload_ms) {
+        memset(req, 0, sizeof(hls_request_t));
+        req->id = scheduler->next_id++;
+        req->type = HLS_REQUEST_PLAYLIST;
+        req->part = -1;
+        req->program_date_time_ms = HLS_NO_DATE;
+        scheduler->blocking_in_flight = scheduler->want_blocking;
+        if(scheduler->want_blocking) {
+            if(scheduler->want_part >= 0) {
+                snprintf(req->query, sizeof(req->query), "_HLS_msn=%llu&_HLS_part=%d", (unsigned long long)scheduler->want_sequence, scheduler->want_part);
+            } else {
+                snprintf(req->query, sizeof(req->query), "_HLS_msn=%llu", (unsigned long long)scheduler->want_sequence);
+            }
+            scheduler->stats.blocking_reloads++;
+        }
+        scheduler->playlist_id = req->id;
+        scheduler->reload_wanted = 0;
+        return 1;
+    }
+    return 0;
+}
+
+int64_t hls_scheduler_next_wakeup(hls_scheduler_t* scheduler) {
+    if(scheduler->playlist_id == 0 && scheduler->reload_wanted) {
+        return scheduler->next_reload_ms;
+    }
+    return INT64_MAX;
+}
+
+/*
+ 阻塞刷新回来的列表里有没有要的位置
+ */
+static int hls_has_position(const hls_playlist_t* pl, uint64_t sequence, int part) {
+    const hls_segment_t *seg = hls_playlist_find_segment(pl, sequence);
+    if(!seg) {
+        return 0;
+    }
+    return part < 0 ? seg->uri != NULL : (seg->uri != NULL || (uint32_t)part < seg->part_count);
+}
+
+void hls_scheduler_playlist_loaded(hls_scheduler_t* scheduler, uint32_t id, hls_playlist_t* playlist, int64_t now_ms) {
+    if(id != scheduler->playlist_id) {
+        hls_playlist_free(playlist);
+        return;
+    }
+    scheduler->playlist_id = 0;
+    scheduler->stats.playlist_loads++;
+    if(!playlist) {
+        scheduler->stats.playlist_failures++;
+        scheduler->reload_wanted = 1;
+        scheduler->want_blocking = 0;
+        scheduler->next_reload_ms = now_ms + HLS_PLAYLIST_RETRY_MS;
+        return;
+    }
+    scheduler->stats.playlist_failures = 0;
+    scheduler->last_load_ms = now_ms;
+    if(scheduler->blocking_in_flight) {
+        if(hls_has_position(playlist, scheduler->want_sequence, scheduler->want_part)) {
+            scheduler->unblocked_reloads = 0;
+        } else if(++scheduler->unblocked_reloads >= HLS_MAX_UNBLOCKED_RELOADS) {
+            scheduler->blocking_disabled = 1;
+        }
+    }
+    scheduler->blocking_in_flight = 0;
+    scheduler->want_blocking = 0;
+    hls_playlist_free(scheduler->playlist);
+    scheduler->playlist = playlist;
+}
+
+void hls_scheduler_media_loaded(hls_scheduler_t* scheduler, uint32_t id, int ok) {
+    for(uint32_t i = 0;i < scheduler->count;++i) {
+        hls_slot_t *slot = hls_slot_at(scheduler, i);
+        if(slot->req.id != id || slot->state != HLS_SLOT_IN_FLIGHT) {
+            continue;
+        }
+        if(ok) {
+            slot->state = HLS_SLOT_DONE;
+        } else if(slot->retries < scheduler->config.max_retries) {
+            slot->retries++;
+            slot->state = HLS_SLOT_RETRY;
+        } else {
+            slot->state = HLS_SLOT_FAILED;
+            scheduler->stats.skipped++;
+        }
+        return;
+    }
+}
+
+int hls_scheduler_pop_ready(hls_scheduler_t* scheduler, uint32_t* id, int* discontinuity) {
+    while(scheduler->count > 0) {
+        hls_slot_t *slot = hls_slot_at(scheduler, 0);
+        if(slot->state != HLS_SLOT_DONE && slot->state != HLS_SLOT_FAILED) {
+            return 0;
+        }
+        scheduler->head = (scheduler->head + 1) % HLS_MAX_SLOTS;
+        scheduler->count--;
+        if(slot->state == HLS_SLOT_FAILED) {
+            scheduler->delivery_discontinuity = 1;
+            continue;
+        }
+        *id = slot->req.id;
+        *discontinuity = slot->req.discontinuity || scheduler->delivery_discontinuity;
+        scheduler->delivery_discontinuity = 0;
+        return 1;
+    }
+    return 0;
+}
+
+int hls_scheduler_finished(hls_scheduler_t* scheduler) {
+    const hls_playlist_t *pl = scheduler->playlist;
+    return pl && pl->endlist && scheduler->started && scheduler->next_part == 0
+        && scheduler->next_sequence >= pl->media_sequence + pl->segment_count;
+}
@@ -0,0 +1,110 @@
+//
+//  hls_scheduler.h
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#ifndef hls_scheduler_h
+#define hls_scheduler_h
+
+#include "hls_playlist.h"
+
+/*
+ decides what an hls loader fetches and when, without doing any i/o:
+ - a bounded window of segment (or part) requests in flight in parallel,
+   handed back strictly in playlist order
+ - live start behind the edge by HOLD-BACK / PART-HOLD-BACK
+ - low latency: the open segment is fetched part by part, the part after
+   the last listed one through EXT-X-PRELOAD-HINT or a blocking reload
+   (_HLS_msn / _HLS_part), falling back to timed reloads when the server
+   answers without blocking
+ - failed requests are retried, then skipped with a discontinuity
+ the caller issues every request hls_scheduler_next_request returns,
+ reports completion, and delivers the media in hls_scheduler_pop_ready order.
+ media playlists only, pick a variant of a master playlist before.
+ times are any monotonic millisecond clock. not thread safe.
+ */
+#define HLS_REQUEST_PLAYLIST        1
+#define HLS_REQUEST_SEGMENT         2
+#define HLS_REQUEST_PART            3
+
+#define HLS_MAX_URI_SIZE            (4*1024)
+
+typedef struct hls_scheduler_config_s {
+    uint32_t prefetch_count;        /*  media requests in flight or waiting for delivery, default 3 */
+    uint32_t hold_back_ms;          /*  live start distance when the playlist has no HOLD-BACK, default 3 target durations */
+    int low_latency;                /*  use EXT-X-PART when the playlist has parts  */
+    uint32_t max_retries;           /*  per request, default 2  */
+} hls_scheduler_config_t;
+
+typedef struct hls_request_s {
+    uint32_t id;
+    int type;                       /*  HLS_REQUEST_*   */
+    /*
+     playlist: empty uri means the media playlist itself, query carries the
+     blocking reload parameters. media: uri relative to the media playlist.
+     */
+    char uri[HLS_MAX_URI_SIZE];
+    char query[64];
+    uint64_t sequence;
+    int part;                       /*  -1 for a whole segment  */
+    int discontinuity;              /*  reset the demuxer before this data  */
+    int64_t program_date_time_ms;   /*  of the data start, HLS_NO_DATE when unknown */
+    uint32_t duration_ms;
+} hls_request_t;
+
+typedef struct hls_scheduler_stats_s {
+    uint64_t playlist_loads;
+    uint64_t blocking_reloads;
+    uint64_t segments;
+    uint64_t parts;
+    uint64_t retries;
+    uint64_t skipped;               /*  failed for good, or fell out of the playlist window */
+    uint32_t playlist_failures;     /*  in a row    */
+    uint32_t in_flight;
+    uint32_t max_in_flight;
+} hls_scheduler_stats_t;
+
+typedef struct hls_scheduler_s hls_scheduler_t;
+
+hls_scheduler_t* hls_scheduler_create(const hls_scheduler_config_t* config);
+void hls_scheduler_destroy(hls_scheduler_t* scheduler);
+
+/*
+ next request to issue now, 1 when req was filled, 0 when there is nothing
+ to do before hls_scheduler_next_wakeup or a completion
+ */
+int hls_scheduler_next_request(hls_scheduler_t* scheduler, int64_t now_ms, hls_request_t* req);
+/*
+ when to call hls_scheduler_next_request again without any completion,
+ INT64_MAX for never
+ */
+int64_t hls_scheduler_next_wakeup(hls_scheduler_t* scheduler);
+
+/*
+ playlist request done, takes the playlist (NULL on failure)
+ */
+void hls_scheduler_playlist_loaded(hls_scheduler_t* scheduler, uint32_t id, hls_playlist_t* playlist, int64_t now_ms);
+/*
+ media request done. ok 0 retries it or gives up on it
+ */
+void hls_scheduler_media_loaded(hls_scheduler_t* scheduler, uint32_t id, int ok);
+/*
+ oldest finished media request in playlist order, 1 when id was filled.
+ skipped requests are not returned, the next one is flagged discontinuity.
+ */
+int hls_scheduler_pop_ready(hls_scheduler_t* scheduler, uint32_t* id, int* discontinuity);
+
+/*
+ the playlist most recently loaded, NULL before the first one
+ */
+const hls_playlist_t* hls_scheduler_playlist(hls_scheduler_t* scheduler);
+/*
+ vod played to the end
+ */
+int hls_scheduler_finished(hls_scheduler_t* scheduler);
+void hls_scheduler_get_stats(hls_scheduler_t* scheduler, hls_scheduler_stats_t* stats);
+
+#endif /* hls_scheduler_h */
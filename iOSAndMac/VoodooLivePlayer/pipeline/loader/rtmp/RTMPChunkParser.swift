@@ -8,138 +8,142 @@
 
 import Foundation
 
+func rtmp_demuxer_callback(parserPtr:UnsafeMutableRawPointer?, type:Int32, data: UnsafeMutableRawPointer?, size:Int32, tsPointer:UnsafeMutablePointer<Int64>?, flag:UInt32) {
+    if parserPtr == nil { return }
+    let parser = Unmanaged<RTMPChunkParser>.fromOpaque(parserPtr!).takeUnretainedValue()
 
+    var ts:[Int64] = [VOODOO_NOPTS_VALUE,VOODOO_NOPTS_VALUE]
+    if let tsPtr = tsPointer {
+        ts[0] = tsPtr.pointee
+        ts[1] = tsPtr.advanced(by: 1).pointee
+    }
+    let data = data != nil ? Data(bytesNoCopy: data!, count: Int(size), deallocator: .none) : Data()
+    parser.handleCallback(type: type, data: data, ts: ts, flag: flag)
+}
+
+func rtmp_demuxer_message_callback(parserPtr:UnsafeMutableRawPointer?, csid:UInt32, type:UInt8, streamID:UInt32, timestamp:UInt32, data:UnsafeRawPointer?, size:UInt32) {
+    if parserPtr == nil { return }
+    let parser = Unmanaged<RTMPChunkParser>.fromOpaque(parserPtr!).takeUnretainedValue()
+    /*
+     data is only valid during the callback, control/command messages are small
+     */
+    let payload = data != nil ? Data(bytes: data!, count: Int(size)) : Data()
+    parser.handleMessage(RTMPMessage(streamID: streamID, type: type, timestamp: timestamp, data: payload, chunkID: csid))
+}
+
+/**
+ chunk stream parsing is done by the C rtmp demuxer (rtmp.c).
+ audio/video/data messages come out through the flv tag path as demuxer data,
+ everything else is returned from parse(rawData:) as RTMPMessage
+ */
 class RTMPChunkParser {
-    
-    static let ChunkTypeMessageHeaderSize = [11, 7, 3, 0]
-    static let ChunkStreamIDSpecialSize = [1, 2]
+
     unowned let connection: RTMPNetConnection
+    private var rtmpDemuxerContext: UnsafeMutableRawPointer? = nil
+    private var packetPool: OpaquePointer? = nil
+    private static let packetBatchSize = 64
+    private let packetBatch = UnsafeMutablePointer<UnsafeMutablePointer<demuxer_packet_t>?>.allocate(capacity: RTMPChunkParser.packetBatchSize)
+
     init(connection:RTMPNetConnection) {
         self.connection = connection
+        let selfPtr = Unmanaged<RTMPChunkParser>.passUnretained(self).toOpaque()
+        self.rtmpDemuxerContext = rtmp_demuxer_init(selfPtr, rtmp_demuxer_callback)
+        rtmp_demuxer_set_message_callback(self.rtmpDemuxerContext, rtmp_demuxer_message_callback)
+        self.packetPool = packet_pool_create(0, nil)
+        rtmp_demuxer_set_packet_pool(self.rtmpDemuxerContext, self.packetPool, nil)
+    }
+
+    deinit {
+        if self.rtmpDemuxerContext != nil {
+            rtmp_demuxer_fint(self.rtmpDemuxerContext)
+            self.rtmpDemuxerContext = nil
+        }
+        if self.packetPool != nil {
+            packet_pool_destroy(self.packetPool)
+            self.packetPool = nil
+        }
+        packetBatch.deallocate()
     }
-    
+
     enum State : Int {
         case start
-        case readTimestamp
-        case readHeader
-        case readPayload
         case failed
     }
-    
+
     var state : State = .start
-    
-    var readingHeader = Data(repeating: 0, count: 20)
-    var readingChunkType: UInt8 = 0
-    var readingChunkStreamID: UInt32 = 0
-    var readingHeaderSize = 0
-    var readingBasicHeaderSize = 0
-    var readingPayloadSize = 0
-    var readingPayload = Data()
+
+    /**
+     total bytes received, for the acknowledgement window
+     */
+    var bytesReceived: UInt64 {
+        return rtmp_demuxer_bytes_received(self.rtmpDemuxerContext)
+    }
+
+    private var messages: [RTMPMessage]? = nil
+
+    fileprivate func handleMessage(_ message: RTMPMessage) {
+        if connection.filterMessage(message: message) { return }
+        if messages == nil {
+            messages = [message]
+        } else {
+            messages?.append(message)
+        }
+    }
+
+    /*
+     called in the middle of a feed, the packets queued so far go first
+     */
+    fileprivate func handleCallback(type: Int32, data: Data, ts: [Int64], flag: UInt32) {
+        drainPackets()
+        handleMedia(type: type, data: data, ts: ts, flag: flag)
+    }
+
+    private func handleMedia(type: Int32, data: Data, ts: [Int64], flag: UInt32) {
+        if let dataType = LivePipelineDataType(rawValue: Int(type)) {
+            connection.delegate?.handleMedia(data, withType: dataType, ts: ts, flag: flag)
+        } else {
+            print("UNKNOWN RTMP DATA TYPE VALUE: \(type)")
+        }
+    }
+
+    private func handlePacket(packet:UnsafeMutablePointer<demuxer_packet_t>) {
+        /*
+         the Data takes over the reference from read_packets
+         */
+        let data = Data(bytesNoCopy: UnsafeMutableRawPointer(packet.pointee.data), count: Int(packet.pointee.size), deallocator: .custom({ _, _ in
+            demuxer_packet_release(packet)
+        }))
+        handleMedia(type: Int32(packet.pointee.type), data: data, ts: [packet.pointee.pts, packet.pointee.dts], flag: packet.pointee.flag)
+    }
+
+    private func drainPackets() {
+        while true {
+            let count = Int(rtmp_demuxer_read_packets(self.rtmpDemuxerContext, packetBatch, Int32(RTMPChunkParser.packetBatchSize)))
+            if count == 0 { break }
+            for i in 0..<count {
+                handlePacket(packet: packetBatch[i]!)
+            }
+        }
+    }
 
     ///
     func parse(rawData: Data) -> [RTMPMessage]? {
-        var messages:[RTMPMessage]? = nil
-        var pos = 0
-        
-        while pos < rawData.count {
-            var bytesAvaliable = rawData.count - pos
-            switch state {
-            case .start:
-                let firstByte = rawData[pos]
-                readingChunkType = (firstByte & 0xc0) >> 6
-                readingChunkStreamID = UInt32(firstByte & 0x3f)
-                readingBasicHeaderSize = 1 + (readingChunkStreamID < 2 ? Int(readingChunkStreamID) + 1 : 0)
-                readingHeaderSize = readingBasicHeaderSize + RTMPChunkParser.ChunkTypeMessageHeaderSize[Int(readingChunkType)]
-                readingHeader.count = 0
-                
-                if readingChunkType == 3 {
-                    state = .readHeader
-                } else {
-                    state = .readTimestamp
-                    fallthrough
-                }
-            case .readTimestamp:
-                let copySize = min(bytesAvaliable, readingHeaderSize - readingHeader.count)
-                readingHeader.append(rawData.subdata(in: pos..<pos+copySize))
-                pos += copySize
-                if readingHeader.count < readingBasicHeaderSize + 3 {
-                    break
-                }
-                let timestamp = RTMPStream.unpackUInt24(readingHeader.subdata(in: readingBasicHeaderSize..<readingBasicHeaderSize + 3))
-                if timestamp == 0xffffff {
-                    readingHeaderSize += 4
-                }
-                state = .readHeader
-                bytesAvaliable -= copySize
-                if bytesAvaliable == 0 {
-                    break
-                }
-                fallthrough
-            case .readHeader:
-                let copySize = min(bytesAvaliable, readingHeaderSize - readingHeader.count)
-                readingHeader.append(rawData.subdata(in: pos..<pos+copySize))
-                pos += copySize
-                if readingHeaderSize > readingHeader.count {
-                    break
-                }
-                /**
-                 determind chunk payload size
-                 */
-                if readingChunkStreamID < 2 {
-                    readingChunkStreamID = 64+UInt32(readingHeader[1])+(readingChunkStreamID==0 ? 0 : UInt32(readingHeader[2])*256)
-                }
-                let chunkStream = connection.getChunkStream(chunkStreamID: readingChunkStreamID)
-                if readingChunkType == 0 || readingChunkType == 1 {
-                    let messageLength = Int(RTMPStream.unpackUInt24(readingHeader.subdata(in: readingBasicHeaderSize+3..<readingBasicHeaderSize+6)))
-                    readingPayloadSize = min(messageLength, chunkStream.chunkSize)
-                } else {
-                    if chunkStream.unpackMessageID == nil {
-                        state = .failed
-                        pos = rawData.count
-                        break
-                    }
-                    let messageLength = chunkStream.unpackMessageLength
-                    readingPayloadSize = chunkStream.unpackMessageState == .waitMessage ?
-                        min(chunkStream.chunkSize, messageLength) :       /** no reading message, leftSize == messageLength*/
-                        min(chunkStream.chunkSize, messageLength - chunkStream.unpackMessagePayload.count)  /** has reading message, leftSize = messageLength - readSize */
-                }
-                
-                    
-                //print("CHUNK PAYLOAD SIZE:\(readingPayloadSize)")
-
-                readingPayload.reserveCapacity(connection.chunkSize)
-                readingPayload.count = 0
-                state = .readPayload
-                bytesAvaliable = rawData.count - pos
-                if bytesAvaliable > 0 {
-                    fallthrough
-                }
-            case .readPayload:
-                let leftPayloadSize = readingPayloadSize - readingPayload.count
-                if bytesAvaliable < leftPayloadSize {
-                    readingPayload.append(rawData.subdata(in: pos..<rawData.count))
-                    pos = rawData.count
-                } else {
-                    let payloadData = rawData.subdata(in: pos..<pos+leftPayloadSize)
-                    pos += leftPayloadSize
-                    if !readingPayload.isEmpty { readingPayload.append(payloadData) }
-                    let headerData = readingHeader.subdata(in: readingBasicHeaderSize..<readingHeader.count)
-                    let chunkStream = connection.getChunkStream(chunkStreamID: readingChunkStreamID)
-
-                    if let message = chunkStream.parseMessageChunk(readingChunkType, header: headerData, payload: readingPayload.isEmpty ? payloadData : readingPayload) {
-                        if !connection.filterMessage(message: message) {
-                            if messages == nil {
-                                messages = [message]
-                            } else {
-                                messages?.append(message)
-                            }
-                        }
-                    }
-                    state = .start
-                }
-            case .failed: return nil
+        if state == .failed { return nil }
+        messages = nil
+        let dataLength = rawData.count
+        let ret = rawData.withUnsafeBytes { (ptr) -> Int32 in
+            if let dataPtr = ptr.baseAddress {
+                return rtmp_demuxer_feed(self.rtmpDemuxerContext, dataPtr, Int32(dataLength))
             }
+            return 0
+        }
+        drainPackets()
+        if ret < 0 {
+            state = .failed
+            return nil
         }
-        return messages
+        let result = messages
+        messages = nil
+        return result
     }
 }
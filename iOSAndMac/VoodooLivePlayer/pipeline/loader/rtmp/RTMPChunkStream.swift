@@ -67,121 +67,7 @@ class RTMPChunkStream {
     }
     */
 
-    
-    enum UnpackMessageState {
-        case waitMessage
-        case readMessage
-    }
-    
-    var unpackMessageState: UnpackMessageState = .waitMessage
-    var unpackMessageID: UInt32! = nil
-    var unpackMessageType: UInt8 = 0
-    var unpackMessageLength: Int = 0
-    var unpackMessageTimestamp: UInt32 = 0
-    var unpackMessageTimestampDelta: UInt32 = 0
-    var unpackMessagePayload: Data! = nil
-    
-    func calcNextPayloadSize(streamID: UInt32?) -> Int {
-        if unpackMessageState == .waitMessage {
-            return min(unpackMessageLength, chunkSize)
-        } else {
-            return min(unpackMessageLength - unpackMessagePayload.count, chunkSize)
-        }
-    }
-    
-    private func parseTimestamp(header:Data) -> UInt32 {
-        var timestamp = RTMPStream.unpackUInt24(header)
-        if timestamp == 0xffffff {
-            timestamp = header.subdata(in: header.count-4..<header.count).withUnsafeBytes({ (ptr) -> UInt32 in
-                return ptr.load(as: UInt32.self).byteSwapped
-            })
-        }
-        return timestamp
-    }
-    
-    func parseMessageChunk(_ chunkType: UInt8, header: Data, payload: Data) -> RTMPMessage? {
-        /**
-         chunkType 0,1 for new message
-         chunkType 2 for register time delta
-         chunkType 3 for take all last message's header
-         */
-        
-        /**
-         first chunk must type 0
-         */
-        if unpackMessageID == nil &&
-            chunkType != 0 {
-            print("[ERROR] parseMessageChunk, chunkStream first chunk must type 0")
-            return nil
-        }
-        
-        switch chunkType {
-        case 0:
-            if unpackMessageState == .readMessage {
-                print("[ERROR] WRONG UNPACK STATE WHEN CHUNK TYPE 0")
-                return nil
-            }
-            /**
-             update timestamp
-             */
-            self.unpackMessageID = header.subdata(in: 7..<11).withUnsafeBytes({ (ptr) -> UInt32 in
-                return ptr.load(as: UInt32.self).byteSwapped
-            })
-            self.unpackMessageTimestamp = parseTimestamp(header: header)
-            self.unpackMessageLength = Int(RTMPStream.unpackUInt24(header.subdata(in: 3..<6)))
-            self.unpackMessageType = header[6]
-            self.unpackMessageTimestampDelta = 0
-        case 1:
-            if unpackMessageState == .readMessage {
-                print("[ERROR] WRONG UNPACK STATE WHEN CHUNK TYPE 1")
-                return nil
-            }
-            /**
-             update timestamp with delta
-             */
-            self.unpackMessageTimestamp += parseTimestamp(header: header)
-            self.unpackMessageLength = Int(RTMPStream.unpackUInt24(header.subdata(in: 3..<6)))
-            self.unpackMessageType = header[6]
-            self.unpackMessageTimestampDelta = 0
-        case 2:
-            self.unpackMessageTimestampDelta = parseTimestamp(header: header)
-            self.unpackMessageTimestamp += self.unpackMessageTimestampDelta
-        case 3:
-            self.unpackMessageTimestamp += self.unpackMessageTimestampDelta
-        default:
-            return nil
-        }
-        if self.unpackMessageState == .waitMessage {
-            //print("STREAM \(self.ID) MESSAGE \(self.unpackMessageType) LENGTH \(self.unpackMessageLength) CREATED")
-            self.unpackMessageState = .readMessage
-            self.unpackMessagePayload = Data(capacity: self.unpackMessageLength)
-        }
-        
-        unpackMessagePayload.append(payload)
-        if unpackMessagePayload.count >= self.unpackMessageLength {
-            
-            //print("STREAM \(self.ID) MESSAGE \(self.unpackMessageType) LENGTH \(self.unpackMessageLength) COMPLETED")
-            if self.unpackMessageType == 0x01 && unpackMessagePayload.count == 4 {
-                self.chunkSize = unpackMessagePayload.withUnsafeBytes({ (ptr) -> Int in
-                    return Int(ptr.load(as: UInt32.self).byteSwapped)
-                })
-                //print("SET CHUNK \(self.ID) CHUNKSIZE \(self.chunkSize)")
-                self.unpackMessageState = .waitMessage
-                self.unpackMessagePayload = nil
-                return nil
-            } else {
-                let msg = RTMPMessage(streamID: self.unpackMessageID!, type: self.unpackMessageType, timestamp: self.unpackMessageTimestamp, data: self.unpackMessagePayload, chunkID: self.ID)
-                self.unpackMessageState = .waitMessage
-                self.unpackMessagePayload = nil
-                return msg
-            }
-        } else {
-            //print("STREAM \(self.ID) MESSAGE \(self.unpackMessageType) LENGTH \(self.unpackMessageLength) APPEND \(payload.count)")
-            return nil
-        }
-    }
-    
-    
+
     /*
     func packMessage(_ message: RTMPMessage, to: RTMPStream) {
         let messageStream = getMessageStream(messageStreamID: message.streamID)
@@ -10,6 +10,10 @@ import Foundation
 
 protocol RTMPNetConnectionDelegate : class {
     func handleMessage(_ message: RTMPMessage)
+    /**
+     audio/video/metadata already demuxed from the flv tags in the messages
+     */
+    func handleMedia(_ data: Data, withType type: LivePipelineDataType, ts: [Int64], flag: UInt32)
     func handleError(_ error: RTMPError)
     func handleStateChanged(newState: RTMPNetConnection.State)
 }
@@ -0,0 +1,1044 @@
+//
+//  fmp4_recorder.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#include "fmp4_recorder.h"
+#include "video_sps.h"
+#include "bitreader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#define FMP4_VIDEO_TIMESCALE            90000
+#define FMP4_VIDEO_TRACK_ID             1
+#define FMP4_AUDIO_TRACK_ID             2
+#define FMP4_AUDIO_ONLY_FRAGMENT_MS     2000
+#define FMP4_DEFAULT_VIDEO_DURATION     40
+#define FMP4_INITIAL_SAMPLES            256
+#define FMP4_INITIAL_HEADER_SIZE        4096
+#define FMP4_MAX_IOV                    1024
+#define FMP4_MAX_PATH_SIZE              1024
+#define FMP4_MAX_QUEUED_JOBS            64
+
+#define FMP4_JOB_OPEN                   1
+#define FMP4_JOB_FRAGMENT               2
+
+/*
+ 统计两个线程都会写，get_stats随时读
+ */
+#define FMP4_STAT_ADD(recorder, field, n)   __atomic_fetch_add(&(recorder)->stats.field, (n), __ATOMIC_RELAXED)
+
+#define FMP4_SAMPLE_FLAGS_SYNC          0x02000000
+#define FMP4_SAMPLE_FLAGS_NON_SYNC      0x01010000
+
+typedef struct fmp4_buffer_s {
+    uint8_t *data;
+    uint32_t size;
+    uint32_t capacity;
+    int error;
+} fmp4_buffer_t;
+
+typedef struct fmp4_track_s {
+    demuxer_packet_t *parameters;       /*  latest seen             */
+    demuxer_packet_t *file_parameters;  /*  in the current init segment, NULL when the file has no such track */
+
+    /*
+     samples of the pending fragment in decode order
+     */
+    demuxer_packet_t **samples;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t bytes;
+
+    int64_t last_dts;                   /*  ms  */
+    uint32_t timescale;
+    uint64_t next_decode_time;          /*  end of what has been written, in timescale units    */
+
+    int codec_id;
+    int width;
+    int height;
+    int sample_rate;
+    int channels;
+    uint32_t frame_length;
+} fmp4_track_t;
+
+/*
+ 一次写盘：开新文件写init segment，或者写一个moof + mdat。
+ 同步时直接执行，异步时连头带样本引用一起排给写线程
+ */
+typedef struct fmp4_job_s {
+    struct fmp4_job_s *next;
+    int type;
+    uint32_t file_number;
+    const uint8_t *header;              /*  init segment, or moof + mdat header. NULL when it could not be built  */
+    uint32_t header_size;
+    demuxer_packet_t **samples[2];      /*  video, audio    */
+    uint32_t counts[2];
+    int key;
+    int64_t dts;
+} fmp4_job_t;
+
+struct fmp4_recorder_s {
+    fmp4_recorder_config_t config;
+    char prefix[FMP4_MAX_PATH_SIZE];
+
+    fn_demuxer_malloc_t malloc_fn;
+    fn_demuxer_free_t free_fn;
+    void *allocator_opaque;
+
+    /*
+     只有执行写盘的线程碰
+     */
+    int fd;
+    int index_fd;
+    uint64_t file_offset;
+    struct iovec *iov;
+    uint32_t iov_capacity;
+
+    /*
+     写线程
+     */
+    int async;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    fmp4_job_t *jobs_head;
+    fmp4_job_t *jobs_tail;
+    uint32_t queued;
+    int stopping;
+
+    uint32_t file_number;
+    uint32_t sequence;
+    uint32_t media_flag;
+
+    int started;
+    int64_t base_dts;                   /*  ms, decode time 0 */
+    int64_t file_start_dts;
+    int64_t fragment_start_dts;
+
+    fmp4_track_t video;
+    fmp4_track_t audio;
+
+    fmp4_buffer_t header;
+
+    fmp4_recorder_stats_t stats;
+};
+
+/*
+ ---------------------------------------------------------------- box writer
+ */
+static int fmp4_reserve(fmp4_recorder_t* recorder, fmp4_buffer_t* b, uint32_t size) {
+    if(b->error) {
+        return -1;
+    }
+    if(b->size + size <= b->capacity) {
+        return 0;
+    }
+    uint32_t capacity = b->capacity ? b->capacity : FMP4_INITIAL_HEADER_SIZE;
+    while(capacity < b->size + size) capacity *= 2;
+    uint8_t *data = (uint8_t*)recorder->malloc_fn(recorder->allocator_opaque, capacity);
+    if(!data) {
+        b->error = 1;
+        return -1;
+    }
+    if(b->data) {
+        memcpy(data, b->data, b->size);
+        recorder->free_fn(recorder->allocator_opaque, b->data);
+    }
+    b->data = data;
+    b->capacity = capacity;
+    return 0;
+}
+
+static void fmp4_put(fmp4_recorder_t* recorder, fmp4_buffer_t* b, const void* data, uint32_t size) {
+    if(fmp4_reserve(recorder, b, size) == 0) {
+        memcpy(b->data + b->size, data, size);
+        b->size += size;
+    }
+}
+
+static void fmp4_put_be(fmp4_recorder_t* recorder, fmp4_buffer_t* b, uint64_t v, int n) {
+    uint8_t bytes[8];
+    for(int i = n - 1;i >= 0;--i, v >>= 8) bytes[i] = (uint8_t)v;
+    fmp4_put(recorder, b, bytes, (uint32_t)n);
+}
+
+static void fmp4_put_zero(fmp4_recorder_t* recorder, fmp4_buffer_t* b, uint32_t n) {
+    if(fmp4_reserve(recorder, b, n) == 0) {
+        memset(b->data + b->size, 0, n);
+        b->size += n;
+    }
+}
+
+/*
+ size is patched by fmp4_box_end
+ */
+static uint32_t fmp4_box_begin(fmp4_recorder_t* recorder, fmp4_buffer_t* b, const char* type) {
+    uint32_t offset = b->size;
+    fmp4_put_be(recorder, b, 0, 4);
+    fmp4_put(recorder, b, type, 4);
+    return offset;
+}
+
+static uint32_t fmp4_full_box_begin(fmp4_recorder_t* recorder, fmp4_buffer_t* b, const char* type, int version, uint32_t flags) {
+    uint32_t offset = fmp4_box_begin(recorder, b, type);
+    fmp4_put_be(recorder, b, ((uint32_t)version << 24) | (flags & 0xffffff), 4);
+    return offset;
+}
+
+static void fmp4_patch_be32(fmp4_buffer_t* b, uint32_t offset, uint32_t v) {
+    if(b->error) {
+        return;
+    }
+    b->data[offset] = (uint8_t)(v >> 24);
+    b->data[offset + 1] = (uint8_t)(v >> 16);
+    b->data[offset + 2] = (uint8_t)(v >> 8);
+    b->data[offset + 3] = (uint8_t)v;
+}
+
+static void fmp4_box_end(fmp4_buffer_t* b, uint32_t offset) {
+    fmp4_patch_be32(b, offset, b->size - offset);
+}
+
+static void fmp4_put_matrix(fmp4_recorder_t* recorder, fmp4_buffer_t* b) {
+    static const uint32_t matrix[9] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+    for(int i = 0;i < 9;++i) fmp4_put_be(recorder, b, matrix[i], 4);
+}
+
+/*
+ ---------------------------------------------------------------- parameters
+ */
+static const int fmp4_sample_rates[16] = { 96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350, 0, 0, 0 };
+
+static void fmp4_parse_audio_parameters(fmp4_track_t* track) {
+    const demuxer_packet_t *p = track->file_parameters;
+    bitreader_t br;
+    track->sample_rate = 44100;
+    track->channels = 2;
+    track->frame_length = 1024;
+    if(p->size < 2) {
+        return;
+    }
+    BR_INIT(&br, p->data, p->size);
+    uint32_t object_type = BR_READ(&br, 5);
+    if(object_type == 31) {
+        object_type = 32 + BR_READ(&br, 6);
+    }
+    uint32_t index = BR_READ(&br, 4);
+    int sample_rate = index == 15 ? (int)BR_READ(&br, 24) : fmp4_sample_rates[index];
+    uint32_t channels = BR_READ(&br, 4);
+    /*
+     sbr / ps 的时间轴按核心层的采样率
+     */
+    if(object_type == 5 || object_type == 29) {
+        index = BR_READ(&br, 4);
+        if(index == 15) BR_SKIP(&br, 24);
+        object_type = BR_READ(&br, 5);
+    }
+    int frame_length_960 = (object_type <= 4 || object_type == 6 || object_type == 7 || object_type == 17 || object_type >= 19) && BR_READ_BIT(&br);
+    if(BR_ERROR(&br) || sample_rate <= 0) {
+        return;
+    }
+    track->sample_rate = sample_rate;
+    track->channels = channels > 0 && channels < 8 ? (int)channels : 2;
+    track->frame_length = frame_length_960 ? 960 : 1024;
+}
+
+static void fmp4_parse_video_parameters(fmp4_track_t* track) {
+    const demuxer_packet_t *p = track->file_parameters;
+    video_sps_info_t info;
+    memset(&info, 0, sizeof(info));
+    track->codec_id = (int)p->flag;
+    track->width = track->height = 0;
+    int ret = -1;
+    if(track->codec_id == VIDEO_CODEC_ID_H264) {
+        ret = avc_parse_decoder_config(p->data, p->size, &info);
+    } else if(track->codec_id == VIDEO_CODEC_ID_HEVC) {
+        ret = hevc_parse_decoder_config(p->data, p->size, &info);
+    } else if(track->codec_id == VIDEO_CODEC_ID_AV1) {
+        ret = av1_parse_decoder_config(p->data, p->size, &info);
+    }
+    if(ret >= 0) {
+        track->width = info.width;
+        track->height = info.height;
+    }
+}
+
+static int fmp4_same_packet_data(const demuxer_packet_t* a, const demuxer_packet_t* b) {
+    if(!a || !b) {
+        return a == b;
+    }
+    return a->flag == b->flag && a->size == b->size && memcmp(a->data, b->data, a->size) == 0;
+}
+
+/*
+ 有了新的参数集，或者音频后到，都要换一个带新init的文件
+ */
+static int fmp4_parameters_changed(fmp4_recorder_t* recorder) {
+    if(!fmp4_same_packet_data(recorder->video.parameters, recorder->video.file_parameters)) {
+        return 1;
+    }
+    return recorder->audio.parameters && !fmp4_same_packet_data(recorder->audio.parameters, recorder->audio.file_parameters);
+}
+
+static void fmp4_set_parameters(fmp4_track_t* track, demuxer_packet_t* packet) {
+    demuxer_packet_retain(packet);
+    if(track->parameters) {
+        demuxer_packet_release(track->parameters);
+    }
+    track->parameters = packet;
+}
+
+/*
+ ---------------------------------------------------------------- init segment
+ */
+static void fmp4_write_sample_entry(fmp4_recorder_t* recorder, fmp4_buffer_t* b, const fmp4_track_t* track, int video) {
+    const demuxer_packet_t *p = track->file_parameters;
+    if(video) {
+        const char *entry = track->codec_id == VIDEO_CODEC_ID_HEVC ? "hvc1" : track->codec_id == VIDEO_CODEC_ID_AV1 ? "av01" : "avc1";
+        const char *config = track->codec_id == VIDEO_CODEC_ID_HEVC ? "hvcC" : track->codec_id == VIDEO_CODEC_ID_AV1 ? "av1C" : "avcC";
+        uint32_t box = fmp4_box_begin(recorder, b, entry);
+        fmp4_put_zero(recorder, b, 6);
+        fmp4_put_be(recorder, b, 1, 2);                         /*  data_reference_index    */
+        fmp4_put_zero(recorder, b, 16);
+        fmp4_put_be(recorder, b, (uint32_t)track->width, 2);
+        fmp4_put_be(recorder, b, (uint32_t)track->height, 2);
+        fmp4_put_be(recorder, b, 0x00480000, 4);                /*  72 dpi  */
+        fmp4_put_be(recorder, b, 0x00480000, 4);
+        fmp4_put_zero(recorder, b, 4);
+        fmp4_put_be(recorder, b, 1, 2);                         /*  frame_count */
+        fmp4_put_zero(recorder, b, 32);                         /*  compressorname  */
+        fmp4_put_be(recorder, b, 0x0018, 2);
+        fmp4_put_be(recorder, b, 0xffff, 2);
+        uint32_t record = fmp4_box_begin(recorder, b, config);
+        fmp4_put(recorder, b, p->data, p->size);
+        fmp4_box_end(b, record);
+        fmp4_box_end(b, box);
+        return;
+    }
+    uint32_t box = fmp4_box_begin(recorder, b, "mp4a");
+    fmp4_put_zero(recorder, b, 6);
+    fmp4_put_be(recorder, b, 1, 2);
+    fmp4_put_zero(recorder, b, 8);
+    fmp4_put_be(recorder, b, (uint32_t)track->channels, 2);
+    fmp4_put_be(recorder, b, 16, 2);
+    fmp4_put_zero(recorder, b, 4);
+    fmp4_put_be(recorder, b, (uint32_t)(track->sample_rate < 65536 ? track->sample_rate : 0) << 16, 4);
+    /*
+     ES_Descriptor > DecoderConfigDescriptor > DecoderSpecificInfo (asc), SLConfigDescriptor
+     */
+    uint32_t esds = fmp4_full_box_begin(recorder, b, "esds", 0, 0);
+    uint32_t asc_size = p->size < 100 ? p->size : 100;
+    fmp4_put_be(recorder, b, 0x03, 1);
+    fmp4_put_be(recorder, b, 3 + 2 + 13 + 2 + asc_size + 3, 1);
+    fmp4_put_be(recorder, b, 0, 2);                             /*  ES_ID   */
+    fmp4_put_be(recorder, b, 0, 1);
+    fmp4_put_be(recorder, b, 0x04, 1);
+    fmp4_put_be(recorder, b, 13 + 2 + asc_size, 1);
+    fmp4_put_be(recorder, b, 0x40, 1);                          /*  mpeg-4 audio    */
+    fmp4_put_be(recorder, b, 0x15, 1);                          /*  audio stream    */
+    fmp4_put_zero(recorder, b, 3 + 4 + 4);                      /*  buffer size, max and avg bitrate    */
+    fmp4_put_be(recorder, b, 0x05, 1);
+    fmp4_put_be(recorder, b, asc_size, 1);
+    fmp4_put(recorder, b, p->data, asc_size);
+    fmp4_put_be(recorder, b, 0x06, 1);
+    fmp4_put_be(recorder, b, 1, 1);
+    fmp4_put_be(recorder, b, 2, 1);
+    fmp4_box_end(b, esds);
+    fmp4_box_end(b, box);
+}
+
+static void fmp4_write_trak(fmp4_recorder_t* recorder, fmp4_buffer_t* b, const fmp4_track_t* track, int video) {
+    uint32_t trak = fmp4_box_begin(recorder, b, "trak");
+
+    uint32_t tkhd = fmp4_full_box_begin(recorder, b, "tkhd", 0, 3);
+    fmp4_put_zero(recorder, b, 8);                              /*  creation / modification time    */
+    fmp4_put_be(recorder, b, video ? FMP4_VIDEO_TRACK_ID : FMP4_AUDIO_TRACK_ID, 4);
+    fmp4_put_zero(recorder, b, 4 + 4 + 8);                      /*  reserved, duration, reserved    */
+    fmp4_put_zero(recorder, b, 4);                              /*  layer, alternate_group  */
+    fmp4_put_be(recorder, b, video ? 0 : 0x0100, 2);
+    fmp4_put_zero(recorder, b, 2);
+    fmp4_put_matrix(recorder, b);
+    fmp4_put_be(recorder, b, video ? (uint32_t)track->width << 16 : 0, 4);
+    fmp4_put_be(recorder, b, video ? (uint32_t)track->height << 16 : 0, 4);
+    fmp4_box_end(b, tkhd);
+
+    uint32_t mdia = fmp4_box_begin(recorder, b, "mdia");
+    uint32_t mdhd = fmp4_full_box_begin(recorder, b, "mdhd", 0, 0);
+    fmp4_put_zero(recorder, b, 8);
+    fmp4_put_be(recorder, b, track->timescale, 4);
+    fmp4_put_zero(recorder, b, 4);
+    fmp4_put_be(recorder, b, 0x55c4, 2);                        /*  und */
+    fmp4_put_zero(recorder, b, 2);
+    fmp4_box_end(b, mdhd);
+
+    uint32_t hdlr = fmp4_full_box_begin(recorder, b, "hdlr", 0, 0);
+    fmp4_put_zero(recorder, b, 4);
+    fmp4_put(recorder, b, video ? "vide" : "soun", 4);
+    fmp4_put_zero(recorder, b, 12);
+    fmp4_put(recorder, b, video ? "VideoHandler" : "SoundHandler", 13);
+    fmp4_box_end(b, hdlr);
+
+    uint32_t minf = fmp4_box_begin(recorder, b, "minf");
+    if(video) {
+        uint32_t vmhd = fmp4_full_box_begin(recorder, b, "vmhd", 0, 1);
+        fmp4_put_zero(recorder, b, 8);
+        fmp4_box_end(b, vmhd);
+    } else {
+        uint32_t smhd = fmp4_full_box_begin(recorder, b, "smhd", 0, 0);
+        fmp4_put_zero(recorder, b, 4);
+        fmp4_box_end(b, smhd);
+    }
+    uint32_t dinf = fmp4_box_begin(recorder, b, "dinf");
+    uint32_t dref = fmp4_full_box_begin(recorder, b, "dref", 0, 0);
+    fmp4_put_be(recorder, b, 1, 4);
+    uint32_t url = fmp4_full_box_begin(recorder, b, "url ", 0, 1);
+    fmp4_box_end(b, url);
+    fmp4_box_end(b, dref);
+    fmp4_box_end(b, dinf);
+
+    /*
+     样本表都是空的，样本在moof里
+     */
+    uint32_t stbl = fmp4_box_begin(recorder, b, "stbl");
+    uint32_t stsd = fmp4_full_box_begin(recorder, b, "stsd", 0, 0);
+    fmp4_put_be(recorder, b, 1, 4);
+    fmp4_write_sample_entry(recorder, b, track, video);
+    fmp4_box_end(b, stsd);
+    static const char *empty_tables[] = { "stts", "stsc", "stco" };
+    for(int i = 0;i < 3;++i) {
+        uint32_t box = fmp4_full_box_begin(recorder, b, empty_tables[i], 0, 0);
+        fmp4_put_zero(recorder, b, 4);
+        fmp4_box_end(b, box);
+    }
+    uint32_t stsz = fmp4_full_box_begin(recorder, b, "stsz", 0, 0);
+    fmp4_put_zero(recorder, b, 8);
+    fmp4_box_end(b, stsz);
+    fmp4_box_end(b, stbl);
+
+    fmp4_box_end(b, minf);
+    fmp4_box_end(b, mdia);
+    fmp4_box_end(b, trak);
+}
+
+static void fmp4_build_init(fmp4_recorder_t* recorder, fmp4_buffer_t* b) {
+    fmp4_track_t *video = recorder->video.file_parameters ? &recorder->video : NULL;
+    fmp4_track_t *audio = recorder->audio.file_parameters ? &recorder->audio : NULL;
+
+    uint32_t ftyp = fmp4_box_begin(recorder, b, "ftyp");
+    fmp4_put(recorder, b, "iso6", 4);
+    fmp4_put_zero(recorder, b, 4);
+    fmp4_put(recorder, b, "iso6cmfcisommp41", 16);
+    fmp4_box_end(b, ftyp);
+
+    uint32_t moov = fmp4_box_begin(recorder, b, "moov");
+    uint32_t mvhd = fmp4_full_box_begin(recorder, b, "mvhd", 0, 0);
+    fmp4_put_zero(recorder, b, 8);
+    fmp4_put_be(recorder, b, 1000, 4);
+    fmp4_put_zero(recorder, b, 4);
+    fmp4_put_be(recorder, b, 0x00010000, 4);                    /*  rate    */
+    fmp4_put_be(recorder, b, 0x0100, 2);                        /*  volume  */
+    fmp4_put_zero(recorder, b, 10);
+    fmp4_put_matrix(recorder, b);
+    fmp4_put_zero(recorder, b, 24);
+    fmp4_put_be(recorder, b, FMP4_AUDIO_TRACK_ID + 1, 4);
+    fmp4_box_end(b, mvhd);
+
+    if(video) fmp4_write_trak(recorder, b, video, 1);
+    if(audio) fmp4_write_trak(recorder, b, audio, 0);
+
+    uint32_t mvex = fmp4_box_begin(recorder, b, "mvex");
+    for(int i = 0;i < 2;++i) {
+        if(!(i == 0 ? (void*)video : (void*)audio)) continue;
+        uint32_t trex = fmp4_full_box_begin(recorder, b, "trex", 0, 0);
+        fmp4_put_be(recorder, b, i == 0 ? FMP4_VIDEO_TRACK_ID : FMP4_AUDIO_TRACK_ID, 4);
+        fmp4_put_be(recorder, b, 1, 4);
+        fmp4_put_zero(recorder, b, 12);
+        fmp4_box_end(b, trex);
+    }
+    fmp4_box_end(b, mvex);
+    fmp4_box_end(b, moov);
+}
+
+/*
+ ---------------------------------------------------------------- output
+ */
+static int fmp4_writev_all(fmp4_recorder_t* recorder, struct iovec* iov, uint32_t count) {
+    if(recorder->fd < 0) {
+        return -1;
+    }
+    while(count > 0) {
+        ssize_t written = writev(recorder->fd, iov, count > FMP4_MAX_IOV ? FMP4_MAX_IOV : (int)count);
+        FMP4_STAT_ADD(recorder, writev_calls, 1);
+        if(written < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        FMP4_STAT_ADD(recorder, bytes, (uint64_t)written);
+        recorder->file_offset += (uint64_t)written;
+        /*
+         写了一部分就从断开的地方接着写
+         */
+        while(count > 0 && (size_t)written >= iov->iov_len) {
+            written -= (ssize_t)iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if(count > 0 && written > 0) {
+            iov->iov_base = (uint8_t*)iov->iov_base + written;
+            iov->iov_len -= (size_t)written;
+        }
+    }
+    return 0;
+}
+
+static void fmp4_close_file(fmp4_recorder_t* recorder) {
+    if(recorder->fd >= 0) {
+        close(recorder->fd);
+        recorder->fd = -1;
+    }
+}
+
+static int fmp4_run_open(fmp4_recorder_t* recorder, fmp4_job_t* job) {
+    char path[FMP4_MAX_PATH_SIZE + 16];
+    fmp4_close_file(recorder);
+    snprintf(path, sizeof(path), "%s-%04u.mp4", recorder->prefix, job->file_number);
+    recorder->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    recorder->file_offset = 0;
+    if(recorder->fd < 0) {
+        FMP4_STAT_ADD(recorder, write_errors, 1);
+        return -1;
+    }
+    struct iovec iov = { (void*)job->header, job->header_size };
+    if(!job->header || fmp4_writev_all(recorder, &iov, 1) < 0) {
+        FMP4_STAT_ADD(recorder, write_errors, 1);
+        fmp4_close_file(recorder);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ moof + mdat, mdat straight from the packets
+ */
+static int fmp4_run_fragment(fmp4_recorder_t* recorder, fmp4_job_t* job) {
+    uint32_t samples = job->counts[0] + job->counts[1];
+    uint32_t iov_count = 1 + samples;
+    if(!job->header) {
+        FMP4_STAT_ADD(recorder, write_errors, 1);
+        return -1;
+    }
+    if(iov_count > recorder->iov_capacity) {
+        uint32_t capacity = recorder->iov_capacity ? recorder->iov_capacity : FMP4_INITIAL_SAMPLES;
+        while(capacity < iov_count) capacity *= 2;
+        struct iovec *iov = (struct iovec*)recorder->malloc_fn(recorder->allocator_opaque, capacity * sizeof(struct iovec));
+        if(!iov) {
+            FMP4_STAT_ADD(recorder, write_errors, 1);
+            return -1;
+        }
+        if(recorder->iov) {
+            recorder->free_fn(recorder->allocator_opaque, recorder->iov);
+        }
+        recorder->iov = iov;
+        recorder->iov_capacity = capacity;
+    }
+
+    struct iovec *iov = recorder->iov;
+    uint64_t moof_offset = recorder->file_offset;
+    uint32_t fragment_size = job->header_size;
+    uint32_t n = 0;
+    iov[n].iov_base = (void*)job->header;
+    iov[n++].iov_len = job->header_size;
+    for(int t = 0;t < 2;++t) {
+        for(uint32_t i = 0;i < job->counts[t];++i) {
+            iov[n].iov_base = job->samples[t][i]->data;
+            iov[n++].iov_len = job->samples[t][i]->size;
+            fragment_size += job->samples[t][i]->size;
+        }
+    }
+    if(fmp4_writev_all(recorder, iov, n) < 0) {
+        FMP4_STAT_ADD(recorder, write_errors, 1);
+        return -1;
+    }
+    FMP4_STAT_ADD(recorder, fragments, 1);
+    FMP4_STAT_ADD(recorder, samples, samples);
+    if(job->key && recorder->index_fd >= 0) {
+        char line[128];
+        int size = snprintf(line, sizeof(line), "%u %llu %lld %u\n", job->file_number, (unsigned long long)moof_offset,
+                            (long long)job->dts, fragment_size);
+        if(write(recorder->index_fd, line, (size_t)size) != size) {
+            FMP4_STAT_ADD(recorder, write_errors, 1);
+        }
+    }
+    return 0;
+}
+
+static int fmp4_run_job(fmp4_recorder_t* recorder, fmp4_job_t* job) {
+    return job->type == FMP4_JOB_OPEN ? fmp4_run_open(recorder, job) : fmp4_run_fragment(recorder, job);
+}
+
+static void* fmp4_writer_main(void* arg) {
+    fmp4_recorder_t *recorder = (fmp4_recorder_t*)arg;
+    pthread_mutex_lock(&recorder->lock);
+    for(;;) {
+        while(!recorder->jobs_head && !recorder->stopping) {
+            pthread_cond_wait(&recorder->cond, &recorder->lock);
+        }
+        fmp4_job_t *job = recorder->jobs_head;
+        if(!job) {
+            break;
+        }
+        recorder->jobs_head = job->next;
+        if(!recorder->jobs_head) {
+            recorder->jobs_tail = NULL;
+        }
+        pthread_mutex_unlock(&recorder->lock);
+
+        fmp4_run_job(recorder, job);
+        for(int t = 0;t < 2;++t) {
+            for(uint32_t i = 0;i < job->counts[t];++i) {
+                demuxer_packet_release(job->samples[t][i]);
+            }
+        }
+        recorder->free_fn(recorder->allocator_opaque, job);
+        pthread_mutex_lock(&recorder->lock);
+        recorder->queued--;
+    }
+    pthread_mutex_unlock(&recorder->lock);
+    return NULL;
+}
+
+/*
+ 同步时就地写。异步时把头拷一份、样本各加一个引用排给写线程，调用方的引用照旧自己放；
+ 写线程落后太多就丢掉分片，文件只是少一段，换文件总要排上
+ */
+static int fmp4_submit(fmp4_recorder_t* recorder, fmp4_job_t* job) {
+    if(!recorder->async) {
+        return fmp4_run_job(recorder, job);
+    }
+    uint32_t samples = job->counts[0] + job->counts[1];
+    pthread_mutex_lock(&recorder->lock);
+    int full = job->type == FMP4_JOB_FRAGMENT && recorder->queued >= FMP4_MAX_QUEUED_JOBS;
+    pthread_mutex_unlock(&recorder->lock);
+    fmp4_job_t *copy = full ? NULL : (fmp4_job_t*)recorder->malloc_fn(recorder->allocator_opaque,
+                                                                      sizeof(fmp4_job_t) + samples * sizeof(demuxer_packet_t*) + job->header_size);
+    if(!copy) {
+        if(job->type == FMP4_JOB_OPEN) {
+            FMP4_STAT_ADD(recorder, write_errors, 1);
+        }
+        FMP4_STAT_ADD(recorder, dropped, samples);
+        return -1;
+    }
+    *copy = *job;
+    copy->next = NULL;
+    demuxer_packet_t **list = (demuxer_packet_t**)(copy + 1);
+    for(int t = 0;t < 2;++t) {
+        copy->samples[t] = list;
+        for(uint32_t i = 0;i < job->counts[t];++i) {
+            demuxer_packet_retain(job->samples[t][i]);
+            *list++ = job->samples[t][i];
+        }
+    }
+    if(job->header) {
+        memcpy(list, job->header, job->header_size);
+        copy->header = (const uint8_t*)list;
+    }
+    pthread_mutex_lock(&recorder->lock);
+    if(recorder->jobs_tail) {
+        recorder->jobs_tail->next = copy;
+    } else {
+        recorder->jobs_head = copy;
+    }
+    recorder->jobs_tail = copy;
+    recorder->queued++;
+    pthread_cond_signal(&recorder->cond);
+    pthread_mutex_unlock(&recorder->lock);
+    return 0;
+}
+
+static void fmp4_start_file(fmp4_recorder_t* recorder, int64_t dts) {
+    if(!recorder->started) {
+        recorder->started = 1;
+        recorder->base_dts = dts;
+    }
+    recorder->file_start_dts = dts;
+
+    fmp4_track_t *tracks[2] = { &recorder->video, &recorder->audio };
+    for(int i = 0;i < 2;++i) {
+        fmp4_track_t *track = tracks[i];
+        if(track->file_parameters) {
+            demuxer_packet_release(track->file_parameters);
+            track->file_parameters = NULL;
+        }
+        if(track->parameters) {
+            demuxer_packet_retain(track->parameters);
+            track->file_parameters = track->parameters;
+        }
+    }
+    if(recorder->video.file_parameters) {
+        fmp4_parse_video_parameters(&recorder->video);
+        recorder->video.timescale = FMP4_VIDEO_TIMESCALE;
+    }
+    if(recorder->audio.file_parameters) {
+        fmp4_parse_audio_parameters(&recorder->audio);
+        recorder->audio.timescale = (uint32_t)recorder->audio.sample_rate;
+        recorder->audio.next_decode_time = (uint64_t)((dts - recorder->base_dts) * recorder->audio.sample_rate / 1000);
+    }
+
+    fmp4_job_t job;
+    memset(&job, 0, sizeof(job));
+    recorder->header.size = 0;
+    fmp4_build_init(recorder, &recorder->header);
+    job.type = FMP4_JOB_OPEN;
+    job.file_number = recorder->file_number++;
+    job.header = recorder->header.error ? NULL : recorder->header.data;
+    job.header_size = recorder->header.size;
+    recorder->header.error = 0;
+    FMP4_STAT_ADD(recorder, files, 1);
+    fmp4_submit(recorder, &job);
+}
+
+static void fmp4_drop_samples(fmp4_track_t* track) {
+    for(uint32_t i = 0;i < track->count;++i) {
+        demuxer_packet_release(track->samples[i]);
+    }
+    track->count = 0;
+    track->bytes = 0;
+}
+
+static void fmp4_write_traf(fmp4_recorder_t* recorder, fmp4_buffer_t* b, fmp4_track_t* track, int video, int64_t next_dts, uint32_t* data_offset_pos) {
+    uint32_t traf = fmp4_box_begin(recorder, b, "traf");
+    uint32_t tfhd = fmp4_full_box_begin(recorder, b, "tfhd", 0, 0x020000);   /*  default-base-is-moof    */
+    fmp4_put_be(recorder, b, video ? FMP4_VIDEO_TRACK_ID : FMP4_AUDIO_TRACK_ID, 4);
+    fmp4_box_end(b, tfhd);
+
+    /*
+     push保证样本不早于base_dts，时间戳往回跳会先换文件重定base
+     */
+    int64_t first_dts = track->samples[0]->dts;
+    uint64_t decode_time;
+    if(video) {
+        decode_time = (uint64_t)(first_dts - recorder->base_dts) * FMP4_VIDEO_TIMESCALE / 1000;
+    } else {
+        /*
+         音频按帧长累加，和毫秒时间戳差出两帧以上才重新对齐
+         */
+        int64_t expected_ms = recorder->base_dts + (int64_t)(track->next_decode_time * 1000 / track->timescale);
+        int64_t tolerance = 2 * (int64_t)track->frame_length * 1000 / track->timescale;
+        decode_time = track->next_decode_time;
+        if(first_dts - expected_ms > tolerance || expected_ms - first_dts > tolerance) {
+            decode_time = (uint64_t)(first_dts - recorder->base_dts) * track->timescale / 1000;
+        }
+    }
+    uint32_t tfdt = fmp4_full_box_begin(recorder, b, "tfdt", 1, 0);
+    fmp4_put_be(recorder, b, decode_time, 8);
+    fmp4_box_end(b, tfdt);
+
+    uint32_t flags = 0x000001 | 0x000100 | 0x000200 | 0x000400 | (video ? 0x000800 : 0);
+    uint32_t trun = fmp4_full_box_begin(recorder, b, "trun", 1, flags);
+    fmp4_put_be(recorder, b, track->count, 4);
+    *data_offset_pos = b->size;
+    fmp4_put_be(recorder, b, 0, 4);
+    uint64_t end_time = decode_time;
+    for(uint32_t i = 0;i < track->count;++i) {
+        const demuxer_packet_t *sample = track->samples[i];
+        uint32_t duration;
+        if(video) {
+            int64_t next = i + 1 < track->count ? track->samples[i + 1]->dts : next_dts;
+            int64_t ms = next != VOODOO_NOPTS_VALUE && next > sample->dts ? next - sample->dts
+                       : i > 0 ? sample->dts - track->samples[i - 1]->dts : FMP4_DEFAULT_VIDEO_DURATION;
+            duration = (uint32_t)(ms > 0 ? ms : FMP4_DEFAULT_VIDEO_DURATION) * (FMP4_VIDEO_TIMESCALE / 1000);
+        } else {
+            duration = track->frame_length;
+        }
+        end_time += duration;
+        fmp4_put_be(recorder, b, duration, 4);
+        fmp4_put_be(recorder, b, sample->size, 4);
+        if(video) {
+            int key = (sample->flag & VOODOO_VIDEO_PACKET_FLAG_IS_KEY_FRAME) != 0;
+            int64_t cto = sample->pts != VOODOO_NOPTS_VALUE ? (sample->pts - sample->dts) * (FMP4_VIDEO_TIMESCALE / 1000) : 0;
+            fmp4_put_be(recorder, b, key ? FMP4_SAMPLE_FLAGS_SYNC : FMP4_SAMPLE_FLAGS_NON_SYNC, 4);
+            fmp4_put_be(recorder, b, (uint32_t)(int32_t)cto, 4);
+        } else {
+            fmp4_put_be(recorder, b, FMP4_SAMPLE_FLAGS_SYNC, 4);
+        }
+    }
+    track->next_decode_time = end_time;
+    fmp4_box_end(b, trun);
+    fmp4_box_end(b, traf);
+}
+
+static int fmp4_write_fragment(fmp4_recorder_t* recorder, int64_t video_next_dts) {
+    fmp4_track_t *video = &recorder->video;
+    fmp4_track_t *audio = &recorder->audio;
+    if(video->count == 0 && audio->count == 0) {
+        return 0;
+    }
+    fmp4_buffer_t *b = &recorder->header;
+    uint32_t video_offset_pos = 0, audio_offset_pos = 0;
+    fmp4_job_t job;
+    memset(&job, 0, sizeof(job));
+    job.type = FMP4_JOB_FRAGMENT;
+    job.file_number = recorder->file_number - 1;
+    job.key = video->count > 0 ? (video->samples[0]->flag & VOODOO_VIDEO_PACKET_FLAG_IS_KEY_FRAME) != 0 : !video->file_parameters;
+    job.dts = video->count > 0 ? video->samples[0]->dts : audio->samples[0]->dts;
+    b->size = 0;
+    uint32_t moof = fmp4_box_begin(recorder, b, "moof");
+    uint32_t mfhd = fmp4_full_box_begin(recorder, b, "mfhd", 0, 0);
+    fmp4_put_be(recorder, b, ++recorder->sequence, 4);
+    fmp4_box_end(b, mfhd);
+    if(video->count > 0) fmp4_write_traf(recorder, b, video, 1, video_next_dts, &video_offset_pos);
+    if(audio->count > 0) fmp4_write_traf(recorder, b, audio, 0, VOODOO_NOPTS_VALUE, &audio_offset_pos);
+    fmp4_box_end(b, moof);
+    uint32_t moof_size = b->size;
+    fmp4_put_be(recorder, b, 8 + video->bytes + audio->bytes, 4);
+    fmp4_put(recorder, b, "mdat", 4);
+    if(video->count > 0) fmp4_patch_be32(b, video_offset_pos, moof_size + 8);
+    if(audio->count > 0) fmp4_patch_be32(b, audio_offset_pos, moof_size + 8 + video->bytes);
+    job.header = b->error ? NULL : b->data;
+    job.header_size = b->size;
+    job.samples[0] = video->samples;
+    job.counts[0] = video->count;
+    job.samples[1] = audio->samples;
+    job.counts[1] = audio->count;
+    b->error = 0;
+
+    int ret = fmp4_submit(recorder, &job);
+    fmp4_drop_samples(video);
+    fmp4_drop_samples(audio);
+    recorder->fragment_start_dts = VOODOO_NOPTS_VALUE;
+    return ret;
+}
+
+/*
+ ---------------------------------------------------------------- api
+ */
+fmp4_recorder_t* fmp4_recorder_create(const fmp4_recorder_config_t* config, const demuxer_config_t* allocator) {
+    fn_demuxer_malloc_t malloc_fn;
+    fn_demuxer_free_t free_fn;
+    void *opaque;
+    if(!config || !config->path_prefix || strlen(config->path_prefix) >= FMP4_MAX_PATH_SIZE) {
+        return NULL;
+    }
+    demuxer_select_allocator(allocator, &malloc_fn, &free_fn, &opaque);
+
+    fmp4_recorder_t *recorder = (fmp4_recorder_t*)malloc_fn(opaque, sizeof(fmp4_recorder_t));
+    if(!recorder) {
+        return NULL;
+    }
+    memset(recorder, 0, sizeof(fmp4_recorder_t));
+    recorder->malloc_fn = malloc_fn;
+    recorder->free_fn = free_fn;
+    recorder->allocator_opaque = opaque;
+    recorder->config = *config;
+    snprintf(recorder->prefix, sizeof(recorder->prefix), "%s", config->path_prefix);
+    recorder->config.path_prefix = recorder->prefix;
+    recorder->fd = -1;
+    recorder->index_fd = -1;
+    recorder->fragment_start_dts = VOODOO_NOPTS_VALUE;
+    recorder->video.last_dts = recorder->audio.last_dts = VOODOO_NOPTS_VALUE;
+    if(config->index) {
+        char path[FMP4_MAX_PATH_SIZE + 16];
+        snprintf(path, sizeof(path), "%s.idx", recorder->prefix);
+        recorder->index_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(recorder->index_fd < 0) {
+            recorder->stats.write_errors++;
+        }
+    }
+    if(config->async) {
+        /*
+         起不来线程就照旧在push里写
+         */
+        pthread_mutex_init(&recorder->lock, NULL);
+        pthread_cond_init(&recorder->cond, NULL);
+        recorder->async = pthread_create(&recorder->writer, NULL, fmp4_writer_main, recorder) == 0;
+        if(!recorder->async) {
+            pthread_cond_destroy(&recorder->cond);
+            pthread_mutex_destroy(&recorder->lock);
+        }
+    }
+    return recorder;
+}
+
+void fmp4_recorder_destroy(fmp4_recorder_t* recorder) {
+    fmp4_write_fragment(recorder, VOODOO_NOPTS_VALUE);
+    if(recorder->async) {
+        /*
+         写线程把排着的都写完才退出
+         */
+        pthread_mutex_lock(&recorder->lock);
+        recorder->stopping = 1;
+        pthread_cond_signal(&recorder->cond);
+        pthread_mutex_unlock(&recorder->lock);
+        pthread_join(recorder->writer, NULL);
+        pthread_cond_destroy(&recorder->cond);
+        pthread_mutex_destroy(&recorder->lock);
+    }
+    fmp4_close_file(recorder);
+    if(recorder->index_fd >= 0) {
+        close(recorder->index_fd);
+    }
+    fmp4_track_t *tracks[2] = { &recorder->video, &recorder->audio };
+    for(int i = 0;i < 2;++i) {
+        fmp4_track_t *track = tracks[i];
+        fmp4_drop_samples(track);
+        if(track->parameters) demuxer_packet_release(track->parameters);
+        if(track->file_parameters) demuxer_packet_release(track->file_parameters);
+        if(track->samples) recorder->free_fn(recorder->allocator_opaque, track->samples);
+    }
+    if(recorder->header.data) {
+        recorder->free_fn(recorder->allocator_opaque, recorder->header.data);
+    }
+    if(recorder->iov) {
+        recorder->free_fn(recorder->allocator_opaque, recorder->iov);
+    }
+    recorder->free_fn(recorder->allocator_opaque, recorder);
+}
+
+void fmp4_recorder_set_media_flag(fmp4_recorder_t* recorder, uint32_t flag) {
+    recorder->media_flag = flag;
+}
+
+static int fmp4_append(fmp4_recorder_t* recorder, fmp4_track_t* track, demuxer_packet_t* packet) {
+    if(track->count == track->capacity) {
+        uint32_t capacity = track->capacity ? track->capacity * 2 : FMP4_INITIAL_SAMPLES;
+        demuxer_packet_t **samples = (demuxer_packet_t**)recorder->malloc_fn(recorder->allocator_opaque, capacity * sizeof(demuxer_packet_t*));
+        if(!samples) {
+            return -1;
+        }
+        if(track->samples) {
+            memcpy(samples, track->samples, track->count * sizeof(demuxer_packet_t*));
+            recorder->free_fn(recorder->allocator_opaque, track->samples);
+        }
+        track->samples = samples;
+        track->capacity = capacity;
+    }
+    demuxer_packet_retain(packet);
+    track->samples[track->count++] = packet;
+    track->bytes += packet->size;
+    track->last_dts = packet->dts;
+    if(recorder->fragment_start_dts == VOODOO_NOPTS_VALUE) {
+        recorder->fragment_start_dts = packet->dts;
+    }
+    return 0;
+}
+
+/*
+ 可以切开的地方决定换文件还是切分片，视频关键帧总是开一个新分片。
+ backward是时间戳往回跳了（推流重连、编码器重启），同一个文件里decode time
+ 不能倒退，写完手上的分片换个文件，从这里重新算decode time
+ */
+static void fmp4_cut_at_sync(fmp4_recorder_t* recorder, int64_t dts, int64_t video_next_dts, uint32_t fragment_ms, int backward) {
+    if(!recorder->started) {
+        fmp4_start_file(recorder, dts);
+        return;
+    }
+    if(backward) {
+        fmp4_write_fragment(recorder, VOODOO_NOPTS_VALUE);
+        recorder->base_dts = dts;
+        recorder->video.last_dts = recorder->audio.last_dts = VOODOO_NOPTS_VALUE;
+        fmp4_start_file(recorder, dts);
+        return;
+    }
+    int new_file = fmp4_parameters_changed(recorder) ||
+                   (recorder->config.segment_ms > 0 && dts - recorder->file_start_dts >= (int64_t)recorder->config.segment_ms);
+    if(new_file || fragment_ms == 0 ||
+       (recorder->fragment_start_dts != VOODOO_NOPTS_VALUE && dts - recorder->fragment_start_dts >= (int64_t)fragment_ms)) {
+        fmp4_write_fragment(recorder, video_next_dts);
+    }
+    if(new_file) {
+        fmp4_start_file(recorder, dts);
+    }
+}
+
+void fmp4_recorder_push(fmp4_recorder_t* recorder, demuxer_packet_t* packet) {
+    fmp4_track_t *video = &recorder->video;
+    fmp4_track_t *audio = &recorder->audio;
+    switch(packet->type) {
+        case VOODOO_DATA_TYPE_VIDEO_PARAMETERS:
+            fmp4_set_parameters(video, packet);
+            return;
+        case VOODOO_DATA_TYPE_AUDIO_PARAMETERS:
+            fmp4_set_parameters(audio, packet);
+            return;
+        case VOODOO_DATA_TYPE_VIDEO_PACKET: {
+            int key = (packet->flag & VOODOO_VIDEO_PACKET_FLAG_IS_KEY_FRAME) != 0;
+            int backward = video->last_dts != VOODOO_NOPTS_VALUE && packet->dts < video->last_dts;
+            if(packet->flag & VOODOO_PACKET_FLAG_FRAGMENT) {
+                break;
+            }
+            if(!recorder->started && (!key || !video->parameters)) {
+                break;
+            }
+            if(backward && !key) {
+                break;
+            }
+            if(key) {
+                fmp4_cut_at_sync(recorder, packet->dts, packet->dts, 0, backward);
+            } else if(recorder->config.fragment_ms > 0 && recorder->fragment_start_dts != VOODOO_NOPTS_VALUE &&
+                      packet->dts - recorder->fragment_start_dts >= (int64_t)recorder->config.fragment_ms) {
+                fmp4_write_fragment(recorder, packet->dts);
+            }
+            if(!video->file_parameters || fmp4_append(recorder, video, packet) < 0) {
+                break;
+            }
+            return;
+        }
+        case VOODOO_DATA_TYPE_AUDIO_PACKET: {
+            /*
+             纯音频流没有关键帧，按时间切分片
+             */
+            int audio_only = (recorder->media_flag & 4) && !(recorder->media_flag & 1);
+            if(packet->flag & VOODOO_PACKET_FLAG_FRAGMENT) {
+                break;
+            }
+            if(audio_only && audio->parameters) {
+                uint32_t fragment_ms = recorder->config.fragment_ms ? recorder->config.fragment_ms : FMP4_AUDIO_ONLY_FRAGMENT_MS;
+                fmp4_cut_at_sync(recorder, packet->dts, VOODOO_NOPTS_VALUE, fragment_ms,
+                                 audio->last_dts != VOODOO_NOPTS_VALUE && packet->dts < audio->last_dts);
+            }
+            if(!recorder->started || !audio->file_parameters || packet->dts < recorder->base_dts ||
+               (audio->last_dts != VOODOO_NOPTS_VALUE && packet->dts < audio->last_dts)) {
+                break;
+            }
+            if(fmp4_append(recorder, audio, packet) < 0) {
+                break;
+            }
+            return;
+        }
+        default:
+            return;
+    }
+    FMP4_STAT_ADD(recorder, dropped, 1);
+}
+
+int fmp4_recorder_flush(fmp4_recorder_t* recorder) {
+    return fmp4_write_fragment(recorder, VOODOO_NOPTS_VALUE);
+}
+
+void fmp4_recorder_get_stats(fmp4_recorder_t* recorder, fmp4_recorder_stats_t* stats) {
+    stats->files = __atomic_load_n(&recorder->stats.files, __ATOMIC_RELAXED);
+    stats->fragments = __atomic_load_n(&recorder->stats.fragments, __ATOMIC_RELAXED);
+    stats->samples = __atomic_load_n(&recorder->stats.samples, __ATOMIC_RELAXED);
+    stats->bytes = __atomic_load_n(&recorder->stats.bytes, __ATOMIC_RELAXED);
+    stats->writev_calls = __atomic_load_n(&recorder->stats.writev_calls, __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n(&recorder->stats.dropped, __ATOMIC_RELAXED);
+    stats->write_errors = __atomic_load_n(&recorder->stats.write_errors, __ATOMIC_RELAXED);
+    stats->queued = 0;
+    if(recorder->async) {
+        pthread_mutex_lock(&recorder->lock);
+        stats->queued = recorder->queued;
+        pthread_mutex_unlock(&recorder->lock);
+    }
+}
@@ -0,0 +1,89 @@
+//
+//  fmp4_recorder.h
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+
+#ifndef fmp4_recorder_h
+#define fmp4_recorder_h
+
+#include "demuxer.h"
+#include "packet_pool.h"
+
+/*
+ records the demuxed stream as fragmented mp4 (cmaf style), fed with the
+ pooled packets of pull mode. samples are held as references and written
+ with writev straight from the packets, nothing is copied per frame.
+ every file is an init segment (ftyp + moov) followed by moof + mdat
+ fragments, one per gop or per time slice. recording starts at the first
+ video keyframe, a new file starts when the codec parameters change,
+ segment_ms is reached at a keyframe, or the timestamps go back at a
+ keyframe (the decode times restart from it). other packets going back
+ are dropped.
+ the sidecar index <prefix>.idx gets one line per fragment starting with a
+ keyframe, appended as they are written:
+     <file number> <moof offset> <dts ms> <fragment bytes>
+ video packets must be length prefixed as their decoder configuration says
+ (VOODOO_NAL_FORMAT_PASSTHROUGH or LENGTH4), audio raw aac.
+ push, flush and destroy from one thread, the one that reads the packets.
+ by default the files are written inside push: the push that closes a
+ fragment blocks for as long as the disk takes, so only do that on the
+ demux thread when a stall there is acceptable. with async a writer thread
+ of its own does the i/o, push only queues the finished fragment with a
+ reference on its packets. when the disk falls more than 64 fragments
+ behind, new ones are dropped and counted, so memory stays bounded.
+ */
+typedef struct fmp4_recorder_s fmp4_recorder_t;
+
+typedef struct fmp4_recorder_config_s {
+    const char *path_prefix;    /*  files are <prefix>-0000.mp4, <prefix>-0001.mp4 ...  */
+    uint32_t fragment_ms;       /*  0 one fragment per gop, else also cut inside a gop after about this long  */
+    uint32_t segment_ms;        /*  0 one file until the parameters change  */
+    int index;                  /*  write the sidecar keyframe index    */
+    int async;                  /*  write on a thread of its own, push never waits for the disk   */
+} fmp4_recorder_config_t;
+
+typedef struct fmp4_recorder_stats_s {
+    uint64_t files;
+    uint64_t fragments;
+    uint64_t samples;
+    uint64_t bytes;             /*  written, headers included   */
+    uint64_t writev_calls;
+    uint64_t dropped;           /*  before the first keyframe, going back in time, or the writer too far behind  */
+    uint32_t write_errors;
+    uint32_t queued;            /*  files and fragments the writer thread has not finished, 0 when all is on disk */
+} fmp4_recorder_stats_t;
+
+/*
+ allocator may be NULL for malloc/free. NULL when the first file can not be named.
+ */
+fmp4_recorder_t* fmp4_recorder_create(const fmp4_recorder_config_t* config, const demuxer_config_t* allocator);
+/*
+ writes the pending fragment and closes the files, waits for the writer
+ thread to finish what is queued
+ */
+void fmp4_recorder_destroy(fmp4_recorder_t* recorder);
+
+/*
+ VOODOO_DATA_TYPE_MEDIA_FLAG value, tells an audio only stream apart from
+ one whose video has not shown up yet. without it audio waits for video.
+ */
+void fmp4_recorder_set_media_flag(fmp4_recorder_t* recorder, uint32_t flag);
+/*
+ parameters and media packets, other types are ignored. takes its own reference.
+ */
+void fmp4_recorder_push(fmp4_recorder_t* recorder, demuxer_packet_t* packet);
+/*
+ writes the pending samples as a fragment now. -1 on a write error, with
+ async only when it could not be queued, errors of the writer thread show
+ in write_errors
+ */
+int fmp4_recorder_flush(fmp4_recorder_t* recorder);
+/*
+ safe to call from any thread
+ */
+void fmp4_recorder_get_stats(fmp4_recorder_t* recorder, fmp4_recorder_stats_t* stats);
+
+#endif /* fmp4_recorder_h */
@@ -53,6 +53,17 @@ class LiveRenderSynchronizer : LivePlayerComponent {
         CMSampleBufferSetOutputPresentationTimeStamp(frame.sampleBuffer!, newValue: newTimeStamp)
     }
     
+    /*
+     a replayed gop starts before what should be shown, the frames ahead of
+     pts get negative times and are only decoded. call before the first frame
+     */
+    func present(fromPTS pts: Int64) {
+        dispatchQueue.async {
+            self.videoFrameReferencePTS = pts
+            self.videoFrameReferenceTimeStamp = CMTimeMake(value: 0, timescale: Constants.VIDEO_TIME_SCALE)
+        }
+    }
+    
     private var lastVideoFrameTimeStamp: CMTime = .invalid
     private var lastVideoKeyFrameTimeStamp: CMTime = .invalid
 
@@ -0,0 +1,106 @@
+//
+//  bitstream_bench.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+//  micro benchmark of bitstream.h against bitreader.h
+//
+//  cc -O2 -I../VoodooLivePlayer/pipeline/demuxer/base bitstream_bench.c -o bitstream_bench
+//  ./bitstream_bench [buffer_kb] [rounds]
+//
+
+#include "bitstream.h"
+#include "bitreader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ Exp-Golomb on top of the old reader, the way it would have to be written
+ */
+static uint32_t bs_read_ue(bitstream_t *bs) {
+    uint32_t zeros = 0;
+    while(bs->pos < bs->len && BS_READ_BIT(bs) == 0 && zeros < 32) {
+        ++zeros;
+    }
+    return zeros == 0 ? 0 : ((1U << zeros) | BS_READ32(bs, zeros)) - 1;
+}
+
+static uint32_t xorshift(uint32_t *s) {
+    *s ^= *s << 13; *s ^= *s >> 17; *s ^= *s << 5;
+    return *s;
+}
+
+int main(int argc, char **argv) {
+    uint32_t size = (argc > 1 ? (uint32_t)atoi(argv[1]) : 256) * 1024;
+    int rounds = argc > 2 ? atoi(argv[2]) : 50;
+    uint8_t *data = (uint8_t*)malloc(size);
+    uint8_t *widths = (uint8_t*)malloc(size);
+    uint32_t seed = 0x12345678, field_count = 0, bits = 0;
+
+    for(uint32_t i = 0;i < size;++i) {
+        data[i] = (uint8_t)xorshift(&seed);
+    }
+    /*
+     mixed 1~32 bit fields like a sps/slice header
+     */
+    while(bits + 32 < size * 8) {
+        widths[field_count] = (uint8_t)(1 + xorshift(&seed) % 32);
+        bits += widths[field_count++];
+    }
+
+    uint64_t sum_bs = 0, sum_br = 0;
+    double t0 = now_ns();
+    for(int r = 0;r < rounds;++r) {
+        bitstream_t bs;
+        BS_INIT(&bs, data, size);
+        for(uint32_t i = 0;i < field_count;++i) sum_bs += BS_READ32(&bs, widths[i]);
+    }
+    double t1 = now_ns();
+    for(int r = 0;r < rounds;++r) {
+        bitreader_t br;
+        BR_INIT(&br, data, size);
+        for(uint32_t i = 0;i < field_count;++i) sum_br += BR_READ(&br, widths[i]);
+    }
+    double t2 = now_ns();
+
+    printf("read_n   fields %u x %d\n", field_count, rounds);
+    printf("  bitstream.h  %8.2f ns/field\n", (t1 - t0) / ((double)field_count * rounds));
+    printf("  bitreader.h  %8.2f ns/field  (%.1fx)\n", (t2 - t1) / ((double)field_count * rounds), (t1 - t0) / (t2 - t1));
+    if(sum_bs != sum_br) {
+        printf("  MISMATCH %llu != %llu\n", (unsigned long long)sum_bs, (unsigned long long)sum_br);
+        return 1;
+    }
+
+    uint32_t ue_count = 0;
+    sum_bs = sum_br = 0;
+    t0 = now_ns();
+    for(int r = 0;r < rounds;++r) {
+        bitstream_t bs;
+        BS_INIT(&bs, data, size);
+        while(bs.pos + 8 < bs.len) { sum_bs += bs_read_ue(&bs); if(r == 0) ++ue_count; }
+    }
+    t1 = now_ns();
+    for(int r = 0;r < rounds;++r) {
+        bitreader_t br;
+        BR_INIT(&br, data, size);
+        while(BR_BITS_LEFT(&br) > 64) sum_br += BR_READ_UE(&br);
+    }
+    t2 = now_ns();
+
+    printf("ue(v)    codes %u x %d\n", ue_count, rounds);
+    printf("  bitstream.h  %8.2f ns/code\n", (t1 - t0) / ((double)ue_count * rounds));
+    printf("  bitreader.h  %8.2f ns/code  (%.1fx)\n", (t2 - t1) / ((double)ue_count * rounds), (t1 - t0) / (t2 - t1));
+
+    free(data);
+    free(widths);
+    return 0;
+}
@@ -0,0 +1,194 @@
+//
+//  engine_bench.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+//  aggregate throughput of demux_engine with many concurrent synthetic flv streams
+//
+//  D=../VoodooLivePlayer/pipeline/demuxer
+//  cc -O2 -pthread -I$D/base -I$D/flv -I$D/rtmp -I$D/engine engine_bench.c $D/engine/demux_engine.c
+//     $D/flv/flv.c $D/rtmp/rtmp.c $D/base/packet_pool.c $D/base/video_sps.c
+//     $D/base/demuxer_trace.c $D/base/gop_cache.c $D/base/nal_format.c -o engine_bench
+//  ./engine_bench [sessions] [workers,...] [seconds_per_stream] [feeders] [copy]
+//
+//  the chunks are handed over with demux_session_feed_buffer, the stream
+//  outlives the engine so nothing is released. copy 1 feeds through
+//  demux_session_feed instead.
+//
+
+#include "demux_engine.h"
+#include "flv_gen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define FEED_CHUNK_SIZE     (4096)
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void on_data(void* userdata, int type, void* data, int size, int64_t ts[], uint32_t flag) {
+}
+
+typedef struct feeder_s {
+    pthread_t thread;
+    demux_session_t **sessions;
+    int first;
+    int step;
+    int count;
+    const uint8_t *stream;
+    uint32_t stream_size;
+    int copy;
+} feeder_t;
+
+/*
+ every feeder walks its sessions round robin, one network sized chunk each
+ */
+static void* feeder_main(void *arg) {
+    feeder_t *f = (feeder_t*)arg;
+    for(uint32_t pos = 0;pos < f->stream_size;pos += FEED_CHUNK_SIZE) {
+        int len = (int)(f->stream_size - pos < FEED_CHUNK_SIZE ? f->stream_size - pos : FEED_CHUNK_SIZE);
+        for(int i = f->first;i < f->count;i += f->step) {
+            if(f->copy) {
+                demux_session_feed(f->sessions[i], f->stream + pos, len);
+            } else {
+                demux_session_feed_buffer(f->sessions[i], f->stream + pos, len, NULL, NULL);
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+ a whole decimal number no less than min, the value is left alone otherwise
+ */
+static int parse_int(const char *arg, int min, int *value) {
+    char *end = NULL;
+    long v = strtol(arg, &end, 10);
+    if(end == arg || *end != 0 || v < min || v > 1000000) {
+        return -1;
+    }
+    *value = (int)v;
+    return 0;
+}
+
+static int usage(const char *name) {
+    fprintf(stderr, "usage: %s [sessions] [workers,...] [seconds_per_stream] [feeders] [copy]\n", name);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    int session_count = 1000;
+    const char *worker_list = argc > 2 ? argv[2] : "1,2,4,8,16,32,64";
+    int seconds = 2;
+    int feeder_count = 4;
+    int copy = 0;
+    if(argc > 6 ||
+       (argc > 1 && parse_int(argv[1], 1, &session_count) < 0) ||
+       (argc > 3 && parse_int(argv[3], 1, &seconds) < 0) ||
+       (argc > 4 && parse_int(argv[4], 1, &feeder_count) < 0) ||
+       (argc > 5 && (parse_int(argv[5], 0, &copy) < 0 || copy > 1))) {
+        return usage(argv[0]);
+    }
+    /*
+     worker 0 is the online cpu count
+     */
+    for(const char *w = worker_list;;) {
+        char number[16];
+        size_t len = strcspn(w, ",");
+        int workers;
+        if(len == 0 || len >= sizeof(number)) {
+            return usage(argv[0]);
+        }
+        memcpy(number, w, len);
+        number[len] = 0;
+        if(parse_int(number, 0, &workers) < 0) {
+            return usage(argv[0]);
+        }
+        w += len;
+        if(*w == 0) break;
+        ++w;
+    }
+    flv_gen_config_t gen;
+    flv_gen_info_t info;
+    flv_gen_default_config(&gen);
+    gen.seconds = (uint32_t)seconds;
+    gen.video_kbps = 1000;
+    uint8_t *stream = flv_gen_stream(&gen, &info);
+    if(!stream) {
+        fprintf(stderr, "generate stream failed\n");
+        return 1;
+    }
+    uint32_t stream_size = info.size;
+    demux_session_t **sessions = (demux_session_t**)calloc((size_t)session_count, sizeof(demux_session_t*));
+    feeder_t *feeders = (feeder_t*)calloc((size_t)feeder_count, sizeof(feeder_t));
+    double base_rate = 0;
+
+    printf("sessions %d  stream %.2f MB  feeders %d  chunk %d  %s\n", session_count, stream_size / 1048576.0, feeder_count, FEED_CHUNK_SIZE,
+           copy ? "copied" : "in place");
+    printf("%8s %10s %14s %10s %10s %8s\n", "workers", "MB/s", "packets/s", "runs", "steals", "speedup");
+
+    for(const char *w = worker_list;*w;) {
+        demux_engine_config_t config;
+        memset(&config, 0, sizeof(config));
+        config.worker_count = atoi(w);
+        demux_engine_t *engine = demux_engine_create(&config);
+        if(!engine) {
+            fprintf(stderr, "create engine with %d workers failed\n", config.worker_count);
+            return 1;
+        }
+        for(int i = 0;i < session_count;++i) {
+            sessions[i] = demux_engine_open_session(engine, DEMUX_SESSION_FLV, NULL, on_data);
+        }
+
+        double t0 = now_ns();
+        for(int i = 0;i < feeder_count;++i) {
+            feeders[i].sessions = sessions;
+            feeders[i].first = i;
+            feeders[i].step = feeder_count;
+            feeders[i].count = session_count;
+            feeders[i].stream = stream;
+            feeders[i].stream_size = stream_size;
+            feeders[i].copy = copy;
+            pthread_create(&feeders[i].thread, NULL, feeder_main, &feeders[i]);
+        }
+        for(int i = 0;i < feeder_count;++i) {
+            pthread_join(feeders[i].thread, NULL);
+        }
+        demux_engine_wait_idle(engine);
+        double t1 = now_ns();
+
+        demux_engine_stats_t stats;
+        demux_engine_get_stats(engine, &stats);
+        double rate = stats.callbacks / ((t1 - t0) / 1e9);
+        if(base_rate == 0) {
+            base_rate = rate;
+        }
+        printf("%8d %10.1f %14.0f %10llu %10llu %7.2fx\n", demux_engine_worker_count(engine),
+               stats.bytes / 1048576.0 / ((t1 - t0) / 1e9), rate,
+               (unsigned long long)stats.sessions_run, (unsigned long long)stats.steals, rate / base_rate);
+        if(stats.errors) {
+            printf("  %llu feeds failed\n", (unsigned long long)stats.errors);
+        }
+
+        for(int i = 0;i < session_count;++i) {
+            demux_session_close(sessions[i]);
+        }
+        demux_engine_destroy(engine);
+
+        while(*w && *w != ',') ++w;
+        if(*w == ',') ++w;
+    }
+
+    free(feeders);
+    free(sessions);
+    free(stream);
+    return 0;
+}
@@ -0,0 +1,613 @@
+//
+//  flv_bench.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+//  flv_demuxer_feed throughput over network sized chunks, after checking
+//  the gop cache
+//
+//  D=../VoodooLivePlayer/pipeline/demuxer
+//  cc -O2 -I$D/base -I$D/flv flv_bench.c $D/flv/flv.c $D/base/packet_pool.c
+//     $D/base/video_sps.c $D/base/demuxer_trace.c $D/base/gop_cache.c $D/base/nal_format.c -o flv_bench
+//
+//  ./flv_bench [-f file.flv] [-t seconds] [-v video_kbps] [-a audio_kbps] [-r fps] [-g gop]
+//              [-k key_ratio] [-j jitter_percent] [-m max_tag_size] [-s seed]
+//              [-c 1024,4096,16384,65536,0] [-n rounds] [-p] [-o result.txt]
+//  ./flv_bench -d base.txt new.txt [threshold_percent]
+//
+//  chunk size 0 feeds random sizes between 1 KB and 64 KB.
+//  -v 0 -a 64 is an audio only stream of ~200 byte tags, where per tag
+//  overhead rather than copying dominates.
+//  every figure is the median of the rounds, -p delivers through a packet pool.
+//  three gop cache checks run first on generated streams, exit 1 when one fails.
+//  a snapshot is taken after every 4 KB fed:
+//  gop cache   under the default caps every snapshot is the sequence headers
+//              plus the gop so far, present_index 500 ms behind the newest
+//  gop evict   a 1.5 s cap on a 2 s gop and a byte cap at the average gop:
+//              an outgrown gop goes whole, nothing is cached until the next
+//              keyframe and no snapshot is over a cap
+//  audio only  the window slides, it stays full up to the cap
+//  then two resync checks, fed with resync on:
+//  resync      37 zero or random bytes inserted, or 37 bytes dropped, at 100
+//              points of a 20 s stream fed in 4 KB chunks. at most 2 packets
+//              are lost, the last one comes out and the cache stays under 1 MB
+//  resync 1 MB 1 MB of random bytes between two tags is skipped with nothing
+//              lost, the time to feed that megabyte is printed
+//  -d compares two saved results and exits 1 when a metric regressed by more
+//  than the threshold (default 5%).
+//
+
+#include "flv.h"
+#include "flv_gen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#define BENCH_MAX_CHUNKS    16
+#define BENCH_MAX_ROUNDS    64
+#define BENCH_MAX_SNAPSHOT  1024
+#define BENCH_LATENCY_MS    500
+#define BENCH_RESYNC_POINTS 100
+#define BENCH_RESYNC_BYTES  37
+#define BENCH_RESYNC_MAX_LOST   2
+#define BENCH_RESYNC_MAX_CACHE  (1024*1024)
+#define BENCH_RESYNC_GARBAGE    (1024*1024)
+
+typedef struct bench_result_s {
+    uint32_t chunk;
+    double mbps;
+    double packets_per_second;
+    double ns_per_tag;
+    double moved;
+    double rss_kb;
+} bench_result_t;
+
+static const char *bench_metric_names[] = { "mbps", "pps", "ns_per_tag", "moved", "rss_kb" };
+/*
+ 1: larger is better, -1: smaller is better
+ */
+static const int bench_metric_direction[] = { 1, 1, -1, -1, -1 };
+
+static uint64_t bench_packets;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double peak_rss_kb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024.0;
+#else
+    return (double)usage.ru_maxrss;
+#endif
+}
+
+static void on_data(void* userdata, int type, void* data, int size, int64_t ts[], uint32_t flag) {
+    ++bench_packets;
+}
+
+/*
+ lent for the callback, the demuxer releases it afterwards
+ */
+static void on_packet(void* userdata, demuxer_packet_t* packet) {
+    ++bench_packets;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double median(double *values, int count) {
+    qsort(values, (size_t)count, sizeof(double), compare_double);
+    return count % 2 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+static double* result_metric(bench_result_t *r, int i) {
+    double *metrics[] = { &r->mbps, &r->packets_per_second, &r->ns_per_tag, &r->moved, &r->rss_kb };
+    return metrics[i];
+}
+
+static void run(const uint8_t *stream, uint32_t size, uint32_t tags, uint32_t chunk, int rounds, int use_pool, bench_result_t *result) {
+    double mbps[BENCH_MAX_ROUNDS], pps[BENCH_MAX_ROUNDS], ns[BENCH_MAX_ROUNDS], moved[BENCH_MAX_ROUNDS];
+    for(int r = 0;r < rounds;++r) {
+        uint32_t seed = 0x1234567u + (uint32_t)r;
+        packet_pool_t *pool = use_pool ? packet_pool_create(0, NULL) : NULL;
+        void *ctx = flv_demuxer_init(NULL, on_data);
+        if(pool) {
+            flv_demuxer_set_packet_pool(ctx, pool, on_packet);
+        }
+        bench_packets = 0;
+        double t0 = now_ns();
+        for(uint32_t pos = 0;pos < size;) {
+            uint32_t len = chunk;
+            if(len == 0) {
+                seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+                len = 1024 + seed % (64 * 1024 - 1024 + 1);
+            }
+            if(len > size - pos) len = size - pos;
+            flv_demuxer_feed(ctx, stream + pos, (int)len);
+            pos += len;
+        }
+        double t1 = now_ns();
+        mbps[r] = size / 1048576.0 / ((t1 - t0) / 1e9);
+        pps[r] = bench_packets / ((t1 - t0) / 1e9);
+        ns[r] = (t1 - t0) / tags;
+        moved[r] = (double)flv_demuxer_cache_bytes_moved(ctx);
+        flv_demuxer_fint(ctx);
+        if(pool) {
+            packet_pool_destroy(pool);
+        }
+    }
+    result->chunk = chunk;
+    result->mbps = median(mbps, rounds);
+    result->packets_per_second = median(pps, rounds);
+    result->ns_per_tag = median(ns, rounds);
+    result->moved = median(moved, rounds);
+    result->rss_kb = peak_rss_kb();
+}
+
+typedef struct gop_check_s {
+    uint64_t samples;
+    uint64_t bad;               /*  snapshots breaking a rule below         */
+    uint32_t min_packets;       /*  of the last snapshot                    */
+    uint32_t last_bytes;
+    int64_t last_span;
+    gop_cache_stats_t stats;
+} gop_check_t;
+
+/*
+ 0 when the snapshot holds: the sequence headers first, with video the gop
+ starts at a keyframe, within the caps, and present_index is the first
+ packet within BENCH_LATENCY_MS of the newest
+ */
+static int gop_check_snapshot(demuxer_packet_t **packets, int n, int present, const gop_cache_config_t *caps, int has_video, gop_check_t *check) {
+    int first = 0;
+    uint32_t bytes = 0;
+    while(first < n && (packets[first]->type == VOODOO_DATA_TYPE_VIDEO_PARAMETERS || packets[first]->type == VOODOO_DATA_TYPE_AUDIO_PARAMETERS)) {
+        ++first;
+    }
+    check->last_bytes = 0;
+    check->last_span = 0;
+    if(first == n) {
+        return present != n;
+    }
+    if(has_video && !(packets[first]->type == VOODOO_DATA_TYPE_VIDEO_PACKET && (packets[first]->flag & VOODOO_VIDEO_PACKET_FLAG_IS_KEY_FRAME))) {
+        return 1;
+    }
+    for(int i = first;i < n;++i) {
+        if(packets[i]->type != VOODOO_DATA_TYPE_VIDEO_PACKET && packets[i]->type != VOODOO_DATA_TYPE_AUDIO_PACKET) {
+            return 1;
+        }
+        bytes += packets[i]->size;
+    }
+    int64_t newest = packets[n - 1]->dts;
+    int64_t span = newest - packets[first]->dts;
+    if(bytes > caps->max_bytes || span > caps->max_duration_ms) {
+        return 1;
+    }
+    if(present < first || present >= n || packets[present]->dts < newest - BENCH_LATENCY_MS ||
+       (present > first && packets[present - 1]->dts >= newest - BENCH_LATENCY_MS)) {
+        return 1;
+    }
+    check->last_bytes = bytes;
+    check->last_span = span;
+    return 0;
+}
+
+static void gop_check_run(const uint8_t *stream, uint32_t size, const gop_cache_config_t *caps, int has_video, gop_check_t *check) {
+    demuxer_packet_t *packets[BENCH_MAX_SNAPSHOT];
+    packet_pool_t *pool = packet_pool_create(0, NULL);
+    gop_cache_t *cache = gop_cache_create(caps, NULL);
+    void *ctx = flv_demuxer_init(NULL, on_data);
+    memset(check, 0, sizeof(gop_check_t));
+    flv_demuxer_set_packet_pool(ctx, pool, on_packet);
+    flv_demuxer_set_gop_cache(ctx, cache);
+    for(uint32_t pos = 0;pos < size;) {
+        uint32_t len = size - pos < 4096 ? size - pos : 4096;
+        int present = 0;
+        flv_demuxer_feed(ctx, stream + pos, (int)len);
+        pos += len;
+        int n = gop_cache_snapshot(cache, BENCH_LATENCY_MS, packets, BENCH_MAX_SNAPSHOT, &present);
+        check->samples++;
+        if(n < 0) {
+            check->bad++;
+            continue;
+        }
+        check->bad += gop_check_snapshot(packets, n, present, caps, has_video, check);
+        for(int i = 0;i < n;++i) {
+            demuxer_packet_release(packets[i]);
+        }
+    }
+    gop_cache_get_stats(cache, &check->stats);
+    flv_demuxer_fint(ctx);
+    gop_cache_destroy(cache);
+    packet_pool_destroy(pool);
+}
+
+static int check(const char *name, int ok, const char *detail) {
+    printf("%-12s %s  %s\n", name, ok ? "ok  " : "FAIL", detail);
+    return ok ? 0 : 1;
+}
+
+static int check_gop_cache(uint32_t seed) {
+    flv_gen_config_t config;
+    flv_gen_info_t info;
+    gop_cache_config_t caps;
+    gop_check_t result;
+    char detail[256];
+    int failures = 0;
+
+    /*
+     2 s gop，默认上限内每个gop都完整留下
+     */
+    flv_gen_default_config(&config);
+    config.seconds = 20;
+    config.seed = seed;
+    uint8_t *stream = flv_gen_stream(&config, &info);
+    if(!stream) {
+        return 1;
+    }
+    memset(&caps, 0, sizeof(caps));
+    caps.max_bytes = 16 * 1024 * 1024;
+    caps.max_duration_ms = 10 * 1000;
+    gop_check_run(stream, info.size, &caps, 1, &result);
+    snprintf(detail, sizeof(detail), "%llu/%llu snapshots bad, %llu gops (%u keyframes), %llu overflows, last %u packets %lld ms",
+             (unsigned long long)result.bad, (unsigned long long)result.samples, (unsigned long long)result.stats.gops,
+             info.keyframes, (unsigned long long)result.stats.overflows, result.stats.packets, (long long)result.last_span);
+    failures += check("gop cache", result.bad == 0 && result.stats.gops == info.keyframes && result.stats.overflows == 0 &&
+                      result.last_span > 1000 * (int64_t)config.gop / config.fps - 100, detail);
+
+    /*
+     超过上限的gop整个丢掉，到下一个关键帧之前什么都不留
+     */
+    caps.max_duration_ms = 1500;
+    gop_check_run(stream, info.size, &caps, 1, &result);
+    uint64_t duration_overflows = result.stats.overflows;
+    uint64_t bad = result.bad, samples = result.samples;
+    caps.max_duration_ms = 10 * 1000;
+    caps.max_bytes = info.size / info.keyframes;
+    gop_check_run(stream, info.size, &caps, 1, &result);
+    snprintf(detail, sizeof(detail), "%llu/%llu snapshots bad, 1.5 s cap %llu/%u gops dropped, %u byte cap %llu/%u",
+             (unsigned long long)(bad + result.bad), (unsigned long long)(samples + result.samples),
+             (unsigned long long)duration_overflows, info.keyframes, caps.max_bytes, (unsigned long long)result.stats.overflows, info.keyframes);
+    failures += check("gop evict", bad == 0 && result.bad == 0 && duration_overflows == info.keyframes &&
+                      result.stats.overflows > 0 && result.stats.overflows < info.keyframes, detail);
+    free(stream);
+
+    /*
+     只有音频时是一个滑动窗口，按时长或者字节数保持满的
+     */
+    config.video_kbps = 0;
+    config.audio_kbps = 64;
+    stream = flv_gen_stream(&config, &info);
+    if(!stream) {
+        return failures + 1;
+    }
+    caps.max_bytes = 16 * 1024 * 1024;
+    caps.max_duration_ms = 2000;
+    gop_check_run(stream, info.size, &caps, 0, &result);
+    int64_t window_span = result.last_span;
+    uint64_t window_gops = result.stats.gops + result.stats.overflows;
+    bad = result.bad;
+    samples = result.samples;
+    caps.max_bytes = 4096;
+    caps.max_duration_ms = 10 * 1000;
+    gop_check_run(stream, info.size, &caps, 0, &result);
+    uint32_t audio_size = (uint32_t)((uint64_t)config.audio_kbps * 125 * 1024 / 44100);
+    snprintf(detail, sizeof(detail), "%llu/%llu snapshots bad, 2 s cap holds %lld ms, 4096 byte cap holds %u bytes",
+             (unsigned long long)(bad + result.bad), (unsigned long long)(samples + result.samples),
+             (long long)window_span, result.last_bytes);
+    failures += check("audio only", bad == 0 && result.bad == 0 && window_gops == 0 &&
+                      result.stats.gops == 0 && result.stats.overflows == 0 &&
+                      window_span > 2000 - 50 && result.last_bytes > caps.max_bytes - 2 * (audio_size + 2) * 12 / 10, detail);
+    free(stream);
+    return failures;
+}
+
+typedef struct resync_check_s {
+    uint64_t packets;           /*  audio and video packets delivered       */
+    int64_t last_dts;
+    uint32_t high_water;
+    demuxer_stats_t stats;
+} resync_check_t;
+
+static void on_resync_data(void* userdata, int type, void* data, int size, int64_t ts[], uint32_t flag) {
+    resync_check_t *check = (resync_check_t*)userdata;
+    if(type == VOODOO_DATA_TYPE_VIDEO_PACKET || type == VOODOO_DATA_TYPE_AUDIO_PACKET) {
+        check->packets++;
+        check->last_dts = ts[1];
+    }
+}
+
+/*
+ 开着resync按chunk大小feed，返回纳秒
+ */
+static double resync_run(const uint8_t *stream, uint32_t size, uint32_t chunk, resync_check_t *check) {
+    void *ctx = flv_demuxer_init(check, on_resync_data);
+    memset(check, 0, sizeof(resync_check_t));
+    check->last_dts = -1;
+    flv_demuxer_set_resync(ctx, 1);
+    double t0 = now_ns();
+    for(uint32_t pos = 0;pos < size;) {
+        uint32_t len = size - pos < chunk ? size - pos : chunk;
+        flv_demuxer_feed(ctx, stream + pos, (int)len);
+        pos += len;
+    }
+    double t1 = now_ns();
+    check->high_water = flv_demuxer_cache_high_water(ctx);
+    flv_demuxer_get_stats(ctx, &check->stats);
+    flv_demuxer_fint(ctx);
+    return t1 - t0;
+}
+
+static int check_resync(uint32_t seed) {
+    flv_gen_config_t config;
+    flv_gen_info_t info;
+    flv_gen_buffer_t garbage = { NULL, 0, 0, seed | 1 };
+    resync_check_t ref, result;
+    char detail[256];
+    int failures = 0;
+
+    flv_gen_default_config(&config);
+    config.seconds = 20;
+    config.seed = seed;
+    uint8_t *stream = flv_gen_stream(&config, &info);
+    uint8_t *corrupt = stream ? (uint8_t*)malloc(info.size + BENCH_RESYNC_GARBAGE) : NULL;
+    if(!corrupt) {
+        free(stream);
+        return 1;
+    }
+    resync_run(stream, info.size, 4096, &ref);
+
+    /*
+     在整个流上均匀取点，插入37个0、37个随机字节或者删掉37个字节，
+     坏掉的tag和紧挨着的tag以外都要送出来，并且一直解析到最后
+     */
+    uint32_t runs = 0, bad = 0, worst_lost = 0, worst_high_water = 0, worst_skipped = 0;
+    for(uint32_t k = 1;k <= BENCH_RESYNC_POINTS;++k) {
+        uint32_t at = (uint32_t)((uint64_t)info.size * k / (BENCH_RESYNC_POINTS + 1));
+        for(int mode = 0;mode < 3;++mode) {
+            uint32_t size = info.size;
+            memcpy(corrupt, stream, at);
+            if(mode == 2) {
+                memcpy(corrupt + at, stream + at + BENCH_RESYNC_BYTES, info.size - at - BENCH_RESYNC_BYTES);
+                size -= BENCH_RESYNC_BYTES;
+            } else {
+                if(mode == 0) {
+                    memset(corrupt + at, 0, BENCH_RESYNC_BYTES);
+                } else {
+                    flv_gen_random(&garbage, corrupt + at, BENCH_RESYNC_BYTES);
+                }
+                memcpy(corrupt + at + BENCH_RESYNC_BYTES, stream + at, info.size - at);
+                size += BENCH_RESYNC_BYTES;
+            }
+            resync_run(corrupt, size, 4096, &result);
+            uint32_t lost = result.packets < ref.packets ? (uint32_t)(ref.packets - result.packets) : 0;
+            runs++;
+            if(result.packets > ref.packets || lost > BENCH_RESYNC_MAX_LOST || result.last_dts != ref.last_dts ||
+               result.stats.resyncs == 0 || result.high_water > BENCH_RESYNC_MAX_CACHE) {
+                bad++;
+            }
+            if(lost > worst_lost) worst_lost = lost;
+            if(result.high_water > worst_high_water) worst_high_water = result.high_water;
+            if(result.stats.resync_bytes_skipped > worst_skipped) worst_skipped = (uint32_t)result.stats.resync_bytes_skipped;
+        }
+    }
+    snprintf(detail, sizeof(detail), "%u/%u corrupt streams bad, worst %u packets lost, %u bytes skipped, cache %u KB",
+             bad, runs, worst_lost, worst_skipped, worst_high_water / 1024);
+    failures += check("resync", bad == 0, detail);
+
+    /*
+     两个tag之间插入1 MB随机数据，单独计时这1 MB的feed
+     */
+    uint32_t at = 13;
+    while(at + 15 <= info.size / 2) {
+        at += 11 + ((uint32_t)stream[at + 1] << 16 | (uint32_t)stream[at + 2] << 8 | stream[at + 3]) + 4;
+    }
+    memcpy(corrupt, stream, at);
+    flv_gen_random(&garbage, corrupt + at, BENCH_RESYNC_GARBAGE);
+    memcpy(corrupt + at + BENCH_RESYNC_GARBAGE, stream + at, info.size - at);
+    double us[BENCH_MAX_ROUNDS];
+    int rounds = 5;
+    for(int r = 0;r < rounds;++r) {
+        void *ctx = flv_demuxer_init(&result, on_resync_data);
+        memset(&result, 0, sizeof(result));
+        flv_demuxer_set_resync(ctx, 1);
+        flv_demuxer_feed(ctx, corrupt, (int)at);
+        double t0 = now_ns();
+        for(uint32_t pos = at;pos < at + BENCH_RESYNC_GARBAGE;pos += 65536) {
+            flv_demuxer_feed(ctx, corrupt + pos, 65536);
+        }
+        us[r] = (now_ns() - t0) / 1e3;
+        flv_demuxer_feed(ctx, corrupt + at + BENCH_RESYNC_GARBAGE, (int)(info.size - at));
+        result.high_water = flv_demuxer_cache_high_water(ctx);
+        flv_demuxer_get_stats(ctx, &result.stats);
+        flv_demuxer_fint(ctx);
+    }
+    double garbage_us = median(us, rounds);
+    snprintf(detail, sizeof(detail), "1 MB garbage skipped in %.0f us (%.0f MB/s), %llu resyncs, %llu bytes skipped, %llu/%llu packets",
+             garbage_us, 1e6 / garbage_us, (unsigned long long)result.stats.resyncs,
+             (unsigned long long)result.stats.resync_bytes_skipped, (unsigned long long)result.packets, (unsigned long long)ref.packets);
+    failures += check("resync 1 MB", result.packets == ref.packets && result.stats.resyncs == 1 &&
+                      result.stats.resync_bytes_skipped + 16 >= BENCH_RESYNC_GARBAGE &&
+                      result.stats.resync_bytes_skipped <= BENCH_RESYNC_GARBAGE, detail);
+    free(corrupt);
+    free(stream);
+    return failures;
+}
+
+static int load_results(const char *path, bench_result_t *results, int max) {
+    FILE *f = fopen(path, "r");
+    char line[512];
+    int count = 0;
+    if(!f) {
+        fprintf(stderr, "open %s failed\n", path);
+        return -1;
+    }
+    while(count < max && fgets(line, sizeof(line), f)) {
+        bench_result_t *r = &results[count];
+        if(line[0] == '#') continue;
+        if(sscanf(line, "chunk=%u mbps=%lf pps=%lf ns_per_tag=%lf moved=%lf rss_kb=%lf",
+                  &r->chunk, &r->mbps, &r->packets_per_second, &r->ns_per_tag, &r->moved, &r->rss_kb) == 6) {
+            ++count;
+        }
+    }
+    fclose(f);
+    return count;
+}
+
+static int compare(const char *base_path, const char *new_path, double threshold) {
+    bench_result_t base[BENCH_MAX_CHUNKS], current[BENCH_MAX_CHUNKS];
+    int base_count = load_results(base_path, base, BENCH_MAX_CHUNKS);
+    int current_count = load_results(new_path, current, BENCH_MAX_CHUNKS);
+    int regressions = 0;
+    if(base_count < 0 || current_count < 0) {
+        return 2;
+    }
+    printf("%-8s %-12s %14s %14s %9s\n", "chunk", "metric", "base", "new", "delta");
+    for(int i = 0;i < current_count;++i) {
+        bench_result_t *b = NULL;
+        for(int j = 0;j < base_count;++j) {
+            if(base[j].chunk == current[i].chunk) b = &base[j];
+        }
+        if(!b) {
+            printf("%-8u only in %s\n", current[i].chunk, new_path);
+            continue;
+        }
+        for(int m = 0;m < 5;++m) {
+            double x = *result_metric(b, m), y = *result_metric(&current[i], m);
+            double delta = x != 0 ? (y - x) * 100.0 / x : 0;
+            int regressed = delta * bench_metric_direction[m] < -threshold;
+            regressions += regressed;
+            printf("%-8u %-12s %14.1f %14.1f %+8.1f%%%s\n", current[i].chunk, bench_metric_names[m], x, y, delta, regressed ? "  REGRESSION" : "");
+        }
+    }
+    printf("%d regression(s) over %.1f%%\n", regressions, threshold);
+    return regressions ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    flv_gen_config_t config;
+    flv_gen_info_t info;
+    const char *input = NULL, *output = NULL, *chunk_list = "1024,4096,16384,65536,0";
+    int rounds = 5, use_pool = 0, failures = 0;
+    uint32_t chunks[BENCH_MAX_CHUNKS];
+    int chunk_count = 0;
+    uint8_t *stream = NULL;
+
+    flv_gen_default_config(&config);
+    for(int i = 1;i < argc;++i) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if(strcmp(arg, "-d") == 0 && i + 2 < argc) {
+            return compare(argv[i + 1], argv[i + 2], i + 3 < argc ? atof(argv[i + 3]) : 5.0);
+        } else if(strcmp(arg, "-p") == 0) {
+            use_pool = 1;
+            continue;
+        } else if(!value) {
+            fprintf(stderr, "missing value for %s\n", arg);
+            return 2;
+        }
+        ++i;
+        if(strcmp(arg, "-f") == 0) input = value;
+        else if(strcmp(arg, "-o") == 0) output = value;
+        else if(strcmp(arg, "-c") == 0) chunk_list = value;
+        else if(strcmp(arg, "-n") == 0) rounds = atoi(value);
+        else if(strcmp(arg, "-t") == 0) config.seconds = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-v") == 0) config.video_kbps = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-a") == 0) config.audio_kbps = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-r") == 0) config.fps = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-g") == 0) config.gop = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-k") == 0) config.key_ratio = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-j") == 0) config.jitter_percent = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-m") == 0) config.max_tag_size = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-s") == 0) config.seed = (uint32_t)atoi(value);
+        else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return 2;
+        }
+    }
+    if(rounds < 1) rounds = 1;
+    if(rounds > BENCH_MAX_ROUNDS) rounds = BENCH_MAX_ROUNDS;
+    for(const char *c = chunk_list;*c && chunk_count < BENCH_MAX_CHUNKS;) {
+        chunks[chunk_count++] = (uint32_t)atoi(c);
+        while(*c && *c != ',') ++c;
+        if(*c == ',') ++c;
+    }
+
+    if(input) {
+        FILE *f = fopen(input, "rb");
+        long size;
+        if(!f) {
+            fprintf(stderr, "open %s failed\n", input);
+            return 2;
+        }
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        stream = (uint8_t*)malloc((size_t)size);
+        if(!stream || fread(stream, 1, (size_t)size, f) != (size_t)size) {
+            fprintf(stderr, "read %s failed\n", input);
+            return 2;
+        }
+        fclose(f);
+        /*
+         文件的tag数先用一次整块feed数出来
+         */
+        void *ctx = flv_demuxer_init(NULL, on_data);
+        bench_packets = 0;
+        flv_demuxer_feed(ctx, stream, (int)size);
+        flv_demuxer_fint(ctx);
+        memset(&info, 0, sizeof(info));
+        info.size = (uint32_t)size;
+        info.video_tags = (uint32_t)bench_packets;
+    } else {
+        stream = flv_gen_stream(&config, &info);
+        if(!stream) {
+            fprintf(stderr, "generate stream failed\n");
+            return 2;
+        }
+    }
+    uint32_t tags = info.video_tags + info.audio_tags + info.script_tags;
+    if(tags == 0) tags = 1;
+    failures = check_gop_cache(config.seed);
+    failures += check_resync(config.seed);
+
+    FILE *out = output ? fopen(output, "w") : NULL;
+    if(input) {
+        printf("# %s  %.2f MB  ~%u tags  rounds %d%s\n", input, info.size / 1048576.0, tags, rounds, use_pool ? "  pool" : "");
+    } else {
+        printf("# generated %us  video %u kbps %u fps gop %u key x%u  audio %u kbps  jitter %u%%  max tag %u  seed %u\n",
+               config.seconds, config.video_kbps, config.fps, config.gop, config.key_ratio, config.audio_kbps,
+               config.jitter_percent, config.max_tag_size, config.seed);
+        printf("# %.2f MB  %u video (%u key)  %u audio  %u script tags  rounds %d%s\n", info.size / 1048576.0,
+               info.video_tags, info.keyframes, info.audio_tags, info.script_tags, rounds, use_pool ? "  pool" : "");
+    }
+    if(out) {
+        fprintf(out, "# flv_bench %s%s\n", input ? input : "generated", use_pool ? " pool" : "");
+    }
+    printf("%-8s %10s %14s %10s %14s %10s\n", "chunk", "MB/s", "packets/s", "ns/tag", "moved", "rss_kb");
+    for(int i = 0;i < chunk_count;++i) {
+        bench_result_t r;
+        run(stream, info.size, tags, chunks[i], rounds, use_pool, &r);
+        printf("%-8u %10.1f %14.0f %10.1f %14.0f %10.0f\n", r.chunk, r.mbps, r.packets_per_second, r.ns_per_tag, r.moved, r.rss_kb);
+        if(out) {
+            fprintf(out, "chunk=%u mbps=%.3f pps=%.1f ns_per_tag=%.3f moved=%.0f rss_kb=%.0f\n",
+                    r.chunk, r.mbps, r.packets_per_second, r.ns_per_tag, r.moved, r.rss_kb);
+        }
+    }
+    if(out) {
+        fclose(out);
+    }
+    free(stream);
+    return failures ? 1 : 0;
+}
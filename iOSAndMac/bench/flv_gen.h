@@ -0,0 +1,234 @@
+//
+//  flv_gen.h
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+//  deterministic synthetic flv stream for the benchmarks.
+//  same config and seed always give the same bytes.
+//
+
+#ifndef flv_gen_h
+#define flv_gen_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct flv_gen_config_s {
+    uint32_t seconds;
+    uint32_t video_kbps;        /*  0 for an audio only stream              */
+    uint32_t fps;
+    uint32_t gop;               /*  frames per keyframe interval            */
+    uint32_t key_ratio;         /*  keyframe size / average inter frame     */
+    uint32_t audio_kbps;        /*  0 for a video only stream, aac 44.1k    */
+    uint32_t jitter_percent;    /*  random +- on every tag size             */
+    uint32_t max_tag_size;      /*  0 for no limit                          */
+    uint32_t seed;
+    int metadata;               /*  write onMetaData first                  */
+} flv_gen_config_t;
+
+typedef struct flv_gen_info_s {
+    uint32_t size;
+    uint32_t video_tags;
+    uint32_t audio_tags;
+    uint32_t script_tags;
+    uint32_t keyframes;
+} flv_gen_info_t;
+
+static inline void flv_gen_default_config(flv_gen_config_t *config) {
+    memset(config, 0, sizeof(flv_gen_config_t));
+    config->seconds = 60;
+    config->video_kbps = 2000;
+    config->fps = 25;
+    config->gop = 50;
+    config->key_ratio = 6;
+    config->audio_kbps = 128;
+    config->jitter_percent = 20;
+    config->seed = 1;
+    config->metadata = 1;
+}
+
+typedef struct flv_gen_buffer_s {
+    uint8_t *data;
+    uint32_t size;
+    uint32_t capacity;
+    uint32_t seed;
+} flv_gen_buffer_t;
+
+static inline uint32_t flv_gen_rand(flv_gen_buffer_t *b) {
+    b->seed ^= b->seed << 13; b->seed ^= b->seed >> 17; b->seed ^= b->seed << 5;
+    return b->seed;
+}
+
+static inline uint8_t* flv_gen_reserve(flv_gen_buffer_t *b, uint32_t size) {
+    if(b->size + size > b->capacity) {
+        uint32_t capacity = b->capacity ? b->capacity : 1 << 20;
+        while(capacity < b->size + size) capacity *= 2;
+        uint8_t *data = (uint8_t*)realloc(b->data, capacity);
+        if(!data) return NULL;
+        b->data = data;
+        b->capacity = capacity;
+    }
+    return b->data + b->size;
+}
+
+static inline void flv_gen_be(uint8_t *p, uint32_t v, int n) {
+    for(int i = n - 1;i >= 0;--i, v >>= 8) p[i] = (uint8_t)v;
+}
+
+/*
+ tag header + body + previous tag size, returns the body to fill
+ */
+static inline uint8_t* flv_gen_tag(flv_gen_buffer_t *b, int type, uint32_t ts, uint32_t body_size) {
+    uint8_t *p = flv_gen_reserve(b, 11 + body_size + 4);
+    if(!p) return NULL;
+    p[0] = (uint8_t)type;
+    flv_gen_be(p + 1, body_size, 3);
+    flv_gen_be(p + 4, ts & 0xffffff, 3);
+    p[7] = (uint8_t)(ts >> 24);
+    p[8] = p[9] = p[10] = 0;
+    flv_gen_be(p + 11 + body_size, 11 + body_size, 4);
+    b->size += 11 + body_size + 4;
+    return p + 11;
+}
+
+static inline void flv_gen_random(flv_gen_buffer_t *b, uint8_t *p, uint32_t size) {
+    uint32_t i = 0;
+    for(;i + 4 <= size;i += 4) {
+        uint32_t r = flv_gen_rand(b);
+        memcpy(p + i, &r, 4);
+    }
+    for(;i < size;++i) p[i] = (uint8_t)flv_gen_rand(b);
+}
+
+static inline uint32_t flv_gen_jitter(flv_gen_buffer_t *b, const flv_gen_config_t *config, uint32_t size) {
+    if(config->jitter_percent > 0) {
+        uint32_t range = size * config->jitter_percent / 100;
+        if(range > 0) size = size - range + flv_gen_rand(b) % (2 * range + 1);
+    }
+    if(config->max_tag_size > 0 && size > config->max_tag_size) size = config->max_tag_size;
+    return size;
+}
+
+static inline uint8_t* flv_gen_amf_number(uint8_t *p, const char *key, double value) {
+    uint16_t len = (uint16_t)strlen(key);
+    uint64_t bits;
+    p[0] = (uint8_t)(len >> 8); p[1] = (uint8_t)len;
+    memcpy(p + 2, key, len);
+    p += 2 + len;
+    *p++ = 0;
+    memcpy(&bits, &value, 8);
+    flv_gen_be(p, (uint32_t)(bits >> 32), 4);
+    flv_gen_be(p + 4, (uint32_t)bits, 4);
+    return p + 8;
+}
+
+static const uint8_t flv_gen_avc_sequence_header[] = {
+    0x17, 0x00, 0x00, 0x00, 0x00, 0x01, 0x64, 0x00, 0x28, 0xff, 0xe1, 0x00, 0x1a, 0x67, 0x64, 0x00,
+    0x1f, 0xac, 0xd9, 0x40, 0x50, 0x05, 0xbb, 0x01, 0x10, 0x00, 0x00, 0x03, 0x00, 0x10, 0x00, 0x00,
+    0x03, 0x03, 0x20, 0xf1, 0x83, 0x19, 0x60, 0x01, 0x00, 0x05, 0x68, 0xeb, 0xec, 0xb2, 0x2c
+};
+static const uint8_t flv_gen_aac_sequence_header[] = { 0xaf, 0x00, 0x12, 0x10 };
+
+/*
+ h264 (one length prefixed nal per frame) + aac, interleaved by timestamp.
+ returns a malloc'ed buffer, NULL on failure
+ */
+static inline uint8_t* flv_gen_stream(const flv_gen_config_t *config, flv_gen_info_t *info) {
+    flv_gen_buffer_t b;
+    flv_gen_info_t stat;
+    uint8_t *p;
+    int has_video = config->video_kbps > 0 && config->fps > 0;
+    int has_audio = config->audio_kbps > 0;
+    uint32_t frames = has_video ? config->seconds * config->fps : 0;
+    uint32_t audio_frames = has_audio ? (uint32_t)((uint64_t)config->seconds * 44100 / 1024) : 0;
+    uint32_t gop = config->gop > 0 ? config->gop : 1;
+    uint32_t key_ratio = config->key_ratio > 0 ? config->key_ratio : 1;
+    uint32_t v = 0, a = 0;
+    /*
+     一个gop的字节数按key_ratio分给关键帧和其他帧
+     */
+    uint64_t gop_bytes = has_video ? (uint64_t)config->video_kbps * 125 * gop / config->fps : 0;
+    uint32_t inter_size = (uint32_t)(gop_bytes / (gop - 1 + key_ratio));
+    uint32_t audio_size = has_audio ? (uint32_t)((uint64_t)config->audio_kbps * 125 * 1024 / 44100) : 0;
+
+    memset(&b, 0, sizeof(b));
+    memset(&stat, 0, sizeof(stat));
+    b.seed = config->seed ? config->seed : 1;
+
+    p = flv_gen_reserve(&b, 13);
+    if(!p) return NULL;
+    memcpy(p, "FLV\x01\x00\x00\x00\x00\x09\x00\x00\x00\x00", 13);
+    p[4] = (uint8_t)((has_audio ? 4 : 0) | (has_video ? 1 : 0));
+    b.size += 13;
+
+    if(config->metadata) {
+        uint8_t script[512], *s = script;
+        *s++ = 2; *s++ = 0; *s++ = 10; memcpy(s, "onMetaData", 10); s += 10;
+        *s++ = 8; flv_gen_be(s, 6, 4); s += 4;
+        s = flv_gen_amf_number(s, "duration", config->seconds);
+        s = flv_gen_amf_number(s, "width", has_video ? 1280 : 0);
+        s = flv_gen_amf_number(s, "height", has_video ? 720 : 0);
+        s = flv_gen_amf_number(s, "framerate", config->fps);
+        s = flv_gen_amf_number(s, "videodatarate", config->video_kbps);
+        s = flv_gen_amf_number(s, "audiodatarate", config->audio_kbps);
+        *s++ = 0; *s++ = 0; *s++ = 9;
+        p = flv_gen_tag(&b, 18, 0, (uint32_t)(s - script));
+        if(!p) goto fail;
+        memcpy(p, script, (size_t)(s - script));
+        stat.script_tags++;
+    }
+    if(has_video) {
+        p = flv_gen_tag(&b, 9, 0, sizeof(flv_gen_avc_sequence_header));
+        if(!p) goto fail;
+        memcpy(p, flv_gen_avc_sequence_header, sizeof(flv_gen_avc_sequence_header));
+        stat.video_tags++;
+    }
+    if(has_audio) {
+        p = flv_gen_tag(&b, 8, 0, sizeof(flv_gen_aac_sequence_header));
+        if(!p) goto fail;
+        memcpy(p, flv_gen_aac_sequence_header, sizeof(flv_gen_aac_sequence_header));
+        stat.audio_tags++;
+    }
+
+    while(v < frames || a < audio_frames) {
+        uint32_t vts = v < frames ? (uint32_t)((uint64_t)v * 1000 / config->fps) : UINT32_MAX;
+        uint32_t ats = a < audio_frames ? (uint32_t)((uint64_t)a * 1024 * 1000 / 44100) : UINT32_MAX;
+        if(vts <= ats) {
+            int key = v % gop == 0;
+            uint32_t nal = flv_gen_jitter(&b, config, key ? inter_size * key_ratio : inter_size);
+            if(nal < 2) nal = 2;
+            p = flv_gen_tag(&b, 9, vts, 9 + nal);
+            if(!p) goto fail;
+            p[0] = key ? 0x17 : 0x27;
+            p[1] = 1;
+            p[2] = p[3] = p[4] = 0;
+            flv_gen_be(p + 5, nal, 4);
+            p[9] = key ? 0x65 : 0x41;
+            flv_gen_random(&b, p + 10, nal - 1);
+            stat.video_tags++;
+            stat.keyframes += key;
+            ++v;
+        } else {
+            uint32_t size = flv_gen_jitter(&b, config, audio_size);
+            if(size < 1) size = 1;
+            p = flv_gen_tag(&b, 8, ats, 2 + size);
+            if(!p) goto fail;
+            p[0] = 0xaf;
+            p[1] = 1;
+            flv_gen_random(&b, p + 2, size);
+            stat.audio_tags++;
+            ++a;
+        }
+    }
+    stat.size = b.size;
+    if(info) *info = stat;
+    return b.data;
+fail:
+    free(b.data);
+    return NULL;
+}
+
+#endif /* flv_gen_h */
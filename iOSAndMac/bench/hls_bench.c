@@ -0,0 +1,800 @@
+//
+//  hls_bench.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+//  time to first frame and live latency of the native hls path
+//  (hls_scheduler + ts demuxer) against a local static http server
+//
+//  D=../VoodooLivePlayer/pipeline/demuxer H=../VoodooLivePlayer/pipeline/loader/hls
+//  cc -O2 -pthread -I$D/base -I$D/ts -I$H hls_bench.c $H/hls_playlist.c $H/hls_scheduler.c
+//     $D/ts/ts.c $D/base/packet_pool.c $D/base/video_sps.c $D/base/demuxer_trace.c
+//     $D/base/gop_cache.c $D/base/nal_format.c -o hls_bench
+//
+//  ./hls_bench gen <dir> [seconds] [part_ms]      live playlist + segments + parts, in real time
+//  (cd <dir> && python3 -m http.server 8080)
+//  ./hls_bench play http://127.0.0.1:8080/live.m3u8 [seconds] [low_latency 0|1] [prefetch]
+//
+//  gen writes 2 s segments of 30 fps h264 + aac with EXT-X-PROGRAM-DATE-TIME,
+//  EXT-X-PART every part_ms (default 500) and a keyframe every second.
+//  no CAN-BLOCK-RELOAD or PRELOAD-HINT, a static server can not hold requests.
+//  play reports the first keyframe out of the demuxer after start, and how far
+//  behind the generator's wall clock each delivered piece ends.
+//
+//  ./hls_bench ll [seconds] [part_ms] [prefetch]
+//
+//  ll runs the scheduler offline against a simulated ll-hls server with
+//  CAN-BLOCK-RELOAD and EXT-X-PRELOAD-HINT, which holds blocking reloads and
+//  the hinted part until they are published. every other segment is closed
+//  only after the next one has started, so the hint taken at the end of the
+//  open segment rolls over into the next. checks in parts and in segments
+//  mode that every part is delivered exactly once, without discontinuity;
+//  exit 1 when not.
+//
+
+#include "hls_scheduler.h"
+#include "ts.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#define BENCH_FPS               30
+#define BENCH_SEGMENT_MS        2000
+#define BENCH_WINDOW            6
+#define BENCH_PART_WINDOW       2
+#define BENCH_VIDEO_PID         0x100
+#define BENCH_AUDIO_PID         0x101
+#define BENCH_PMT_PID           0x1000
+#define BENCH_MAX_FETCHES       256
+
+static int64_t wall_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int64_t mono_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ ---------------------------------------------------------------- gen
+ */
+typedef struct bench_buffer_s {
+    uint8_t *data;
+    uint32_t size;
+    uint32_t capacity;
+} bench_buffer_t;
+
+static uint8_t* bench_reserve(bench_buffer_t *b, uint32_t size) {
+    if(b->size + size > b->capacity) {
+        uint32_t capacity = b->capacity ? b->capacity : 1 << 16;
+        while(capacity < b->size + size) capacity *= 2;
+        b->data = (uint8_t*)realloc(b->data, capacity);
+        if(!b->data) exit(1);
+        b->capacity = capacity;
+    }
+    return b->data + b->size;
+}
+
+static uint32_t bench_seed = 1;
+static uint32_t bench_rand(void) {
+    bench_seed ^= bench_seed << 13; bench_seed ^= bench_seed >> 17; bench_seed ^= bench_seed << 5;
+    return bench_seed;
+}
+
+static uint32_t mpeg_crc32(const uint8_t *p, uint32_t size) {
+    uint32_t crc = 0xffffffff;
+    for(uint32_t i = 0;i < size;++i) {
+        crc ^= (uint32_t)p[i] << 24;
+        for(int k = 0;k < 8;++k) crc = crc & 0x80000000 ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+    }
+    return crc;
+}
+
+typedef struct bench_muxer_s {
+    uint8_t cc[0x2000];
+} bench_muxer_t;
+
+/*
+ one pes or section split over 188 byte packets, stuffing in the adaptation field
+ */
+static void ts_write(bench_muxer_t *m, bench_buffer_t *out, int pid, const uint8_t *data, uint32_t size, int random_access) {
+    int first = 1;
+    while(size > 0 || first) {
+        uint8_t *p = bench_reserve(out, 188);
+        uint32_t room = 184;
+        uint32_t adaptation = 0;
+        if(first && random_access) {
+            adaptation = 2;
+        }
+        if(size + adaptation < room) {
+            adaptation = room - size;
+        }
+        uint32_t n = room - adaptation;
+        p[0] = 0x47;
+        p[1] = (uint8_t)((first ? 0x40 : 0) | (pid >> 8));
+        p[2] = (uint8_t)pid;
+        p[3] = (uint8_t)((adaptation ? 0x30 : 0x10) | (m->cc[pid]++ & 0x0f));
+        if(adaptation) {
+            p[4] = (uint8_t)(adaptation - 1);
+            if(adaptation > 1) {
+                p[5] = first && random_access ? 0x40 : 0;
+                memset(p + 6, 0xff, adaptation - 2);
+            }
+        }
+        memcpy(p + 4 + adaptation, data, n);
+        out->size += 188;
+        data += n;
+        size -= n;
+        first = 0;
+    }
+}
+
+static void ts_write_tables(bench_muxer_t *m, bench_buffer_t *out) {
+    uint8_t pat[] = { 0, 0x00, 0xb0, 13, 0, 1, 0xc1, 0, 0, 0, 1, 0xe0 | (BENCH_PMT_PID >> 8), BENCH_PMT_PID & 0xff, 0, 0, 0, 0 };
+    uint32_t crc = mpeg_crc32(pat + 1, 12);
+    pat[13] = crc >> 24; pat[14] = crc >> 16; pat[15] = crc >> 8; pat[16] = crc;
+    ts_write(m, out, 0, pat, sizeof(pat), 0);
+    uint8_t pmt[] = { 0, 0x02, 0xb0, 23, 0, 1, 0xc1, 0, 0, 0xe0 | (BENCH_VIDEO_PID >> 8), BENCH_VIDEO_PID & 0xff, 0xf0, 0,
+        0x1b, 0xe0 | (BENCH_VIDEO_PID >> 8), BENCH_VIDEO_PID & 0xff, 0xf0, 0,
+        0x0f, 0xe0 | (BENCH_AUDIO_PID >> 8), BENCH_AUDIO_PID & 0xff, 0xf0, 0, 0, 0, 0, 0 };
+    crc = mpeg_crc32(pmt + 1, 22);
+    pmt[23] = crc >> 24; pmt[24] = crc >> 16; pmt[25] = crc >> 8; pmt[26] = crc;
+    ts_write(m, out, BENCH_PMT_PID, pmt, sizeof(pmt), 0);
+}
+
+static uint8_t* pes_header(uint8_t *p, int stream_id, uint32_t payload, int64_t pts90k) {
+    uint32_t length = stream_id == 0xe0 ? 0 : payload + 8;
+    p[0] = 0; p[1] = 0; p[2] = 1; p[3] = (uint8_t)stream_id;
+    p[4] = (uint8_t)(length >> 8); p[5] = (uint8_t)length;
+    p[6] = 0x80; p[7] = 0x80; p[8] = 5;
+    p[9] = (uint8_t)(0x21 | ((pts90k >> 29) & 0x0e));
+    p[10] = (uint8_t)(pts90k >> 22);
+    p[11] = (uint8_t)(0x01 | ((pts90k >> 14) & 0xfe));
+    p[12] = (uint8_t)(pts90k >> 7);
+    p[13] = (uint8_t)(0x01 | ((pts90k << 1) & 0xfe));
+    return p + 14;
+}
+
+/*
+ random slice bytes without zero, so no start code emulation
+ */
+static void fill_nonzero(uint8_t *p, uint32_t size) {
+    for(uint32_t i = 0;i < size;++i) p[i] = (uint8_t)(bench_rand() | 1);
+}
+
+static const uint8_t bench_sps_pps[] = {
+    0, 0, 0, 1, 0x67, 0x64, 0x00, 0x1f, 0xac, 0xd9, 0x40, 0x50, 0x05, 0xbb, 0x01, 0x10, 0x00, 0x00, 0x03, 0x00,
+    0x10, 0x00, 0x00, 0x03, 0x03, 0x20, 0xf1, 0x83, 0x19, 0x60,
+    0, 0, 0, 1, 0x68, 0xeb, 0xec, 0xb2, 0x2c
+};
+
+static void ts_write_video(bench_muxer_t *m, bench_buffer_t *out, int64_t pts_ms, int key) {
+    static uint8_t pes[256 * 1024];
+    uint32_t slice = key ? 60000 : 8000 + bench_rand() % 4000;
+    uint32_t size = (key ? sizeof(bench_sps_pps) : 0) + 5 + slice;
+    uint8_t *p = pes_header(pes, 0xe0, size, pts_ms * 90);
+    if(key) {
+        memcpy(p, bench_sps_pps, sizeof(bench_sps_pps));
+        p += sizeof(bench_sps_pps);
+    }
+    p[0] = 0; p[1] = 0; p[2] = 0; p[3] = 1; p[4] = key ? 0x65 : 0x41;
+    fill_nonzero(p + 5, slice);
+    ts_write(m, out, BENCH_VIDEO_PID, pes, 14 + size, key);
+}
+
+static void ts_write_audio(bench_muxer_t *m, bench_buffer_t *out, int64_t pts_ms) {
+    uint8_t pes[14 + 7 + 400];
+    uint32_t frame = 7 + 360;
+    uint8_t *p = pes_header(pes, 0xc0, frame, pts_ms * 90);
+    /*
+     adts aac lc 44.1k stereo
+     */
+    p[0] = 0xff; p[1] = 0xf1; p[2] = 0x50; p[3] = (uint8_t)(0x80 | (frame >> 11));
+    p[4] = (uint8_t)(frame >> 3); p[5] = (uint8_t)(((frame & 7) << 5) | 0x1f); p[6] = 0xfc;
+    fill_nonzero(p + 7, frame - 7);
+    ts_write(m, out, BENCH_AUDIO_PID, pes, 14 + frame, 0);
+}
+
+static void format_date(int64_t ms, char *out, size_t capacity) {
+    time_t seconds = (time_t)(ms / 1000);
+    struct tm tm;
+    gmtime_r(&seconds, &tm);
+    snprintf(out, capacity, "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+             tm.tm_hour, tm.tm_min, tm.tm_sec, (int)(ms % 1000));
+}
+
+static void write_file(const char *dir, const char *name, const void *data, size_t size) {
+    char path[1024], tmp[1024];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    snprintf(tmp, sizeof(tmp), "%s/.%s.tmp", dir, name);
+    FILE *f = fopen(tmp, "wb");
+    if(!f) {
+        fprintf(stderr, "open %s: %s\n", tmp, strerror(errno));
+        exit(1);
+    }
+    fwrite(data, 1, size, f);
+    fclose(f);
+    rename(tmp, path);
+}
+
+static int gen(const char *dir, int seconds, int part_ms) {
+    int parts_per_segment = BENCH_SEGMENT_MS / part_ms;
+    int64_t start = wall_ms();
+    int64_t video_ms = 0, audio_ms = 0;
+    uint32_t frame = 0, audio_index = 0;
+    bench_muxer_t muxer;
+    bench_buffer_t segment = { 0 }, part = { 0 };
+    char name[256];
+    memset(&muxer, 0, sizeof(muxer));
+    mkdir(dir, 0755);
+    if(part_ms <= 0 || BENCH_SEGMENT_MS % part_ms != 0) {
+        fprintf(stderr, "part_ms must divide %d\n", BENCH_SEGMENT_MS);
+        return 1;
+    }
+
+    for(int sequence = 0;(int64_t)sequence * BENCH_SEGMENT_MS < (int64_t)seconds * 1000;++sequence) {
+        segment.size = 0;
+        for(int k = 0;k < parts_per_segment;++k) {
+            int64_t end = (int64_t)sequence * BENCH_SEGMENT_MS + (int64_t)(k + 1) * part_ms;
+            part.size = 0;
+            while(video_ms < end) {
+                int key = frame % BENCH_FPS == 0;
+                if(key) {
+                    ts_write_tables(&muxer, &part);
+                }
+                ts_write_video(&muxer, &part, video_ms, key);
+                while(audio_ms <= video_ms && audio_ms < end) {
+                    ts_write_audio(&muxer, &part, audio_ms);
+                    audio_ms = (int64_t)(++audio_index) * 1024 * 1000 / 44100;
+                }
+                video_ms = (int64_t)(++frame) * 1000 / BENCH_FPS;
+            }
+            while(audio_ms < end) {
+                ts_write_audio(&muxer, &part, audio_ms);
+                audio_ms = (int64_t)(++audio_index) * 1024 * 1000 / 44100;
+            }
+            /*
+             a part is published when its last frame would have been captured
+             */
+            int64_t wait = start + end - wall_ms();
+            if(wait > 0) usleep((useconds_t)wait * 1000);
+
+            snprintf(name, sizeof(name), "seg%d.%d.ts", sequence, k);
+            write_file(dir, name, part.data, part.size);
+            memcpy(bench_reserve(&segment, part.size), part.data, part.size);
+            segment.size += part.size;
+            if(k == parts_per_segment - 1) {
+                snprintf(name, sizeof(name), "seg%d.ts", sequence);
+                write_file(dir, name, segment.data, segment.size);
+            }
+
+            /*
+             playlist: complete segments in the window, parts for the last ones
+             */
+            int first = sequence - BENCH_WINDOW + 1 > 0 ? sequence - BENCH_WINDOW + 1 : 0;
+            int complete = k == parts_per_segment - 1;
+            char playlist[16 * 1024], date[64];
+            int o = snprintf(playlist, sizeof(playlist),
+                             "#EXTM3U\n#EXT-X-VERSION:6\n#EXT-X-TARGETDURATION:%d\n#EXT-X-PART-INF:PART-TARGET=%.3f\n"
+                             "#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=%.3f\n#EXT-X-MEDIA-SEQUENCE:%d\n",
+                             BENCH_SEGMENT_MS / 1000, part_ms / 1000.0, 3 * part_ms / 1000.0, first);
+            for(int s = first;s <= sequence;++s) {
+                format_date(start + (int64_t)s * BENCH_SEGMENT_MS, date, sizeof(date));
+                o += snprintf(playlist + o, sizeof(playlist) - o, "#EXT-X-PROGRAM-DATE-TIME:%s\n", date);
+                int last = s == sequence ? k : parts_per_segment - 1;
+                if(s > sequence - BENCH_PART_WINDOW) {
+                    for(int q = 0;q <= last;++q) {
+                        o += snprintf(playlist + o, sizeof(playlist) - o, "#EXT-X-PART:DURATION=%.3f,URI=\"seg%d.%d.ts\"%s\n",
+                                      part_ms / 1000.0, s, q, (q * part_ms) % 1000 == 0 ? ",INDEPENDENT=YES" : "");
+                    }
+                }
+                if(s < sequence || complete) {
+                    o += snprintf(playlist + o, sizeof(playlist) - o, "#EXTINF:%.3f,\nseg%d.ts\n", BENCH_SEGMENT_MS / 1000.0, s);
+                }
+            }
+            write_file(dir, "live.m3u8", playlist, (size_t)o);
+
+            int stale = sequence - BENCH_WINDOW - 2;
+            if(stale >= 0 && k == 0) {
+                char path[1024];
+                snprintf(path, sizeof(path), "%s/seg%d.ts", dir, stale);
+                unlink(path);
+                for(int q = 0;q < parts_per_segment;++q) {
+                    snprintf(path, sizeof(path), "%s/seg%d.%d.ts", dir, stale, q);
+                    unlink(path);
+                }
+            }
+        }
+        printf("segment %d %u bytes\n", sequence, segment.size);
+        fflush(stdout);
+    }
+    free(segment.data);
+    free(part.data);
+    return 0;
+}
+
+/*
+ ---------------------------------------------------------------- play
+ */
+typedef struct fetch_s {
+    uint32_t id;
+    int type;
+    char host[256];
+    char port[16];
+    char path[HLS_MAX_URI_SIZE + 128];
+    int ok;
+    int64_t end_ms;                 /*  wall clock end of the data, 0 unknown   */
+    bench_buffer_t body;
+    struct fetch_s *next;
+} fetch_t;
+
+static pthread_mutex_t done_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static fetch_t *done_list = NULL;
+
+/*
+ http/1.0 GET, the body is everything after the headers
+ */
+static void* fetch_thread(void *arg) {
+    fetch_t *f = (fetch_t*)arg;
+    struct addrinfo hints, *ai = NULL;
+    int fd = -1;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(f->host, f->port, &hints, &ai) == 0) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if(fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(ai);
+    }
+    if(fd >= 0) {
+        char request[HLS_MAX_URI_SIZE + 512];
+        int n = snprintf(request, sizeof(request), "GET %s HTTP/1.0\r\nHost: %s\r\n\r\n", f->path, f->host);
+        if(send(fd, request, (size_t)n, 0) == n) {
+            for(;;) {
+                uint8_t *p = bench_reserve(&f->body, 64 * 1024);
+                ssize_t r = recv(fd, p, 64 * 1024, 0);
+                if(r <= 0) break;
+                f->body.size += (uint32_t)r;
+            }
+        }
+        close(fd);
+        uint8_t *end = NULL;
+        for(uint32_t i = 0;i + 4 <= f->body.size;++i) {
+            if(memcmp(f->body.data + i, "\r\n\r\n", 4) == 0) {
+                end = f->body.data + i + 4;
+                break;
+            }
+        }
+        if(end && f->body.size > 12 && memcmp(f->body.data + 9, "200", 3) == 0) {
+            uint32_t header = (uint32_t)(end - f->body.data);
+            memmove(f->body.data, end, f->body.size - header);
+            f->body.size -= header;
+            f->ok = 1;
+        }
+    }
+    pthread_mutex_lock(&done_mutex);
+    f->next = done_list;
+    done_list = f;
+    pthread_cond_signal(&done_cond);
+    pthread_mutex_unlock(&done_mutex);
+    return NULL;
+}
+
+static int split_url(const char *url, fetch_t *f) {
+    const char *p = strstr(url, "://");
+    if(!p || strncmp(url, "http", 4) != 0) return -1;
+    p += 3;
+    const char *slash = strchr(p, '/');
+    if(!slash) slash = p + strlen(p);
+    const char *colon = memchr(p, ':', (size_t)(slash - p));
+    const char *host_end = colon ? colon : slash;
+    snprintf(f->host, sizeof(f->host), "%.*s", (int)(host_end - p), p);
+    if(colon) {
+        snprintf(f->port, sizeof(f->port), "%.*s", (int)(slash - colon - 1), colon + 1);
+    } else {
+        snprintf(f->port, sizeof(f->port), "80");
+    }
+    snprintf(f->path, sizeof(f->path), "%s", *slash ? slash : "/");
+    return 0;
+}
+
+typedef struct player_s {
+    int64_t start;
+    int64_t first_frame;
+    uint64_t video_packets;
+    uint64_t audio_packets;
+} player_t;
+
+static void on_data(void* userdata, int type, void* data, int size, int64_t ts[], uint32_t flag) {
+    player_t *player = (player_t*)userdata;
+    if(type == VOODOO_DATA_TYPE_VIDEO_PACKET) {
+        if(player->first_frame == 0 && (flag & VOODOO_VIDEO_PACKET_FLAG_IS_KEY_FRAME)) {
+            player->first_frame = mono_ms();
+        }
+        player->video_packets++;
+    } else if(type == VOODOO_DATA_TYPE_AUDIO_PACKET) {
+        player->audio_packets++;
+    }
+}
+
+static int play(const char *url, int seconds, int low_latency, int prefetch) {
+    hls_scheduler_config_t config;
+    player_t player;
+    fetch_t *ready[1024];
+    int ready_count = 0;
+    int64_t latency_sum = 0, latency_min = INT64_MAX, latency_max = 0, latency_last = 0, latency_count = 0;
+    memset(&config, 0, sizeof(config));
+    memset(&player, 0, sizeof(player));
+    config.low_latency = low_latency;
+    config.prefetch_count = (uint32_t)prefetch;
+    hls_scheduler_t *scheduler = hls_scheduler_create(&config);
+    void *demuxer = ts_demuxer_init(&player, on_data);
+    if(!scheduler || !demuxer) return 1;
+
+    player.start = mono_ms();
+    while(mono_ms() - player.start < (int64_t)seconds * 1000 && !hls_scheduler_finished(scheduler)) {
+        hls_request_t req;
+        while(hls_scheduler_next_request(scheduler, mono_ms(), &req)) {
+            fetch_t *f = (fetch_t*)calloc(1, sizeof(fetch_t));
+            char resolved[HLS_MAX_URI_SIZE + 64];
+            f->id = req.id;
+            f->type = req.type;
+            if(req.program_date_time_ms != HLS_NO_DATE) {
+                f->end_ms = req.program_date_time_ms + req.duration_ms;
+            }
+            if(req.type == HLS_REQUEST_PLAYLIST) {
+                snprintf(resolved, sizeof(resolved), "%s%s%s", url, req.query[0] ? "?" : "", req.query);
+            } else if(hls_resolve_uri(url, req.uri, resolved, sizeof(resolved)) < 0) {
+                resolved[0] = 0;
+            }
+            pthread_t thread;
+            if(split_url(resolved, f) != 0 || pthread_create(&thread, NULL, fetch_thread, f) != 0) {
+                f->ok = 0;
+                pthread_mutex_lock(&done_mutex);
+                f->next = done_list;
+                done_list = f;
+                pthread_mutex_unlock(&done_mutex);
+            } else {
+                pthread_detach(thread);
+            }
+        }
+
+        pthread_mutex_lock(&done_mutex);
+        if(!done_list) {
+            int64_t wakeup = hls_scheduler_next_wakeup(scheduler);
+            int64_t wait = wakeup == INT64_MAX ? 100 : wakeup - mono_ms();
+            if(wait > 100) wait = 100;
+            if(wait > 0) {
+                struct timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_nsec += (long)(wait % 1000) * 1000000;
+                deadline.tv_sec += wait / 1000 + deadline.tv_nsec / 1000000000;
+                deadline.tv_nsec %= 1000000000;
+                pthread_cond_timedwait(&done_cond, &done_mutex, &deadline);
+            }
+        }
+        fetch_t *done = done_list;
+        done_list = NULL;
+        pthread_mutex_unlock(&done_mutex);
+
+        while(done) {
+            fetch_t *f = done;
+            done = f->next;
+            if(f->type == HLS_REQUEST_PLAYLIST) {
+                hls_playlist_t *playlist = f->ok ? hls_playlist_parse(f->body.data, f->body.size) : NULL;
+                hls_scheduler_playlist_loaded(scheduler, f->id, playlist, mono_ms());
+                free(f->body.data);
+                free(f);
+                continue;
+            }
+            hls_scheduler_media_loaded(scheduler, f->id, f->ok);
+            if(f->ok && ready_count < 1024) {
+                ready[ready_count++] = f;
+            } else {
+                free(f->body.data);
+                free(f);
+            }
+        }
+
+        uint32_t id;
+        int discontinuity;
+        while(hls_scheduler_pop_ready(scheduler, &id, &discontinuity)) {
+            for(int i = 0;i < ready_count;++i) {
+                if(ready[i]->id != id) continue;
+                fetch_t *f = ready[i];
+                ready[i] = ready[--ready_count];
+                ts_demuxer_flush(demuxer);
+                if(discontinuity) ts_demuxer_reset(demuxer);
+                ts_demuxer_feed(demuxer, f->body.data, (int)f->body.size);
+                /*
+                 gen stamps the wall clock, so the end of the piece just
+                 delivered against now is the distance to the live edge
+                 */
+                if(f->end_ms > 0 && player.first_frame > 0) {
+                    int64_t latency = wall_ms() - f->end_ms;
+                    latency_sum += latency;
+                    if(latency < latency_min) latency_min = latency;
+                    if(latency > latency_max) latency_max = latency;
+                    latency_last = latency;
+                    latency_count++;
+                }
+                free(f->body.data);
+                free(f);
+                break;
+            }
+        }
+    }
+
+    hls_scheduler_stats_t stats;
+    hls_scheduler_get_stats(scheduler, &stats);
+    printf("mode            %s, prefetch %d\n", low_latency ? "parts" : "segments", prefetch);
+    if(player.first_frame > 0) {
+        printf("first keyframe  %lld ms\n", (long long)(player.first_frame - player.start));
+    } else {
+        printf("first keyframe  none\n");
+    }
+    if(latency_count > 0) {
+        printf("latency         avg %lld ms, min %lld, max %lld, last %lld over %lld pieces\n", (long long)(latency_sum / latency_count),
+               (long long)latency_min, (long long)latency_max, (long long)latency_last, (long long)latency_count);
+    }
+    printf("packets         video %llu, audio %llu\n", (unsigned long long)player.video_packets, (unsigned long long)player.audio_packets);
+    printf("requests        playlists %llu (blocking %llu), segments %llu, parts %llu, retries %llu, skipped %llu, max in flight %u\n",
+           (unsigned long long)stats.playlist_loads, (unsigned long long)stats.blocking_reloads, (unsigned long long)stats.segments,
+           (unsigned long long)stats.parts, (unsigned long long)stats.retries, (unsigned long long)stats.skipped, stats.max_in_flight);
+    for(int i = 0;i < ready_count;++i) {
+        free(ready[i]->body.data);
+        free(ready[i]);
+    }
+    hls_scheduler_destroy(scheduler);
+    ts_demuxer_fint(demuxer);
+    return 0;
+}
+
+/*
+ ---------------------------------------------------------------- ll
+ */
+
+/*
+ an ll-hls server on a virtual clock: part n is published at (n + 1) * part_ms,
+ parts are named by that global index so the preload hint stays valid across
+ a segment boundary. even segments are closed with their last part, odd ones
+ only when the first part of the next segment is out, like a packager that
+ waits for the next keyframe: the hint is then listed after the open segment
+ but turns out to be part 0 of the next one.
+ */
+typedef struct ll_server_s {
+    int part_ms;
+    int parts_per_segment;
+    int rtt_ms;
+} ll_server_t;
+
+static int64_t ll_part_time(const ll_server_t *s, int64_t part) {
+    return (part + 1) * s->part_ms;
+}
+
+static int64_t ll_close_time(const ll_server_t *s, int64_t sequence) {
+    int64_t last = (sequence + 1) * s->parts_per_segment - 1;
+    return ll_part_time(s, sequence % 2 ? last + 1 : last);
+}
+
+static int ll_playlist(const ll_server_t *s, int64_t now, char *out, size_t capacity) {
+    int64_t published = now / s->part_ms;
+    int64_t current = (published - 1) / s->parts_per_segment;
+    int64_t first = current - BENCH_WINDOW + 1 > 0 ? current - BENCH_WINDOW + 1 : 0;
+    int o = snprintf(out, capacity,
+                     "#EXTM3U\n#EXT-X-VERSION:6\n#EXT-X-TARGETDURATION:%d\n#EXT-X-PART-INF:PART-TARGET=%.3f\n"
+                     "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=%.3f\n#EXT-X-MEDIA-SEQUENCE:%lld\n",
+                     s->parts_per_segment * s->part_ms / 1000 + 1, s->part_ms / 1000.0, 3 * s->part_ms / 1000.0, (long long)first);
+    for(int64_t q = first;q <= current;++q) {
+        if(q > current - BENCH_PART_WINDOW) {
+            for(int64_t n = q * s->parts_per_segment;n < (q + 1) * s->parts_per_segment && n < published;++n) {
+                o += snprintf(out + o, capacity - o, "#EXT-X-PART:DURATION=%.3f,URI=\"part%lld.ts\"%s\n", s->part_ms / 1000.0,
+                              (long long)n, n % s->parts_per_segment == 0 ? ",INDEPENDENT=YES" : "");
+            }
+        }
+        if(ll_close_time(s, q) <= now) {
+            o += snprintf(out + o, capacity - o, "#EXTINF:%.3f,\nseg%lld.ts\n", s->parts_per_segment * s->part_ms / 1000.0, (long long)q);
+        }
+    }
+    o += snprintf(out + o, capacity - o, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"part%lld.ts\"\n", (long long)published);
+    return o;
+}
+
+/*
+ when the server can answer: blocking reloads and the hint are held until
+ what they ask for is out
+ */
+static int64_t ll_playlist_ready(const ll_server_t *s, const char *query, int64_t now) {
+    long long msn = -1;
+    int part = -1;
+    if(!query[0] || sscanf(query, "_HLS_msn=%lld&_HLS_part=%d", &msn, &part) < 1) {
+        return now;
+    }
+    int64_t ready = part < 0 ? ll_close_time(s, msn) : ll_part_time(s, msn * s->parts_per_segment + part);
+    if(part >= s->parts_per_segment && ll_close_time(s, msn) < ready) {
+        ready = ll_close_time(s, msn);
+    }
+    return ready > now ? ready : now;
+}
+
+typedef struct ll_fetch_s {
+    uint32_t id;
+    int type;
+    int64_t done_ms;
+    int ok;
+    int64_t first_part;             /*  media: parts [first_part, end_part) */
+    int64_t end_part;
+    char playlist[16 * 1024];
+    int playlist_size;
+} ll_fetch_t;
+
+typedef struct ll_result_s {
+    uint64_t pieces;
+    uint64_t duplicated;            /*  parts delivered more than once  */
+    uint64_t missing;
+    uint64_t discontinuities;
+    uint64_t failed;
+    int64_t latency_sum;
+    int stuck;
+} ll_result_t;
+
+static int ll_run(const ll_server_t *s, int seconds, int low_latency, int prefetch, ll_result_t *result, hls_scheduler_stats_t *stats) {
+    static ll_fetch_t fetches[BENCH_MAX_FETCHES];
+    ll_fetch_t *done[BENCH_MAX_FETCHES];
+    int count = 0, done_count = 0;
+    int64_t next_part = -1;
+    hls_scheduler_config_t config;
+    memset(&config, 0, sizeof(config));
+    memset(result, 0, sizeof(ll_result_t));
+    config.low_latency = low_latency;
+    config.prefetch_count = (uint32_t)prefetch;
+    hls_scheduler_t *scheduler = hls_scheduler_create(&config);
+    if(!scheduler) return 1;
+
+    /*
+     start well into the stream, so the window is full
+     */
+    int64_t now = (int64_t)BENCH_WINDOW * s->parts_per_segment * s->part_ms + s->part_ms / 3;
+    int64_t end = now + (int64_t)seconds * 1000;
+    while(now < end) {
+        hls_request_t req;
+        while(count < BENCH_MAX_FETCHES && hls_scheduler_next_request(scheduler, now, &req)) {
+            ll_fetch_t *f = &fetches[count++];
+            long long index;
+            memset(f, 0, offsetof(ll_fetch_t, playlist));
+            f->id = req.id;
+            f->type = req.type;
+            f->ok = 1;
+            int64_t ready = now;
+            if(req.type == HLS_REQUEST_PLAYLIST) {
+                ready = ll_playlist_ready(s, req.query, now);
+                f->playlist_size = ll_playlist(s, ready, f->playlist, sizeof(f->playlist));
+            } else if(sscanf(req.uri, "part%lld.ts", &index) == 1) {
+                f->first_part = index;
+                f->end_part = index + 1;
+                ready = ll_part_time(s, index) > now ? ll_part_time(s, index) : now;
+            } else if(sscanf(req.uri, "seg%lld.ts", &index) == 1) {
+                f->first_part = index * s->parts_per_segment;
+                f->end_part = f->first_part + s->parts_per_segment;
+                ready = ll_close_time(s, index) > now ? ll_close_time(s, index) : now;
+            } else {
+                f->ok = 0;
+            }
+            f->done_ms = ready + s->rtt_ms;
+        }
+
+        int64_t next = hls_scheduler_next_wakeup(scheduler);
+        for(int i = 0;i < count;++i) {
+            if(fetches[i].done_ms < next) next = fetches[i].done_ms;
+        }
+        if(next == INT64_MAX) {
+            result->stuck = 1;
+            break;
+        }
+        now = next > now ? next : now;
+
+        for(int i = 0;i < count;) {
+            ll_fetch_t f = fetches[i];
+            if(f.done_ms > now) {
+                ++i;
+                continue;
+            }
+            fetches[i] = fetches[--count];
+            if(f.type == HLS_REQUEST_PLAYLIST) {
+                hls_playlist_t *playlist = hls_playlist_parse((const uint8_t*)f.playlist, (uint32_t)f.playlist_size);
+                hls_scheduler_playlist_loaded(scheduler, f.id, playlist, now);
+                continue;
+            }
+            hls_scheduler_media_loaded(scheduler, f.id, f.ok);
+            if(!f.ok) {
+                result->failed++;
+            } else if(done_count < BENCH_MAX_FETCHES) {
+                done[done_count] = (ll_fetch_t*)malloc(offsetof(ll_fetch_t, playlist));
+                memcpy(done[done_count++], &f, offsetof(ll_fetch_t, playlist));
+            }
+        }
+
+        uint32_t id;
+        int discontinuity;
+        while(hls_scheduler_pop_ready(scheduler, &id, &discontinuity)) {
+            for(int i = 0;i < done_count;++i) {
+                if(done[i]->id != id) continue;
+                ll_fetch_t *f = done[i];
+                done[i] = done[--done_count];
+                if(next_part >= 0) {
+                    if(f->first_part < next_part) result->duplicated += (f->end_part < next_part ? f->end_part : next_part) - f->first_part;
+                    if(f->first_part > next_part) result->missing += f->first_part - next_part;
+                    result->discontinuities += discontinuity != 0;
+                }
+                if(f->end_part > next_part) next_part = f->end_part;
+                result->latency_sum += now - ll_part_time(s, f->end_part - 1);
+                result->pieces++;
+                free(f);
+                break;
+            }
+        }
+    }
+    for(int i = 0;i < done_count;++i) free(done[i]);
+    hls_scheduler_get_stats(scheduler, stats);
+    hls_scheduler_destroy(scheduler);
+    return 0;
+}
+
+static int ll(int seconds, int part_ms, int prefetch) {
+    ll_server_t server;
+    int failures = 0;
+    if(part_ms <= 0 || BENCH_SEGMENT_MS % part_ms != 0) {
+        fprintf(stderr, "part_ms must divide %d\n", BENCH_SEGMENT_MS);
+        return 2;
+    }
+    server.part_ms = part_ms;
+    server.parts_per_segment = BENCH_SEGMENT_MS / part_ms;
+    server.rtt_ms = 20;
+    for(int low_latency = 1;low_latency >= 0;--low_latency) {
+        ll_result_t r;
+        hls_scheduler_stats_t stats;
+        ll_run(&server, seconds, low_latency, prefetch, &r, &stats);
+        int ok = !r.stuck && r.duplicated == 0 && r.missing == 0 && r.discontinuities == 0 && r.failed == 0 && r.pieces > 0;
+        printf("%-10s %s  %llu pieces (%llu parts, %llu segments), %llu duplicated, %llu missing, %llu discontinuities, %llu failed%s, "
+               "%llu playlists (%llu blocking), avg latency %lld ms\n",
+               low_latency ? "parts" : "segments", ok ? "ok  " : "FAIL", (unsigned long long)r.pieces,
+               (unsigned long long)stats.parts, (unsigned long long)stats.segments, (unsigned long long)r.duplicated,
+               (unsigned long long)r.missing, (unsigned long long)r.discontinuities, (unsigned long long)r.failed,
+               r.stuck ? ", stuck" : "", (unsigned long long)stats.playlist_loads, (unsigned long long)stats.blocking_reloads,
+               r.pieces ? (long long)(r.latency_sum / (int64_t)r.pieces) : 0ll);
+        failures += !ok;
+    }
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    if(argc >= 3 && strcmp(argv[1], "gen") == 0) {
+        return gen(argv[2], argc > 3 ? atoi(argv[3]) : 600, argc > 4 ? atoi(argv[4]) : 500);
+    }
+    if(argc >= 3 && strcmp(argv[1], "play") == 0) {
+        return play(argv[2], argc > 3 ? atoi(argv[3]) : 20, argc > 4 ? atoi(argv[4]) : 1, argc > 5 ? atoi(argv[5]) : 3);
+    }
+    if(argc >= 2 && strcmp(argv[1], "ll") == 0) {
+        return ll(argc > 2 ? atoi(argv[2]) : 120, argc > 3 ? atoi(argv[3]) : 500, argc > 4 ? atoi(argv[4]) : 3);
+    }
+    fprintf(stderr, "usage: %s gen <dir> [seconds] [part_ms]\n       %s play <url> [seconds] [low_latency] [prefetch]\n"
+            "       %s ll [seconds] [part_ms] [prefetch]\n", argv[0], argv[0], argv[0]);
+    return 1;
+}
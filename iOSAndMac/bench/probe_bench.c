@@ -0,0 +1,208 @@
+//
+//  probe_bench.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+//  stream info for a channel list: n streams probed side by side with
+//  flv_probe, against a full flv_demuxer run until it has delivered both
+//  sequence headers and the first video packet
+//
+//  D=../VoodooLivePlayer/pipeline/demuxer
+//  cc -O2 -I$D/base -I$D/flv probe_bench.c $D/flv/flv_probe.c $D/flv/flv.c
+//     $D/base/packet_pool.c $D/base/video_sps.c $D/base/demuxer_trace.c
+//     $D/base/gop_cache.c $D/base/nal_format.c -o probe_bench
+//
+//  ./probe_bench [-f file.flv] [-n streams] [-c chunk_bytes] [-v video_kbps]
+//
+//  chunks are fed round robin like concurrent downloads. memory is the
+//  peak held by the allocator over all streams at once.
+//
+
+#include "flv.h"
+#include "flv_probe.h"
+#include "flv_gen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+typedef struct bench_allocator_s {
+    uint64_t current;
+    uint64_t peak;
+} bench_allocator_t;
+
+typedef struct bench_demuxer_s {
+    int parameters;
+    int done;
+} bench_demuxer_t;
+
+static double cpu_seconds(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static void* bench_malloc(void* opaque, size_t size) {
+    bench_allocator_t *a = (bench_allocator_t*)opaque;
+    size_t *p = (size_t*)malloc(size + sizeof(size_t));
+    if(!p) return NULL;
+    *p = size;
+    a->current += size;
+    if(a->current > a->peak) a->peak = a->current;
+    return p + 1;
+}
+
+static void bench_free(void* opaque, void* ptr) {
+    bench_allocator_t *a = (bench_allocator_t*)opaque;
+    if(!ptr) return;
+    size_t *p = (size_t*)ptr - 1;
+    a->current -= *p;
+    free(p);
+}
+
+static void on_data(void* userdata, int type, void* data, int size, int64_t ts[], uint32_t flag) {
+    bench_demuxer_t *d = (bench_demuxer_t*)userdata;
+    if(type == VOODOO_DATA_TYPE_VIDEO_PARAMETERS || type == VOODOO_DATA_TYPE_AUDIO_PARAMETERS) {
+        ++d->parameters;
+    } else if(type == VOODOO_DATA_TYPE_VIDEO_PACKET && d->parameters >= 2) {
+        d->done = 1;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *file = NULL;
+    flv_gen_config_t gen;
+    int streams = 500;
+    uint32_t chunk = 16384;
+    uint8_t *stream = NULL;
+    uint32_t stream_size = 0;
+
+    flv_gen_default_config(&gen);
+    gen.seconds = 10;
+    int opt;
+    while((opt = getopt(argc, argv, "f:n:c:v:")) != -1) {
+        switch(opt) {
+            case 'f': file = optarg; break;
+            case 'n': streams = atoi(optarg); break;
+            case 'c': chunk = (uint32_t)atoi(optarg); break;
+            case 'v': gen.video_kbps = (uint32_t)atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-f file.flv] [-n streams] [-c chunk_bytes] [-v video_kbps]\n", argv[0]);
+                return 1;
+        }
+    }
+    if(streams < 1) streams = 1;
+    if(chunk < 1) chunk = 1;
+
+    if(file) {
+        FILE *f = fopen(file, "rb");
+        if(!f) {
+            perror(file);
+            return 1;
+        }
+        fseek(f, 0, SEEK_END);
+        stream_size = (uint32_t)ftell(f);
+        fseek(f, 0, SEEK_SET);
+        stream = (uint8_t*)malloc(stream_size);
+        if(!stream || fread(stream, 1, stream_size, f) != stream_size) {
+            fclose(f);
+            return 1;
+        }
+        fclose(f);
+    } else {
+        flv_gen_info_t info;
+        stream = flv_gen_stream(&gen, &info);
+        if(!stream) return 1;
+        stream_size = info.size;
+    }
+
+    bench_allocator_t allocator;
+    demuxer_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.malloc_fn = bench_malloc;
+    config.free_fn = bench_free;
+    config.allocator_opaque = &allocator;
+    uint32_t *offsets = (uint32_t*)calloc((size_t)streams, sizeof(uint32_t));
+
+    /*
+     probe
+     */
+    memset(&allocator, 0, sizeof(allocator));
+    flv_probe_t **probes = (flv_probe_t**)calloc((size_t)streams, sizeof(flv_probe_t*));
+    double cpu = cpu_seconds();
+    for(int i = 0;i < streams;++i) {
+        probes[i] = flv_probe_create(0, 0, &config);
+    }
+    uint64_t probe_bytes = 0;
+    for(int left = streams;left > 0;) {
+        left = 0;
+        for(int i = 0;i < streams;++i) {
+            if(!probes[i] || offsets[i] >= stream_size) continue;
+            uint32_t n = stream_size - offsets[i] < chunk ? stream_size - offsets[i] : chunk;
+            int ret = flv_probe_feed(probes[i], stream + offsets[i], n);
+            offsets[i] += n;
+            if(ret == FLV_PROBE_NEED_MORE && offsets[i] < stream_size) {
+                ++left;
+                continue;
+            }
+            probe_bytes += flv_probe_get_info(probes[i])->bytes_probed;
+            if(i == 0) {
+                const flv_probe_info_t *info = flv_probe_get_info(probes[i]);
+                printf("stream info     codec %d %dx%d %.2f fps, audio %d %d Hz %d ch, keyframe at %llu\n",
+                       info->video_codec_id, info->width, info->height, info->frame_rate,
+                       info->audio_format, info->sample_rate, info->channels, (unsigned long long)info->keyframe_offset);
+            }
+            flv_probe_destroy(probes[i]);
+            probes[i] = NULL;
+        }
+    }
+    double probe_cpu = cpu_seconds() - cpu;
+    uint64_t probe_peak = allocator.peak;
+
+    /*
+     full demuxer
+     */
+    memset(&allocator, 0, sizeof(allocator));
+    memset(offsets, 0, (size_t)streams * sizeof(uint32_t));
+    void **demuxers = (void**)calloc((size_t)streams, sizeof(void*));
+    bench_demuxer_t *states = (bench_demuxer_t*)calloc((size_t)streams, sizeof(bench_demuxer_t));
+    cpu = cpu_seconds();
+    for(int i = 0;i < streams;++i) {
+        demuxers[i] = flv_demuxer_init_with_config(&states[i], on_data, &config);
+    }
+    uint64_t demuxer_bytes = 0;
+    for(int left = streams;left > 0;) {
+        left = 0;
+        for(int i = 0;i < streams;++i) {
+            if(!demuxers[i]) continue;
+            uint32_t n = stream_size - offsets[i] < chunk ? stream_size - offsets[i] : chunk;
+            flv_demuxer_feed(demuxers[i], stream + offsets[i], (int)n);
+            offsets[i] += n;
+            if(!states[i].done && offsets[i] < stream_size) {
+                ++left;
+                continue;
+            }
+            demuxer_bytes += offsets[i];
+            flv_demuxer_fint(demuxers[i]);
+            demuxers[i] = NULL;
+        }
+    }
+    double demuxer_cpu = cpu_seconds() - cpu;
+    uint64_t demuxer_peak = allocator.peak;
+
+    printf("streams         %d, %u byte chunks, probe holds %u bytes\n", streams, chunk, flv_probe_memory_size());
+    printf("probe           %.1f us/stream, %.1f KB read/stream, %.1f KB peak/stream, %.2f MB peak\n",
+           probe_cpu * 1e6 / streams, probe_bytes / 1024.0 / streams, probe_peak / 1024.0 / streams, probe_peak / 1e6);
+    printf("demuxer         %.1f us/stream, %.1f KB read/stream, %.1f KB peak/stream, %.2f MB peak\n",
+           demuxer_cpu * 1e6 / streams, demuxer_bytes / 1024.0 / streams, demuxer_peak / 1024.0 / streams, demuxer_peak / 1e6);
+
+    free(states);
+    free(demuxers);
+    free(probes);
+    free(offsets);
+    free(stream);
+    return 0;
+}
@@ -0,0 +1,408 @@
+//
+//  queue_bench.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+//  per stage latency of loader -> demuxer -> decoder, once on one thread
+//  like a single serial queue, once on three threads joined by packet_queue
+//
+//  D=../VoodooLivePlayer/pipeline/demuxer
+//  cc -O2 -pthread -I$D/base -I$D/flv queue_bench.c $D/base/packet_queue.c $D/flv/flv.c
+//     $D/base/packet_pool.c $D/base/video_sps.c $D/base/demuxer_trace.c
+//     $D/base/gop_cache.c $D/base/nal_format.c -o queue_bench
+//
+//  ./queue_bench [-t seconds] [-v video_kbps] [-b burst_ms] [-x speed]
+//                [-d decode_us] [-k decode_us_per_kb] [-q capacity]
+//
+//  the stream arrives in bursts: everything of burst_ms media time at once,
+//  in 16 KB chunks, as after a stall on the network. -x plays it faster
+//  than real time. decoding is a busy wait of decode_us + decode_us_per_kb.
+//  end to end is from the arrival of the chunk that completed a packet to
+//  the end of its decode.
+//
+
+#include "flv.h"
+#include "packet_queue.h"
+#include "demuxer_trace.h"
+#include "flv_gen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#define CHUNK_SIZE          (16 * 1024)
+#define PACKET_BATCH        64
+#define END_OF_STREAM       (-1)
+#define LATE_NS             (1000000)
+
+typedef struct samples_s {
+    uint64_t *values;
+    uint32_t count;
+    uint32_t capacity;
+} samples_t;
+
+typedef struct stage_link_s {
+    packet_queue_t *queue;
+    sem_t wake;             /*  consumer idle -> producer posts     */
+    sem_t resume;           /*  producer throttled -> consumer posts */
+} stage_link_t;
+
+typedef struct bench_s {
+    const uint8_t *stream;
+    uint32_t size;
+    uint32_t seconds;
+    uint32_t burst_ms;
+    double speed;
+    uint32_t decode_us;
+    uint32_t decode_us_per_kb;
+    uint32_t capacity;
+
+    packet_pool_t *pool;
+    void *demuxer;
+    uint64_t start_ns;
+
+    stage_link_t chunks;    /*  loader -> demuxer   */
+    stage_link_t packets;   /*  demuxer -> decoder  */
+    /*
+     arrival time of every packet in the demuxer -> decoder queue, in queue
+     order. written before the push and read after the pop
+     */
+    uint64_t *origin;
+    uint32_t origin_mask;
+    uint32_t origin_head;
+    uint32_t origin_tail;
+
+    samples_t demux_ns;
+    samples_t decode_ns;
+    samples_t end_to_end_ns;
+    uint64_t late_chunks;
+} bench_t;
+
+static void samples_add(samples_t *s, uint64_t v) {
+    if(s->count == s->capacity) {
+        s->capacity = s->capacity ? s->capacity * 2 : 4096;
+        s->values = (uint64_t*)realloc(s->values, s->capacity * sizeof(uint64_t));
+    }
+    s->values[s->count++] = v;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t samples_percentile(samples_t *s, double p) {
+    if(s->count == 0) return 0;
+    uint32_t i = (uint32_t)(p * (s->count - 1) + 0.5);
+    return s->values[i];
+}
+
+static void samples_print(const char *name, samples_t *s) {
+    qsort(s->values, s->count, sizeof(uint64_t), compare_u64);
+    printf("  %-22s %9.3f %9.3f %9.3f %9.3f   %u\n", name, samples_percentile(s, 0.5) / 1e6, samples_percentile(s, 0.9) / 1e6,
+           samples_percentile(s, 0.99) / 1e6, s->count ? s->values[s->count - 1] / 1e6 : 0, s->count);
+}
+
+static void queue_print(const char *name, packet_queue_t *queue) {
+    packet_queue_stats_t stats;
+    packet_queue_get_stats(queue, &stats);
+    printf("  %-22s %9.3f %9.3f %9.3f %9.3f   %llu\n", name, packet_queue_wait_percentile_ns(&stats, 0.5) / 1e6,
+           packet_queue_wait_percentile_ns(&stats, 0.9) / 1e6, packet_queue_wait_percentile_ns(&stats, 0.99) / 1e6,
+           stats.wait_ns_max / 1e6, (unsigned long long)stats.popped);
+    printf("  %-22s depth max %u of %u, %llu throttles, %llu full, %llu wakeups\n", "", stats.max_depth, stats.capacity,
+           (unsigned long long)stats.throttles, (unsigned long long)stats.full, (unsigned long long)stats.wakeups);
+}
+
+static void sleep_until(uint64_t ns) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ns / 1000000000ULL);
+    ts.tv_nsec = (long)(ns % 1000000000ULL);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+/*
+ when the chunk at pos is on the wire: the bytes of a burst_ms window all
+ show up at its end
+ */
+static uint64_t arrival_ns(bench_t *b, uint32_t pos) {
+    double media_ms = (double)pos / b->size * b->seconds * 1000.0;
+    uint64_t burst = (uint64_t)(media_ms / b->burst_ms) + 1;
+    return b->start_ns + (uint64_t)(burst * b->burst_ms * 1e6 / b->speed);
+}
+
+static void decode(bench_t *b, demuxer_packet_t *packet, uint64_t origin) {
+    uint64_t start = demuxer_trace_now_ns();
+    uint64_t cost = ((uint64_t)b->decode_us + (uint64_t)b->decode_us_per_kb * packet->size / 1024) * 1000;
+    while(demuxer_trace_now_ns() - start < cost) {
+    }
+    uint64_t end = demuxer_trace_now_ns();
+    samples_add(&b->decode_ns, end - start);
+    samples_add(&b->end_to_end_ns, end - origin);
+}
+
+static void on_data(void* userdata, int type, void* data, int size, int64_t ts[], uint32_t flag) {
+}
+
+static int is_media(demuxer_packet_t *packet) {
+    return packet->type == VOODOO_DATA_TYPE_VIDEO_PACKET || packet->type == VOODOO_DATA_TYPE_AUDIO_PACKET;
+}
+
+/*
+ ------------------------------------------------------------------ serial
+ */
+static void run_serial(bench_t *b) {
+    demuxer_packet_t *batch[PACKET_BATCH];
+    for(uint32_t pos = 0;pos < b->size;pos += CHUNK_SIZE) {
+        uint32_t len = b->size - pos < CHUNK_SIZE ? b->size - pos : CHUNK_SIZE;
+        uint64_t arrival = arrival_ns(b, pos);
+        if(demuxer_trace_now_ns() < arrival) {
+            sleep_until(arrival);
+        } else if(demuxer_trace_now_ns() - arrival > LATE_NS) {
+            b->late_chunks++;
+        }
+        uint64_t start = demuxer_trace_now_ns();
+        flv_demuxer_feed(b->demuxer, b->stream + pos, (int)len);
+        int n;
+        int first = 1;
+        while((n = flv_demuxer_read_packets(b->demuxer, batch, PACKET_BATCH)) > 0) {
+            if(first) {
+                samples_add(&b->demux_ns, demuxer_trace_now_ns() - start);
+                first = 0;
+            }
+            for(int i = 0;i < n;++i) {
+                if(is_media(batch[i])) decode(b, batch[i], arrival);
+                demuxer_packet_release(batch[i]);
+            }
+        }
+        if(first) samples_add(&b->demux_ns, demuxer_trace_now_ns() - start);
+    }
+}
+
+/*
+ ------------------------------------------------------------------ staged
+ */
+static int link_push(stage_link_t *link, demuxer_packet_t *packet, int *throttled) {
+    int r;
+    while((r = packet_queue_push(link->queue, packet)) < 0) {
+        sem_wait(&link->resume);
+    }
+    if(r & PACKET_QUEUE_WAKE_CONSUMER) sem_post(&link->wake);
+    *throttled = (r & PACKET_QUEUE_THROTTLED) != 0;
+    return r;
+}
+
+/*
+ one packet, waits while idle. NULL never comes back, the end is a packet
+ */
+static demuxer_packet_t* link_pop(stage_link_t *link) {
+    demuxer_packet_t *packet;
+    for(;;) {
+        if(packet_queue_pop(link->queue, &packet, 1) == 1) {
+            if(packet_queue_resume_producer(link->queue)) sem_post(&link->resume);
+            return packet;
+        }
+        if(packet_queue_consumer_idle(link->queue)) sem_wait(&link->wake);
+    }
+}
+
+static void* loader_main(void *arg) {
+    bench_t *b = (bench_t*)arg;
+    int throttled = 0;
+    for(uint32_t pos = 0;pos < b->size;pos += CHUNK_SIZE) {
+        uint32_t len = b->size - pos < CHUNK_SIZE ? b->size - pos : CHUNK_SIZE;
+        uint64_t arrival = arrival_ns(b, pos);
+        if(throttled) {
+            sem_wait(&b->chunks.resume);
+        }
+        if(demuxer_trace_now_ns() < arrival) {
+            sleep_until(arrival);
+        } else if(demuxer_trace_now_ns() - arrival > LATE_NS) {
+            b->late_chunks++;
+        }
+        demuxer_packet_t *chunk = packet_pool_alloc(b->pool, len);
+        memcpy(chunk->data, b->stream + pos, len);
+        chunk->type = 0;
+        chunk->dts = (int64_t)arrival;
+        link_push(&b->chunks, chunk, &throttled);
+    }
+    demuxer_packet_t *end = packet_pool_alloc(b->pool, 0);
+    end->type = END_OF_STREAM;
+    link_push(&b->chunks, end, &throttled);
+    return NULL;
+}
+
+static void* demuxer_main(void *arg) {
+    bench_t *b = (bench_t*)arg;
+    demuxer_packet_t *batch[PACKET_BATCH];
+    int throttled = 0;
+    for(;;) {
+        if(throttled) {
+            sem_wait(&b->packets.resume);
+            throttled = 0;
+        }
+        demuxer_packet_t *chunk = link_pop(&b->chunks);
+        if(chunk->type == END_OF_STREAM) {
+            link_push(&b->packets, chunk, &throttled);
+            return NULL;
+        }
+        uint64_t arrival = (uint64_t)chunk->dts;
+        uint64_t start = demuxer_trace_now_ns();
+        flv_demuxer_feed(b->demuxer, chunk->data, (int)chunk->size);
+        demuxer_packet_release(chunk);
+        int n;
+        int first = 1;
+        while((n = flv_demuxer_read_packets(b->demuxer, batch, PACKET_BATCH)) > 0) {
+            if(first) {
+                samples_add(&b->demux_ns, demuxer_trace_now_ns() - start);
+                first = 0;
+            }
+            for(int i = 0;i < n;++i) {
+                if(!is_media(batch[i])) {
+                    demuxer_packet_release(batch[i]);
+                    continue;
+                }
+                b->origin[b->origin_head++ & b->origin_mask] = arrival;
+                link_push(&b->packets, batch[i], &throttled);
+            }
+        }
+        if(first) samples_add(&b->demux_ns, demuxer_trace_now_ns() - start);
+    }
+}
+
+static void* decoder_main(void *arg) {
+    bench_t *b = (bench_t*)arg;
+    for(;;) {
+        demuxer_packet_t *packet = link_pop(&b->packets);
+        if(packet->type == END_OF_STREAM) {
+            demuxer_packet_release(packet);
+            return NULL;
+        }
+        decode(b, packet, b->origin[b->origin_tail++ & b->origin_mask]);
+        demuxer_packet_release(packet);
+    }
+}
+
+static void link_init(stage_link_t *link, uint32_t capacity) {
+    link->queue = packet_queue_create(capacity, 0, NULL);
+    sem_init(&link->wake, 0, 0);
+    sem_init(&link->resume, 0, 0);
+}
+
+static void link_fini(stage_link_t *link) {
+    packet_queue_destroy(link->queue);
+    sem_destroy(&link->wake);
+    sem_destroy(&link->resume);
+}
+
+static void run_staged(bench_t *b) {
+    pthread_t loader, demuxer, decoder;
+    link_init(&b->chunks, b->capacity);
+    link_init(&b->packets, b->capacity);
+    packet_queue_stats_t stats;
+    packet_queue_get_stats(b->packets.queue, &stats);
+    /*
+     twice the queue, the slot is written before a push that may still find it full
+     */
+    b->origin_mask = stats.capacity * 2 - 1;
+    b->origin = (uint64_t*)calloc(stats.capacity * 2, sizeof(uint64_t));
+
+    pthread_create(&decoder, NULL, decoder_main, b);
+    pthread_create(&demuxer, NULL, demuxer_main, b);
+    pthread_create(&loader, NULL, loader_main, b);
+    pthread_join(loader, NULL);
+    pthread_join(demuxer, NULL);
+    pthread_join(decoder, NULL);
+}
+
+static void run(bench_t *b, int staged) {
+    memset(&b->demux_ns, 0, sizeof(samples_t));
+    memset(&b->decode_ns, 0, sizeof(samples_t));
+    memset(&b->end_to_end_ns, 0, sizeof(samples_t));
+    b->late_chunks = 0;
+    b->pool = packet_pool_create(0, NULL);
+    b->demuxer = flv_demuxer_init(NULL, on_data);
+    flv_demuxer_set_packet_pool(b->demuxer, b->pool, NULL);
+    b->start_ns = demuxer_trace_now_ns();
+
+    if(staged) {
+        run_staged(b);
+    } else {
+        run_serial(b);
+    }
+
+    printf("\n%s, %llu of %u chunks taken in over 1 ms late\n", staged ? "three threads, packet_queue between stages" : "one thread, like a single serial queue",
+           (unsigned long long)b->late_chunks, (b->size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    printf("  %-22s %9s %9s %9s %9s   %s\n", "ms", "p50", "p90", "p99", "max", "count");
+    if(staged) queue_print("loader -> demuxer wait", b->chunks.queue);
+    samples_print("demux per chunk", &b->demux_ns);
+    if(staged) queue_print("demuxer -> decoder wait", b->packets.queue);
+    samples_print("decode per packet", &b->decode_ns);
+    samples_print("end to end", &b->end_to_end_ns);
+
+    if(staged) {
+        link_fini(&b->chunks);
+        link_fini(&b->packets);
+        free(b->origin);
+        b->origin = NULL;
+        b->origin_head = b->origin_tail = 0;
+    }
+    free(b->demux_ns.values);
+    free(b->decode_ns.values);
+    free(b->end_to_end_ns.values);
+    flv_demuxer_fint(b->demuxer);
+    packet_pool_destroy(b->pool);
+}
+
+int main(int argc, char *argv[]) {
+    flv_gen_config_t gen;
+    flv_gen_info_t info;
+    bench_t b;
+
+    flv_gen_default_config(&gen);
+    gen.seconds = 20;
+    gen.video_kbps = 6000;
+    gen.fps = 30;
+    gen.gop = 60;
+    memset(&b, 0, sizeof(b));
+    b.burst_ms = 500;
+    b.speed = 2;
+    b.decode_us = 300;
+    b.decode_us_per_kb = 25;
+    b.capacity = 256;
+
+    int opt;
+    while((opt = getopt(argc, argv, "t:v:b:x:d:k:q:")) != -1) {
+        switch(opt) {
+            case 't': gen.seconds = (uint32_t)atoi(optarg); break;
+            case 'v': gen.video_kbps = (uint32_t)atoi(optarg); break;
+            case 'b': b.burst_ms = (uint32_t)atoi(optarg); break;
+            case 'x': b.speed = atof(optarg); break;
+            case 'd': b.decode_us = (uint32_t)atoi(optarg); break;
+            case 'k': b.decode_us_per_kb = (uint32_t)atoi(optarg); break;
+            case 'q': b.capacity = (uint32_t)atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-t seconds] [-v video_kbps] [-b burst_ms] [-x speed] [-d decode_us] [-k decode_us_per_kb] [-q capacity]\n", argv[0]);
+                return 1;
+        }
+    }
+    if(b.burst_ms == 0) b.burst_ms = 1;
+    if(b.speed <= 0) b.speed = 1;
+
+    uint8_t *stream = flv_gen_stream(&gen, &info);
+    if(!stream) return 1;
+    b.stream = stream;
+    b.size = info.size;
+    b.seconds = gen.seconds;
+    printf("%u s, %u kbps, %u bytes, bursts of %u ms at %.1fx, decode %u us + %u us/KB, queues of %u\n",
+           gen.seconds, gen.video_kbps, info.size, b.burst_ms, b.speed, b.decode_us, b.decode_us_per_kb, b.capacity);
+
+    run(&b, 0);
+    run(&b, 1);
+    free(stream);
+    return 0;
+}
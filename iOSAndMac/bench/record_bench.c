@@ -0,0 +1,340 @@
+//
+//  record_bench.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+//  cost of fmp4_recorder per stream: a stream is demuxed once into pooled
+//  packets, then pushed into n recorders writing side by side
+//
+//  D=../VoodooLivePlayer/pipeline/demuxer R=../VoodooLivePlayer/pipeline/recorder
+//  cc -O2 -pthread -I$D/base -I$D/flv -I$R record_bench.c $R/fmp4_recorder.c $D/flv/flv.c
+//     $D/base/packet_pool.c $D/base/video_sps.c $D/base/demuxer_trace.c
+//     $D/base/gop_cache.c $D/base/nal_format.c -o record_bench
+//
+//  ./record_bench [-f file.flv] [-t seconds] [-v video_kbps] [-n recorders]
+//                 [-g fragment_ms] [-s segment_ms] [-o dir] [-a]
+//
+//  without -f a 1080p-like 6 Mbps stream is generated. the figure that
+//  matters is streams per core: media seconds recorded per cpu second.
+//  files go to -o (default /tmp), point it at a real disk to include i/o.
+//  -a writes on the recorders' writer threads, cpu then includes them.
+//  first a check, exit 1 when it fails: the timestamps restart at a keyframe
+//  half way, the recording has to go on in a second file from decode time 0.
+//
+
+#include "flv.h"
+#include "fmp4_recorder.h"
+#include "flv_gen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+typedef struct bench_packets_s {
+    demuxer_packet_t **packets;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t media_flag;
+    uint64_t bytes;
+    int64_t first_dts;
+    int64_t last_dts;
+} bench_packets_t;
+
+static double cpu_seconds(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void on_data(void* userdata, int type, void* data, int size, int64_t ts[], uint32_t flag) {
+    bench_packets_t *b = (bench_packets_t*)userdata;
+    if(type == VOODOO_DATA_TYPE_MEDIA_FLAG) {
+        b->media_flag = flag;
+    }
+}
+
+static void read_all(void *demuxer, bench_packets_t *b) {
+    demuxer_packet_t *batch[64];
+    int n;
+    while((n = flv_demuxer_read_packets(demuxer, batch, 64)) > 0) {
+        for(int i = 0;i < n;++i) {
+            if(b->count == b->capacity) {
+                b->capacity = b->capacity ? b->capacity * 2 : 4096;
+                b->packets = (demuxer_packet_t**)realloc(b->packets, b->capacity * sizeof(demuxer_packet_t*));
+            }
+            if(batch[i]->type == VOODOO_DATA_TYPE_VIDEO_PACKET || batch[i]->type == VOODOO_DATA_TYPE_AUDIO_PACKET) {
+                if(b->first_dts == VOODOO_NOPTS_VALUE) b->first_dts = batch[i]->dts;
+                b->last_dts = batch[i]->dts;
+                b->bytes += batch[i]->size;
+            }
+            b->packets[b->count++] = batch[i];
+        }
+    }
+}
+
+static demuxer_packet_t* clone_packet(packet_pool_t *pool, const demuxer_packet_t *packet, int64_t shift) {
+    demuxer_packet_t *copy = packet_pool_alloc(pool, packet->size);
+    if(!copy) exit(1);
+    copy->type = packet->type;
+    copy->stream_index = packet->stream_index;
+    copy->flag = packet->flag;
+    copy->pts = packet->pts == VOODOO_NOPTS_VALUE ? packet->pts : packet->pts - shift;
+    copy->dts = packet->dts - shift;
+    memcpy(copy->data, packet->data, packet->size);
+    return copy;
+}
+
+static uint32_t be32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+/*
+ decode time of the first traf of every moof, -1 when the file can not be read
+ */
+static int read_decode_times(const char *path, uint64_t *times, int max) {
+    FILE *f = fopen(path, "rb");
+    if(!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = (uint8_t*)malloc((size_t)size);
+    if(!data || fread(data, 1, (size_t)size, f) != (size_t)size) {
+        fclose(f);
+        free(data);
+        return -1;
+    }
+    fclose(f);
+    int count = 0;
+    for(long offset = 0;offset + 8 <= size && count < max;) {
+        uint32_t box = be32(data + offset);
+        if(box < 8 || offset + box > size) break;
+        if(memcmp(data + offset + 4, "moof", 4) == 0) {
+            /*
+             moof > traf > tfdt, first match is the video track
+             */
+            for(long p = offset + 8;p + 8 <= offset + box;p += 4) {
+                if(memcmp(data + p + 4, "tfdt", 4) == 0 && p + 20 <= offset + box) {
+                    times[count++] = data[p + 8] == 1 ? (uint64_t)be32(data + p + 12) << 32 | be32(data + p + 16) : be32(data + p + 12);
+                    break;
+                }
+            }
+        }
+        offset += box;
+    }
+    free(data);
+    return count;
+}
+
+/*
+ the stream with its timestamps restarting at a keyframe half way, and one
+ stray non-keyframe from the past before that: the recorder has to start a
+ second file whose decode times begin at 0, and drop the stray frame
+ */
+static int check_restart(bench_packets_t *packets, packet_pool_t *pool, const char *dir, int async) {
+    uint32_t restart = 0, stray = 0;
+    int64_t first_dts = VOODOO_NOPTS_VALUE;
+    for(uint32_t k = 0;k < packets->count;++k) {
+        demuxer_packet_t *p = packets->packets[k];
+        if(p->type != VOODOO_DATA_TYPE_VIDEO_PACKET) continue;
+        if(first_dts == VOODOO_NOPTS_VALUE) first_dts = p->dts;
+        int key = (p->flag & VOODOO_VIDEO_PACKET_FLAG_IS_KEY_FRAME) != 0;
+        if(!key && stray == 0) stray = k;
+        if(key && k >= packets->count / 2) {
+            restart = k;
+            break;
+        }
+    }
+    const char *name = async ? "restart async" : "restart";
+    if(restart == 0 || stray == 0) {
+        printf("%-14s skipped, no keyframe in the second half\n", name);
+        return 0;
+    }
+    int64_t shift = packets->packets[restart]->dts - first_dts;
+    char prefix[1024], path[1100];
+    snprintf(prefix, sizeof(prefix), "%s/record_bench_restart", dir);
+    fmp4_recorder_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.path_prefix = prefix;
+    config.async = async;
+    fmp4_recorder_stats_t clean, stats;
+    for(int pass = 0;pass < 2;++pass) {
+        fmp4_recorder_t *recorder = fmp4_recorder_create(&config, NULL);
+        if(!recorder) return 1;
+        fmp4_recorder_set_media_flag(recorder, packets->media_flag);
+        for(uint32_t k = 0;k < packets->count;++k) {
+            demuxer_packet_t *p = packets->packets[k];
+            if(pass == 0 || k < restart) {
+                fmp4_recorder_push(recorder, p);
+            } else {
+                demuxer_packet_t *copy = clone_packet(pool, p, shift);
+                fmp4_recorder_push(recorder, copy);
+                demuxer_packet_release(copy);
+            }
+            if(pass == 1 && k == stray + 10) {
+                demuxer_packet_t *copy = clone_packet(pool, packets->packets[stray], 0);
+                fmp4_recorder_push(recorder, copy);
+                demuxer_packet_release(copy);
+            }
+        }
+        /*
+         files and dropped are counted on this thread, the written files
+         are read back below
+         */
+        fmp4_recorder_get_stats(recorder, pass == 0 ? &clean : &stats);
+        fmp4_recorder_destroy(recorder);
+    }
+
+    uint64_t times[2][4096];
+    int counts[2], monotonic = 1;
+    for(int i = 0;i < 2;++i) {
+        snprintf(path, sizeof(path), "%s-%04d.mp4", prefix, i);
+        counts[i] = read_decode_times(path, times[i], 4096);
+        for(int k = 1;k < counts[i];++k) {
+            if(times[i][k] <= times[i][k - 1]) monotonic = 0;
+        }
+    }
+    /*
+     90 kHz video, the second file restarts close to 0
+     */
+    int ok = stats.files == 2 && clean.files == 1 && stats.dropped >= clean.dropped + 1 && stats.write_errors == 0 &&
+             counts[0] > 0 && counts[1] > 0 && times[1][0] == 0 && times[1][counts[1] - 1] < (uint64_t)shift * 90 + 90000 && monotonic;
+    printf("%-14s %s  %llu files, %llu dropped (clean run %llu), %d + %d fragments, second file decode time %llu .. %llu%s\n",
+           name, ok ? "ok  " : "FAIL", (unsigned long long)stats.files, (unsigned long long)stats.dropped, (unsigned long long)clean.dropped,
+           counts[0], counts[1], counts[1] > 0 ? (unsigned long long)times[1][0] : 0ull,
+           counts[1] > 0 ? (unsigned long long)times[1][counts[1] - 1] : 0ull, monotonic ? "" : ", not increasing");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    const char *file = NULL, *dir = "/tmp";
+    flv_gen_config_t gen;
+    fmp4_recorder_config_t config;
+    int recorders = 8;
+    uint8_t *stream = NULL;
+    long stream_size = 0;
+    bench_packets_t packets;
+
+    flv_gen_default_config(&gen);
+    gen.video_kbps = 6000;
+    gen.fps = 30;
+    gen.gop = 60;
+    memset(&config, 0, sizeof(config));
+    config.index = 1;
+    memset(&packets, 0, sizeof(packets));
+    packets.first_dts = VOODOO_NOPTS_VALUE;
+
+    int opt;
+    while((opt = getopt(argc, argv, "f:t:v:n:g:s:o:a")) != -1) {
+        switch(opt) {
+            case 'f': file = optarg; break;
+            case 't': gen.seconds = (uint32_t)atoi(optarg); break;
+            case 'v': gen.video_kbps = (uint32_t)atoi(optarg); break;
+            case 'n': recorders = atoi(optarg); break;
+            case 'g': config.fragment_ms = (uint32_t)atoi(optarg); break;
+            case 's': config.segment_ms = (uint32_t)atoi(optarg); break;
+            case 'o': dir = optarg; break;
+            case 'a': config.async = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-f file.flv] [-t seconds] [-v video_kbps] [-n recorders] [-g fragment_ms] [-s segment_ms] [-o dir] [-a]\n", argv[0]);
+                return 1;
+        }
+    }
+    if(recorders < 1) recorders = 1;
+
+    if(file) {
+        FILE *f = fopen(file, "rb");
+        if(!f) {
+            perror(file);
+            return 1;
+        }
+        fseek(f, 0, SEEK_END);
+        stream_size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        stream = (uint8_t*)malloc((size_t)stream_size);
+        if(!stream || fread(stream, 1, (size_t)stream_size, f) != (size_t)stream_size) {
+            fclose(f);
+            return 1;
+        }
+        fclose(f);
+    } else {
+        flv_gen_info_t info;
+        stream = flv_gen_stream(&gen, &info);
+        if(!stream) return 1;
+        stream_size = info.size;
+    }
+
+    packet_pool_t *pool = packet_pool_create(0, NULL);
+    void *demuxer = flv_demuxer_init(&packets, on_data);
+    flv_demuxer_set_packet_pool(demuxer, pool, NULL);
+    for(long offset = 0;offset < stream_size;offset += 65536) {
+        long n = stream_size - offset < 65536 ? stream_size - offset : 65536;
+        flv_demuxer_feed(demuxer, stream + offset, (int)n);
+        read_all(demuxer, &packets);
+    }
+    double media_seconds = packets.first_dts == VOODOO_NOPTS_VALUE ? 0 : (packets.last_dts - packets.first_dts) / 1000.0;
+    printf("stream          %u packets, %.1f MB, %.1f s, %.0f kbps\n", packets.count, packets.bytes / 1e6, media_seconds,
+           media_seconds > 0 ? packets.bytes * 8 / media_seconds / 1000 : 0);
+
+    int failures = check_restart(&packets, pool, dir, 0) + check_restart(&packets, pool, dir, 1);
+
+    fmp4_recorder_t **list = (fmp4_recorder_t**)calloc((size_t)recorders, sizeof(fmp4_recorder_t*));
+    char prefix[1024];
+    for(int i = 0;i < recorders;++i) {
+        snprintf(prefix, sizeof(prefix), "%s/record_bench_%d", dir, i);
+        config.path_prefix = prefix;
+        list[i] = fmp4_recorder_create(&config, NULL);
+        if(!list[i]) return 1;
+        fmp4_recorder_set_media_flag(list[i], packets.media_flag);
+    }
+
+    /*
+     和直播一样交错着推，每个录制器一次一个包
+     */
+    double cpu = cpu_seconds(), wall = now_seconds();
+    for(uint32_t k = 0;k < packets.count;++k) {
+        for(int i = 0;i < recorders;++i) {
+            fmp4_recorder_push(list[i], packets.packets[k]);
+        }
+    }
+    fmp4_recorder_stats_t stats;
+    fmp4_recorder_flush(list[0]);
+    do {
+        fmp4_recorder_get_stats(list[0], &stats);
+    } while(stats.queued > 0 && usleep(1000) == 0);
+    for(int i = 0;i < recorders;++i) {
+        fmp4_recorder_destroy(list[i]);
+    }
+    cpu = cpu_seconds() - cpu;
+    wall = now_seconds() - wall;
+
+    printf("recorders       %d, fragment %u ms, segment %u ms%s\n", recorders, config.fragment_ms, config.segment_ms,
+           config.async ? ", async" : "");
+    printf("per recorder    %llu files, %llu fragments, %llu samples, %.1f MB, %llu writev, %llu dropped, %u errors\n",
+           (unsigned long long)stats.files, (unsigned long long)stats.fragments, (unsigned long long)stats.samples, stats.bytes / 1e6,
+           (unsigned long long)stats.writev_calls, (unsigned long long)stats.dropped, stats.write_errors);
+    printf("time            %.3f s cpu, %.3f s wall\n", cpu, wall);
+    if(cpu > 0) {
+        printf("streams/core    %.0f\n", media_seconds * recorders / cpu);
+        printf("throughput      %.0f MB/s\n", stats.bytes * (double)recorders / 1e6 / wall);
+    }
+
+    for(uint32_t k = 0;k < packets.count;++k) {
+        demuxer_packet_release(packets.packets[k]);
+    }
+    free(packets.packets);
+    free(list);
+    flv_demuxer_fint(demuxer);
+    packet_pool_destroy(pool);
+    free(stream);
+    return failures ? 1 : 0;
+}
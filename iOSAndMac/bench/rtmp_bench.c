@@ -0,0 +1,504 @@
+//
+//  rtmp_bench.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+//  rtmp_demuxer_feed on a chunk encoded synthetic stream: checks that the
+//  chunk layer delivers exactly what flv_demuxer_feed_tag does on the same
+//  tags, and measures throughput over piece sizes from 1 byte to 64 KB
+//
+//  D=../VoodooLivePlayer/pipeline/demuxer
+//  cc -O2 -I$D/base -I$D/flv -I$D/rtmp rtmp_bench.c $D/rtmp/rtmp.c $D/flv/flv.c $D/base/packet_pool.c
+//     $D/base/video_sps.c $D/base/demuxer_trace.c $D/base/gop_cache.c $D/base/nal_format.c -o rtmp_bench
+//
+//  ./rtmp_bench [-t seconds] [-w seconds_before_extended] [-s seed]
+//               [-c 1,2,3,7,64,127,128,129,1000,4096,16384,65536,0] [-n rounds]
+//
+//  the flv_gen tags go out as audio on csid 70 (2 byte basic header), video
+//  on csid 6 and data on csid 400 (3 byte basic header), one chunk at a time
+//  from a random stream, so messages interleave. every message header takes
+//  the smallest fmt the previous one on its csid allows, keyframes and one
+//  in 16 messages use fmt 0. timestamps pass 0xffffff -w seconds in (default
+//  3), fmt 0 headers and the fmt 3 chunks after them then carry the extended
+//  timestamp. every 97 messages a Set Chunk Size cycles through 4096, 60,
+//  1500, 65536, 128, 17 and 8192, some video messages are aborted halfway
+//  with Abort and sent again.
+//  the reference is a bare flv demuxer fed with flv_demuxer_feed_tag in the
+//  order the messages complete. every callback (type, size, pts, dts, flag
+//  and a hash of the data) must match, for every piece size. piece size 0
+//  feeds random sizes between 1 byte and 64 KB. exit 1 on a mismatch.
+//
+
+#include "rtmp.h"
+#include "flv.h"
+#include "flv_gen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_MAX_PIECES    16
+#define BENCH_MAX_ROUNDS    64
+#define BENCH_VIDEO_CSID    6
+#define BENCH_AUDIO_CSID    70
+#define BENCH_DATA_CSID     400
+#define BENCH_CONTROL_CSID  2
+#define BENCH_STREAM_ID     1
+#define BENCH_CHUNK_SIZE_EVERY  97
+
+static const uint32_t bench_chunk_sizes[] = { 4096, 60, 1500, 65536, 128, 17, 8192 };
+
+typedef struct bench_tag_s {
+    uint8_t type;
+    uint32_t timestamp;
+    const uint8_t *body;
+    uint32_t size;
+} bench_tag_t;
+
+/*
+ 编码端的chunk stream，和rtmp.c一样记着上一个消息头，fmt 1~3据此省掉字段
+ */
+typedef struct enc_stream_s {
+    uint32_t csid;
+    int has_header;
+    int extended;
+    uint32_t ext;               /*  extended timestamp, repeated on fmt 3   */
+    uint8_t type;
+    uint32_t stream_id;
+    uint32_t timestamp;
+    uint32_t delta;
+    uint32_t length;
+
+    /*
+     message being sent, tag -1 when idle
+     */
+    int tag;
+    uint8_t message_type;
+    uint32_t message_stream_id;
+    uint32_t message_ts;
+    const uint8_t *data;
+    uint32_t size;
+    uint32_t sent;
+    int force_fmt0;
+    int aborted;
+} enc_stream_t;
+
+typedef struct encoder_s {
+    flv_gen_buffer_t out;
+    uint32_t chunk_size;
+    uint64_t fmt[4];
+    uint64_t fmt3_messages;     /*  new messages with a fmt 3 header        */
+    uint64_t extended;
+    uint64_t extended_fmt3;
+    uint64_t chunk_size_changes;
+    uint64_t aborts;
+} encoder_t;
+
+typedef struct bench_record_s {
+    int type;
+    int size;
+    int64_t pts;
+    int64_t dts;
+    uint32_t flag;
+    uint32_t hash;
+} bench_record_t;
+
+typedef struct bench_output_s {
+    bench_record_t *records;
+    uint32_t count;
+    uint32_t capacity;
+} bench_output_t;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t bench_hash(const uint8_t *p, int size) {
+    uint32_t h = 2166136261u;
+    for(int i = 0;i < size;++i) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+/*
+ media flag只有rtmp这边发，不比较
+ */
+static void on_data(void* userdata, int type, void* data, int size, int64_t ts[], uint32_t flag) {
+    bench_output_t *out = (bench_output_t*)userdata;
+    if(type == VOODOO_DATA_TYPE_MEDIA_FLAG) {
+        return;
+    }
+    if(out->count == out->capacity) {
+        uint32_t capacity = out->capacity ? out->capacity * 2 : 4096;
+        bench_record_t *records = (bench_record_t*)realloc(out->records, capacity * sizeof(bench_record_t));
+        if(!records) {
+            return;
+        }
+        out->records = records;
+        out->capacity = capacity;
+    }
+    bench_record_t *r = &out->records[out->count++];
+    r->type = type;
+    r->size = size;
+    r->pts = ts ? ts[0] : 0;
+    r->dts = ts ? ts[1] : 0;
+    r->flag = flag;
+    r->hash = data && size > 0 ? bench_hash((const uint8_t*)data, size) : 0;
+}
+
+static void enc_write(encoder_t *enc, const uint8_t *p, uint32_t size) {
+    uint8_t *dst = flv_gen_reserve(&enc->out, size);
+    if(!dst) {
+        fprintf(stderr, "out of memory\n");
+        exit(2);
+    }
+    memcpy(dst, p, size);
+    enc->out.size += size;
+}
+
+/*
+ 发cs当前消息的下一个chunk，消息发完返回1
+ */
+static int enc_chunk(encoder_t *enc, enc_stream_t *cs) {
+    uint8_t h[18];
+    uint32_t n = 0, field = 0;
+    int fmt = 3;
+    if(cs->sent == 0) {
+        field = cs->message_ts - cs->timestamp;
+        if(!cs->has_header || cs->force_fmt0 || cs->message_stream_id != cs->stream_id) {
+            fmt = 0;
+            field = cs->message_ts;
+        } else if(cs->message_type != cs->type || cs->size != cs->length) {
+            fmt = 1;
+        } else if(field != cs->delta) {
+            fmt = 2;
+        }
+    }
+    if(cs->csid < 64) {
+        h[n++] = (uint8_t)(fmt << 6 | cs->csid);
+    } else if(cs->csid < 320) {
+        h[n++] = (uint8_t)(fmt << 6);
+        h[n++] = (uint8_t)(cs->csid - 64);
+    } else {
+        h[n++] = (uint8_t)(fmt << 6 | 1);
+        h[n++] = (uint8_t)((cs->csid - 64) & 0xff);
+        h[n++] = (uint8_t)((cs->csid - 64) >> 8);
+    }
+    enc->fmt[fmt]++;
+    if(fmt <= 2) {
+        cs->extended = field >= 0xffffff;
+        cs->ext = field;
+        flv_gen_be(h + n, cs->extended ? 0xffffff : field, 3);
+        n += 3;
+        if(fmt <= 1) {
+            flv_gen_be(h + n, cs->size, 3);
+            h[n + 3] = cs->message_type;
+            n += 4;
+            cs->length = cs->size;
+            cs->type = cs->message_type;
+        }
+        if(fmt == 0) {
+            for(int i = 0;i < 4;++i) {
+                h[n++] = (uint8_t)(cs->message_stream_id >> (8 * i));
+            }
+            cs->stream_id = cs->message_stream_id;
+            cs->timestamp = field;
+            cs->delta = 0;
+        } else {
+            cs->delta = field;
+            cs->timestamp += field;
+        }
+        if(cs->extended) {
+            flv_gen_be(h + n, field, 4);
+            n += 4;
+            enc->extended++;
+        }
+        cs->has_header = 1;
+        cs->force_fmt0 = 0;
+    } else {
+        if(cs->extended) {
+            flv_gen_be(h + n, cs->ext, 4);
+            n += 4;
+            enc->extended_fmt3++;
+        }
+        if(cs->sent == 0) {
+            cs->timestamp += cs->delta;
+            enc->fmt3_messages++;
+        }
+    }
+    uint32_t len = cs->size - cs->sent;
+    if(len > enc->chunk_size) {
+        len = enc->chunk_size;
+    }
+    enc_write(enc, h, n);
+    enc_write(enc, cs->data + cs->sent, len);
+    cs->sent += len;
+    return cs->sent == cs->size;
+}
+
+/*
+ 控制消息走csid 2，一次发完
+ */
+static void enc_control(encoder_t *enc, enc_stream_t *cs, uint8_t type, uint32_t value) {
+    uint8_t payload[4];
+    flv_gen_be(payload, value, 4);
+    cs->message_type = type;
+    cs->message_stream_id = 0;
+    cs->message_ts = 0;
+    cs->data = payload;
+    cs->size = 4;
+    cs->sent = 0;
+    while(!enc_chunk(enc, cs));
+    cs->data = NULL;
+}
+
+/*
+ 把tag编码成chunk流，order按消息收全的顺序记下tag下标
+ */
+static void encode(const bench_tag_t *tags, uint32_t tag_count, uint32_t seed, encoder_t *enc, uint32_t *order) {
+    enc_stream_t streams[3], control;
+    const uint32_t csids[3] = { BENCH_VIDEO_CSID, BENCH_AUDIO_CSID, BENCH_DATA_CSID };
+    flv_gen_buffer_t rng = { NULL, 0, 0, seed | 1 };
+    uint32_t next = 0, done = 0, sizes = 0;
+
+    memset(enc, 0, sizeof(encoder_t));
+    enc->chunk_size = RTMP_DEFAULT_CHUNK_SIZE;
+    memset(streams, 0, sizeof(streams));
+    memset(&control, 0, sizeof(control));
+    for(int i = 0;i < 3;++i) {
+        streams[i].csid = csids[i];
+        streams[i].tag = -1;
+    }
+    control.csid = BENCH_CONTROL_CSID;
+    while(done < tag_count) {
+        /*
+         按原来的顺序装载，下一个tag的csid还在发上一条消息时先不往后装
+         */
+        while(next < tag_count) {
+            const bench_tag_t *tag = &tags[next];
+            enc_stream_t *cs = &streams[tag->type == 9 ? 0 : (tag->type == 8 ? 1 : 2)];
+            if(cs->tag >= 0) {
+                break;
+            }
+            cs->tag = (int)next++;
+            cs->message_type = tag->type;
+            cs->message_stream_id = BENCH_STREAM_ID;
+            cs->message_ts = tag->timestamp;
+            cs->data = tag->body;
+            cs->size = tag->size;
+            cs->sent = 0;
+            cs->aborted = 0;
+            cs->force_fmt0 = (tag->type == 9 && tag->size > 0 && (tag->body[0] >> 4) == 1) || flv_gen_rand(&rng) % 16 == 0;
+        }
+        enc_stream_t *active[3];
+        int count = 0;
+        for(int i = 0;i < 3;++i) {
+            if(streams[i].tag >= 0) {
+                active[count++] = &streams[i];
+            }
+        }
+        enc_stream_t *cs = active[flv_gen_rand(&rng) % count];
+        if(cs->message_type == 9 && cs->sent > 0 && !cs->aborted && flv_gen_rand(&rng) % 256 == 0) {
+            /*
+             发到一半的视频消息abort掉，重新用fmt 0整条再发
+             */
+            enc_control(enc, &control, RTMP_MESSAGE_ABORT, cs->csid);
+            enc->aborts++;
+            cs->sent = 0;
+            cs->aborted = 1;
+            cs->force_fmt0 = 1;
+            continue;
+        }
+        if(enc_chunk(enc, cs)) {
+            order[done++] = (uint32_t)cs->tag;
+            cs->tag = -1;
+            if(done % BENCH_CHUNK_SIZE_EVERY == 0) {
+                uint32_t chunk_size = bench_chunk_sizes[sizes++ % (sizeof(bench_chunk_sizes) / sizeof(bench_chunk_sizes[0]))];
+                enc_control(enc, &control, RTMP_MESSAGE_SET_CHUNK_SIZE, chunk_size);
+                enc->chunk_size = chunk_size;
+                enc->chunk_size_changes++;
+            }
+        }
+    }
+}
+
+/*
+ 跳过flv头，按顺序取出每个tag，时间戳加上base
+ */
+static uint32_t split_tags(const uint8_t *stream, uint32_t size, uint32_t base, bench_tag_t *tags, uint32_t max) {
+    uint32_t pos = 13, count = 0;
+    while(pos + 15 <= size && count < max) {
+        const uint8_t *p = stream + pos;
+        bench_tag_t *tag = &tags[count++];
+        tag->type = p[0] & 0x1f;
+        tag->size = ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+        tag->timestamp = base + (((uint32_t)p[4] << 16) | ((uint32_t)p[5] << 8) | p[6] | ((uint32_t)p[7] << 24));
+        tag->body = p + 11;
+        pos += 11 + tag->size + 4;
+    }
+    return count;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double median(double *values, int count) {
+    qsort(values, (size_t)count, sizeof(double), compare_double);
+    return count % 2 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+/*
+ 返回第一个不一样的回调的下标，完全一样返回-1
+ */
+static int64_t first_mismatch(const bench_output_t *a, const bench_output_t *b) {
+    uint32_t n = a->count < b->count ? a->count : b->count;
+    for(uint32_t i = 0;i < n;++i) {
+        const bench_record_t *x = &a->records[i], *y = &b->records[i];
+        if(x->type != y->type || x->size != y->size || x->pts != y->pts || x->dts != y->dts ||
+           x->flag != y->flag || x->hash != y->hash) {
+            return i;
+        }
+    }
+    return a->count == b->count ? -1 : (int64_t)n;
+}
+
+int main(int argc, char **argv) {
+    flv_gen_config_t config;
+    flv_gen_info_t info;
+    const char *piece_list = "1,2,3,7,64,127,128,129,1000,4096,16384,65536,0";
+    int rounds = 3, before_extended = 3, failures = 0;
+    uint32_t pieces[BENCH_MAX_PIECES];
+    int piece_count = 0;
+
+    flv_gen_default_config(&config);
+    config.seconds = 10;
+    config.jitter_percent = 0;
+    for(int i = 1;i < argc;++i) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if(!value) {
+            fprintf(stderr, "missing value for %s\n", arg);
+            return 2;
+        }
+        ++i;
+        if(strcmp(arg, "-t") == 0) config.seconds = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-w") == 0) before_extended = atoi(value);
+        else if(strcmp(arg, "-s") == 0) config.seed = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-c") == 0) piece_list = value;
+        else if(strcmp(arg, "-n") == 0) rounds = atoi(value);
+        else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return 2;
+        }
+    }
+    if(rounds < 1) rounds = 1;
+    if(rounds > BENCH_MAX_ROUNDS) rounds = BENCH_MAX_ROUNDS;
+    if(before_extended < 0) before_extended = 0;
+    for(const char *c = piece_list;*c && piece_count < BENCH_MAX_PIECES;) {
+        int piece = atoi(c);
+        pieces[piece_count++] = piece > 0 ? (uint32_t)piece : 0;
+        while(*c && *c != ',') ++c;
+        if(*c == ',') ++c;
+    }
+
+    uint8_t *stream = flv_gen_stream(&config, &info);
+    uint32_t tag_count = info.video_tags + info.audio_tags + info.script_tags;
+    bench_tag_t *tags = (bench_tag_t*)malloc(tag_count * sizeof(bench_tag_t));
+    uint32_t *order = (uint32_t*)malloc(tag_count * sizeof(uint32_t));
+    if(!stream || !tags || !order) {
+        fprintf(stderr, "generate stream failed\n");
+        return 2;
+    }
+    tag_count = split_tags(stream, info.size, 0xffffff - (uint32_t)before_extended * 1000, tags, tag_count);
+
+    encoder_t enc;
+    encode(tags, tag_count, config.seed, &enc, order);
+    printf("stream       %.2f MB flv, %.2f MB rtmp, %u messages, timestamps extended at %d s\n",
+           info.size / 1048576.0, enc.out.size / 1048576.0, tag_count, before_extended);
+    printf("chunks       fmt 0 %llu  fmt 1 %llu  fmt 2 %llu  fmt 3 %llu (%llu new messages)\n",
+           (unsigned long long)enc.fmt[0], (unsigned long long)enc.fmt[1], (unsigned long long)enc.fmt[2],
+           (unsigned long long)enc.fmt[3], (unsigned long long)enc.fmt3_messages);
+    printf("             %llu extended headers, %llu fmt 3 with extended, %llu chunk sizes, %llu aborts\n",
+           (unsigned long long)enc.extended, (unsigned long long)enc.extended_fmt3,
+           (unsigned long long)enc.chunk_size_changes, (unsigned long long)enc.aborts);
+    if(enc.fmt[1] == 0 || enc.fmt[2] == 0 || enc.fmt3_messages == 0 || enc.extended == 0 ||
+       enc.extended_fmt3 == 0 || enc.chunk_size_changes == 0 || enc.aborts == 0) {
+        printf("FAIL         the encoded stream misses a case, try a longer stream\n");
+        failures++;
+    }
+
+    /*
+     参照：同样的tag按消息收全的顺序直接feed_tag
+     */
+    bench_output_t ref;
+    memset(&ref, 0, sizeof(ref));
+    void *flv = flv_demuxer_init(&ref, on_data);
+    for(uint32_t i = 0;i < tag_count;++i) {
+        const bench_tag_t *tag = &tags[order[i]];
+        flv_demuxer_feed_tag(flv, tag->type, tag->timestamp, tag->body, tag->size);
+    }
+    flv_demuxer_fint(flv);
+
+    printf("%-8s %10s %14s %10s  %s\n", "piece", "MB/s", "messages/s", "callbacks", "result");
+    for(int p = 0;p < piece_count;++p) {
+        double mbps[BENCH_MAX_ROUNDS], mps[BENCH_MAX_ROUNDS];
+        bench_output_t out;
+        int64_t mismatch = -1;
+        int broken = 0;
+        memset(&out, 0, sizeof(out));
+        for(int r = 0;r < rounds;++r) {
+            uint32_t seed = 0x1234567u + (uint32_t)r;
+            void *ctx = rtmp_demuxer_init(&out, on_data);
+            out.count = 0;
+            double t0 = now_ns();
+            for(uint32_t pos = 0;pos < enc.out.size;) {
+                uint32_t len = pieces[p];
+                if(len == 0) {
+                    seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+                    len = 1 + seed % (64 * 1024);
+                }
+                if(len > enc.out.size - pos) len = enc.out.size - pos;
+                if(rtmp_demuxer_feed(ctx, enc.out.data + pos, (int)len) < 0) {
+                    broken = 1;
+                    break;
+                }
+                pos += len;
+            }
+            double t1 = now_ns();
+            rtmp_demuxer_fint(ctx);
+            mbps[r] = enc.out.size / 1048576.0 / ((t1 - t0) / 1e9);
+            mps[r] = tag_count / ((t1 - t0) / 1e9);
+            if(mismatch < 0) {
+                mismatch = first_mismatch(&ref, &out);
+            }
+        }
+        char result[128];
+        if(broken) {
+            snprintf(result, sizeof(result), "FAIL  feed returned -1");
+        } else if(mismatch >= 0) {
+            snprintf(result, sizeof(result), "FAIL  callback %lld differs", (long long)mismatch);
+        } else {
+            snprintf(result, sizeof(result), "ok");
+        }
+        failures += broken || mismatch >= 0;
+        if(pieces[p] > 0) {
+            printf("%-8u %10.1f %14.0f %10u  %s\n", pieces[p], median(mbps, rounds), median(mps, rounds), out.count, result);
+        } else {
+            printf("%-8s %10.1f %14.0f %10u  %s\n", "random", median(mbps, rounds), median(mps, rounds), out.count, result);
+        }
+        free(out.records);
+    }
+    free(ref.records);
+    free(enc.out.data);
+    free(order);
+    free(tags);
+    free(stream);
+    return failures ? 1 : 0;
+}
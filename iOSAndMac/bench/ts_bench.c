@@ -0,0 +1,244 @@
+//
+//  ts_bench.c
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+//  ts_demuxer_feed on a synthetic stream, offline: checks what comes out
+//  and measures throughput over network sized chunks
+//
+//  D=../VoodooLivePlayer/pipeline/demuxer
+//  cc -O2 -I$D/base -I$D/ts ts_bench.c $D/ts/ts.c $D/base/packet_pool.c
+//     $D/base/video_sps.c $D/base/demuxer_trace.c $D/base/gop_cache.c $D/base/nal_format.c -o ts_bench
+//
+//  ./ts_bench [-t seconds] [-v video_kbps] [-a audio_kbps] [-r fps] [-g gop] [-f audio_frames_per_pes]
+//             [-w seconds_before_wrap] [-l drop_every] [-s seed] [-c 188,1316,16384,65536] [-n rounds] [-p]
+//
+//  the 33 bit pts wraps -w seconds into the stream (default half way).
+//  two checks run first, exit 1 when one fails:
+//  clean       every frame out, pts strictly increasing through the wrap
+//  cc gaps     every -l th media packet dropped (default 997): each gap is
+//              reported once, at most the two pes around it are lost and
+//              the rest still comes out in order
+//  then the clean stream is fed in each chunk size, the median of the
+//  rounds is reported. -p delivers through a packet pool.
+//
+
+#include "ts.h"
+#include "ts_gen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_MAX_CHUNKS    16
+#define BENCH_MAX_ROUNDS    64
+
+typedef struct bench_output_s {
+    uint64_t video_frames;
+    uint64_t audio_frames;
+    uint64_t keyframes;
+    uint64_t parameters;
+    int64_t first_video_pts;
+    int64_t last_video_pts;
+    int64_t last_audio_pts;
+    uint64_t backwards;         /*  pts not above the previous one of its stream */
+} bench_output_t;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench_count(bench_output_t *out, int type, int64_t pts, uint32_t flag) {
+    if(type == VOODOO_DATA_TYPE_VIDEO_PACKET) {
+        if(out->video_frames == 0) {
+            out->first_video_pts = pts;
+        } else if(pts <= out->last_video_pts) {
+            out->backwards++;
+        }
+        out->last_video_pts = pts;
+        out->video_frames++;
+        out->keyframes += (flag & VOODOO_VIDEO_PACKET_FLAG_IS_KEY_FRAME) != 0;
+    } else if(type == VOODOO_DATA_TYPE_AUDIO_PACKET) {
+        if(out->audio_frames > 0 && pts <= out->last_audio_pts) {
+            out->backwards++;
+        }
+        out->last_audio_pts = pts;
+        out->audio_frames++;
+    } else if(type == VOODOO_DATA_TYPE_VIDEO_PARAMETERS || type == VOODOO_DATA_TYPE_AUDIO_PARAMETERS) {
+        out->parameters++;
+    }
+}
+
+static void on_data(void* userdata, int type, void* data, int size, int64_t ts[], uint32_t flag) {
+    bench_count((bench_output_t*)userdata, type, ts ? ts[0] : VOODOO_NOPTS_VALUE, flag);
+}
+
+/*
+ lent for the callback, the demuxer releases it afterwards
+ */
+static void on_packet(void* userdata, demuxer_packet_t* packet) {
+    bench_count((bench_output_t*)userdata, packet->type, packet->pts, packet->flag);
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double median(double *values, int count) {
+    qsort(values, (size_t)count, sizeof(double), compare_double);
+    return count % 2 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+/*
+ feeds the whole stream in chunk sized pieces, returns the seconds it took
+ */
+static double demux(const uint8_t *stream, uint32_t size, uint32_t chunk, int use_pool, bench_output_t *out, demuxer_stats_t *stats) {
+    packet_pool_t *pool = use_pool ? packet_pool_create(0, NULL) : NULL;
+    void *ctx = ts_demuxer_init(out, on_data);
+    memset(out, 0, sizeof(bench_output_t));
+    if(pool) {
+        ts_demuxer_set_packet_pool(ctx, pool, on_packet);
+    }
+    double t0 = now_ns();
+    for(uint32_t pos = 0;pos < size;) {
+        uint32_t len = chunk < size - pos ? chunk : size - pos;
+        ts_demuxer_feed(ctx, stream + pos, (int)len);
+        pos += len;
+    }
+    ts_demuxer_flush(ctx);
+    double t1 = now_ns();
+    if(stats) {
+        ts_demuxer_get_stats(ctx, stats);
+    }
+    ts_demuxer_fint(ctx);
+    if(pool) {
+        packet_pool_destroy(pool);
+    }
+    return (t1 - t0) / 1e9;
+}
+
+static int check(const char *name, int ok, const char *detail) {
+    printf("%-12s %s  %s\n", name, ok ? "ok  " : "FAIL", detail);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    ts_gen_config_t config;
+    ts_gen_info_t info, gap_info;
+    const char *chunk_list = "188,1316,16384,65536";
+    int rounds = 5, use_pool = 0, failures = 0;
+    int64_t before_wrap = -1;
+    uint32_t drop_every = 997;
+    uint32_t chunks[BENCH_MAX_CHUNKS];
+    int chunk_count = 0;
+    char detail[256];
+
+    ts_gen_default_config(&config);
+    for(int i = 1;i < argc;++i) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if(strcmp(arg, "-p") == 0) {
+            use_pool = 1;
+            continue;
+        }
+        if(!value) {
+            fprintf(stderr, "missing value for %s\n", arg);
+            return 2;
+        }
+        ++i;
+        if(strcmp(arg, "-t") == 0) config.seconds = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-v") == 0) config.video_kbps = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-a") == 0) config.audio_kbps = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-r") == 0) config.fps = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-g") == 0) config.gop = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-f") == 0) config.audio_frames_per_pes = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-w") == 0) before_wrap = atoi(value);
+        else if(strcmp(arg, "-l") == 0) drop_every = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-s") == 0) config.seed = (uint32_t)atoi(value);
+        else if(strcmp(arg, "-c") == 0) chunk_list = value;
+        else if(strcmp(arg, "-n") == 0) rounds = atoi(value);
+        else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return 2;
+        }
+    }
+    if(rounds < 1) rounds = 1;
+    if(rounds > BENCH_MAX_ROUNDS) rounds = BENCH_MAX_ROUNDS;
+    for(const char *c = chunk_list;*c && chunk_count < BENCH_MAX_CHUNKS;) {
+        int chunk = atoi(c);
+        chunks[chunk_count++] = chunk > 0 ? (uint32_t)chunk : 188;
+        while(*c && *c != ',') ++c;
+        if(*c == ',') ++c;
+    }
+    if(before_wrap < 0) {
+        before_wrap = config.seconds / 2;
+    }
+    config.start_pts = TS_GEN_WRAP - before_wrap * 90000;
+
+    uint8_t *stream = ts_gen_stream(&config, &info);
+    ts_gen_config_t gap_config = config;
+    gap_config.drop_every = drop_every > 0 ? drop_every : 997;
+    uint8_t *gap_stream = ts_gen_stream(&gap_config, &gap_info);
+    if(!stream || !gap_stream) {
+        fprintf(stderr, "generate stream failed\n");
+        return 2;
+    }
+    printf("stream       %.2f MB, %u s, %u video frames (%u key), %u audio frames in %u per pes, pts wraps at %lld s\n",
+           info.size / 1048576.0, config.seconds, info.video_frames, info.keyframes, info.audio_frames,
+           config.audio_frames_per_pes, (long long)before_wrap);
+
+    /*
+     clean: 每一帧都要出来，时间戳穿过回绕仍然递增
+     */
+    bench_output_t out;
+    demuxer_stats_t stats;
+    demux(stream, info.size, 1316, use_pool, &out, &stats);
+    int64_t span = out.last_video_pts - out.first_video_pts;
+    int64_t expected_span = (int64_t)(info.video_frames - 1) * 1000 / config.fps;
+    snprintf(detail, sizeof(detail), "video %llu/%u (%llu key), audio %llu/%u, %llu backwards, %llu malformed, pts span %lld ms (want %lld)",
+             (unsigned long long)out.video_frames, info.video_frames, (unsigned long long)out.keyframes,
+             (unsigned long long)out.audio_frames, info.audio_frames, (unsigned long long)out.backwards,
+             (unsigned long long)stats.malformed_tags, (long long)span, (long long)expected_span);
+    failures += check("clean", out.video_frames == info.video_frames && out.audio_frames == info.audio_frames &&
+                      out.keyframes == info.keyframes && out.backwards == 0 && stats.malformed_tags == 0 &&
+                      span >= expected_span - 1 && span <= expected_span + 1, detail);
+
+    /*
+     cc gaps: 每个缺口报一次，最多丢掉缺口前后两个pes
+     */
+    demux(gap_stream, gap_info.size, 1316, use_pool, &out, &stats);
+    uint64_t video_lost = gap_info.video_frames - out.video_frames;
+    uint64_t audio_lost = gap_info.audio_frames - out.audio_frames;
+    uint32_t per_pes = config.audio_frames_per_pes > 0 ? config.audio_frames_per_pes : 1;
+    snprintf(detail, sizeof(detail), "%u packets dropped, %llu reported, video lost %llu (%u pes hit), audio lost %llu (%u pes hit), %llu backwards",
+             gap_info.dropped_packets, (unsigned long long)stats.malformed_tags, (unsigned long long)video_lost, gap_info.damaged_video_pes,
+             (unsigned long long)audio_lost, gap_info.damaged_audio_pes, (unsigned long long)out.backwards);
+    failures += check("cc gaps", stats.malformed_tags == gap_info.dropped_packets &&
+                      video_lost >= gap_info.damaged_video_pes && audio_lost >= gap_info.damaged_audio_pes &&
+                      video_lost + audio_lost / per_pes <= 2ull * gap_info.dropped_packets &&
+                      out.backwards == 0, detail);
+
+    /*
+     throughput
+     */
+    printf("%-12s %10s %12s %10s\n", "chunk", "MB/s", "frames/s", "ns/frame");
+    for(int c = 0;c < chunk_count;++c) {
+        double mbps[BENCH_MAX_ROUNDS], fps[BENCH_MAX_ROUNDS];
+        for(int r = 0;r < rounds;++r) {
+            double seconds = demux(stream, info.size, chunks[c], use_pool, &out, NULL);
+            mbps[r] = info.size / 1048576.0 / seconds;
+            fps[r] = (out.video_frames + out.audio_frames) / seconds;
+        }
+        double frames_per_second = median(fps, rounds);
+        printf("%-12u %10.1f %12.0f %10.1f\n", chunks[c], median(mbps, rounds), frames_per_second, 1e9 / frames_per_second);
+    }
+
+    free(gap_stream);
+    free(stream);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,294 @@
+//
+//  ts_gen.h
+//  VoodooLivePlayer
+//
+//  Created by voodoo on 2026/10/17.
+//  Copyright © 2026 Voodoo-Live. All rights reserved.
+//
+//  deterministic synthetic mpeg-ts stream for the benchmarks: pat/pmt,
+//  h264 pes and adts aac pes. same config and seed always give the same bytes.
+//
+
+#ifndef ts_gen_h
+#define ts_gen_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TS_GEN_PMT_PID      0x1000
+#define TS_GEN_VIDEO_PID    0x100
+#define TS_GEN_AUDIO_PID    0x101
+#define TS_GEN_WRAP         (1LL << 33)
+
+typedef struct ts_gen_config_s {
+    uint32_t seconds;
+    uint32_t video_kbps;        /*  0 for an audio only stream              */
+    uint32_t fps;
+    uint32_t gop;               /*  frames per keyframe interval            */
+    uint32_t key_ratio;         /*  keyframe size / average inter frame     */
+    uint32_t audio_kbps;        /*  0 for a video only stream, aac 44.1k    */
+    uint32_t audio_frames_per_pes;
+    /*
+     90 kHz pts of the first frame, the 33 bit clock wraps in the stream
+     when it is close to TS_GEN_WRAP
+     */
+    int64_t start_pts;
+    /*
+     every n-th audio/video ts packet is left out, a continuity counter gap.
+     0 drops nothing
+     */
+    uint32_t drop_every;
+    uint32_t seed;
+} ts_gen_config_t;
+
+typedef struct ts_gen_info_s {
+    uint32_t size;
+    uint32_t packets;
+    uint32_t video_frames;
+    uint32_t audio_frames;
+    uint32_t keyframes;
+    uint32_t dropped_packets;
+    /*
+     pes that lost a packet. a gap at the start of a pes also costs the one
+     before it, which only ends with that start
+     */
+    uint32_t damaged_video_pes;
+    uint32_t damaged_audio_pes;
+} ts_gen_info_t;
+
+static inline void ts_gen_default_config(ts_gen_config_t *config) {
+    memset(config, 0, sizeof(ts_gen_config_t));
+    config->seconds = 60;
+    config->video_kbps = 2000;
+    config->fps = 25;
+    config->gop = 50;
+    config->key_ratio = 6;
+    config->audio_kbps = 128;
+    config->audio_frames_per_pes = 2;
+    config->seed = 1;
+}
+
+typedef struct ts_gen_buffer_s {
+    uint8_t *data;
+    uint32_t size;
+    uint32_t capacity;
+    uint32_t seed;
+    uint8_t cc[0x2000];
+    uint32_t media_packets;
+    uint32_t drop_every;
+    ts_gen_info_t info;
+} ts_gen_buffer_t;
+
+static inline uint32_t ts_gen_rand(ts_gen_buffer_t *b) {
+    b->seed ^= b->seed << 13; b->seed ^= b->seed >> 17; b->seed ^= b->seed << 5;
+    return b->seed;
+}
+
+static inline uint8_t* ts_gen_reserve(ts_gen_buffer_t *b, uint32_t size) {
+    if(b->size + size > b->capacity) {
+        uint32_t capacity = b->capacity ? b->capacity : 1 << 20;
+        while(capacity < b->size + size) capacity *= 2;
+        uint8_t *data = (uint8_t*)realloc(b->data, capacity);
+        if(!data) return NULL;
+        b->data = data;
+        b->capacity = capacity;
+    }
+    return b->data + b->size;
+}
+
+static inline uint32_t ts_gen_crc32(const uint8_t *p, uint32_t size) {
+    uint32_t crc = 0xffffffff;
+    for(uint32_t i = 0;i < size;++i) {
+        crc ^= (uint32_t)p[i] << 24;
+        for(int k = 0;k < 8;++k) crc = crc & 0x80000000 ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+    }
+    return crc;
+}
+
+/*
+ one pes or section split over 188 byte packets, stuffing in the adaptation
+ field. returns 1 when a packet of it was dropped, -1 on allocation failure
+ */
+static inline int ts_gen_write(ts_gen_buffer_t *b, int pid, const uint8_t *data, uint32_t size, int random_access) {
+    int first = 1, damaged = 0;
+    while(size > 0 || first) {
+        uint8_t *p = ts_gen_reserve(b, 188);
+        if(!p) return -1;
+        uint32_t adaptation = first && random_access ? 2 : 0;
+        if(size + adaptation < 184) {
+            adaptation = 184 - size;
+        }
+        uint32_t n = 184 - adaptation;
+        p[0] = 0x47;
+        p[1] = (uint8_t)((first ? 0x40 : 0) | (pid >> 8));
+        p[2] = (uint8_t)pid;
+        p[3] = (uint8_t)((adaptation ? 0x30 : 0x10) | (b->cc[pid]++ & 0x0f));
+        if(adaptation) {
+            p[4] = (uint8_t)(adaptation - 1);
+            if(adaptation > 1) {
+                p[5] = first && random_access ? 0x40 : 0;
+                memset(p + 6, 0xff, adaptation - 2);
+            }
+        }
+        memcpy(p + 4 + adaptation, data, n);
+        data += n;
+        size -= n;
+        first = 0;
+        if(pid != 0 && pid != TS_GEN_PMT_PID && b->drop_every > 0 && ++b->media_packets % b->drop_every == 0) {
+            b->info.dropped_packets++;
+            damaged = 1;
+            continue;
+        }
+        b->size += 188;
+        b->info.packets++;
+    }
+    return damaged;
+}
+
+static inline int ts_gen_tables(ts_gen_buffer_t *b, int has_video, int has_audio) {
+    uint8_t pat[] = { 0, 0x00, 0xb0, 13, 0, 1, 0xc1, 0, 0, 0, 1, 0xe0 | (TS_GEN_PMT_PID >> 8), TS_GEN_PMT_PID & 0xff, 0, 0, 0, 0 };
+    uint32_t crc = ts_gen_crc32(pat + 1, 12);
+    pat[13] = (uint8_t)(crc >> 24); pat[14] = (uint8_t)(crc >> 16); pat[15] = (uint8_t)(crc >> 8); pat[16] = (uint8_t)crc;
+    if(ts_gen_write(b, 0, pat, sizeof(pat), 0) < 0) return -1;
+
+    uint8_t pmt[32], *p = pmt;
+    int pcr_pid = has_video ? TS_GEN_VIDEO_PID : TS_GEN_AUDIO_PID;
+    *p++ = 0; *p++ = 0x02; *p++ = 0xb0; *p++ = 0;
+    *p++ = 0; *p++ = 1; *p++ = 0xc1; *p++ = 0; *p++ = 0;
+    *p++ = (uint8_t)(0xe0 | (pcr_pid >> 8)); *p++ = (uint8_t)pcr_pid; *p++ = 0xf0; *p++ = 0;
+    if(has_video) {
+        *p++ = 0x1b; *p++ = 0xe0 | (TS_GEN_VIDEO_PID >> 8); *p++ = TS_GEN_VIDEO_PID & 0xff; *p++ = 0xf0; *p++ = 0;
+    }
+    if(has_audio) {
+        *p++ = 0x0f; *p++ = 0xe0 | (TS_GEN_AUDIO_PID >> 8); *p++ = TS_GEN_AUDIO_PID & 0xff; *p++ = 0xf0; *p++ = 0;
+    }
+    /*
+     section_length算到crc结束，去掉前面4个字节再加上4字节crc正好是当前长度
+     */
+    pmt[3] = (uint8_t)(p - pmt);
+    crc = ts_gen_crc32(pmt + 1, (uint32_t)(p - pmt - 1));
+    *p++ = (uint8_t)(crc >> 24); *p++ = (uint8_t)(crc >> 16); *p++ = (uint8_t)(crc >> 8); *p++ = (uint8_t)crc;
+    return ts_gen_write(b, TS_GEN_PMT_PID, pmt, (uint32_t)(p - pmt), 0) < 0 ? -1 : 0;
+}
+
+static inline uint8_t* ts_gen_pes_header(uint8_t *p, int stream_id, uint32_t payload, int64_t pts) {
+    uint32_t length = stream_id == 0xe0 ? 0 : payload + 8;
+    pts &= TS_GEN_WRAP - 1;
+    p[0] = 0; p[1] = 0; p[2] = 1; p[3] = (uint8_t)stream_id;
+    p[4] = (uint8_t)(length >> 8); p[5] = (uint8_t)length;
+    p[6] = 0x80; p[7] = 0x80; p[8] = 5;
+    p[9] = (uint8_t)(0x21 | ((pts >> 29) & 0x0e));
+    p[10] = (uint8_t)(pts >> 22);
+    p[11] = (uint8_t)(0x01 | ((pts >> 14) & 0xfe));
+    p[12] = (uint8_t)(pts >> 7);
+    p[13] = (uint8_t)(0x01 | ((pts << 1) & 0xfe));
+    return p + 14;
+}
+
+/*
+ payload bytes without zero, so no start code emulation
+ */
+static inline void ts_gen_nonzero(ts_gen_buffer_t *b, uint8_t *p, uint32_t size) {
+    for(uint32_t i = 0;i < size;++i) p[i] = (uint8_t)(ts_gen_rand(b) | 1);
+}
+
+static const uint8_t ts_gen_sps_pps[] = {
+    0, 0, 0, 1, 0x67, 0x64, 0x00, 0x1f, 0xac, 0xd9, 0x40, 0x50, 0x05, 0xbb, 0x01, 0x10, 0x00, 0x00, 0x03, 0x00,
+    0x10, 0x00, 0x00, 0x03, 0x03, 0x20, 0xf1, 0x83, 0x19, 0x60,
+    0, 0, 0, 1, 0x68, 0xeb, 0xec, 0xb2, 0x2c
+};
+
+/*
+ h264 (aud-less, sps/pps in front of every keyframe) + adts aac, interleaved
+ by timestamp, pat/pmt before every keyframe. returns a malloc'ed buffer,
+ NULL on failure
+ */
+static inline uint8_t* ts_gen_stream(const ts_gen_config_t *config, ts_gen_info_t *info) {
+    ts_gen_buffer_t *b = (ts_gen_buffer_t*)calloc(1, sizeof(ts_gen_buffer_t));
+    int has_video = config->video_kbps > 0 && config->fps > 0;
+    int has_audio = config->audio_kbps > 0;
+    uint32_t frames = has_video ? config->seconds * config->fps : 0;
+    uint32_t audio_frames = has_audio ? (uint32_t)((uint64_t)config->seconds * 44100 / 1024) : 0;
+    uint32_t per_pes = config->audio_frames_per_pes > 0 ? config->audio_frames_per_pes : 1;
+    uint32_t gop = config->gop > 0 ? config->gop : 1;
+    uint32_t key_ratio = config->key_ratio > 0 ? config->key_ratio : 1;
+    uint64_t gop_bytes = has_video ? (uint64_t)config->video_kbps * 125 * gop / config->fps : 0;
+    uint32_t inter_size = (uint32_t)(gop_bytes / (gop - 1 + key_ratio));
+    uint32_t audio_size = has_audio ? (uint32_t)((uint64_t)config->audio_kbps * 125 * 1024 / 44100) : 0;
+    uint32_t v = 0, a = 0, pes_capacity = 0;
+    uint8_t *pes = NULL, *data;
+    int damaged;
+
+    if(!b) return NULL;
+    b->seed = config->seed ? config->seed : 1;
+    b->drop_every = config->drop_every;
+    if(!has_video && ts_gen_tables(b, 0, has_audio) < 0) goto fail;
+
+    while(v < frames || a < audio_frames) {
+        int64_t vts = v < frames ? (int64_t)v * 90000 / config->fps : INT64_MAX;
+        int64_t ats = a < audio_frames ? (int64_t)a * 1024 * 90000 / 44100 : INT64_MAX;
+        uint32_t need;
+        if(vts <= ats) {
+            int key = v % gop == 0;
+            uint32_t slice = key ? inter_size * key_ratio : inter_size;
+            if(slice < 2) slice = 2;
+            need = 14 + sizeof(ts_gen_sps_pps) + 5 + slice;
+        } else {
+            need = 14 + per_pes * (7 + audio_size);
+        }
+        if(need > pes_capacity) {
+            pes_capacity = need * 2;
+            free(pes);
+            pes = (uint8_t*)malloc(pes_capacity);
+            if(!pes) goto fail;
+        }
+        if(vts <= ats) {
+            int key = v % gop == 0;
+            uint32_t slice = need - 14 - sizeof(ts_gen_sps_pps) - 5;
+            uint32_t size = (key ? sizeof(ts_gen_sps_pps) : 0) + 5 + slice;
+            if(key && ts_gen_tables(b, 1, has_audio) < 0) goto fail;
+            data = ts_gen_pes_header(pes, 0xe0, size, config->start_pts + vts);
+            if(key) {
+                memcpy(data, ts_gen_sps_pps, sizeof(ts_gen_sps_pps));
+                data += sizeof(ts_gen_sps_pps);
+            }
+            data[0] = 0; data[1] = 0; data[2] = 0; data[3] = 1; data[4] = key ? 0x65 : 0x41;
+            ts_gen_nonzero(b, data + 5, slice);
+            if((damaged = ts_gen_write(b, TS_GEN_VIDEO_PID, pes, 14 + size, key)) < 0) goto fail;
+            b->info.damaged_video_pes += (uint32_t)damaged;
+            b->info.video_frames++;
+            b->info.keyframes += (uint32_t)key;
+            ++v;
+        } else {
+            uint32_t n = audio_frames - a < per_pes ? audio_frames - a : per_pes;
+            uint32_t frame = 7 + audio_size;
+            data = ts_gen_pes_header(pes, 0xc0, n * frame, config->start_pts + ats);
+            /*
+             adts aac lc 44.1k stereo, no crc
+             */
+            for(uint32_t i = 0;i < n;++i, data += frame) {
+                data[0] = 0xff; data[1] = 0xf1; data[2] = 0x50; data[3] = (uint8_t)(0x80 | (frame >> 11));
+                data[4] = (uint8_t)(frame >> 3); data[5] = (uint8_t)(((frame & 7) << 5) | 0x1f); data[6] = 0xfc;
+                ts_gen_nonzero(b, data + 7, audio_size);
+            }
+            if((damaged = ts_gen_write(b, TS_GEN_AUDIO_PID, pes, 14 + n * frame, 0)) < 0) goto fail;
+            b->info.damaged_audio_pes += (uint32_t)damaged;
+            b->info.audio_frames += n;
+            a += n;
+        }
+    }
+    free(pes);
+    b->info.size = b->size;
+    if(info) *info = b->info;
+    data = b->data;
+    free(b);
+    return data;
+fail:
+    free(pes);
+    free(b->data);
+    free(b);
+    return NULL;
+}
+
+#endif /* ts_gen_h */